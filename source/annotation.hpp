@@ -0,0 +1,227 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdlib>
+#include <stddef.h>
+
+namespace reshade
+{
+	/// <summary>
+	/// A typed annotation value. Numeric values are stored as is, so reading them never involves any string parsing.
+	/// </summary>
+	class annotation
+	{
+	public:
+		enum class datatype
+		{
+			none,
+			signed_integer,
+			unsigned_integer,
+			floating_point,
+			string
+		};
+
+		annotation() { }
+		annotation(const char *value) : annotation(std::string(value)) { }
+		annotation(const std::string &value) : _type(datatype::string), _count(1), _string(value) { }
+		annotation(const int *values, size_t count) : _type(datatype::signed_integer), _count(count)
+		{
+			for (size_t i = 0; i < count; i++)
+				scalar_at(i).as_int = values[i];
+		}
+		annotation(const unsigned int *values, size_t count) : _type(datatype::unsigned_integer), _count(count)
+		{
+			for (size_t i = 0; i < count; i++)
+				scalar_at(i).as_uint = values[i];
+		}
+		annotation(const float *values, size_t count) : _type(datatype::floating_point), _count(count)
+		{
+			for (size_t i = 0; i < count; i++)
+				scalar_at(i).as_float = values[i];
+		}
+
+		/// <summary>
+		/// Returns the type the value was declared with in the effect file.
+		/// </summary>
+		datatype type() const { return _type; }
+		/// <summary>
+		/// Returns the number of components in the value.
+		/// </summary>
+		size_t size() const { return _count; }
+
+		template <typename T>
+		T as(size_t index = 0) const;
+
+	private:
+		static const size_t inline_capacity = 4;
+
+		union scalar
+		{
+			int as_int;
+			unsigned int as_uint;
+			float as_float;
+		};
+
+		scalar &scalar_at(size_t index)
+		{
+			if (index < inline_capacity)
+			{
+				return _values[index];
+			}
+
+			// Values with more components than fit into the inline storage spill over onto the heap
+			if (_overflow.size() <= index - inline_capacity)
+			{
+				_overflow.resize(index - inline_capacity + 1);
+			}
+
+			return _overflow[index - inline_capacity];
+		}
+		const scalar &scalar_at(size_t index) const
+		{
+			return index < inline_capacity ? _values[index] : _overflow[index - inline_capacity];
+		}
+
+		static std::string format_float(float value)
+		{
+			// Use as few digits as possible while still reading back the same value, so that "0.5" stays "0.5" rather than becoming "0.500000"
+			char buffer[32];
+			for (int precision = 1; precision < 9; precision++)
+			{
+				std::snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+				if (std::strtof(buffer, nullptr) == value)
+					return buffer;
+			}
+
+			std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+			return buffer;
+		}
+
+		datatype _type = datatype::none;
+		size_t _count = 0;
+		scalar _values[inline_capacity] = { };
+		std::vector<scalar> _overflow;
+		std::string _string;
+	};
+
+	template <>
+	inline int annotation::as<int>(size_t i) const
+	{
+		if (i >= _count)
+		{
+			return 0;
+		}
+
+		switch (_type)
+		{
+			case datatype::signed_integer:
+				return scalar_at(i).as_int;
+			case datatype::unsigned_integer:
+				return static_cast<int>(scalar_at(i).as_uint);
+			case datatype::floating_point:
+				return static_cast<int>(scalar_at(i).as_float);
+			case datatype::string:
+				return static_cast<int>(std::strtol(_string.c_str(), nullptr, 10));
+			default:
+				return 0;
+		}
+	}
+	template <>
+	inline unsigned int annotation::as<unsigned int>(size_t i) const
+	{
+		if (i >= _count)
+		{
+			return 0u;
+		}
+
+		switch (_type)
+		{
+			case datatype::signed_integer:
+				return static_cast<unsigned int>(scalar_at(i).as_int);
+			case datatype::unsigned_integer:
+				return scalar_at(i).as_uint;
+			case datatype::floating_point:
+				return static_cast<unsigned int>(scalar_at(i).as_float);
+			case datatype::string:
+				return static_cast<unsigned int>(std::strtoul(_string.c_str(), nullptr, 10));
+			default:
+				return 0u;
+		}
+	}
+	template <>
+	inline float annotation::as<float>(size_t i) const
+	{
+		if (i >= _count)
+		{
+			return 0.0f;
+		}
+
+		switch (_type)
+		{
+			case datatype::signed_integer:
+				return static_cast<float>(scalar_at(i).as_int);
+			case datatype::unsigned_integer:
+				return static_cast<float>(scalar_at(i).as_uint);
+			case datatype::floating_point:
+				return scalar_at(i).as_float;
+			case datatype::string:
+				return static_cast<float>(std::strtod(_string.c_str(), nullptr));
+			default:
+				return 0.0f;
+		}
+	}
+	template <>
+	inline std::string annotation::as<std::string>(size_t i) const
+	{
+		if (i >= _count)
+		{
+			return std::string();
+		}
+
+		// Numeric values are only converted to their string form when actually requested
+		switch (_type)
+		{
+			case datatype::signed_integer:
+				return std::to_string(scalar_at(i).as_int);
+			case datatype::unsigned_integer:
+				return std::to_string(scalar_at(i).as_uint);
+			case datatype::floating_point:
+				return format_float(scalar_at(i).as_float);
+			case datatype::string:
+				return _string;
+			default:
+				return std::string();
+		}
+	}
+	template <>
+	inline bool annotation::as<bool>(size_t i) const
+	{
+		if (_type == datatype::string)
+		{
+			return as<int>(i) != 0 || (i < _count && (_string == "true" || _string == "True" || _string == "TRUE"));
+		}
+
+		return as<int>(i) != 0;
+	}
+
+	/// <summary>
+	/// Look up an annotation by name. Unlike 'operator[]', this does not insert missing annotations into the map.
+	/// </summary>
+	/// <param name="annotations">The annotations of an effect object.</param>
+	/// <param name="name">The name of the annotation to find.</param>
+	/// <returns>The annotation, or an empty value which converts to zero or an empty string if it does not exist.</returns>
+	inline const annotation &find_annotation(const std::unordered_map<std::string, annotation> &annotations, const std::string &name)
+	{
+		static const annotation empty;
+		const auto it = annotations.find(name);
+		return it != annotations.end() ? it->second : empty;
+	}
+}
@@ -4,6 +4,8 @@
  */
 
 #include "effect_syntax_tree.hpp"
+#include <math.h>
+#include <string.h>
 #include <algorithm>
 
 namespace reshadefx
@@ -328,6 +330,11 @@ namespace reshadefx
 					DOFOLDING2_BOOL(||);
 					break;
 			}
+
+			if (left->constant == nullptr)
+			{
+				left->constant = right->constant;
+			}
 		}
 		else if (expression->id == nodeid::intrinsic_expression)
 		{
@@ -428,6 +435,11 @@ namespace reshadefx
 				{
 					vector_literal_cast(static_cast<literal_expression_node *>(argument), k, literal, j);
 				}
+
+				if (literal->constant == nullptr)
+				{
+					literal->constant = static_cast<literal_expression_node *>(argument)->constant;
+				}
 			}
 
 			expression = literal;
@@ -443,6 +455,7 @@ namespace reshadefx
 
 			const auto literal = ast.make_node<literal_expression_node>(expression->location);
 			literal->type = expression->type;
+			literal->constant = variable;
 			expression = literal;
 
 			for (unsigned int i = 0, size = std::min(variable->initializer_expression->type.rows * variable->initializer_expression->type.cols, literal->type.rows * literal->type.cols); i < size; ++i)
@@ -5,6 +5,8 @@
 
 #include "d3d10_runtime.hpp"
 #include "d3d10_effect_compiler.hpp"
+#include "render_graph.hpp"
+#include "dds_file.hpp"
 #include <assert.h>
 #include <iomanip>
 #include <fstream>
@@ -16,10 +18,6 @@ namespace reshade::d3d10
 	using namespace reshadefx;
 	using namespace reshadefx::nodes;
 
-	static inline size_t roundto16(size_t size)
-	{
-		return (size + 15) & ~15;
-	}
 	static D3D10_BLEND literal_to_blend_func(unsigned int value)
 	{
 		switch (value)
@@ -228,6 +226,9 @@ namespace reshade::d3d10
 		{
 			visit(_global_code, node);
 		}
+
+		std::vector<const variable_declaration_node *> uniforms;
+
 		for (auto uniform : _ast.variables)
 		{
 			if (uniform->type.is_texture())
@@ -240,7 +241,7 @@ namespace reshade::d3d10
 			}
 			else if (uniform->type.has_qualifier(type_node::qualifier_uniform))
 			{
-				visit_uniform(uniform);
+				uniforms.push_back(uniform);
 			}
 			else
 			{
@@ -249,6 +250,9 @@ namespace reshade::d3d10
 				_global_code << ";\n";
 			}
 		}
+
+		visit_uniforms(uniforms);
+
 		for (auto function : _ast.functions)
 		{
 			visit(_global_code, function);
@@ -258,18 +262,29 @@ namespace reshade::d3d10
 			visit_technique(technique);
 		}
 
-		if (_constant_buffer_size != 0)
+		if (_constant_buffer_size != 0 || _frame_constant_buffer_size != 0)
 		{
-			_constant_buffer_size = roundto16(_constant_buffer_size);
-			_runtime->get_uniform_value_storage().resize(_uniform_storage_offset + _constant_buffer_size);
+			d3d10_constant_buffers constant_buffers;
+			constant_buffers.user_buffer_size = static_cast<UINT>(_constant_buffer_size);
+			constant_buffers.frame_buffer_size = static_cast<UINT>(_frame_constant_buffer_size);
 
-			const CD3D10_BUFFER_DESC globals_desc(static_cast<UINT>(_constant_buffer_size), D3D10_BIND_CONSTANT_BUFFER, D3D10_USAGE_DYNAMIC, D3D10_CPU_ACCESS_WRITE);
-			const D3D10_SUBRESOURCE_DATA globals_initial = { _runtime->get_uniform_value_storage().data(), static_cast<UINT>(_constant_buffer_size) };
+			if (_constant_buffer_size != 0)
+			{
+				// User-modifiable uniforms rarely change, so they are updated via 'UpdateSubresource' instead of being mapped every frame
+				const CD3D10_BUFFER_DESC globals_desc(static_cast<UINT>(_constant_buffer_size), D3D10_BIND_CONSTANT_BUFFER, D3D10_USAGE_DEFAULT);
+				const D3D10_SUBRESOURCE_DATA globals_initial = { _runtime->get_uniform_value_storage().data() + _uniform_storage_offset, static_cast<UINT>(_constant_buffer_size) };
 
-			com_ptr<ID3D10Buffer> constant_buffer;
-			_runtime->_device->CreateBuffer(&globals_desc, &globals_initial, &constant_buffer);
+				_runtime->_device->CreateBuffer(&globals_desc, &globals_initial, &constant_buffers.user_buffer);
+			}
+			if (_frame_constant_buffer_size != 0)
+			{
+				const CD3D10_BUFFER_DESC globals_desc(static_cast<UINT>(_frame_constant_buffer_size), D3D10_BIND_CONSTANT_BUFFER, D3D10_USAGE_DYNAMIC, D3D10_CPU_ACCESS_WRITE);
+				const D3D10_SUBRESOURCE_DATA globals_initial = { _runtime->get_uniform_value_storage().data() + _uniform_storage_offset + _constant_buffer_size, static_cast<UINT>(_frame_constant_buffer_size) };
+
+				_runtime->_device->CreateBuffer(&globals_desc, &globals_initial, &constant_buffers.frame_buffer);
+			}
 
-			_runtime->_constant_buffers.push_back(std::move(constant_buffer));
+			_runtime->_constant_buffers.push_back(std::move(constant_buffers));
 		}
 
 		FreeLibrary(_d3dcompiler_module);
@@ -1566,6 +1581,13 @@ namespace reshade::d3d10
 			texdesc.BindFlags = D3D10_BIND_SHADER_RESOURCE | D3D10_BIND_RENDER_TARGET;
 			texdesc.MiscFlags = D3D10_RESOURCE_MISC_GENERATE_MIPS;
 
+			// Block-compressed formats cannot be rendered to, their mipmaps are loaded from the image file instead of being generated
+			if (dds::is_block_compressed(obj.format))
+			{
+				texdesc.BindFlags = D3D10_BIND_SHADER_RESOURCE;
+				texdesc.MiscFlags = 0;
+			}
+
 			if (node->semantic == "COLOR" || node->semantic == "SV_TARGET")
 			{
 				obj.width = _runtime->frame_width();
@@ -1697,25 +1719,84 @@ namespace reshade::d3d10
 
 		_global_code << ", __SamplerState" << it->second << " };\n";
 	}
-	void d3d10_effect_compiler::visit_uniform(const variable_declaration_node *node)
+	void d3d10_effect_compiler::visit_uniforms(const std::vector<const variable_declaration_node *> &nodes)
+	{
+		std::vector<const variable_declaration_node *> user_uniforms, frame_uniforms;
+
+		// Uniforms with a source annotation are updated by the runtime every frame, so keep them in a separate constant buffer
+		// This way the user-modifiable uniforms only have to be uploaded when their value actually changes
+		for (auto node : nodes)
+		{
+			if (node->annotation_list.count("source"))
+			{
+				frame_uniforms.push_back(node);
+			}
+			else
+			{
+				user_uniforms.push_back(node);
+			}
+		}
+
+		_constant_buffer_size = visit_uniform_buffer(_global_uniforms, user_uniforms, _uniform_storage_offset);
+		_frame_constant_buffer_size = visit_uniform_buffer(_global_frame_uniforms, frame_uniforms, _uniform_storage_offset + _constant_buffer_size);
+	}
+	size_t d3d10_effect_compiler::visit_uniform_buffer(std::stringstream &output, const std::vector<const variable_declaration_node *> &nodes, size_t storage_offset)
+	{
+		std::vector<uniform_layout_entry> layout(nodes.size());
+
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			layout[i].rows = nodes[i]->type.rows;
+			layout[i].columns = nodes[i]->type.cols;
+			layout[i].elements = std::max(0, nodes[i]->type.array_length);
+		}
+
+		// Reorder uniforms to minimize padding in the constant buffer
+		const size_t size = compute_uniform_layout(uniform_layout_rules::hlsl_cbuffer, layout);
+
+		_runtime->get_uniform_value_storage().resize(storage_offset + size);
+
+		// Add uniforms in declaration order, but emit their declarations in order of their offset
+		std::vector<std::stringstream> declarations(nodes.size());
+
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			visit_uniform(declarations[i], nodes[i], layout[i], storage_offset);
+		}
+
+		for (const size_t index : sort_uniform_layout(layout))
+		{
+			output << declarations[index].str();
+		}
+
+		return size;
+	}
+	void d3d10_effect_compiler::visit_uniform(std::stringstream &output, const variable_declaration_node *node, const uniform_layout_entry &layout, size_t storage_offset)
 	{
-		visit(_global_uniforms, node->type);
+		visit(output, node->type);
 
-		_global_uniforms << ' ' << node->unique_name;
+		output << ' ' << node->unique_name;
 
 		if (node->type.is_array())
 		{
-			_global_uniforms << '[';
+			output << '[';
 
 			if (node->type.array_length > 0)
 			{
-				_global_uniforms << node->type.array_length;
+				output << node->type.array_length;
 			}
 
-			_global_uniforms << ']';
+			output << ']';
+		}
+
+		output << " : packoffset(c" << layout.register_index();
+
+		if (layout.register_component() != 0)
+		{
+			output << '.' << "xyzw"[layout.register_component()];
 		}
 
-		_global_uniforms << ";\n";
+		output << ");\n";
 
 		uniform obj;
 		obj.name = node->name;
@@ -1725,19 +1806,11 @@ namespace reshade::d3d10
 		obj.columns = node->type.cols;
 		obj.elements = node->type.array_length;
 		obj.storage_size = node->type.rows * node->type.cols * std::max(1u, obj.elements) * 4;
+		obj.storage_offset = storage_offset + layout.offset;
 		obj.annotations = node->annotation_list;
 
-		const UINT alignment = 16 - (_constant_buffer_size % 16);
-		_constant_buffer_size += static_cast<UINT>((obj.storage_size > alignment && (alignment != 16 || obj.storage_size <= 16)) ? obj.storage_size + alignment : obj.storage_size);
-		obj.storage_offset = _uniform_storage_offset + _constant_buffer_size - obj.storage_size;
-
 		auto &uniform_storage = _runtime->get_uniform_value_storage();
 
-		if (_uniform_storage_offset + _constant_buffer_size >= uniform_storage.size())
-		{
-			uniform_storage.resize(uniform_storage.size() + 128);
-		}
-
 		if (node->initializer_expression != nullptr && node->initializer_expression->id == nodeid::literal_expression)
 		{
 			CopyMemory(uniform_storage.data() + obj.storage_offset, &static_cast<const literal_expression_node *>(node->initializer_expression)->value_float, obj.storage_size);
@@ -1757,14 +1830,22 @@ namespace reshade::d3d10
 		obj.annotations = node->annotation_list;
 
 		auto obj_data = obj.impl->as<d3d10_technique_data>();
-		D3D10_QUERY_DESC query_desc = { };
-		query_desc.Query = D3D10_QUERY_TIMESTAMP;
-		_runtime->_device->CreateQuery(&query_desc, &obj_data->timestamp_query_beg);
-		_runtime->_device->CreateQuery(&query_desc, &obj_data->timestamp_query_end);
-		query_desc.Query = D3D10_QUERY_TIMESTAMP_DISJOINT;
-		_runtime->_device->CreateQuery(&query_desc, &obj_data->timestamp_disjoint);
+		obj_data->timestamp_disjoint.resize(obj_data->query_slots.size());
+		obj_data->timestamp_query_beg.resize(obj_data->query_slots.size());
+		obj_data->timestamp_query_end.resize(obj_data->query_slots.size());
+		obj_data->pass_timestamps_issued.resize(obj_data->query_slots.size());
 
-		if (_constant_buffer_size != 0)
+		for (size_t i = 0; i < obj_data->query_slots.size(); i++)
+		{
+			D3D10_QUERY_DESC query_desc = { };
+			query_desc.Query = D3D10_QUERY_TIMESTAMP;
+			_runtime->_device->CreateQuery(&query_desc, &obj_data->timestamp_query_beg[i]);
+			_runtime->_device->CreateQuery(&query_desc, &obj_data->timestamp_query_end[i]);
+			query_desc.Query = D3D10_QUERY_TIMESTAMP_DISJOINT;
+			_runtime->_device->CreateQuery(&query_desc, &obj_data->timestamp_disjoint[i]);
+		}
+
+		if (_constant_buffer_size != 0 || _frame_constant_buffer_size != 0)
 		{
 			obj.uniform_storage_index = _runtime->_constant_buffers.size();
 			obj.uniform_storage_offset = _uniform_storage_offset;
@@ -1776,6 +1857,34 @@ namespace reshade::d3d10
 			visit_pass(pass, *static_cast<d3d10_pass_data *>(obj.passes.back().get()));
 		}
 
+		// Describe the state of every pass once now, so that rendering can compare it to what is bound already without looking at the individual objects
+		for (const auto &pass_object : obj.passes)
+		{
+			auto &pass = *pass_object->as<d3d10_pass_data>();
+			auto &state = pass.state;
+
+			state.add(render_graph::pass_state::shaders, reinterpret_cast<uintptr_t>(pass.vertex_shader.get()));
+			state.add(render_graph::pass_state::shaders, reinterpret_cast<uintptr_t>(pass.pixel_shader.get()));
+			state.add(render_graph::pass_state::blend_state, reinterpret_cast<uintptr_t>(pass.blend_state.get()));
+			state.add(render_graph::pass_state::depth_stencil_state, reinterpret_cast<uintptr_t>(pass.depth_stencil_state.get()));
+			state.add(render_graph::pass_state::depth_stencil_state, pass.stencil_reference);
+
+			for (const auto &target : pass.render_targets)
+			{
+				state.add(render_graph::pass_state::render_targets, reinterpret_cast<uintptr_t>(target.get()));
+			}
+			for (const auto &resource : pass.shader_resources)
+			{
+				state.add(render_graph::pass_state::shader_resources, reinterpret_cast<uintptr_t>(resource.get()));
+			}
+
+			// The viewport size also decides whether the default depth stencil is bound with the render targets
+			state.add(render_graph::pass_state::render_targets, static_cast<uintptr_t>(pass.viewport.Width));
+			state.add(render_graph::pass_state::render_targets, static_cast<uintptr_t>(pass.viewport.Height));
+			state.add(render_graph::pass_state::viewport, static_cast<uintptr_t>(pass.viewport.Width));
+			state.add(render_graph::pass_state::viewport, static_cast<uintptr_t>(pass.viewport.Height));
+		}
+
 		_runtime->add_technique(std::move(obj));
 	}
 	void d3d10_effect_compiler::visit_pass(const pass_declaration_node *node, d3d10_pass_data &pass)
@@ -1786,7 +1895,6 @@ namespace reshade::d3d10
 		pass.viewport.MaxDepth = 1.0f;
 		pass.clear_render_targets = node->clear_render_targets;
 		ZeroMemory(pass.render_targets, sizeof(pass.render_targets));
-		ZeroMemory(pass.render_target_resources, sizeof(pass.render_target_resources));
 		pass.shader_resources = _runtime->_effect_shader_resources;
 
 		if (node->vertex_shader != nullptr)
@@ -1800,7 +1908,6 @@ namespace reshade::d3d10
 
 		const int target_index = node->srgb_write_enable ? 1 : 0;
 		pass.render_targets[0] = _runtime->_backbuffer_rtv[target_index];
-		pass.render_target_resources[0] = _runtime->_backbuffer_texture_srv[target_index];
 
 		for (unsigned int i = 0; i < 8; i++)
 		{
@@ -1848,7 +1955,6 @@ namespace reshade::d3d10
 			}
 
 			pass.render_targets[i] = texture_impl->rtv[target_index];
-			pass.render_target_resources[i] = texture_impl->srv[target_index];
 		}
 
 		if (pass.viewport.Width == 0 && pass.viewport.Height == 0)
@@ -1994,6 +2100,11 @@ namespace reshade::d3d10
 
 		source += "cbuffer __GLOBAL__ : register(b0)\n{\n" + _global_uniforms.str() + "};\n";
 
+		if (_frame_constant_buffer_size != 0)
+		{
+			source += "cbuffer __GLOBAL_FRAME__ : register(b1)\n{\n" + _global_frame_uniforms.str() + "};\n";
+		}
+
 		for (const auto &samplerdesc : _runtime->_effect_sampler_descs)
 		{
 			source += "SamplerState __SamplerState" + std::to_string(samplerdesc.second) + " : register(s" + std::to_string(samplerdesc.second) + ");\n";
@@ -2023,6 +2134,26 @@ namespace reshade::d3d10
 			flags |= D3DCOMPILE_SKIP_OPTIMIZATION;
 		}
 
+		// Reuse the shader compiled for another pass with identical code
+		const std::string shader_key = source + '\n' + node->unique_name + '\n' + profile + '\n' + std::to_string(flags);
+
+		if (shadertype == "vs")
+		{
+			if (const auto it = _runtime->_effect_vertex_shaders.find(shader_key); it != _runtime->_effect_vertex_shaders.end())
+			{
+				pass.vertex_shader = it->second;
+				return;
+			}
+		}
+		else if (shadertype == "ps")
+		{
+			if (const auto it = _runtime->_effect_pixel_shaders.find(shader_key); it != _runtime->_effect_pixel_shaders.end())
+			{
+				pass.pixel_shader = it->second;
+				return;
+			}
+		}
+
 		const auto D3DCompile = reinterpret_cast<pD3DCompile>(GetProcAddress(_d3dcompiler_module, "D3DCompile"));
 		HRESULT hr = D3DCompile(source.c_str(), source.length(), nullptr, nullptr, nullptr, node->unique_name.c_str(), profile.c_str(), flags, 0, &compiled, &errors);
 
@@ -2051,5 +2182,14 @@ namespace reshade::d3d10
 			error(node->location, "'CreateShader' failed with error code " + std::to_string(static_cast<unsigned long>(hr)) + "!");
 			return;
 		}
+
+		if (shadertype == "vs")
+		{
+			_runtime->_effect_vertex_shaders.emplace(shader_key, pass.vertex_shader);
+		}
+		else if (shadertype == "ps")
+		{
+			_runtime->_effect_pixel_shaders.emplace(shader_key, pass.pixel_shader);
+		}
 	}
 }
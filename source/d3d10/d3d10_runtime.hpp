@@ -7,6 +7,8 @@
 
 #include <d3d10_1.h>
 #include "runtime.hpp"
+#include "render_graph.hpp"
+#include "query_ring.hpp"
 #include "d3d10_stateblock.hpp"
 
 namespace reshade::d3d10
@@ -26,16 +28,23 @@ namespace reshade::d3d10
 		UINT stencil_reference;
 		bool clear_render_targets;
 		com_ptr<ID3D10RenderTargetView> render_targets[D3D10_SIMULTANEOUS_RENDER_TARGET_COUNT];
-		com_ptr<ID3D10ShaderResourceView> render_target_resources[D3D10_SIMULTANEOUS_RENDER_TARGET_COUNT];
 		D3D10_VIEWPORT viewport;
 		std::vector<com_ptr<ID3D10ShaderResourceView>> shader_resources;
+		render_graph::pass_state_desc state;
 	};
 	struct d3d10_technique_data : base_object
 	{
-		bool query_in_flight = false;
-		com_ptr<ID3D10Query> timestamp_disjoint;
-		com_ptr<ID3D10Query> timestamp_query_beg;
-		com_ptr<ID3D10Query> timestamp_query_end;
+		query_ring query_slots;
+		std::vector<com_ptr<ID3D10Query>> timestamp_disjoint;
+		std::vector<com_ptr<ID3D10Query>> timestamp_query_beg;
+		std::vector<com_ptr<ID3D10Query>> timestamp_query_end;
+		std::vector<com_ptr<ID3D10Query>> pass_timestamps;
+		std::vector<bool> pass_timestamps_issued;
+	};
+	struct d3d10_constant_buffers
+	{
+		com_ptr<ID3D10Buffer> user_buffer, frame_buffer;
+		UINT user_buffer_size = 0, frame_buffer_size = 0;
 	};
 
 	class d3d10_runtime : public runtime
@@ -53,11 +62,15 @@ namespace reshade::d3d10
 		void on_clear_depthstencil_view(ID3D10DepthStencilView *&depthstencil);
 		void on_copy_resource(ID3D10Resource *&dest, ID3D10Resource *&source);
 
-		void capture_frame(uint8_t *buffer) const override;
+		bool capture_frame(const std::function<void(const frame_data &)> &callback) const override;
 		bool load_effect(const reshadefx::syntax_tree &ast, std::string &errors) override;
 		bool update_texture(texture &texture, const uint8_t *data) override;
+		bool alias_texture(texture &texture, const texture &target) override;
+		bool copy_frame_to_staging(unsigned int slot) override;
+		bool map_frame_from_staging(unsigned int slot, frame_data &frame) override;
+		void unmap_frame_from_staging(unsigned int slot) override;
 
-		void render_technique(const technique &technique) override;
+		void render_technique(technique &technique) override;
 		void render_imgui_draw_data(ImDrawData *data) override;
 
 		com_ptr<ID3D10Device1> _device;
@@ -69,7 +82,9 @@ namespace reshade::d3d10
 		std::vector<com_ptr<ID3D10SamplerState>> _effect_sampler_states;
 		std::unordered_map<size_t, size_t> _effect_sampler_descs;
 		std::vector<com_ptr<ID3D10ShaderResourceView>> _effect_shader_resources;
-		std::vector<com_ptr<ID3D10Buffer>> _constant_buffers;
+		std::vector<d3d10_constant_buffers> _constant_buffers;
+		shader_registry<com_ptr<ID3D10VertexShader>> _effect_vertex_shaders;
+		shader_registry<com_ptr<ID3D10PixelShader>> _effect_pixel_shaders;
 
 	private:
 		struct depth_source_info
@@ -78,6 +93,10 @@ namespace reshade::d3d10
 			UINT drawcall_count, vertices_count;
 		};
 
+		bool create_capture_staging(com_ptr<ID3D10Texture2D> &texture) const;
+		bool map_capture_staging(ID3D10Texture2D *texture, frame_data &frame) const;
+		void unmap_capture_staging(ID3D10Texture2D *texture) const;
+
 		bool init_backbuffer_texture();
 		bool init_default_depth_stencil();
 		bool init_fx_resources();
@@ -87,7 +106,10 @@ namespace reshade::d3d10
 		void detect_depth_source();
 		bool create_depthstencil_replacement(ID3D10DepthStencilView *depthstencil);
 
+		void unbind_pass_resources(const d3d10_pass_data &pass);
+
 		bool _is_multisampling_enabled = false;
+		render_graph::pass_state_filter _pass_state_filter;
 		DXGI_FORMAT _backbuffer_format = DXGI_FORMAT_UNKNOWN;
 		d3d10_stateblock _stateblock;
 		com_ptr<ID3D10Texture2D> _backbuffer, _backbuffer_resolved;
@@ -99,6 +121,8 @@ namespace reshade::d3d10
 		com_ptr<ID3D10PixelShader> _copy_pixel_shader;
 		com_ptr<ID3D10SamplerState> _copy_sampler;
 		com_ptr<ID3D10RasterizerState> _effect_rasterizer_state;
+		std::vector<uint8_t> _texture_upload_buffer;
+		com_ptr<ID3D10Texture2D> _capture_staging[capture_ring_size];
 
 		com_ptr<ID3D10Buffer> _imgui_vertex_buffer, _imgui_index_buffer;
 		com_ptr<ID3D10VertexShader> _imgui_vertex_shader;
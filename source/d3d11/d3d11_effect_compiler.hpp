@@ -6,6 +6,7 @@
 #pragma once
 
 #include "effect_syntax_tree.hpp"
+#include "uniform_layout.hpp"
 #include <sstream>
 #include <unordered_set>
 
@@ -59,7 +60,9 @@ namespace reshade::d3d11
 
 		void visit_texture(const reshadefx::nodes::variable_declaration_node *node);
 		void visit_sampler(const reshadefx::nodes::variable_declaration_node *node);
-		void visit_uniform(const reshadefx::nodes::variable_declaration_node *node);
+		void visit_uniforms(const std::vector<const reshadefx::nodes::variable_declaration_node *> &nodes);
+		size_t visit_uniform_buffer(std::stringstream &output, const std::vector<const reshadefx::nodes::variable_declaration_node *> &nodes, size_t storage_offset);
+		void visit_uniform(std::stringstream &output, const reshadefx::nodes::variable_declaration_node *node, const uniform_layout_entry &layout, size_t storage_offset);
 		void visit_technique(const reshadefx::nodes::technique_declaration_node *node);
 		void visit_pass(const reshadefx::nodes::pass_declaration_node *node, d3d11_pass_data &pass);
 		void visit_pass_shader(const reshadefx::nodes::function_declaration_node *node, const std::string &shadertype, d3d11_pass_data &pass);
@@ -68,9 +71,9 @@ namespace reshade::d3d11
 		bool _success = true;
 		const reshadefx::syntax_tree &_ast;
 		std::string &_errors;
-		std::stringstream _global_code, _global_uniforms;
+		std::stringstream _global_code, _global_uniforms, _global_frame_uniforms;
 		bool _skip_shader_optimization, _is_in_parameter_block = false, _is_in_function_block = false;
-		size_t _uniform_storage_offset = 0, _constant_buffer_size = 0;
+		size_t _uniform_storage_offset = 0, _constant_buffer_size = 0, _frame_constant_buffer_size = 0;
 		HMODULE _d3dcompiler_module = nullptr;
 #if RESHADE_DUMP_NATIVE_SHADERS
 		filesystem::path _dump_filename;
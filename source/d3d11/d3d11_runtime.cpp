@@ -6,9 +6,12 @@
 #include "log.hpp"
 #include "d3d11_runtime.hpp"
 #include "d3d11_effect_compiler.hpp"
+#include "render_graph.hpp"
 #include "effect_lexer.hpp"
 #include "input.hpp"
 #include "resource_loading.hpp"
+#include "pixel_conversion.hpp"
+#include "dds_file.hpp"
 #include <imgui.h>
 #include <algorithm>
 
@@ -435,6 +438,7 @@ namespace reshade::d3d11
 		_width = desc.BufferDesc.Width;
 		_height = desc.BufferDesc.Height;
 		_backbuffer_format = desc.BufferDesc.Format;
+		_is_backbuffer_float = desc.BufferDesc.Format == DXGI_FORMAT_R16G16B16A16_FLOAT;
 		_is_multisampling_enabled = desc.SampleDesc.Count > 1;
 		_input = input::register_window(desc.OutputWindow);
 
@@ -467,6 +471,11 @@ namespace reshade::d3d11
 		// Destroy resources
 		_backbuffer.reset();
 		_backbuffer_resolved.reset();
+
+		for (auto &texture_staging : _capture_staging)
+		{
+			texture_staging.reset();
+		}
 		_backbuffer_texture.reset();
 		_backbuffer_texture_srv[0].reset();
 		_backbuffer_texture_srv[1].reset();
@@ -506,6 +515,8 @@ namespace reshade::d3d11
 		_effect_sampler_descs.clear();
 		_effect_sampler_states.clear();
 		_constant_buffers.clear();
+		_effect_vertex_shaders.clear();
+		_effect_pixel_shaders.clear();
 
 		_effect_shader_resources.resize(3);
 		_effect_shader_resources[0] = _backbuffer_texture_srv[0];
@@ -526,25 +537,48 @@ namespace reshade::d3d11
 		detect_depth_source(tracker);
 #endif
 
-		// Evaluate queries
+		// Evaluate queries of earlier frames that finished, without waiting for those that did not
 		for (technique &technique : _techniques)
 		{
 			d3d11_technique_data &technique_data = *technique.impl->as<d3d11_technique_data>();
 
-			if (technique.enabled && technique_data.query_in_flight)
-			{
+			technique_data.query_slots.poll([this, &technique, &technique_data](size_t index, uint64_t frame) {
 				UINT64 timestamp0, timestamp1;
 				D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint_data;
 
-				if (_immediate_context->GetData(technique_data.timestamp_disjoint.get(), &disjoint_data, sizeof(disjoint_data), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
-					_immediate_context->GetData(technique_data.timestamp_query_beg.get(), &timestamp0, sizeof(timestamp0), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
-					_immediate_context->GetData(technique_data.timestamp_query_end.get(), &timestamp1, sizeof(timestamp1), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK)
+				if (!(_immediate_context->GetData(technique_data.timestamp_disjoint[index].get(), &disjoint_data, sizeof(disjoint_data), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+					_immediate_context->GetData(technique_data.timestamp_query_beg[index].get(), &timestamp0, sizeof(timestamp0), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK &&
+					_immediate_context->GetData(technique_data.timestamp_query_end[index].get(), &timestamp1, sizeof(timestamp1), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK))
 				{
-					if (!disjoint_data.Disjoint)
-						technique.average_gpu_duration.append((timestamp1 - timestamp0) * 1'000'000'000 / disjoint_data.Frequency);
-					technique_data.query_in_flight = false;
+					return false;
 				}
-			}
+
+				// There is a timestamp before every pass and one after the last, if passes were measured in this frame
+				std::vector<UINT64> pass_timestamps(technique_data.pass_timestamps_issued[index] ? technique.passes.size() + 1 : 0);
+
+				for (size_t k = 0; k < pass_timestamps.size(); k++)
+				{
+					if (_immediate_context->GetData(technique_data.pass_timestamps[index * pass_timestamps.size() + k].get(), &pass_timestamps[k], sizeof(pass_timestamps[k]), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+					{
+						return false;
+					}
+				}
+
+				// Timestamps are unreliable if the GPU clock changed in between, so the results of such frames are dropped
+				if (!disjoint_data.Disjoint)
+				{
+					std::vector<uint64_t> pass_durations(pass_timestamps.empty() ? 0 : pass_timestamps.size() - 1);
+
+					for (size_t k = 0; k < pass_durations.size(); k++)
+					{
+						pass_durations[k] = (pass_timestamps[k + 1] - pass_timestamps[k]) * 1'000'000'000 / disjoint_data.Frequency;
+					}
+
+					record_gpu_timings(technique, frame, (timestamp1 - timestamp0) * 1'000'000'000 / disjoint_data.Frequency, pass_durations);
+				}
+
+				return true;
+			});
 		}
 
 		// Capture device state
@@ -615,7 +649,53 @@ namespace reshade::d3d11
 		_stateblock.apply_and_release();
 	}
 
-	void d3d11_runtime::capture_frame(uint8_t *buffer) const
+	bool d3d11_runtime::capture_frame(const std::function<void(const frame_data &)> &callback) const
+	{
+		com_ptr<ID3D11Texture2D> texture_staging;
+
+		if (!create_capture_staging(texture_staging))
+		{
+			return false;
+		}
+
+		_immediate_context->CopyResource(texture_staging.get(), _backbuffer_resolved.get());
+
+		frame_data frame;
+
+		if (!map_capture_staging(texture_staging.get(), frame))
+		{
+			return false;
+		}
+
+		callback(frame);
+
+		unmap_capture_staging(texture_staging.get());
+
+		return true;
+	}
+	bool d3d11_runtime::copy_frame_to_staging(unsigned int slot)
+	{
+		auto &texture_staging = _capture_staging[slot];
+
+		// Staging textures are kept around, so that repeated captures do not have to create new resources
+		if (texture_staging == nullptr && !create_capture_staging(texture_staging))
+		{
+			return false;
+		}
+
+		_immediate_context->CopyResource(texture_staging.get(), _backbuffer_resolved.get());
+
+		return true;
+	}
+	bool d3d11_runtime::map_frame_from_staging(unsigned int slot, frame_data &frame)
+	{
+		return _capture_staging[slot] != nullptr && map_capture_staging(_capture_staging[slot].get(), frame);
+	}
+	void d3d11_runtime::unmap_frame_from_staging(unsigned int slot)
+	{
+		unmap_capture_staging(_capture_staging[slot].get());
+	}
+	bool d3d11_runtime::create_capture_staging(com_ptr<ID3D11Texture2D> &texture) const
 	{
 		if (_backbuffer_format != DXGI_FORMAT_R8G8B8A8_UNORM &&
 			_backbuffer_format != DXGI_FORMAT_R8G8B8A8_UNORM_SRGB &&
@@ -623,7 +703,7 @@ namespace reshade::d3d11
 			_backbuffer_format != DXGI_FORMAT_B8G8R8A8_UNORM_SRGB)
 		{
 			LOG(WARNING) << "Screenshots are not supported for back buffer format " << _backbuffer_format << ".";
-			return;
+			return false;
 		}
 
 		D3D11_TEXTURE2D_DESC texture_desc = { };
@@ -636,49 +716,38 @@ namespace reshade::d3d11
 		texture_desc.Usage = D3D11_USAGE_STAGING;
 		texture_desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 
-		com_ptr<ID3D11Texture2D> texture_staging;
-
-		HRESULT hr = _device->CreateTexture2D(&texture_desc, nullptr, &texture_staging);
+		const HRESULT hr = _device->CreateTexture2D(&texture_desc, nullptr, &texture);
 
 		if (FAILED(hr))
 		{
 			LOG(ERROR) << "Failed to create staging resource for screenshot capture! HRESULT is '" << std::hex << hr << std::dec << "'.";
-			return;
+			return false;
 		}
 
-		_immediate_context->CopyResource(texture_staging.get(), _backbuffer_resolved.get());
-
+		return true;
+	}
+	bool d3d11_runtime::map_capture_staging(ID3D11Texture2D *texture, frame_data &frame) const
+	{
 		D3D11_MAPPED_SUBRESOURCE mapped;
-		hr = _immediate_context->Map(texture_staging.get(), 0, D3D11_MAP_READ, 0, &mapped);
+		const HRESULT hr = _immediate_context->Map(texture, 0, D3D11_MAP_READ, 0, &mapped);
 
 		if (FAILED(hr))
 		{
 			LOG(ERROR) << "Failed to map staging resource with screenshot capture! HRESULT is '" << std::hex << hr << std::dec << "'.";
-			return;
+			return false;
 		}
 
-		auto mapped_data = static_cast<BYTE *>(mapped.pData);
-		const UINT pitch = texture_desc.Width * 4;
+		frame.data = static_cast<const uint8_t *>(mapped.pData);
+		frame.row_pitch = mapped.RowPitch;
+		frame.width = _width;
+		frame.height = _height;
+		frame.format = _backbuffer_format == DXGI_FORMAT_B8G8R8A8_UNORM || _backbuffer_format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB ? frame_format::bgra8 : frame_format::rgba8;
 
-		for (UINT y = 0; y < texture_desc.Height; y++)
-		{
-			CopyMemory(buffer, mapped_data, std::min(pitch, static_cast<UINT>(mapped.RowPitch)));
-
-			for (UINT x = 0; x < pitch; x += 4)
-			{
-				buffer[x + 3] = 0xFF;
-
-				if (texture_desc.Format == DXGI_FORMAT_B8G8R8A8_UNORM || texture_desc.Format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB)
-				{
-					std::swap(buffer[x + 0], buffer[x + 2]);
-				}
-			}
-
-			buffer += pitch;
-			mapped_data += mapped.RowPitch;
-		}
-
-		_immediate_context->Unmap(texture_staging.get(), 0);
+		return true;
+	}
+	void d3d11_runtime::unmap_capture_staging(ID3D11Texture2D *texture) const
+	{
+		_immediate_context->Unmap(texture, 0);
 	}
 	bool d3d11_runtime::load_effect(const reshadefx::syntax_tree &ast, std::string &errors)
 	{
@@ -696,23 +765,43 @@ namespace reshade::d3d11
 		assert(data != nullptr);
 		assert(texture_impl != nullptr);
 
+		if (dds::is_block_compressed(texture.format))
+		{
+			// Upload every mipmap level directly from the compressed data, since block-compressed textures cannot generate their own mipmaps
+			for (unsigned int level = 0; level < texture.levels; level++)
+			{
+				const unsigned int level_width = std::max(texture.width >> level, 1u), level_height = std::max(texture.height >> level, 1u);
+				const size_t pitch = dds::row_pitch(texture.format, level_width);
+
+				_immediate_context->UpdateSubresource(texture_impl->texture.get(), level, nullptr, data, static_cast<UINT>(pitch), 0);
+
+				data += dds::mip_chain_size(texture.format, level_width, level_height, 1);
+			}
+
+			return true;
+		}
+
 		switch (texture.format)
 		{
 			case texture_format::r8:
 			{
-				std::vector<uint8_t> data2(texture.width * texture.height);
-				for (size_t i = 0, k = 0; i < texture.width * texture.height * 4; i += 4, k++)
-					data2[k] = data[i];
-				_immediate_context->UpdateSubresource(texture_impl->texture.get(), 0, nullptr, data2.data(), texture.width, texture.width * texture.height);
+				_texture_upload_buffer.resize(texture.width * texture.height);
+				pixel_conversion::extract_channels_rgba8(data, _texture_upload_buffer.data(), texture.width * texture.height, 1);
+				_immediate_context->UpdateSubresource(texture_impl->texture.get(), 0, nullptr, _texture_upload_buffer.data(), texture.width, texture.width * texture.height);
 				break;
 			}
 			case texture_format::rg8:
 			{
-				std::vector<uint8_t> data2(texture.width * texture.height * 2);
-				for (size_t i = 0, k = 0; i < texture.width * texture.height * 4; i += 4, k += 2)
-					data2[k] = data[i],
-					data2[k + 1] = data[i + 1];
-				_immediate_context->UpdateSubresource(texture_impl->texture.get(), 0, nullptr, data2.data(), texture.width * 2, texture.width * texture.height * 2);
+				_texture_upload_buffer.resize(texture.width * texture.height * 2);
+				pixel_conversion::extract_channels_rgba8(data, _texture_upload_buffer.data(), texture.width * texture.height, 2);
+				_immediate_context->UpdateSubresource(texture_impl->texture.get(), 0, nullptr, _texture_upload_buffer.data(), texture.width * 2, texture.width * texture.height * 2);
+				break;
+			}
+			case texture_format::rgba16f:
+			{
+				_texture_upload_buffer.resize(texture.width * texture.height * 8);
+				pixel_conversion::unorm8_to_float16(data, reinterpret_cast<uint16_t *>(_texture_upload_buffer.data()), texture.width * texture.height * 4);
+				_immediate_context->UpdateSubresource(texture_impl->texture.get(), 0, nullptr, _texture_upload_buffer.data(), texture.width * 8, texture.width * texture.height * 8);
 				break;
 			}
 			default:
@@ -729,78 +818,283 @@ namespace reshade::d3d11
 
 		return true;
 	}
+	bool d3d11_runtime::alias_texture(texture &texture, const texture &target)
+	{
+		const auto texture_impl = texture.impl->as<d3d11_tex_data>();
+		const auto target_impl = target.impl->as<d3d11_tex_data>();
+
+		if (texture_impl == nullptr || target_impl == nullptr)
+		{
+			return false;
+		}
+
+		// Passes may render to the texture with a view format the shared resource does not have a view for yet
+		for (unsigned int i = 0; i < 2; i++)
+		{
+			if (texture_impl->rtv[i] == nullptr || target_impl->rtv[i] != nullptr)
+			{
+				continue;
+			}
+
+			D3D11_RENDER_TARGET_VIEW_DESC rtvdesc;
+			texture_impl->rtv[i]->GetDesc(&rtvdesc);
+
+			if (FAILED(_device->CreateRenderTargetView(target_impl->texture.get(), &rtvdesc, &target_impl->rtv[i])))
+			{
+				return false;
+			}
+		}
+
+		const auto replace = [](auto &view, const auto &old_views, const auto &new_views) {
+			for (unsigned int i = 0; i < 2; i++)
+			{
+				if (view != nullptr && view == old_views[i])
+				{
+					view = new_views[i];
+					break;
+				}
+			}
+		};
+
+		for (auto &srv : _effect_shader_resources)
+		{
+			replace(srv, texture_impl->srv, target_impl->srv);
+		}
+
+		for (const auto &technique : _techniques)
+		{
+			for (const auto &pass_object : technique.passes)
+			{
+				d3d11_pass_data &pass = *pass_object->as<d3d11_pass_data>();
+
+				bool renders_to_target = false;
+
+				for (UINT i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
+				{
+					replace(pass.render_targets[i], texture_impl->rtv, target_impl->rtv);
+
+					renders_to_target |= pass.render_targets[i] != nullptr && (pass.render_targets[i] == target_impl->rtv[0] || pass.render_targets[i] == target_impl->rtv[1]);
+				}
+
+				for (auto &srv : pass.shader_resources)
+				{
+					replace(srv, texture_impl->srv, target_impl->srv);
+
+					// A resource cannot be bound as input and output at the same time, so unbind it from passes that render to it, just like the effect compiler does
+					if (renders_to_target && srv != nullptr && (srv == target_impl->srv[0] || srv == target_impl->srv[1]))
+					{
+						srv.reset();
+					}
+				}
+			}
+		}
+
+		texture_impl->texture = target_impl->texture;
+		texture_impl->srv[0] = target_impl->srv[0];
+		texture_impl->srv[1] = target_impl->srv[1];
+		texture_impl->rtv[0] = target_impl->rtv[0];
+		texture_impl->rtv[1] = target_impl->rtv[1];
+
+		return true;
+	}
 
-	void d3d11_runtime::render_technique(const technique &technique)
+	void d3d11_runtime::unbind_pass_resources(const d3d11_pass_data &pass)
+	{
+		// Reset render targets
+		_immediate_context->OMSetRenderTargets(0, nullptr, nullptr);
+
+		// Reset shader resources
+		ID3D11ShaderResourceView *null[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT] = { nullptr };
+		_immediate_context->VSSetShaderResources(0, static_cast<UINT>(pass.shader_resources.size()), null);
+		_immediate_context->PSSetShaderResources(0, static_cast<UINT>(pass.shader_resources.size()), null);
+	}
+	void d3d11_runtime::render_technique(technique &technique)
 	{
 		d3d11_technique_data &technique_data = *technique.impl->as<d3d11_technique_data>();
 
-		if (!technique_data.query_in_flight)
+		// Only measure this frame if a query is free, which is not the case while the GPU is more frames behind than there are queries
+		size_t query_index = 0;
+		const bool measure = technique_data.query_slots.reserve(_framecount, query_index);
+
+		if (measure)
 		{
-			_immediate_context->Begin(technique_data.timestamp_disjoint.get());
-			_immediate_context->End(technique_data.timestamp_query_beg.get());
+			_immediate_context->Begin(technique_data.timestamp_disjoint[query_index].get());
+			_immediate_context->End(technique_data.timestamp_query_beg[query_index].get());
 		}
 
-		bool is_default_depthstencil_cleared = false;
+		// Timestamps between passes are only issued while they are shown in the statistics, and created the first time they are needed
+		const size_t pass_timestamp_count = technique.passes.size() + 1;
+		bool measure_passes = measure && _profile_passes;
 
-		// Setup shader constants
-		if (technique.uniform_storage_index >= 0)
+		if (measure_passes && technique_data.pass_timestamps.empty())
 		{
-			const auto constant_buffer = _constant_buffers[technique.uniform_storage_index].get();
-			D3D11_MAPPED_SUBRESOURCE mapped;
+			technique_data.pass_timestamps.resize(technique_data.query_slots.size() * pass_timestamp_count);
 
-			const HRESULT hr = _immediate_context->Map(constant_buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+			D3D11_QUERY_DESC query_desc = { };
+			query_desc.Query = D3D11_QUERY_TIMESTAMP;
 
-			if (SUCCEEDED(hr))
+			for (auto &query : technique_data.pass_timestamps)
 			{
-				CopyMemory(mapped.pData, get_uniform_value_storage().data() + technique.uniform_storage_offset, mapped.RowPitch);
+				if (FAILED(_device->CreateQuery(&query_desc, &query)))
+				{
+					LOG(ERROR) << "Failed to create timestamp queries for technique '" << technique.name << "'!";
 
-				_immediate_context->Unmap(constant_buffer, 0);
-			}
-			else
-			{
-				LOG(ERROR) << "Failed to map constant buffer! HRESULT is '" << std::hex << hr << std::dec << "'!";
+					technique_data.pass_timestamps.clear();
+					break;
+				}
 			}
+		}
 
-			_immediate_context->VSSetConstantBuffers(0, 1, &constant_buffer);
-			_immediate_context->PSSetConstantBuffers(0, 1, &constant_buffer);
+		if (measure)
+		{
+			measure_passes = measure_passes && !technique_data.pass_timestamps.empty();
+			technique_data.pass_timestamps_issued[query_index] = measure_passes;
 		}
 
-		for (const auto &pass_object : technique.passes)
+		// Setup shader constants
+		if (technique.uniform_storage_index >= 0)
 		{
-			const d3d11_pass_data &pass = *pass_object->as<d3d11_pass_data>();
+			auto &constant_buffers = _constant_buffers[technique.uniform_storage_index];
+			const size_t user_buffer_offset = technique.uniform_storage_offset;
+			const size_t frame_buffer_offset = user_buffer_offset + constant_buffers.user_buffer_size;
+			const auto uniform_storage_data = get_uniform_value_storage().data() + technique.uniform_storage_offset;
+			size_t dirty_begin = 0, dirty_end = 0;
+
+			// Only upload uniforms after they were changed. Taking the range from the dirty list means techniques sharing the same buffers do not upload it again.
+			// Constant buffers can only be updated partially starting with D3D11.1, so always update the whole buffer.
+			if (constant_buffers.user_buffer != nullptr && _uniform_dirty_ranges.take(user_buffer_offset, frame_buffer_offset, dirty_begin, dirty_end))
+			{
+				_immediate_context->UpdateSubresource(constant_buffers.user_buffer.get(), 0, nullptr, uniform_storage_data, 0, 0);
 
-			// Setup states
-			_immediate_context->VSSetShader(pass.vertex_shader.get(), nullptr, 0);
-			_immediate_context->PSSetShader(pass.pixel_shader.get(), nullptr, 0);
+				_uniform_bytes_uploaded += constant_buffers.user_buffer_size;
+			}
 
-			_immediate_context->OMSetBlendState(pass.blend_state.get(), nullptr, D3D11_DEFAULT_SAMPLE_MASK);
-			_immediate_context->OMSetDepthStencilState(pass.depth_stencil_state.get(), pass.stencil_reference);
+			if (constant_buffers.frame_buffer != nullptr && _uniform_dirty_ranges.take(frame_buffer_offset, frame_buffer_offset + constant_buffers.frame_buffer_size, dirty_begin, dirty_end))
+			{
+				D3D11_MAPPED_SUBRESOURCE mapped;
 
-			// Save back buffer of previous pass
-			_immediate_context->CopyResource(_backbuffer_texture.get(), _backbuffer_resolved.get());
+				const HRESULT hr = _immediate_context->Map(constant_buffers.frame_buffer.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+
+				if (SUCCEEDED(hr))
+				{
+					CopyMemory(mapped.pData, uniform_storage_data + constant_buffers.user_buffer_size, constant_buffers.frame_buffer_size);
 
-			// Setup shader resources
-			_immediate_context->VSSetShaderResources(0, static_cast<UINT>(pass.shader_resources.size()), reinterpret_cast<ID3D11ShaderResourceView *const *>(pass.shader_resources.data()));
-			_immediate_context->PSSetShaderResources(0, static_cast<UINT>(pass.shader_resources.size()), reinterpret_cast<ID3D11ShaderResourceView *const *>(pass.shader_resources.data()));
+					_immediate_context->Unmap(constant_buffers.frame_buffer.get(), 0);
 
-			// Setup render targets
-			if (static_cast<UINT>(pass.viewport.Width) == _width && static_cast<UINT>(pass.viewport.Height) == _height)
+					_uniform_bytes_uploaded += constant_buffers.frame_buffer_size;
+				}
+				else
+				{
+					LOG(ERROR) << "Failed to map constant buffer! HRESULT is '" << std::hex << hr << std::dec << "'!";
+
+					// Try again next time
+					_uniform_dirty_ranges.add(dirty_begin, dirty_end - dirty_begin);
+				}
+			}
+
+			ID3D11Buffer *const constant_buffer_list[2] = { constant_buffers.user_buffer.get(), constant_buffers.frame_buffer.get() };
+			// The frame buffer slot is only declared in the shaders if the effect has any per-frame uniforms
+			const UINT constant_buffer_count = constant_buffers.frame_buffer != nullptr ? 2 : 1;
+
+			_immediate_context->VSSetConstantBuffers(0, constant_buffer_count, constant_buffer_list);
+			_immediate_context->PSSetConstantBuffers(0, constant_buffer_count, constant_buffer_list);
+		}
+
+		// Binds the state of the current pass whenever the state filter finds that it is not bound yet
+		struct pass_device
+		{
+			d3d11_runtime &runtime;
+			const d3d11_pass_data *pass, *resources_pass;
+			bool is_default_depthstencil_cleared;
+
+			void bind(render_graph::pass_state state)
 			{
-				_immediate_context->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, reinterpret_cast<ID3D11RenderTargetView *const *>(pass.render_targets), _default_depthstencil.get());
+				const auto device = runtime._immediate_context.get();
 
-				if (!is_default_depthstencil_cleared)
+				switch (state)
 				{
-					is_default_depthstencil_cleared = true;
+					case render_graph::pass_state::shaders:
+						device->VSSetShader(pass->vertex_shader.get(), nullptr, 0);
+						device->PSSetShader(pass->pixel_shader.get(), nullptr, 0);
+						break;
+					case render_graph::pass_state::blend_state:
+						device->OMSetBlendState(pass->blend_state.get(), nullptr, D3D11_DEFAULT_SAMPLE_MASK);
+						break;
+					case render_graph::pass_state::depth_stencil_state:
+						device->OMSetDepthStencilState(pass->depth_stencil_state.get(), pass->stencil_reference);
+						break;
+					case render_graph::pass_state::shader_resources:
+						device->VSSetShaderResources(0, static_cast<UINT>(pass->shader_resources.size()), reinterpret_cast<ID3D11ShaderResourceView *const *>(pass->shader_resources.data()));
+						device->PSSetShaderResources(0, static_cast<UINT>(pass->shader_resources.size()), reinterpret_cast<ID3D11ShaderResourceView *const *>(pass->shader_resources.data()));
+						resources_pass = pass;
+						break;
+					case render_graph::pass_state::render_targets:
+						if (static_cast<UINT>(pass->viewport.Width) == runtime._width && static_cast<UINT>(pass->viewport.Height) == runtime._height)
+						{
+							device->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, reinterpret_cast<ID3D11RenderTargetView *const *>(pass->render_targets), runtime._default_depthstencil.get());
 
-					_immediate_context->ClearDepthStencilView(_default_depthstencil.get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+							if (!is_default_depthstencil_cleared)
+							{
+								is_default_depthstencil_cleared = true;
+
+								device->ClearDepthStencilView(runtime._default_depthstencil.get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0);
+							}
+						}
+						else
+						{
+							device->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, reinterpret_cast<ID3D11RenderTargetView *const *>(pass->render_targets), nullptr);
+						}
+						break;
+					case render_graph::pass_state::viewport:
+						device->RSSetViewports(1, &pass->viewport);
+						break;
 				}
 			}
-			else
+			void unbind_resources()
 			{
-				_immediate_context->OMSetRenderTargets(D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT, reinterpret_cast<ID3D11RenderTargetView *const *>(pass.render_targets), nullptr);
+				runtime.unbind_pass_resources(*resources_pass);
 			}
+		} device = { *this, nullptr, nullptr, false };
+
+		for (size_t pass_index = 0; pass_index < technique.passes.size(); pass_index++)
+		{
+			const d3d11_pass_data &pass = *technique.passes[pass_index]->as<d3d11_pass_data>();
+			pass_info &info = technique.pass_infos[pass_index];
 
-			_immediate_context->RSSetViewports(1, &pass.viewport);
+			if (measure_passes)
+			{
+				_immediate_context->End(technique_data.pass_timestamps[query_index * pass_timestamp_count + pass_index].get());
+			}
+
+			// Passes can be skipped on frames a technique reuses what it rendered earlier. Their averages only include the frames they ran in.
+			if (info.skipped)
+			{
+				continue;
+			}
+
+			const auto time_pass_started = std::chrono::high_resolution_clock::now();
+
+			// Textures cannot be written to outside of a pass while they are still bound
+			if (info.copy_backbuffer || !info.generate_mipmaps.empty())
+			{
+				_pass_state_filter.unbind_resources(device);
+			}
+
+			// Save back buffer of previous pass, unless this pass does not sample it or it was not rendered to since the last copy
+			if (info.copy_backbuffer)
+			{
+				_immediate_context->CopyResource(_backbuffer_texture.get(), _backbuffer_resolved.get());
+			}
+
+			// Generate mipmaps of textures this pass samples that were rendered to since they were last generated
+			for (const auto texture : info.generate_mipmaps)
+			{
+				_immediate_context->GenerateMips(texture->impl->as<d3d11_tex_data>()->srv[0].get());
+			}
+
+			// Setup states and resources, skipping those an earlier pass of this technique bound already
+			device.pass = &pass;
+			_pass_state_filter.bind(pass.state, device);
 
 			if (pass.clear_render_targets)
 			{
@@ -820,37 +1114,24 @@ namespace reshade::d3d11
 			_vertices += 3;
 			_drawcalls += 1;
 
-			// Reset render targets
-			_immediate_context->OMSetRenderTargets(0, nullptr, nullptr);
-
-			// Reset shader resources
-			ID3D11ShaderResourceView *null[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT] = { nullptr };
-			_immediate_context->VSSetShaderResources(0, static_cast<UINT>(pass.shader_resources.size()), null);
-			_immediate_context->PSSetShaderResources(0, static_cast<UINT>(pass.shader_resources.size()), null);
-
-			// Update shader resources
-			for (const auto &resource : pass.render_target_resources)
+			if (_profile_passes)
 			{
-				if (resource == nullptr)
-				{
-					continue;
-				}
-
-				D3D11_SHADER_RESOURCE_VIEW_DESC resource_desc;
-				resource->GetDesc(&resource_desc);
-
-				if (resource_desc.Texture2D.MipLevels > 1)
-				{
-					_immediate_context->GenerateMips(resource.get());
-				}
+				info.average_cpu_duration.append(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - time_pass_started).count());
 			}
 		}
 
-		if (!technique_data.query_in_flight)
+		if (measure_passes)
+		{
+			_immediate_context->End(technique_data.pass_timestamps[query_index * pass_timestamp_count + technique.passes.size()].get());
+		}
+
+		// Leave no effect resources bound and forget the bound state, so that the next technique starts from scratch
+		_pass_state_filter.end_technique(device);
+
+		if (measure)
 		{
-			_immediate_context->End(technique_data.timestamp_query_end.get());
-			_immediate_context->End(technique_data.timestamp_disjoint.get());
-			technique_data.query_in_flight = true;
+			_immediate_context->End(technique_data.timestamp_query_end[query_index].get());
+			_immediate_context->End(technique_data.timestamp_disjoint[query_index].get());
 		}
 	}
 	void d3d11_runtime::render_imgui_draw_data(ImDrawData *draw_data)
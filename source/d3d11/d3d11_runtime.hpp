@@ -8,6 +8,8 @@
 #include <mutex>
 #include <d3d11_3.h>
 #include "runtime.hpp"
+#include "render_graph.hpp"
+#include "query_ring.hpp"
 #include "d3d11_stateblock.hpp"
 #include "draw_call_tracker.hpp"
 
@@ -28,16 +30,23 @@ namespace reshade::d3d11
 		UINT stencil_reference;
 		bool clear_render_targets;
 		com_ptr<ID3D11RenderTargetView> render_targets[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
-		com_ptr<ID3D11ShaderResourceView> render_target_resources[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
 		D3D11_VIEWPORT viewport;
 		std::vector<com_ptr<ID3D11ShaderResourceView>> shader_resources;
+		render_graph::pass_state_desc state;
 	};
 	struct d3d11_technique_data : base_object
 	{
-		bool query_in_flight = false;
-		com_ptr<ID3D11Query> timestamp_disjoint;
-		com_ptr<ID3D11Query> timestamp_query_beg;
-		com_ptr<ID3D11Query> timestamp_query_end;
+		query_ring query_slots;
+		std::vector<com_ptr<ID3D11Query>> timestamp_disjoint;
+		std::vector<com_ptr<ID3D11Query>> timestamp_query_beg;
+		std::vector<com_ptr<ID3D11Query>> timestamp_query_end;
+		std::vector<com_ptr<ID3D11Query>> pass_timestamps;
+		std::vector<bool> pass_timestamps_issued;
+	};
+	struct d3d11_constant_buffers
+	{
+		com_ptr<ID3D11Buffer> user_buffer, frame_buffer;
+		UINT user_buffer_size = 0, frame_buffer_size = 0;
 	};
 
 	class d3d11_runtime : public runtime
@@ -50,11 +59,15 @@ namespace reshade::d3d11
 		void on_reset_effect() override;
 		void on_present(draw_call_tracker& tracker);
 
-		void capture_frame(uint8_t *buffer) const override;
+		bool capture_frame(const std::function<void(const frame_data &)> &callback) const override;
 		bool load_effect(const reshadefx::syntax_tree &ast, std::string &errors) override;
 		bool update_texture(texture &texture, const uint8_t *data) override;
+		bool alias_texture(texture &texture, const texture &target) override;
+		bool copy_frame_to_staging(unsigned int slot) override;
+		bool map_frame_from_staging(unsigned int slot, frame_data &frame) override;
+		void unmap_frame_from_staging(unsigned int slot) override;
 
-		void render_technique(const technique &technique) override;
+		void render_technique(technique &technique) override;
 		void render_imgui_draw_data(ImDrawData *data) override;
 
 		com_ptr<ID3D11Device> _device;
@@ -68,7 +81,9 @@ namespace reshade::d3d11
 		std::vector<com_ptr<ID3D11SamplerState>> _effect_sampler_states;
 		std::unordered_map<size_t, size_t> _effect_sampler_descs;
 		std::vector<com_ptr<ID3D11ShaderResourceView>> _effect_shader_resources;
-		std::vector<com_ptr<ID3D11Buffer>> _constant_buffers;
+		std::vector<d3d11_constant_buffers> _constant_buffers;
+		shader_registry<com_ptr<ID3D11VertexShader>> _effect_vertex_shaders;
+		shader_registry<com_ptr<ID3D11PixelShader>> _effect_pixel_shaders;
 
 		bool depth_buffer_before_clear() { return _depth_buffer_before_clear; }
 
@@ -77,6 +92,10 @@ namespace reshade::d3d11
 		bool _depth_buffer_debug = false;
 		bool _depth_buffer_before_clear = false;
 
+		bool create_capture_staging(com_ptr<ID3D11Texture2D> &texture) const;
+		bool map_capture_staging(ID3D11Texture2D *texture, frame_data &frame) const;
+		void unmap_capture_staging(ID3D11Texture2D *texture) const;
+
 		bool init_backbuffer_texture();
 		bool init_default_depth_stencil();
 		bool init_fx_resources();
@@ -85,12 +104,15 @@ namespace reshade::d3d11
 
 		void draw_debug_menu();
 
+		void unbind_pass_resources(const d3d11_pass_data &pass);
+
 #if RESHADE_DX11_CAPTURE_DEPTH_BUFFERS
 		void detect_depth_source(draw_call_tracker& tracker);
 		bool create_depthstencil_replacement(ID3D11DepthStencilView *depthstencil, ID3D11Texture2D *texture);
 #endif
 
 		bool _is_multisampling_enabled = false;
+		render_graph::pass_state_filter _pass_state_filter;
 		DXGI_FORMAT _backbuffer_format = DXGI_FORMAT_UNKNOWN;
 		d3d11_stateblock _stateblock;
 		com_ptr<ID3D11Texture2D> _backbuffer, _backbuffer_resolved;
@@ -103,6 +125,8 @@ namespace reshade::d3d11
 		com_ptr<ID3D11SamplerState> _copy_sampler;
 		std::mutex _mutex;
 		com_ptr<ID3D11RasterizerState> _effect_rasterizer_state;
+		std::vector<uint8_t> _texture_upload_buffer;
+		com_ptr<ID3D11Texture2D> _capture_staging[capture_ring_size];
 
 		com_ptr<ID3D11Buffer> _imgui_vertex_buffer, _imgui_index_buffer;
 		com_ptr<ID3D11VertexShader> _imgui_vertex_shader;
@@ -5,6 +5,7 @@
 
 #include "d3d9_runtime.hpp"
 #include "d3d9_effect_compiler.hpp"
+#include "dds_file.hpp"
 #include <assert.h>
 #include <iomanip>
 #include <fstream>
@@ -182,6 +183,8 @@ namespace reshade::d3d9
 			visit(_global_code, node);
 		}
 
+		std::vector<const variable_declaration_node *> uniforms;
+
 		for (auto uniform : _ast.variables)
 		{
 			if (uniform->type.is_texture())
@@ -194,7 +197,7 @@ namespace reshade::d3d9
 			}
 			else if (uniform->type.has_qualifier(type_node::qualifier_uniform))
 			{
-				visit_uniform(uniform);
+				uniforms.push_back(uniform);
 			}
 			else
 			{
@@ -204,6 +207,8 @@ namespace reshade::d3d9
 			}
 		}
 
+		visit_uniforms(uniforms);
+
 		for (auto function : _ast.functions)
 		{
 			std::stringstream function_code;
@@ -1512,7 +1517,8 @@ namespace reshade::d3d9
 			D3DDEVICE_CREATION_PARAMETERS cp;
 			_runtime->_device->GetCreationParameters(&cp);
 
-			if (levels > 1)
+			// Block-compressed textures get their mipmaps from the image file instead
+			if (levels > 1 && !dds::is_block_compressed(obj.format))
 			{
 				if (_runtime->_d3d->CheckDeviceFormat(cp.AdapterOrdinal, cp.DeviceType, D3DFMT_X8R8G8B8, D3DUSAGE_AUTOGENMIPMAP, D3DRTYPE_TEXTURE, format) == D3D_OK)
 				{
@@ -1573,27 +1579,75 @@ namespace reshade::d3d9
 
 		_samplers[node->name] = sampler;
 	}
-	void d3d9_effect_compiler::visit_uniform(const variable_declaration_node *node)
+	void d3d9_effect_compiler::visit_uniforms(const std::vector<const variable_declaration_node *> &nodes)
 	{
-		auto type = node->type;
-		type.basetype = type_node::datatype_float;
-		visit(_global_code, type);
+		std::vector<uniform_layout_entry> layout(nodes.size());
 
-		_global_code << ' ' << node->unique_name;
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			layout[i].rows = nodes[i]->type.rows;
+			layout[i].columns = nodes[i]->type.cols;
+			layout[i].elements = std::max(0, nodes[i]->type.array_length);
+		}
 
-		if (node->type.is_array())
+		// Pack scalars and vectors into shared registers to reduce the number of constants that have to be uploaded per pass
+		_constant_register_count = compute_uniform_layout(uniform_layout_rules::hlsl_registers, layout) / 16;
+
+		_runtime->get_uniform_value_storage().resize(_uniform_storage_offset + _constant_register_count * 16);
+
+		// Add uniforms in declaration order, but emit their declarations in order of their register
+		std::vector<std::stringstream> declarations(nodes.size());
+
+		for (size_t i = 0; i < nodes.size(); i++)
 		{
-			_global_code << '[';
+			visit_uniform(declarations[i], nodes[i], layout[i]);
+		}
 
-			if (node->type.array_length > 0)
+		size_t packed_register_index = static_cast<size_t>(-1);
+
+		for (const size_t index : sort_uniform_layout(layout))
+		{
+			const auto &entry = layout[index];
+
+			if (!entry.is_multi_register() && entry.register_index() != packed_register_index)
 			{
-				_global_code << node->type.array_length;
+				packed_register_index = entry.register_index();
+
+				_global_uniforms << "uniform float4 __GLOBAL__" << packed_register_index << " : register(c" << packed_register_index << ");\n";
 			}
 
-			_global_code << ']';
+			_global_uniforms << declarations[index].str();
 		}
+	}
+	void d3d9_effect_compiler::visit_uniform(std::stringstream &output, const variable_declaration_node *node, const uniform_layout_entry &layout)
+	{
+		if (layout.is_multi_register())
+		{
+			auto type = node->type;
+			type.basetype = type_node::datatype_float;
+			visit(output, type);
+
+			output << ' ' << node->unique_name;
 
-		_global_code << " : register(c" << _constant_register_count << ");\n";
+			if (node->type.is_array())
+			{
+				output << '[';
+
+				if (node->type.array_length > 0)
+				{
+					output << node->type.array_length;
+				}
+
+				output << ']';
+			}
+
+			output << " : register(c" << layout.register_index() << ");\n";
+		}
+		else
+		{
+			// SM3 cannot bind a variable to individual register components, so access the packed register through a swizzle instead
+			output << "#define " << node->unique_name << " __GLOBAL__" << layout.register_index() << '.' << std::string("xyzw").substr(layout.register_component(), node->type.rows) << '\n';
+		}
 
 		uniform obj;
 		obj.name = node->name;
@@ -1604,18 +1658,11 @@ namespace reshade::d3d9
 		obj.columns = node->type.cols;
 		obj.elements = node->type.array_length;
 		obj.storage_size = obj.rows * obj.columns * std::max(1u, obj.elements) * 4;
+		obj.storage_offset = _uniform_storage_offset + layout.offset;
 		obj.annotations = node->annotation_list;
 
-		obj.storage_offset = _uniform_storage_offset + _constant_register_count * 16;
-		_constant_register_count += (obj.storage_size / 4 + 4 - ((obj.storage_size / 4) % 4)) / 4;
-
 		auto &uniform_storage = _runtime->get_uniform_value_storage();
 
-		if (_uniform_storage_offset + _constant_register_count * 16 >= uniform_storage.size())
-		{
-			uniform_storage.resize(uniform_storage.size() + 4096);
-		}
-
 		if (node->initializer_expression != nullptr && node->initializer_expression->id == nodeid::literal_expression)
 		{
 			for (size_t i = 0; i < obj.storage_size / 4; i++)
@@ -1831,6 +1878,7 @@ namespace reshade::d3d9
 		}
 
 		source << samplers;
+		source << _global_uniforms.str();
 		source << _global_code.str();
 
 		for (auto dependency : _functions.at(node).dependencies)
@@ -2052,6 +2100,26 @@ namespace reshade::d3d9
 			flags |= D3DCOMPILE_SKIP_OPTIMIZATION;
 		}
 
+		// Look for a shader that was already compiled for another pass
+		const std::string shader_key = source_str + '\n' + shadertype + '\n' + std::to_string(flags);
+
+		if (shadertype == "vs")
+		{
+			if (const auto it = _runtime->_effect_vertex_shaders.find(shader_key); it != _runtime->_effect_vertex_shaders.end())
+			{
+				pass.vertex_shader = it->second;
+				return;
+			}
+		}
+		else if (shadertype == "ps")
+		{
+			if (const auto it = _runtime->_effect_pixel_shaders.find(shader_key); it != _runtime->_effect_pixel_shaders.end())
+			{
+				pass.pixel_shader = it->second;
+				return;
+			}
+		}
+
 		const auto D3DCompile = reinterpret_cast<pD3DCompile>(GetProcAddress(_d3dcompiler_module, "D3DCompile"));
 		HRESULT hr = D3DCompile(source_str.c_str(), source_str.size(), nullptr, nullptr, nullptr, "__main", (shadertype + "_3_0").c_str(), flags, 0, &compiled, &errors);
 
@@ -2080,5 +2148,14 @@ namespace reshade::d3d9
 			error(node->location, "internal shader creation failed with error code " + std::to_string(static_cast<unsigned long>(hr)) + "!");
 			return;
 		}
+
+		if (shadertype == "vs")
+		{
+			_runtime->_effect_vertex_shaders.emplace(shader_key, pass.vertex_shader);
+		}
+		else if (shadertype == "ps")
+		{
+			_runtime->_effect_pixel_shaders.emplace(shader_key, pass.pixel_shader);
+		}
 	}
 }
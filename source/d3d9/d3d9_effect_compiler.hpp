@@ -6,6 +6,7 @@
 #pragma once
 
 #include "effect_syntax_tree.hpp"
+#include "uniform_layout.hpp"
 #include <sstream>
 #include <unordered_set>
 
@@ -60,7 +61,8 @@ namespace reshade::d3d9
 
 		void visit_texture(const reshadefx::nodes::variable_declaration_node *node);
 		void visit_sampler(const reshadefx::nodes::variable_declaration_node *node);
-		void visit_uniform(const reshadefx::nodes::variable_declaration_node *node);
+		void visit_uniforms(const std::vector<const reshadefx::nodes::variable_declaration_node *> &nodes);
+		void visit_uniform(std::stringstream &output, const reshadefx::nodes::variable_declaration_node *node, const uniform_layout_entry &layout);
 		void visit_technique(const reshadefx::nodes::technique_declaration_node *node);
 		void visit_pass(const reshadefx::nodes::pass_declaration_node *node, d3d9_pass_data &pass);
 		void visit_pass_shader(const reshadefx::nodes::function_declaration_node *node, const std::string &shadertype, const std::string &samplers, d3d9_pass_data &pass);
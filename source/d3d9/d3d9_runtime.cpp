@@ -8,6 +8,8 @@
 #include "d3d9_effect_compiler.hpp"
 #include "effect_lexer.hpp"
 #include "input.hpp"
+#include "pixel_conversion.hpp"
+#include "dds_file.hpp"
 #include <imgui.h>
 #include <algorithm>
 
@@ -27,6 +29,9 @@ namespace reshade::d3d9
 
 		assert(_d3d != nullptr);
 
+		// Techniques are not timed with GPU queries here, so the effect budget has nothing to go by
+		_has_gpu_timings = false;
+
 		D3DCAPS9 caps;
 		D3DADAPTER_IDENTIFIER9 adapter_desc;
 		D3DDEVICE_CREATION_PARAMETERS creation_params;
@@ -246,6 +251,7 @@ namespace reshade::d3d9
 		_width = pp.BackBufferWidth;
 		_height = pp.BackBufferHeight;
 		_backbuffer_format = pp.BackBufferFormat;
+		_is_backbuffer_float = pp.BackBufferFormat == D3DFMT_A16B16G16R16F || pp.BackBufferFormat == D3DFMT_A32B32G32R32F;
 		_is_multisampling_enabled = pp.MultiSampleType != D3DMULTISAMPLE_NONE;
 		_input = input::register_window(pp.hDeviceWindow);
 
@@ -281,6 +287,15 @@ namespace reshade::d3d9
 		_backbuffer_texture.reset();
 		_backbuffer_texture_surface.reset();
 
+		for (auto &surface : _capture_surfaces)
+		{
+			surface.reset();
+		}
+		for (auto &surface : _capture_readback_surfaces)
+		{
+			surface.reset();
+		}
+
 		_depthstencil.reset();
 		_depthstencil_replacement.reset();
 		_depthstencil_texture.reset();
@@ -305,6 +320,13 @@ namespace reshade::d3d9
 
 		_depth_source_table.clear();
 	}
+	void d3d9_runtime::on_reset_effect()
+	{
+		runtime::on_reset_effect();
+
+		_effect_vertex_shaders.clear();
+		_effect_pixel_shaders.clear();
+	}
 	void d3d9_runtime::on_present()
 	{
 		if (!is_initialized())
@@ -358,6 +380,9 @@ namespace reshade::d3d9
 			on_present_effect();
 		}
 
+		// Constant registers are set again for every technique regardless of what changed, so the modified ranges are never consumed here and would only pile up
+		_uniform_dirty_ranges.clear();
+
 		// Apply presenting
 		runtime::on_present();
 
@@ -467,15 +492,11 @@ namespace reshade::d3d9
 		}
 	}
 
-	void d3d9_runtime::capture_frame(uint8_t *buffer) const
+	bool d3d9_runtime::capture_frame(const std::function<void(const frame_data &)> &callback) const
 	{
-		if (_backbuffer_format != D3DFMT_X8R8G8B8 &&
-			_backbuffer_format != D3DFMT_X8B8G8R8 &&
-			_backbuffer_format != D3DFMT_A8R8G8B8 &&
-			_backbuffer_format != D3DFMT_A8B8G8R8)
+		if (!check_capture_format())
 		{
-			LOG(WARNING) << "Screenshots are not supported for back buffer format " << _backbuffer_format << ".";
-			return;
+			return false;
 		}
 
 		HRESULT hr;
@@ -484,46 +505,110 @@ namespace reshade::d3d9
 
 		if (FAILED(hr))
 		{
-			return;
+			return false;
 		}
 
 		hr = _device->GetRenderTargetData(_backbuffer_resolved.get(), screenshot_surface.get());
 
 		if (FAILED(hr))
 		{
-			return;
+			return false;
 		}
 
-		D3DLOCKED_RECT mapped_rect;
-		hr = screenshot_surface->LockRect(&mapped_rect, nullptr, D3DLOCK_READONLY);
+		frame_data frame;
 
-		if (FAILED(hr))
+		if (!lock_capture_surface(screenshot_surface.get(), frame))
 		{
-			return;
+			return false;
 		}
 
-		auto mapped_data = static_cast<BYTE *>(mapped_rect.pBits);
-		const UINT pitch = _width * 4;
+		callback(frame);
+
+		screenshot_surface->UnlockRect();
+
+		return true;
+	}
+	bool d3d9_runtime::copy_frame_to_staging(unsigned int slot)
+	{
+		auto &surface = _capture_surfaces[slot];
 
-		for (UINT y = 0; y < _height; y++)
+		if (surface == nullptr)
 		{
-			std::memcpy(buffer, mapped_data, std::min(pitch, static_cast<UINT>(mapped_rect.Pitch)));
+			if (!check_capture_format())
+			{
+				return false;
+			}
+
+			// Copy into a video memory surface first, since 'GetRenderTargetData' would wait for the GPU to finish rendering the frame
+			const HRESULT hr = _device->CreateRenderTarget(_width, _height, _backbuffer_format, D3DMULTISAMPLE_NONE, 0, FALSE, &surface, nullptr);
 
-			for (UINT x = 0; x < pitch; x += 4)
+			if (FAILED(hr))
 			{
-				buffer[x + 3] = 0xFF;
+				LOG(ERROR) << "Failed to create staging surface for screenshot capture! HRESULT is '" << std::hex << hr << std::dec << "'.";
+				return false;
+			}
+		}
 
-				if (_backbuffer_format == D3DFMT_A8R8G8B8 || _backbuffer_format == D3DFMT_X8R8G8B8)
-				{
-					std::swap(buffer[x + 0], buffer[x + 2]);
-				}
+		return SUCCEEDED(_device->StretchRect(_backbuffer_resolved.get(), nullptr, surface.get(), nullptr, D3DTEXF_NONE));
+	}
+	bool d3d9_runtime::map_frame_from_staging(unsigned int slot, frame_data &frame)
+	{
+		if (_capture_surfaces[slot] == nullptr)
+		{
+			return false;
+		}
+
+		// Every slot needs its own readback surface, since it stays locked until the frame was written
+		auto &readback_surface = _capture_readback_surfaces[slot];
+
+		if (readback_surface == nullptr)
+		{
+			const HRESULT hr = _device->CreateOffscreenPlainSurface(_width, _height, _backbuffer_format, D3DPOOL_SYSTEMMEM, &readback_surface, nullptr);
+
+			if (FAILED(hr))
+			{
+				LOG(ERROR) << "Failed to create readback surface for screenshot capture! HRESULT is '" << std::hex << hr << std::dec << "'.";
+				return false;
 			}
+		}
+
+		return SUCCEEDED(_device->GetRenderTargetData(_capture_surfaces[slot].get(), readback_surface.get())) && lock_capture_surface(readback_surface.get(), frame);
+	}
+	void d3d9_runtime::unmap_frame_from_staging(unsigned int slot)
+	{
+		_capture_readback_surfaces[slot]->UnlockRect();
+	}
+	bool d3d9_runtime::check_capture_format() const
+	{
+		if (_backbuffer_format != D3DFMT_X8R8G8B8 &&
+			_backbuffer_format != D3DFMT_X8B8G8R8 &&
+			_backbuffer_format != D3DFMT_A8R8G8B8 &&
+			_backbuffer_format != D3DFMT_A8B8G8R8)
+		{
+			LOG(WARNING) << "Screenshots are not supported for back buffer format " << _backbuffer_format << ".";
+			return false;
+		}
+
+		return true;
+	}
+	bool d3d9_runtime::lock_capture_surface(IDirect3DSurface9 *surface, frame_data &frame) const
+	{
+		D3DLOCKED_RECT mapped_rect;
+		const HRESULT hr = surface->LockRect(&mapped_rect, nullptr, D3DLOCK_READONLY);
 
-			buffer += pitch;
-			mapped_data += mapped_rect.Pitch;
+		if (FAILED(hr))
+		{
+			return false;
 		}
 
-		screenshot_surface->UnlockRect();
+		// The D3DFMT_A8R8G8B8 family is named after the bit order of a 32-bit value, so it is stored as BGRA in memory
+		frame.data = static_cast<const uint8_t *>(mapped_rect.pBits);
+		frame.row_pitch = mapped_rect.Pitch;
+		frame.width = _width;
+		frame.height = _height;
+		frame.format = _backbuffer_format == D3DFMT_A8R8G8B8 || _backbuffer_format == D3DFMT_X8R8G8B8 ? frame_format::bgra8 : frame_format::rgba8;
+
+		return true;
 	}
 	bool d3d9_runtime::load_effect(const reshadefx::syntax_tree &ast, std::string &errors)
 	{
@@ -544,9 +629,12 @@ namespace reshade::d3d9
 		D3DSURFACE_DESC desc;
 		texture_impl->texture->GetLevelDesc(0, &desc);
 
+		const bool is_block_compressed = dds::is_block_compressed(texture.format);
+
 		HRESULT hr;
 		com_ptr<IDirect3DTexture9> mem_texture;
-		hr = _device->CreateTexture(desc.Width, desc.Height, 1, 0, desc.Format, D3DPOOL_SYSTEMMEM, &mem_texture, nullptr);
+		// Block-compressed data contains all mipmap levels, so the memory texture needs them too
+		hr = _device->CreateTexture(desc.Width, desc.Height, is_block_compressed ? texture_impl->texture->GetLevelCount() : 1, 0, desc.Format, D3DPOOL_SYSTEMMEM, &mem_texture, nullptr);
 
 		if (FAILED(hr))
 		{
@@ -555,46 +643,75 @@ namespace reshade::d3d9
 		}
 
 		D3DLOCKED_RECT mapped_rect;
-		hr = mem_texture->LockRect(0, &mapped_rect, nullptr, 0);
 
-		if (FAILED(hr))
+		if (is_block_compressed)
 		{
-			LOG(ERROR) << "Failed to lock memory texture for texture updating! HRESULT is '" << std::hex << hr << std::dec << "'.";
-			return false;
-		}
+			for (DWORD level = 0; level < mem_texture->GetLevelCount(); level++)
+			{
+				const UINT level_width = std::max(texture.width >> level, 1u), level_height = std::max(texture.height >> level, 1u);
+				const size_t pitch = dds::row_pitch(texture.format, level_width);
 
-		const UINT size = std::min(texture.width * 4, static_cast<UINT>(mapped_rect.Pitch)) * texture.height;
-		auto mapped_data = static_cast<BYTE *>(mapped_rect.pBits);
+				hr = mem_texture->LockRect(level, &mapped_rect, nullptr, 0);
 
-		switch (texture.format)
-		{
-			case texture_format::r8:
-				for (UINT i = 0; i < size; i += 4, mapped_data += 4)
-					mapped_data[0] = 0,
-					mapped_data[1] = 0,
-					mapped_data[2] = data[i],
-					mapped_data[3] = 0;
-				break;
-			case texture_format::rg8:
-				for (UINT i = 0; i < size; i += 4, mapped_data += 4)
-					mapped_data[0] = 0,
-					mapped_data[1] = data[i + 1],
-					mapped_data[2] = data[i],
-					mapped_data[3] = 0;
-				break;
-			case texture_format::rgba8:
-				for (UINT i = 0; i < size; i += 4, mapped_data += 4)
-					mapped_data[0] = data[i + 2],
-					mapped_data[1] = data[i + 1],
-					mapped_data[2] = data[i],
-					mapped_data[3] = data[i + 3];
-				break;
-			default:
-				std::memcpy(mapped_data, data, size);
-				break;
+				if (FAILED(hr))
+				{
+					LOG(ERROR) << "Failed to lock memory texture for texture updating! HRESULT is '" << std::hex << hr << std::dec << "'.";
+					return false;
+				}
+
+				auto mapped_data = static_cast<BYTE *>(mapped_rect.pBits);
+
+				// Copy one row of blocks at a time, since the pitch of the locked surface may differ from the packed data
+				for (UINT y = 0; y < (level_height + 3) / 4; y++, data += pitch, mapped_data += mapped_rect.Pitch)
+				{
+					std::memcpy(mapped_data, data, std::min(pitch, static_cast<size_t>(mapped_rect.Pitch)));
+				}
+
+				mem_texture->UnlockRect(level);
+			}
 		}
+		else
+		{
+			hr = mem_texture->LockRect(0, &mapped_rect, nullptr, 0);
+
+			if (FAILED(hr))
+			{
+				LOG(ERROR) << "Failed to lock memory texture for texture updating! HRESULT is '" << std::hex << hr << std::dec << "'.";
+				return false;
+			}
+
+			auto mapped_data = static_cast<BYTE *>(mapped_rect.pBits);
+
+			// D3D9 textures store their channels in BGRA order, with unused channels set to zero
+			int8_t pattern[4] = { 2, 1, 0, 3 };
+
+			switch (texture.format)
+			{
+				case texture_format::r8:
+					pattern[0] = -1, pattern[1] = -1, pattern[3] = -1;
+					break;
+				case texture_format::rg8:
+					pattern[0] = -1, pattern[3] = -1;
+					break;
+			}
+
+			for (UINT y = 0; y < texture.height; y++, data += texture.width * 4, mapped_data += mapped_rect.Pitch)
+			{
+				switch (texture.format)
+				{
+					case texture_format::r8:
+					case texture_format::rg8:
+					case texture_format::rgba8:
+						pixel_conversion::shuffle_rgba8(data, mapped_data, texture.width, pattern);
+						break;
+					default:
+						std::memcpy(mapped_data, data, std::min(texture.width * 4, static_cast<UINT>(mapped_rect.Pitch)));
+						break;
+				}
+			}
 
-		mem_texture->UnlockRect(0);
+			mem_texture->UnlockRect(0);
+		}
 
 		hr = _device->UpdateTexture(mem_texture.get(), texture_impl->texture.get());
 
@@ -606,6 +723,38 @@ namespace reshade::d3d9
 
 		return true;
 	}
+	bool d3d9_runtime::alias_texture(texture &texture, const texture &target)
+	{
+		const auto texture_impl = texture.impl->as<d3d9_tex_data>();
+		const auto target_impl = target.impl->as<d3d9_tex_data>();
+
+		if (texture_impl == nullptr || target_impl == nullptr)
+		{
+			return false;
+		}
+
+		// Samplers reference the texture data rather than the texture itself, so only render targets have to be updated
+		for (const auto &technique : _techniques)
+		{
+			for (const auto &pass_object : technique.passes)
+			{
+				d3d9_pass_data &pass = *pass_object->as<d3d9_pass_data>();
+
+				for (auto &render_target : pass.render_targets)
+				{
+					if (render_target != nullptr && render_target == texture_impl->surface.get())
+					{
+						render_target = target_impl->surface.get();
+					}
+				}
+			}
+		}
+
+		texture_impl->texture = target_impl->texture;
+		texture_impl->surface = target_impl->surface;
+
+		return true;
+	}
 	bool d3d9_runtime::update_texture_reference(texture &texture, texture_reference id)
 	{
 		com_ptr<IDirect3DTexture9> new_reference;
@@ -659,7 +808,7 @@ namespace reshade::d3d9
 		return true;
 	}
 
-	void d3d9_runtime::render_technique(const technique &technique)
+	void d3d9_runtime::render_technique(technique &technique)
 	{
 		bool is_default_depthstencil_cleared = false;
 
@@ -667,19 +816,44 @@ namespace reshade::d3d9
 		if (technique.uniform_storage_index >= 0)
 		{
 			const auto uniform_storage_data = reinterpret_cast<const float *>(get_uniform_value_storage().data() + technique.uniform_storage_offset);
+			const size_t uniform_storage_size = technique.uniform_storage_index * 16;
+
+			// Constant registers are shared by all effects, so they have to be set again for every technique regardless of whether anything changed
 			_device->SetVertexShaderConstantF(0, uniform_storage_data, static_cast<UINT>(technique.uniform_storage_index));
 			_device->SetPixelShaderConstantF(0, uniform_storage_data, static_cast<UINT>(technique.uniform_storage_index));
+
+			_uniform_bytes_uploaded += 2 * uniform_storage_size;
 		}
 
-		for (const auto &pass_object : technique.passes)
+		for (size_t pass_index = 0; pass_index < technique.passes.size(); pass_index++)
 		{
-			const d3d9_pass_data &pass = *pass_object->as<d3d9_pass_data>();
+			const d3d9_pass_data &pass = *technique.passes[pass_index]->as<d3d9_pass_data>();
+
+			// Passes can be skipped on frames a technique reuses what it rendered earlier. Their averages only include the frames they ran in.
+			if (technique.pass_infos[pass_index].skipped)
+			{
+				continue;
+			}
+
+			const auto time_pass_started = std::chrono::high_resolution_clock::now();
 
 			// Setup states
 			pass.stateblock->Apply();
 
-			// Save back buffer of previous pass
-			_device->StretchRect(_backbuffer_resolved.get(), nullptr, _backbuffer_texture_surface.get(), nullptr, D3DTEXF_NONE);
+			// Save back buffer of previous pass, unless this pass does not sample it or it was not rendered to since the last copy
+			if (technique.pass_infos[pass_index].copy_backbuffer)
+			{
+				_device->StretchRect(_backbuffer_resolved.get(), nullptr, _backbuffer_texture_surface.get(), nullptr, D3DTEXF_NONE);
+			}
+
+			// Generate mipmaps of textures this pass samples that were rendered to since they were last generated
+			for (const auto texture : technique.pass_infos[pass_index].generate_mipmaps)
+			{
+				const auto texture_impl = texture->impl->as<d3d9_tex_data>();
+
+				texture_impl->texture->SetAutoGenFilterType(D3DTEXF_LINEAR);
+				texture_impl->texture->GenerateMipSubLevels();
+			}
 
 			// Setup shader resources
 			for (DWORD sampler = 0; sampler < pass.sampler_count; sampler++)
@@ -725,21 +899,9 @@ namespace reshade::d3d9
 			_vertices += 3;
 			_drawcalls += 1;
 
-			// Update shader resources
-			for (const auto target : pass.render_targets)
+			if (_profile_passes)
 			{
-				if (target == nullptr || target == _backbuffer_resolved)
-				{
-					continue;
-				}
-
-				com_ptr<IDirect3DBaseTexture9> texture;
-
-				if (SUCCEEDED(target->GetContainer(IID_PPV_ARGS(&texture))) && texture->GetLevelCount() > 1)
-				{
-					texture->SetAutoGenFilterType(D3DTEXF_LINEAR);
-					texture->GenerateMipSubLevels();
-				}
+				technique.pass_infos[pass_index].average_cpu_duration.append(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - time_pass_started).count());
 			}
 		}
 	}
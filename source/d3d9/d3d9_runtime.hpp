@@ -40,17 +40,22 @@ namespace reshade::d3d9
 
 		bool on_init(const D3DPRESENT_PARAMETERS &pp);
 		void on_reset();
+		void on_reset_effect() override;
 		void on_present();
 		void on_draw_call(D3DPRIMITIVETYPE type, UINT count);
 		void on_set_depthstencil_surface(IDirect3DSurface9 *&depthstencil);
 		void on_get_depthstencil_surface(IDirect3DSurface9 *&depthstencil);
 
-		void capture_frame(uint8_t *buffer) const override;
+		bool capture_frame(const std::function<void(const frame_data &)> &callback) const override;
 		bool load_effect(const reshadefx::syntax_tree &ast, std::string &errors) override;
 		bool update_texture(texture &texture, const uint8_t *data) override;
+		bool alias_texture(texture &texture, const texture &target) override;
 		bool update_texture_reference(texture &texture, texture_reference id);
+		bool copy_frame_to_staging(unsigned int slot) override;
+		bool map_frame_from_staging(unsigned int slot, frame_data &frame) override;
+		void unmap_frame_from_staging(unsigned int slot) override;
 
-		void render_technique(const technique &technique) override;
+		void render_technique(technique &technique) override;
 		void render_imgui_draw_data(ImDrawData *data) override;
 
 		com_ptr<IDirect3D9> _d3d;
@@ -62,6 +67,8 @@ namespace reshade::d3d9
 		com_ptr<IDirect3DTexture9> _backbuffer_texture;
 		com_ptr<IDirect3DSurface9> _backbuffer_texture_surface;
 		com_ptr<IDirect3DTexture9> _depthstencil_texture;
+		shader_registry<com_ptr<IDirect3DVertexShader9>> _effect_vertex_shaders;
+		shader_registry<com_ptr<IDirect3DPixelShader9>> _effect_pixel_shaders;
 
 	private:
 		struct depth_source_info
@@ -70,6 +77,9 @@ namespace reshade::d3d9
 			UINT drawcall_count, vertices_count;
 		};
 
+		bool check_capture_format() const;
+		bool lock_capture_surface(IDirect3DSurface9 *surface, frame_data &frame) const;
+
 		bool init_backbuffer_texture();
 		bool init_default_depth_stencil();
 		bool init_fx_resources();
@@ -91,6 +101,8 @@ namespace reshade::d3d9
 		com_ptr<IDirect3DSurface9> _depthstencil_replacement;
 		com_ptr<IDirect3DSurface9> _default_depthstencil;
 		std::unordered_map<IDirect3DSurface9 *, depth_source_info> _depth_source_table;
+		com_ptr<IDirect3DSurface9> _capture_surfaces[capture_ring_size];
+		com_ptr<IDirect3DSurface9> _capture_readback_surfaces[capture_ring_size];
 
 		com_ptr<IDirect3DVertexBuffer9> _effect_triangle_buffer;
 		com_ptr<IDirect3DVertexDeclaration9> _effect_triangle_layout;
@@ -0,0 +1,252 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "dds_file.hpp"
+#include <string.h>
+#include <algorithm>
+
+namespace reshade::dds
+{
+	static const uint32_t dds_magic = 0x20534444; // "DDS "
+	static const uint32_t ddsd_mipmapcount = 0x20000;
+	static const uint32_t ddpf_fourcc = 0x4;
+	static const uint32_t ddscaps2_cubemap = 0x200;
+	static const uint32_t ddscaps2_volume = 0x200000;
+
+	struct pixel_format
+	{
+		uint32_t size, flags, fourcc, rgb_bit_count, masks[4];
+	};
+	struct header
+	{
+		uint32_t size, flags, height, width, pitch_or_linear_size, depth, mip_map_count, reserved1[11];
+		pixel_format format;
+		uint32_t caps, caps2, caps3, caps4, reserved2;
+	};
+	struct header_dx10
+	{
+		uint32_t dxgi_format, resource_dimension, misc_flag, array_size, misc_flags2;
+	};
+
+	static constexpr uint32_t make_fourcc(char a, char b, char c, char d)
+	{
+		return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+	}
+
+	static texture_format fourcc_to_format(uint32_t fourcc)
+	{
+		switch (fourcc)
+		{
+			case make_fourcc('D', 'X', 'T', '1'):
+				return texture_format::dxt1;
+			case make_fourcc('D', 'X', 'T', '3'):
+				return texture_format::dxt3;
+			case make_fourcc('D', 'X', 'T', '5'):
+				return texture_format::dxt5;
+			case make_fourcc('A', 'T', 'I', '1'):
+			case make_fourcc('B', 'C', '4', 'U'):
+				return texture_format::latc1;
+			case make_fourcc('A', 'T', 'I', '2'):
+			case make_fourcc('B', 'C', '5', 'U'):
+				return texture_format::latc2;
+			default:
+				return texture_format::unknown;
+		}
+	}
+	static texture_format dxgi_to_format(uint32_t dxgi_format)
+	{
+		// Values of the DXGI_FORMAT enumeration, the signed BC4 and BC5 variants are not supported since the effect formats are all unsigned
+		switch (dxgi_format)
+		{
+			case 70: // DXGI_FORMAT_BC1_TYPELESS
+			case 71: // DXGI_FORMAT_BC1_UNORM
+			case 72: // DXGI_FORMAT_BC1_UNORM_SRGB
+				return texture_format::dxt1;
+			case 73: // DXGI_FORMAT_BC2_TYPELESS
+			case 74: // DXGI_FORMAT_BC2_UNORM
+			case 75: // DXGI_FORMAT_BC2_UNORM_SRGB
+				return texture_format::dxt3;
+			case 76: // DXGI_FORMAT_BC3_TYPELESS
+			case 77: // DXGI_FORMAT_BC3_UNORM
+			case 78: // DXGI_FORMAT_BC3_UNORM_SRGB
+				return texture_format::dxt5;
+			case 79: // DXGI_FORMAT_BC4_TYPELESS
+			case 80: // DXGI_FORMAT_BC4_UNORM
+				return texture_format::latc1;
+			case 82: // DXGI_FORMAT_BC5_TYPELESS
+			case 83: // DXGI_FORMAT_BC5_UNORM
+				return texture_format::latc2;
+			default:
+				return texture_format::unknown;
+		}
+	}
+
+	static size_t block_size(texture_format format)
+	{
+		switch (format)
+		{
+			case texture_format::dxt1:
+			case texture_format::latc1:
+				return 8;
+			case texture_format::dxt3:
+			case texture_format::dxt5:
+			case texture_format::latc2:
+				return 16;
+			default:
+				return 0;
+		}
+	}
+
+	bool is_block_compressed(texture_format format)
+	{
+		return block_size(format) != 0;
+	}
+	size_t row_pitch(texture_format format, unsigned int width)
+	{
+		return ((std::max(width, 1u) + 3) / 4) * block_size(format);
+	}
+	size_t mip_chain_size(texture_format format, unsigned int width, unsigned int height, unsigned int levels)
+	{
+		size_t size = 0;
+
+		for (unsigned int level = 0; level < levels; level++)
+		{
+			size += row_pitch(format, width >> level) * ((std::max(height >> level, 1u) + 3) / 4);
+		}
+
+		return size;
+	}
+
+	bool read_header(const uint8_t *data, size_t size, file_info &info)
+	{
+		uint32_t magic;
+		header header;
+
+		if (size < sizeof(magic) + sizeof(header))
+		{
+			return false;
+		}
+
+		memcpy(&magic, data, sizeof(magic));
+		memcpy(&header, data + sizeof(magic), sizeof(header));
+
+		if (magic != dds_magic || header.size != sizeof(header) || header.format.size != sizeof(pixel_format) || (header.format.flags & ddpf_fourcc) == 0)
+		{
+			return false;
+		}
+
+		// Cube maps and volume textures cannot be uploaded to the two-dimensional textures effects declare
+		if ((header.caps2 & (ddscaps2_cubemap | ddscaps2_volume)) != 0)
+		{
+			return false;
+		}
+
+		info.data_offset = sizeof(magic) + sizeof(header);
+
+		if (header.format.fourcc == make_fourcc('D', 'X', '1', '0'))
+		{
+			header_dx10 header10;
+
+			if (size < info.data_offset + sizeof(header10))
+			{
+				return false;
+			}
+
+			memcpy(&header10, data + info.data_offset, sizeof(header10));
+
+			// Only accept a single 'D3D10_RESOURCE_DIMENSION_TEXTURE2D'
+			if (header10.resource_dimension != 3 || header10.array_size != 1)
+			{
+				return false;
+			}
+
+			info.format = dxgi_to_format(header10.dxgi_format);
+			info.data_offset += sizeof(header10);
+		}
+		else
+		{
+			info.format = fourcc_to_format(header.format.fourcc);
+		}
+
+		if (info.format == texture_format::unknown || header.width == 0 || header.height == 0)
+		{
+			return false;
+		}
+
+		info.width = header.width;
+		info.height = header.height;
+		info.levels = (header.flags & ddsd_mipmapcount) != 0 ? std::max(header.mip_map_count, 1u) : 1;
+
+		return size - info.data_offset >= mip_chain_size(info.format, info.width, info.height, info.levels);
+	}
+
+	// Each of these reverses the first 'rows' pixel rows of a block, leaving the remaining (unused) rows of blocks at the bottom edge of small levels alone
+	static void flip_color_block(uint8_t *block, unsigned int rows)
+	{
+		// Two 16-bit endpoint colors, followed by one byte of 2-bit indices per row
+		std::reverse(block + 4, block + 4 + rows);
+	}
+	static void flip_explicit_alpha_block(uint8_t *block, unsigned int rows)
+	{
+		// 16 bits of 4-bit alpha values per row
+		for (unsigned int i = 0; i < rows / 2; i++)
+		{
+			std::swap(block[i * 2 + 0], block[(rows - 1 - i) * 2 + 0]);
+			std::swap(block[i * 2 + 1], block[(rows - 1 - i) * 2 + 1]);
+		}
+	}
+	static void flip_interpolated_alpha_block(uint8_t *block, unsigned int rows)
+	{
+		// Two 8-bit endpoints, followed by a 48-bit field with 12 bits of 3-bit indices per row
+		uint64_t indices = 0, flipped = 0;
+		memcpy(&indices, block + 2, 6);
+
+		for (unsigned int row = 0; row < 4; row++)
+		{
+			const unsigned int target_row = row < rows ? rows - 1 - row : row;
+			flipped |= ((indices >> (row * 12)) & 0xFFF) << (target_row * 12);
+		}
+
+		memcpy(block + 2, &flipped, 6);
+	}
+
+	void flip_level_vertically(texture_format format, uint8_t *data, unsigned int width, unsigned int height)
+	{
+		const size_t pitch = row_pitch(format, width);
+		const size_t size = block_size(format);
+		const unsigned int block_rows = (std::max(height, 1u) + 3) / 4;
+		const unsigned int rows = std::min(std::max(height, 1u), 4u);
+
+		for (unsigned int y = 0; y < block_rows / 2; y++)
+		{
+			std::swap_ranges(data + y * pitch, data + (y + 1) * pitch, data + (block_rows - 1 - y) * pitch);
+		}
+
+		for (uint8_t *block = data, *const end = data + block_rows * pitch; block < end; block += size)
+		{
+			switch (format)
+			{
+				case texture_format::dxt1:
+					flip_color_block(block, rows);
+					break;
+				case texture_format::dxt3:
+					flip_explicit_alpha_block(block, rows);
+					flip_color_block(block + 8, rows);
+					break;
+				case texture_format::dxt5:
+					flip_interpolated_alpha_block(block, rows);
+					flip_color_block(block + 8, rows);
+					break;
+				case texture_format::latc1:
+					flip_interpolated_alpha_block(block, rows);
+					break;
+				case texture_format::latc2:
+					flip_interpolated_alpha_block(block, rows);
+					flip_interpolated_alpha_block(block + 8, rows);
+					break;
+			}
+		}
+	}
+}
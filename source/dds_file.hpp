@@ -0,0 +1,53 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "runtime_objects.hpp"
+
+namespace reshade::dds
+{
+	/// <summary>
+	/// Description of the image stored in a DDS file.
+	/// </summary>
+	struct file_info
+	{
+		texture_format format = texture_format::unknown;
+		unsigned int width = 0, height = 0, levels = 0;
+		size_t data_offset = 0;
+	};
+
+	/// <summary>
+	/// Returns whether the specified format stores its data in 4x4 pixel blocks.
+	/// </summary>
+	bool is_block_compressed(texture_format format);
+	/// <summary>
+	/// Returns the number of bytes in a single row of blocks of a mipmap level with the specified width.
+	/// </summary>
+	size_t row_pitch(texture_format format, unsigned int width);
+	/// <summary>
+	/// Returns the number of bytes of block-compressed data in a mipmap chain.
+	/// </summary>
+	/// <param name="width">The width of the first level.</param>
+	/// <param name="height">The height of the first level.</param>
+	/// <param name="levels">The number of levels in the chain.</param>
+	size_t mip_chain_size(texture_format format, unsigned int width, unsigned int height, unsigned int levels);
+
+	/// <summary>
+	/// Parse the header of a DDS file. Only two-dimensional block-compressed images are recognized (DXT1, DXT3, DXT5, ATI1/BC4 and ATI2/BC5).
+	/// </summary>
+	/// <param name="data">The contents of the file.</param>
+	/// <param name="size">The size of the file in bytes.</param>
+	/// <param name="info">The resulting description of the image.</param>
+	/// <returns><c>true</c> if the header is valid and the file contains all the data it describes, <c>false</c> otherwise.</returns>
+	bool read_header(const uint8_t *data, size_t size, file_info &info);
+
+	/// <summary>
+	/// Flip a single mipmap level of block-compressed data upside down in place, by reversing the order of the block rows and the pixel rows inside each block.
+	/// This is exact for heights that are a multiple of four or below four, which covers every level of textures with power-of-two dimensions.
+	/// </summary>
+	void flip_level_vertically(texture_format format, uint8_t *data, unsigned int width, unsigned int height);
+}
@@ -0,0 +1,76 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "dirty_range_list.hpp"
+#include <algorithm>
+
+namespace reshade
+{
+	void dirty_range_list::add(size_t offset, size_t size)
+	{
+		if (size == 0)
+		{
+			return;
+		}
+
+		size_t begin = offset, end = offset + size;
+
+		// Find the first range that ends at or after the new one starts, which is the first candidate for merging
+		auto first = std::lower_bound(_ranges.begin(), _ranges.end(), begin,
+			[](const std::pair<size_t, size_t> &range, size_t value) { return range.second < value; });
+		auto last = first;
+
+		for (; last != _ranges.end() && last->first <= end; ++last)
+		{
+			begin = std::min(begin, last->first);
+			end = std::max(end, last->second);
+		}
+
+		first = _ranges.erase(first, last);
+		_ranges.emplace(first, begin, end);
+	}
+	bool dirty_range_list::take(size_t begin, size_t end, size_t &dirty_begin, size_t &dirty_end)
+	{
+		if (begin >= end)
+		{
+			return false;
+		}
+
+		auto first = std::lower_bound(_ranges.begin(), _ranges.end(), begin,
+			[](const std::pair<size_t, size_t> &range, size_t value) { return range.second <= value; });
+
+		if (first == _ranges.end() || first->first >= end)
+		{
+			return false;
+		}
+
+		auto last = first;
+
+		for (; last != _ranges.end() && last->first < end; ++last)
+		{
+			continue;
+		}
+
+		dirty_begin = std::max(begin, first->first);
+		dirty_end = std::min(end, (last - 1)->second);
+
+		// Keep the parts of the first and last range that lie outside the region
+		std::vector<std::pair<size_t, size_t>> remainder;
+
+		if (first->first < begin)
+		{
+			remainder.emplace_back(first->first, begin);
+		}
+		if ((last - 1)->second > end)
+		{
+			remainder.emplace_back(end, (last - 1)->second);
+		}
+
+		first = _ranges.erase(first, last);
+		_ranges.insert(first, remainder.begin(), remainder.end());
+
+		return true;
+	}
+}
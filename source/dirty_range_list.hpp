@@ -0,0 +1,51 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+
+namespace reshade
+{
+	/// <summary>
+	/// Sorted list of disjoint byte ranges that were modified since they were last consumed.
+	/// </summary>
+	class dirty_range_list
+	{
+	public:
+		/// <summary>
+		/// Mark a range as modified. Overlapping and adjacent ranges are merged.
+		/// </summary>
+		/// <param name="offset">The offset of the first modified byte.</param>
+		/// <param name="size">The number of modified bytes.</param>
+		void add(size_t offset, size_t size);
+		/// <summary>
+		/// Remove all modified bytes in the region [begin, end) from the list and return their bounding range.
+		/// </summary>
+		/// <param name="begin">The offset of the first byte in the region.</param>
+		/// <param name="end">The offset one past the last byte in the region.</param>
+		/// <param name="dirty_begin">The offset of the first modified byte in the region.</param>
+		/// <param name="dirty_end">The offset one past the last modified byte in the region.</param>
+		/// <returns><c>true</c> if anything in the region was modified, <c>false</c> otherwise.</returns>
+		bool take(size_t begin, size_t end, size_t &dirty_begin, size_t &dirty_end);
+		/// <summary>
+		/// Remove all ranges from the list.
+		/// </summary>
+		void clear() { _ranges.clear(); }
+
+		/// <summary>
+		/// Returns whether no range is marked as modified.
+		/// </summary>
+		bool empty() const { return _ranges.empty(); }
+		/// <summary>
+		/// Returns the list of modified [begin, end) ranges.
+		/// </summary>
+		const std::vector<std::pair<size_t, size_t>> &ranges() const { return _ranges; }
+
+	private:
+		std::vector<std::pair<size_t, size_t>> _ranges;
+	};
+}
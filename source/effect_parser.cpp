@@ -5,6 +5,7 @@
 
 #include "effect_parser.hpp"
 #include "effect_symbol_table.hpp"
+#include <iterator>
 #include <algorithm>
 
 namespace reshadefx
@@ -1316,7 +1317,7 @@ namespace reshadefx
 					newexpression->type = callexpression->type;
 					newexpression->op = static_cast<enum intrinsic_expression_node::op>(callexpression->callee_name[0]);
 
-					for (size_t i = 0, count = std::min(callexpression->arguments.size(), _countof(newexpression->arguments)); i < count; ++i)
+					for (size_t i = 0, count = std::min(callexpression->arguments.size(), std::size(newexpression->arguments)); i < count; ++i)
 					{
 						newexpression->arguments[i] = callexpression->arguments[i];
 					}
@@ -2594,7 +2595,7 @@ namespace reshadefx
 
 		return true;
 	}
-	bool parser::parse_annotations(std::unordered_map<std::string, reshade::variant> &annotations)
+	bool parser::parse_annotations(std::unordered_map<std::string, reshade::annotation> &annotations)
 	{
 		if (!accept('<'))
 		{
@@ -2630,17 +2631,19 @@ namespace reshadefx
 				continue;
 			}
 
+			const size_t count = std::max(1u, static_cast<unsigned int>(expression->type.rows * expression->type.cols));
+
 			switch (expression->type.basetype)
 			{
 				case type_node::datatype_int:
-					annotations[name] = expression->value_int;
+					annotations[name] = reshade::annotation(expression->value_int, count);
 					break;
 				case type_node::datatype_bool:
 				case type_node::datatype_uint:
-					annotations[name] = expression->value_uint;
+					annotations[name] = reshade::annotation(expression->value_uint, count);
 					break;
 				case type_node::datatype_float:
-					annotations[name] = expression->value_float;
+					annotations[name] = reshade::annotation(expression->value_float, count);
 					break;
 				case type_node::datatype_string:
 					annotations[name] = expression->value_string;
@@ -2811,7 +2814,7 @@ namespace reshadefx
 				return false;
 			}
 
-			const auto parameter = _ast.make_node<variable_declaration_node>(struct location());
+			const auto parameter = _ast.make_node<variable_declaration_node>(reshadefx::location());
 
 			if (!parse_type(parameter->type))
 			{
@@ -0,0 +1,1045 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "effect_pass_fusion.hpp"
+#include <math.h>
+#include <algorithm>
+#include <type_traits>
+#include <unordered_set>
+
+namespace reshadefx
+{
+	using namespace nodes;
+
+	namespace
+	{
+		struct fusable_pass
+		{
+			bool fusable = false;
+			bool srgb = false;
+			const variable_declaration_node *texcoord = nullptr;
+			std::unordered_set<const node *> samples, sample_paths;
+		};
+
+		template <typename F>
+		void for_each_child(node *node, F visit)
+		{
+			switch (node->id)
+			{
+				case nodeid::unary_expression:
+					visit(static_cast<unary_expression_node *>(node)->operand);
+					break;
+				case nodeid::binary_expression:
+					for (auto &operand : static_cast<binary_expression_node *>(node)->operands)
+						visit(operand);
+					break;
+				case nodeid::intrinsic_expression:
+					for (auto &argument : static_cast<intrinsic_expression_node *>(node)->arguments)
+						visit(argument);
+					break;
+				case nodeid::conditional_expression:
+					visit(static_cast<conditional_expression_node *>(node)->condition);
+					visit(static_cast<conditional_expression_node *>(node)->expression_when_true);
+					visit(static_cast<conditional_expression_node *>(node)->expression_when_false);
+					break;
+				case nodeid::assignment_expression:
+					visit(static_cast<assignment_expression_node *>(node)->left);
+					visit(static_cast<assignment_expression_node *>(node)->right);
+					break;
+				case nodeid::expression_sequence:
+					for (auto &expression : static_cast<expression_sequence_node *>(node)->expression_list)
+						visit(expression);
+					break;
+				case nodeid::call_expression:
+					for (auto &argument : static_cast<call_expression_node *>(node)->arguments)
+						visit(argument);
+					break;
+				case nodeid::constructor_expression:
+					for (auto &argument : static_cast<constructor_expression_node *>(node)->arguments)
+						visit(argument);
+					break;
+				case nodeid::swizzle_expression:
+					visit(static_cast<swizzle_expression_node *>(node)->operand);
+					break;
+				case nodeid::field_expression:
+					visit(static_cast<field_expression_node *>(node)->operand);
+					break;
+				case nodeid::initializer_list:
+					for (auto &value : static_cast<initializer_list_node *>(node)->values)
+						visit(value);
+					break;
+				case nodeid::compound_statement:
+					for (auto &statement : static_cast<compound_statement_node *>(node)->statement_list)
+						visit(statement);
+					break;
+				case nodeid::expression_statement:
+					visit(static_cast<expression_statement_node *>(node)->expression);
+					break;
+				case nodeid::if_statement:
+					visit(static_cast<if_statement_node *>(node)->condition);
+					visit(static_cast<if_statement_node *>(node)->statement_when_true);
+					visit(static_cast<if_statement_node *>(node)->statement_when_false);
+					break;
+				case nodeid::switch_statement:
+					visit(static_cast<switch_statement_node *>(node)->test_expression);
+					for (auto &case_statement : static_cast<switch_statement_node *>(node)->case_list)
+						visit(case_statement);
+					break;
+				case nodeid::case_statement:
+					visit(static_cast<case_statement_node *>(node)->statement_list);
+					break;
+				case nodeid::for_statement:
+					visit(static_cast<for_statement_node *>(node)->init_statement);
+					visit(static_cast<for_statement_node *>(node)->condition);
+					visit(static_cast<for_statement_node *>(node)->increment_expression);
+					visit(static_cast<for_statement_node *>(node)->statement_list);
+					break;
+				case nodeid::while_statement:
+					visit(static_cast<while_statement_node *>(node)->condition);
+					visit(static_cast<while_statement_node *>(node)->statement_list);
+					break;
+				case nodeid::return_statement:
+					visit(static_cast<return_statement_node *>(node)->return_value);
+					break;
+				case nodeid::declarator_list:
+					for (auto &declarator : static_cast<declarator_list_node *>(node)->declarator_list)
+						visit(declarator);
+					break;
+				case nodeid::variable_declaration:
+					visit(static_cast<variable_declaration_node *>(node)->initializer_expression);
+					break;
+				default:
+					break;
+			}
+		}
+		node *copy_node(syntax_tree &ast, const node *node)
+		{
+			switch (node->id)
+			{
+				case nodeid::unary_expression:
+					return ast.copy_node(*static_cast<const unary_expression_node *>(node));
+				case nodeid::binary_expression:
+					return ast.copy_node(*static_cast<const binary_expression_node *>(node));
+				case nodeid::intrinsic_expression:
+					return ast.copy_node(*static_cast<const intrinsic_expression_node *>(node));
+				case nodeid::conditional_expression:
+					return ast.copy_node(*static_cast<const conditional_expression_node *>(node));
+				case nodeid::assignment_expression:
+					return ast.copy_node(*static_cast<const assignment_expression_node *>(node));
+				case nodeid::expression_sequence:
+					return ast.copy_node(*static_cast<const expression_sequence_node *>(node));
+				case nodeid::call_expression:
+					return ast.copy_node(*static_cast<const call_expression_node *>(node));
+				case nodeid::constructor_expression:
+					return ast.copy_node(*static_cast<const constructor_expression_node *>(node));
+				case nodeid::swizzle_expression:
+					return ast.copy_node(*static_cast<const swizzle_expression_node *>(node));
+				case nodeid::field_expression:
+					return ast.copy_node(*static_cast<const field_expression_node *>(node));
+				case nodeid::initializer_list:
+					return ast.copy_node(*static_cast<const initializer_list_node *>(node));
+				case nodeid::compound_statement:
+					return ast.copy_node(*static_cast<const compound_statement_node *>(node));
+				case nodeid::expression_statement:
+					return ast.copy_node(*static_cast<const expression_statement_node *>(node));
+				case nodeid::if_statement:
+					return ast.copy_node(*static_cast<const if_statement_node *>(node));
+				case nodeid::switch_statement:
+					return ast.copy_node(*static_cast<const switch_statement_node *>(node));
+				case nodeid::case_statement:
+					return ast.copy_node(*static_cast<const case_statement_node *>(node));
+				case nodeid::for_statement:
+					return ast.copy_node(*static_cast<const for_statement_node *>(node));
+				case nodeid::while_statement:
+					return ast.copy_node(*static_cast<const while_statement_node *>(node));
+				case nodeid::return_statement:
+					return ast.copy_node(*static_cast<const return_statement_node *>(node));
+				case nodeid::declarator_list:
+					return ast.copy_node(*static_cast<const declarator_list_node *>(node));
+				case nodeid::variable_declaration:
+					return ast.copy_node(*static_cast<const variable_declaration_node *>(node));
+				default:
+					return nullptr;
+			}
+		}
+
+		std::string normalize_semantic(const std::string &semantic)
+		{
+			if (semantic == "TEXCOORD")
+				return "TEXCOORD0";
+			if (semantic == "SV_TARGET0" || semantic == "COLOR" || semantic == "COLOR0")
+				return "SV_TARGET";
+			return semantic;
+		}
+		bool is_float4(const type_node &type)
+		{
+			return type.is_floating_point() && type.rows == 4 && type.cols == 1 && !type.is_array();
+		}
+		bool is_same_type(const type_node &lhs, const type_node &rhs)
+		{
+			return lhs.basetype == rhs.basetype && lhs.rows == rhs.rows && lhs.cols == rhs.cols && lhs.array_length == rhs.array_length;
+		}
+		bool is_backbuffer_sampler(const variable_declaration_node *variable)
+		{
+			if (!variable->type.is_sampler() || variable->properties.texture == nullptr)
+			{
+				return false;
+			}
+
+			const std::string &semantic = variable->properties.texture->semantic;
+
+			return semantic == "COLOR" || semantic == "SV_TARGET";
+		}
+		const variable_declaration_node *find_written_variable(const expression_node *node)
+		{
+			while (node != nullptr)
+			{
+				switch (node->id)
+				{
+					case nodeid::lvalue_expression:
+						return static_cast<const lvalue_expression_node *>(node)->reference;
+					case nodeid::swizzle_expression:
+						node = static_cast<const swizzle_expression_node *>(node)->operand;
+						break;
+					case nodeid::field_expression:
+						node = static_cast<const field_expression_node *>(node)->operand;
+						break;
+					case nodeid::binary_expression:
+						if (static_cast<const binary_expression_node *>(node)->op != binary_expression_node::element_extract)
+							return nullptr;
+						node = static_cast<const binary_expression_node *>(node)->operands[0];
+						break;
+					default:
+						return nullptr;
+				}
+			}
+
+			return nullptr;
+		}
+
+		class vertex_shader_evaluator
+		{
+		public:
+			struct value
+			{
+				float data[4] = {};
+				unsigned int count = 0;
+			};
+
+			explicit vertex_shader_evaluator(unsigned int vertex_id) : _vertex_id(vertex_id) { }
+
+			/// <summary>
+			/// Run a vertex shader for a single vertex. This only supports the few constructs a full-screen triangle is usually generated with, which is enough to find out where it places its vertices.
+			/// </summary>
+			bool run(const function_declaration_node *function)
+			{
+				for (auto parameter : function->parameter_list)
+				{
+					if (parameter->type.is_array() || parameter->type.is_matrix() || !parameter->type.is_numeric())
+					{
+						return false;
+					}
+
+					value &variable = _variables[parameter];
+					variable.count = parameter->type.rows;
+
+					if (!parameter->type.has_qualifier(type_node::qualifier_out))
+					{
+						// The vertex index is the only input that is known without a vertex buffer
+						if (normalize_semantic(parameter->semantic) != "SV_VERTEXID" || variable.count != 1)
+						{
+							return false;
+						}
+
+						variable.data[0] = static_cast<float>(_vertex_id);
+					}
+				}
+
+				return execute(function->definition);
+			}
+
+			const value *find(const variable_declaration_node *variable) const
+			{
+				const auto it = _variables.find(variable);
+
+				return it != _variables.end() ? &it->second : nullptr;
+			}
+
+		private:
+			bool execute(const statement_node *node)
+			{
+				if (node == nullptr || _returned)
+				{
+					return true;
+				}
+
+				switch (node->id)
+				{
+					case nodeid::compound_statement:
+						for (auto statement : static_cast<const compound_statement_node *>(node)->statement_list)
+							if (!execute(statement))
+								return false;
+						return true;
+					case nodeid::expression_statement:
+						return evaluate(static_cast<const expression_statement_node *>(node)->expression).count != 0;
+					case nodeid::declarator_list:
+						for (auto declarator : static_cast<const declarator_list_node *>(node)->declarator_list)
+						{
+							if (declarator->type.is_array() || declarator->type.is_matrix() || !declarator->type.is_numeric())
+								return false;
+
+							value &variable = _variables[declarator];
+							variable.count = declarator->type.rows;
+
+							if (declarator->initializer_expression != nullptr && !convert(evaluate(declarator->initializer_expression), declarator->type, variable))
+								return false;
+						}
+						return true;
+					case nodeid::if_statement:
+					{
+						const auto statement = static_cast<const if_statement_node *>(node);
+						const value condition = evaluate(statement->condition);
+						return condition.count == 1 && execute(condition.data[0] != 0 ? statement->statement_when_true : statement->statement_when_false);
+					}
+					case nodeid::return_statement:
+						_returned = true;
+						return !static_cast<const return_statement_node *>(node)->is_discard && static_cast<const return_statement_node *>(node)->return_value == nullptr;
+					default:
+						return false;
+				}
+			}
+
+			value evaluate(const expression_node *node)
+			{
+				value result;
+
+				if (node == nullptr || node->type.is_array() || node->type.is_matrix() || !node->type.is_numeric())
+				{
+					return result;
+				}
+
+				switch (node->id)
+				{
+					case nodeid::literal_expression:
+					{
+						const auto literal = static_cast<const literal_expression_node *>(node);
+						result.count = node->type.rows;
+						for (unsigned int i = 0; i < result.count; i++)
+							result.data[i] = node->type.is_floating_point() ? literal->value_float[i] : node->type.basetype == type_node::datatype_uint ? static_cast<float>(literal->value_uint[i]) : static_cast<float>(literal->value_int[i]);
+						break;
+					}
+					case nodeid::lvalue_expression:
+						if (const value *const variable = find(static_cast<const lvalue_expression_node *>(node)->reference))
+							result = *variable;
+						break;
+					case nodeid::unary_expression:
+					{
+						const auto unary = static_cast<const unary_expression_node *>(node);
+						const value operand = evaluate(unary->operand);
+						switch (unary->op)
+						{
+							case unary_expression_node::none:
+								result = operand;
+								break;
+							case unary_expression_node::negate:
+								result = operand;
+								for (unsigned int i = 0; i < result.count; i++)
+									result.data[i] = -result.data[i];
+								break;
+							case unary_expression_node::logical_not:
+								result = operand;
+								for (unsigned int i = 0; i < result.count; i++)
+									result.data[i] = result.data[i] == 0 ? 1.0f : 0.0f;
+								break;
+							case unary_expression_node::cast:
+								convert(operand, node->type, result);
+								break;
+							default:
+								break;
+						}
+						break;
+					}
+					case nodeid::binary_expression:
+					{
+						const auto binary = static_cast<const binary_expression_node *>(node);
+						const value lhs = evaluate(binary->operands[0]), rhs = evaluate(binary->operands[1]);
+						// Scalar operands are applied to every component of the other one
+						if (lhs.count == 0 || rhs.count == 0 || (lhs.count != 1 && lhs.count < node->type.rows) || (rhs.count != 1 && rhs.count < node->type.rows))
+							break;
+						result.count = node->type.rows;
+						for (unsigned int i = 0; i < result.count; i++)
+						{
+							const float a = lhs.data[lhs.count == 1 ? 0 : i], b = rhs.data[rhs.count == 1 ? 0 : i];
+							switch (binary->op)
+							{
+								case binary_expression_node::add: result.data[i] = a + b; break;
+								case binary_expression_node::subtract: result.data[i] = a - b; break;
+								case binary_expression_node::multiply: result.data[i] = a * b; break;
+								case binary_expression_node::divide: result.data[i] = b != 0 ? (node->type.is_integral() ? truncf(a / b) : a / b) : 0.0f; break;
+								case binary_expression_node::less: result.data[i] = a < b; break;
+								case binary_expression_node::greater: result.data[i] = a > b; break;
+								case binary_expression_node::less_equal: result.data[i] = a <= b; break;
+								case binary_expression_node::greater_equal: result.data[i] = a >= b; break;
+								case binary_expression_node::equal: result.data[i] = a == b; break;
+								case binary_expression_node::not_equal: result.data[i] = a != b; break;
+								case binary_expression_node::logical_and: result.data[i] = a != 0 && b != 0; break;
+								case binary_expression_node::logical_or: result.data[i] = a != 0 || b != 0; break;
+								default: return value();
+							}
+						}
+						break;
+					}
+					case nodeid::conditional_expression:
+					{
+						const auto conditional = static_cast<const conditional_expression_node *>(node);
+						const value condition = evaluate(conditional->condition);
+						if (condition.count == 1)
+							convert(evaluate(condition.data[0] != 0 ? conditional->expression_when_true : conditional->expression_when_false), node->type, result);
+						break;
+					}
+					case nodeid::constructor_expression:
+						for (auto argument : static_cast<const constructor_expression_node *>(node)->arguments)
+						{
+							const value component = evaluate(argument);
+							if (component.count == 0 || result.count + component.count > 4)
+								return value();
+							for (unsigned int i = 0; i < component.count; i++)
+								result.data[result.count++] = component.data[i];
+						}
+						if (result.count != node->type.rows)
+							return value();
+						break;
+					case nodeid::swizzle_expression:
+					{
+						const auto swizzle = static_cast<const swizzle_expression_node *>(node);
+						const value operand = evaluate(swizzle->operand);
+						if (operand.count == 0)
+							break;
+						result.count = node->type.rows;
+						for (unsigned int i = 0; i < result.count; i++)
+						{
+							if (swizzle->mask[i] < 0 || static_cast<unsigned int>(swizzle->mask[i]) >= operand.count)
+								return value();
+							result.data[i] = operand.data[swizzle->mask[i]];
+						}
+						break;
+					}
+					case nodeid::assignment_expression:
+					{
+						const auto assignment = static_cast<const assignment_expression_node *>(node);
+						if (assignment->op != assignment_expression_node::none)
+							break;
+
+						// Only whole variables and swizzles of them can be assigned to
+						const expression_node *target = assignment->left;
+						const signed char *mask = nullptr;
+						if (target->id == nodeid::swizzle_expression)
+						{
+							mask = static_cast<const swizzle_expression_node *>(target)->mask;
+							target = static_cast<const swizzle_expression_node *>(target)->operand;
+						}
+						if (target->id != nodeid::lvalue_expression)
+							break;
+
+						value *const variable = const_cast<value *>(find(static_cast<const lvalue_expression_node *>(target)->reference));
+						if (variable == nullptr || !convert(evaluate(assignment->right), assignment->left->type, result))
+							break;
+
+						for (unsigned int i = 0; i < result.count; i++)
+						{
+							const unsigned int index = mask != nullptr ? mask[i] : i;
+							if (index >= variable->count)
+								return value();
+							variable->data[index] = result.data[i];
+						}
+						break;
+					}
+					default:
+						break;
+				}
+
+				return result;
+			}
+
+			static bool convert(const value &from, const type_node &type, value &to)
+			{
+				// Scalars are broadcast to vectors, while vectors are truncated to shorter ones
+				if (from.count == 0 || (from.count != 1 && from.count < type.rows))
+				{
+					return false;
+				}
+
+				to.count = type.rows;
+
+				for (unsigned int i = 0; i < to.count; i++)
+				{
+					const float component = from.data[from.count == 1 ? 0 : i];
+					to.data[i] = type.is_boolean() ? (component != 0 ? 1.0f : 0.0f) : type.is_integral() ? truncf(component) : component;
+				}
+
+				return true;
+			}
+
+			const unsigned int _vertex_id;
+			bool _returned = false;
+			std::unordered_map<const variable_declaration_node *, value> _variables;
+		};
+
+		bool is_full_screen_triangle(const function_declaration_node *vertex_shader)
+		{
+			const variable_declaration_node *position = nullptr, *texcoord = nullptr;
+
+			for (auto parameter : vertex_shader->parameter_list)
+			{
+				if (!parameter->type.has_qualifier(type_node::qualifier_out))
+					continue;
+				if (normalize_semantic(parameter->semantic) == "SV_POSITION" && is_float4(parameter->type))
+					position = parameter;
+				else if (normalize_semantic(parameter->semantic) == "TEXCOORD0" && parameter->type.is_floating_point() && parameter->type.rows == 2 && parameter->type.cols == 1)
+					texcoord = parameter;
+			}
+
+			if (position == nullptr || texcoord == nullptr || !vertex_shader->return_type.is_void())
+			{
+				return false;
+			}
+
+			float w = 0;
+
+			// Passes draw a single triangle, whose texture coordinates have to be exactly where its vertices end up on the screen, so that they address the pixel being shaded after interpolation
+			for (unsigned int vertex_id = 0; vertex_id < 3; vertex_id++)
+			{
+				vertex_shader_evaluator evaluator(vertex_id);
+
+				if (!evaluator.run(vertex_shader))
+				{
+					return false;
+				}
+
+				const auto &pos = evaluator.find(position)->data;
+				const auto &uv = evaluator.find(texcoord)->data;
+
+				// Perspective correct interpolation only matches the screen position if all vertices have the same depth
+				if (pos[3] == 0 || (vertex_id != 0 && pos[3] != w))
+				{
+					return false;
+				}
+
+				w = pos[3];
+
+				if (fabsf(uv[0] - (pos[0] / w * 0.5f + 0.5f)) > 1e-6f || fabsf(uv[1] - (pos[1] / w * -0.5f + 0.5f)) > 1e-6f)
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		class pixel_shader_analyzer
+		{
+		public:
+			explicit pixel_shader_analyzer(fusable_pass &info) : _info(info) { }
+
+			bool analyze(const function_declaration_node *function)
+			{
+				_function = function;
+				_valid = true;
+
+				visit(function->definition);
+
+				// The coordinate the back buffer is sampled at has to be the one that was passed in, so it may not be changed anywhere in the shader
+				if (_info.texcoord != nullptr && _written_variables.count(_info.texcoord))
+				{
+					_valid = false;
+				}
+
+				return _valid;
+			}
+
+		private:
+			void visit(node *node)
+			{
+				if (node == nullptr || !_valid)
+				{
+					return;
+				}
+
+				switch (node->id)
+				{
+					case nodeid::lvalue_expression:
+						// Sampling the back buffer at the current pixel is handled below, any other use of a sampler could read a different pixel or texture
+						if (static_cast<lvalue_expression_node *>(node)->reference->type.is_sampler())
+							_valid = false;
+						return;
+					case nodeid::intrinsic_expression:
+					{
+						const auto intrinsic = static_cast<intrinsic_expression_node *>(node);
+
+						if (intrinsic->op == intrinsic_expression_node::texture && intrinsic->arguments[0]->id == nodeid::lvalue_expression)
+						{
+							visit_sample(intrinsic);
+							return;
+						}
+
+						switch (intrinsic->op)
+						{
+							case intrinsic_expression_node::sincos:
+								_written_variables.insert(find_written_variable(intrinsic->arguments[1]));
+								_written_variables.insert(find_written_variable(intrinsic->arguments[2]));
+								break;
+							case intrinsic_expression_node::frexp:
+							case intrinsic_expression_node::modf:
+								_written_variables.insert(find_written_variable(intrinsic->arguments[1]));
+								break;
+							default:
+								break;
+						}
+						break;
+					}
+					case nodeid::unary_expression:
+						switch (static_cast<unary_expression_node *>(node)->op)
+						{
+							case unary_expression_node::pre_increase:
+							case unary_expression_node::pre_decrease:
+							case unary_expression_node::post_increase:
+							case unary_expression_node::post_decrease:
+								_written_variables.insert(find_written_variable(static_cast<unary_expression_node *>(node)->operand));
+								break;
+							default:
+								break;
+						}
+						break;
+					case nodeid::assignment_expression:
+						_written_variables.insert(find_written_variable(static_cast<assignment_expression_node *>(node)->left));
+						break;
+					case nodeid::call_expression:
+					{
+						const auto call = static_cast<call_expression_node *>(node);
+
+						for (size_t i = 0; i < call->arguments.size(); i++)
+						{
+							if (call->callee->parameter_list[i]->type.has_qualifier(type_node::qualifier_out))
+							{
+								_written_variables.insert(find_written_variable(call->arguments[i]));
+							}
+						}
+
+						visit_function(call->callee);
+						break;
+					}
+					case nodeid::return_statement:
+						if (static_cast<return_statement_node *>(node)->is_discard)
+							_valid = false;
+						break;
+					default:
+						break;
+				}
+
+				_ancestors.push_back(node);
+				for_each_child(node, [this](auto *child) { visit(child); });
+				_ancestors.pop_back();
+			}
+			void visit_sample(const intrinsic_expression_node *node)
+			{
+				const auto sampler = static_cast<const lvalue_expression_node *>(node->arguments[0])->reference;
+				const auto coordinate = node->arguments[1];
+
+				if (!is_backbuffer_sampler(sampler) || coordinate->id != nodeid::lvalue_expression)
+				{
+					_valid = false;
+					return;
+				}
+
+				const auto texcoord = static_cast<const lvalue_expression_node *>(coordinate)->reference;
+
+				if (std::find(_function->parameter_list.begin(), _function->parameter_list.end(), texcoord) == _function->parameter_list.end() ||
+					normalize_semantic(texcoord->semantic) != "TEXCOORD0" ||
+					(!_info.samples.empty() && (_info.texcoord != texcoord || _info.srgb != sampler->properties.srgb_texture)))
+				{
+					_valid = false;
+					return;
+				}
+
+				_info.texcoord = texcoord;
+				_info.srgb = sampler->properties.srgb_texture;
+				_info.samples.insert(node);
+				_info.sample_paths.insert(_ancestors.begin(), _ancestors.end());
+			}
+
+			void visit_function(const function_declaration_node *function)
+			{
+				// Functions called by the pixel shader are not rewritten, so they may not sample anything or discard the pixel
+				if (_visited_functions.insert(function).second)
+				{
+					visit_callee(function->definition);
+				}
+			}
+			void visit_callee(node *node)
+			{
+				if (node == nullptr || !_valid)
+				{
+					return;
+				}
+
+				switch (node->id)
+				{
+					case nodeid::lvalue_expression:
+						if (static_cast<lvalue_expression_node *>(node)->reference->type.is_sampler())
+							_valid = false;
+						return;
+					case nodeid::call_expression:
+						visit_function(static_cast<call_expression_node *>(node)->callee);
+						break;
+					case nodeid::return_statement:
+						if (static_cast<return_statement_node *>(node)->is_discard)
+							_valid = false;
+						break;
+					default:
+						break;
+				}
+
+				for_each_child(node, [this](auto *child) { visit_callee(child); });
+			}
+
+			fusable_pass &_info;
+			const function_declaration_node *_function = nullptr;
+			bool _valid = true;
+			std::vector<const reshadefx::node *> _ancestors;
+			std::unordered_set<const variable_declaration_node *> _written_variables;
+			std::unordered_set<const function_declaration_node *> _visited_functions;
+		};
+
+		class sample_replacer
+		{
+		public:
+			sample_replacer(syntax_tree &ast, const fusable_pass &info, const variable_declaration_node *color) : _ast(ast), _info(info), _color(color) { }
+
+			template <typename T>
+			void visit(T *&node)
+			{
+				if (node == nullptr)
+				{
+					return;
+				}
+
+				if constexpr (std::is_same_v<T, expression_node>)
+				{
+					if (_info.samples.count(node))
+					{
+						const auto lvalue = _ast.make_node<lvalue_expression_node>(node->location);
+						lvalue->reference = _color;
+						lvalue->type = _color->type;
+
+						node = lvalue;
+						return;
+					}
+				}
+
+				// Copy every node on the way to a sample, so that the original pixel shader stays intact for when the pass is rendered on its own
+				if (_info.sample_paths.count(node))
+				{
+					node = static_cast<T *>(copy_node(_ast, node));
+
+					for_each_child(node, [this](auto *&child) { visit(child); });
+				}
+			}
+
+		private:
+			syntax_tree &_ast;
+			const fusable_pass &_info;
+			const variable_declaration_node *const _color;
+		};
+
+		class pass_fuser
+		{
+		public:
+			pass_fuser(syntax_tree &ast, bool clamp_colors) : _ast(ast), _clamp_colors(clamp_colors) { }
+
+			size_t find_run(pass_declaration_node *const *passes, size_t count)
+			{
+				const fusable_pass &first = analyze(passes[0]);
+
+				if (!first.fusable)
+				{
+					return 1;
+				}
+
+				size_t length = 1;
+
+				while (length < count && can_follow(passes[0], passes[length - 1], passes[length]))
+				{
+					length++;
+				}
+
+				return length;
+			}
+			pass_declaration_node *fuse(pass_declaration_node *const *passes, size_t count)
+			{
+				const auto first_shader = passes[0]->pixel_shader;
+
+				// Each pass after the first gets the color the previous one returned instead of sampling the back buffer, clamped just like writing it to a normalized back buffer would
+				expression_node *color = make_call(first_shader, first_shader, nullptr);
+
+				for (size_t i = 1; i < count; i++)
+				{
+					if (_clamp_colors)
+					{
+						const auto saturate = _ast.make_node<intrinsic_expression_node>(color->location);
+						saturate->op = intrinsic_expression_node::saturate;
+						saturate->type = color->type;
+						saturate->arguments[0] = color;
+
+						color = saturate;
+					}
+
+					color = make_call(rewrite_pixel_shader(passes[i]), first_shader, color);
+				}
+
+				const auto return_statement = _ast.make_node<return_statement_node>(first_shader->location);
+				return_statement->return_value = color;
+
+				const auto function = _ast.make_node<function_declaration_node>(first_shader->location);
+				function->name = "__fused" + std::to_string(_fused_function_count++);
+				function->unique_name = 'F' + function->name;
+				function->return_type = first_shader->return_type;
+				function->return_semantic = first_shader->return_semantic;
+				function->parameter_list = first_shader->parameter_list;
+				function->definition = _ast.make_node<compound_statement_node>(first_shader->location);
+				function->definition->statement_list.push_back(return_statement);
+
+				// Functions are compiled in order, so this has to come after all the functions it calls
+				_ast.functions.push_back(function);
+
+				const auto pass = _ast.copy_node(*passes[0]);
+				pass->pixel_shader = function;
+				pass->srgb_write_enable = passes[count - 1]->srgb_write_enable;
+
+				return pass;
+			}
+
+		private:
+			const fusable_pass &analyze(const pass_declaration_node *pass)
+			{
+				const auto it = _passes.find(pass);
+
+				if (it != _passes.end())
+				{
+					return it->second;
+				}
+
+				fusable_pass &info = _passes[pass];
+				const auto function = pass->pixel_shader;
+
+				// Only passes that overwrite the whole back buffer replace what the previous pass rendered
+				if (std::any_of(std::begin(pass->render_targets), std::end(pass->render_targets), [](auto target) { return target != nullptr; }) ||
+					pass->blend_enable || pass->stencil_enable || pass->color_write_mask != 0xF)
+				{
+					return info;
+				}
+
+				// The texture coordinates have to map one to one to the pixel that is being shaded, which is checked by running the vertex shader rather than trusting its name
+				if (pass->vertex_shader == nullptr || !is_full_screen_triangle(pass->vertex_shader) || function == nullptr ||
+					!is_float4(function->return_type) || normalize_semantic(function->return_semantic) != "SV_TARGET")
+				{
+					return info;
+				}
+
+				for (auto parameter : function->parameter_list)
+				{
+					if (parameter->type.is_struct() || parameter->type.has_qualifier(type_node::qualifier_out) || parameter->semantic.empty())
+					{
+						return info;
+					}
+				}
+
+				info.fusable = pixel_shader_analyzer(info).analyze(function);
+
+				return info;
+			}
+			bool can_follow(const pass_declaration_node *first, const pass_declaration_node *previous, const pass_declaration_node *pass)
+			{
+				const fusable_pass &info = analyze(pass);
+
+				if (!info.fusable || pass->vertex_shader != previous->vertex_shader)
+				{
+					return false;
+				}
+
+				// Reading the back buffer with sRGB conversion only gives back what the previous pass returned if that pass wrote it with sRGB conversion too
+				if (!info.samples.empty() && info.srgb != previous->srgb_write_enable)
+				{
+					return false;
+				}
+
+				// The fused pixel shader takes the same parameters as the first one and passes them on to the others by semantic
+				for (auto parameter : pass->pixel_shader->parameter_list)
+				{
+					if (find_parameter(first->pixel_shader, parameter) == nullptr)
+					{
+						return false;
+					}
+				}
+
+				return true;
+			}
+
+			const function_declaration_node *rewrite_pixel_shader(const pass_declaration_node *pass)
+			{
+				const auto original = pass->pixel_shader;
+				const auto it = _rewritten_functions.find(original);
+
+				if (it != _rewritten_functions.end())
+				{
+					return it->second;
+				}
+
+				const auto color = _ast.make_node<variable_declaration_node>(original->location);
+				color->name = color->unique_name = "__color";
+				color->type = { type_node::datatype_float, type_node::qualifier_in, 4, 1, 0, nullptr };
+
+				const auto function = _ast.copy_node(*original);
+				function->name += "__fused";
+				function->unique_name += "__fused";
+				function->parameter_list.push_back(color);
+
+				sample_replacer(_ast, analyze(pass), color).visit(function->definition);
+
+				_ast.functions.push_back(function);
+
+				return _rewritten_functions[original] = function;
+			}
+
+			expression_node *make_call(const function_declaration_node *callee, const function_declaration_node *caller, expression_node *color)
+			{
+				const auto call = _ast.make_node<call_expression_node>(caller->location);
+				call->callee = callee;
+				call->callee_name = callee->name;
+				call->type = callee->return_type;
+
+				for (auto parameter : callee->parameter_list)
+				{
+					if (parameter->semantic.empty())
+					{
+						continue;
+					}
+
+					const auto lvalue = _ast.make_node<lvalue_expression_node>(caller->location);
+					lvalue->reference = find_parameter(caller, parameter);
+					lvalue->type = lvalue->reference->type;
+
+					call->arguments.push_back(lvalue);
+				}
+
+				if (color != nullptr)
+				{
+					call->arguments.push_back(color);
+				}
+
+				return call;
+			}
+			static const variable_declaration_node *find_parameter(const function_declaration_node *function, const variable_declaration_node *parameter)
+			{
+				const std::string semantic = normalize_semantic(parameter->semantic);
+
+				for (auto candidate : function->parameter_list)
+				{
+					if (normalize_semantic(candidate->semantic) == semantic && is_same_type(candidate->type, parameter->type))
+					{
+						return candidate;
+					}
+				}
+
+				return nullptr;
+			}
+
+			syntax_tree &_ast;
+			const bool _clamp_colors;
+			size_t _fused_function_count = 0;
+			std::unordered_map<const pass_declaration_node *, fusable_pass> _passes;
+			std::unordered_map<const function_declaration_node *, const function_declaration_node *> _rewritten_functions;
+		};
+	}
+
+	pass_fusion_result fuse_pixel_local_passes(syntax_tree &ast, bool clamp_colors)
+	{
+		pass_fusion_result result;
+		result.function_count = ast.functions.size();
+		result.technique_count = ast.techniques.size();
+
+		for (auto technique : ast.techniques)
+		{
+			result.pass_lists.push_back(technique->pass_list);
+		}
+
+		pass_fuser fuser(ast, clamp_colors);
+
+		// Fuse passes within each technique first, since those are always rendered together
+		for (size_t i = 0; i < result.technique_count; i++)
+		{
+			const auto technique = ast.techniques[i];
+			std::vector<pass_declaration_node *> pass_list;
+
+			for (size_t k = 0, count; k < technique->pass_list.size(); k += count)
+			{
+				count = fuser.find_run(technique->pass_list.data() + k, technique->pass_list.size() - k);
+
+				pass_list.push_back(count > 1 ? fuser.fuse(technique->pass_list.data() + k, count) : technique->pass_list[k]);
+
+				result.removed_pass_count += count - 1;
+			}
+
+			technique->pass_list = std::move(pass_list);
+		}
+
+		// Then add a hidden technique for every run of techniques that consist of a single pass, which can replace them when they are rendered one after another
+		for (size_t i = 0, count; i < result.technique_count; i += count)
+		{
+			std::vector<pass_declaration_node *> passes;
+
+			for (size_t k = i; k < result.technique_count && ast.techniques[k]->pass_list.size() == 1; k++)
+			{
+				passes.push_back(ast.techniques[k]->pass_list[0]);
+			}
+
+			count = passes.empty() ? 1 : fuser.find_run(passes.data(), passes.size());
+
+			if (count < 2)
+			{
+				continue;
+			}
+
+			const auto technique = ast.make_node<technique_declaration_node>(ast.techniques[i]->location);
+			std::vector<std::string> names;
+
+			for (size_t k = i; k < i + count; k++)
+			{
+				names.push_back(ast.techniques[k]->name);
+				technique->name += (k == i ? "" : "+") + ast.techniques[k]->name;
+			}
+
+			const unsigned int hidden = 1;
+			technique->unique_name = 'T' + technique->name;
+			technique->annotation_list["hidden"] = reshade::annotation(&hidden, 1);
+			technique->pass_list.push_back(fuser.fuse(passes.data(), count));
+
+			ast.techniques.push_back(technique);
+
+			result.fused_techniques[technique] = std::move(names);
+		}
+
+		return result;
+	}
+	void revert_pass_fusion(syntax_tree &ast, const pass_fusion_result &result)
+	{
+		ast.functions.resize(result.function_count);
+		ast.techniques.resize(result.technique_count);
+
+		for (size_t i = 0; i < result.technique_count; i++)
+		{
+			ast.techniques[i]->pass_list = result.pass_lists[i];
+		}
+	}
+}
@@ -0,0 +1,45 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include "effect_syntax_tree.hpp"
+#include <unordered_map>
+
+namespace reshadefx
+{
+	/// <summary>
+	/// The changes made to a syntax tree by <see cref="fuse_pixel_local_passes"/>.
+	/// </summary>
+	struct pass_fusion_result
+	{
+		/// <summary>
+		/// The number of passes that no longer have to be rendered separately.
+		/// </summary>
+		size_t removed_pass_count = 0;
+		/// <summary>
+		/// The techniques that were added to the syntax tree, each combining a run of single-pass techniques, together with the names of those techniques in order.
+		/// </summary>
+		std::unordered_map<const nodes::technique_declaration_node *, std::vector<std::string>> fused_techniques;
+
+		size_t function_count = 0, technique_count = 0;
+		std::vector<std::vector<nodes::pass_declaration_node *>> pass_lists;
+	};
+
+	/// <summary>
+	/// Combine consecutive passes that only read the back buffer at the pixel they write into a single pass, whose pixel shader calls the pixel shaders of the original passes one after another.
+	/// Passes are fused within a technique, and runs of single-pass techniques get an additional hidden technique, which can be rendered instead of them when they are all enabled in the same order.
+	/// </summary>
+	/// <param name="ast">The syntax tree of the effect to fuse passes in. New functions and techniques are appended to it.</param>
+	/// <param name="clamp_colors">Set to <c>true</c> if the back buffer stores normalized values, so that the color passed from one pass to the next is clamped like it would be when written to the back buffer. Floating-point back buffers keep values outside that range.</param>
+	/// <returns>The changes that were made, so that they can be reverted again.</returns>
+	pass_fusion_result fuse_pixel_local_passes(syntax_tree &ast, bool clamp_colors);
+	/// <summary>
+	/// Restore the functions, techniques and passes a syntax tree had before <see cref="fuse_pixel_local_passes"/> was called on it.
+	/// </summary>
+	/// <param name="ast">The syntax tree passes were fused in.</param>
+	/// <param name="result">The changes that were made.</param>
+	void revert_pass_fusion(syntax_tree &ast, const pass_fusion_result &result);
+}
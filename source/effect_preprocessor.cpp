@@ -117,10 +117,13 @@ namespace reshadefx
 			if (parent != nullptr)
 			{
 				_input_stack.top()._name = parent->_name;
+				_input_stack.top()._is_macro_expansion = true;
 			}
 		}
 		else
 		{
+			// The line after the directive is the first one
+			_output_location.line = 0;
 			_output_location.source = name;
 			_output += "#line 1 \"" + name + "\"\n";
 		}
@@ -140,6 +143,12 @@ namespace reshadefx
 		auto &input_level = _input_stack.top();
 		_token = input_level._next_token;
 		_token.location.source = _output_location.source;
+
+		if (!input_level._is_macro_expansion)
+		{
+			_source_location = _token.location;
+		}
+
 		_current_token_raw_data = current_lexer().input_string().substr(_token.offset, _token.length);
 
 		input_level._next_token = input_level._lexer->lex();
@@ -162,7 +171,7 @@ namespace reshadefx
 
 			if (_output_location.source != _input_stack.top()._name)
 			{
-				_output_location.line = 1;
+				_output_location.line = 0;
 				_output_location.source = _input_stack.top()._name;
 				_output += "#line 1 \"" + _output_location.source + "\"\n";
 			}
@@ -1028,6 +1037,9 @@ namespace reshadefx
 			}
 		}
 
+		// The tokens of nested macros end up on the line the outermost one was expanded on
+		_macro_usages[it->first].push_back(_source_location);
+
 		std::string input;
 		expand_macro(it->second, arguments, input);
 
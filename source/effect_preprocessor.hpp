@@ -34,6 +34,10 @@ namespace reshadefx
 		const std::string &errors() const { return _errors; }
 		const std::string &current_output() const { return _output; }
 		const std::vector<std::string> &current_pragmas() const { return _pragmas; }
+		/// <summary>
+		/// Get the locations in the source at which each macro was expanded. Macros expanded as part of another macro are reported at the location the outermost macro was expanded at, which is where the parser sees the resulting tokens.
+		/// </summary>
+		const std::unordered_map<std::string, std::vector<location>> &current_macro_usages() const { return _macro_usages; }
 
 		bool run(const reshade::filesystem::path &file_path);
 		bool run(const reshade::filesystem::path &file_path, std::vector<reshade::filesystem::path> &included_files);
@@ -58,6 +62,7 @@ namespace reshadefx
 
 			std::string _name;
 			std::unique_ptr<lexer> _lexer;
+			bool _is_macro_expansion = false;
 			token _next_token;
 			size_t _offset;
 			std::stack<if_level> _if_stack;
@@ -105,6 +110,8 @@ namespace reshadefx
 		std::string _output, _errors, _current_token_raw_data;
 		int _recursion_count = 0;
 		std::unordered_map<std::string, macro> _macros;
+		std::unordered_map<std::string, std::vector<location>> _macro_usages;
+		location _source_location;
 		std::vector<std::string> _pragmas;
 		std::vector<reshade::filesystem::path> _include_paths;
 		std::unordered_map<std::string, std::string> _filecache;
@@ -8,6 +8,7 @@
 #include <stack>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 namespace reshadefx
 {
@@ -7,6 +7,7 @@
 
 #include "effect_syntax_tree_nodes.hpp"
 #include <list>
+#include <algorithm>
 
 namespace reshadefx
 {
@@ -26,6 +27,11 @@ namespace reshadefx
 
 			return node;
 		}
+		template <typename T>
+		T *copy_node(const T &original)
+		{
+			return _pool.add<T>(original);
+		}
 
 		std::vector<nodes::struct_declaration_node *> structs;
 		std::vector<nodes::variable_declaration_node *> variables;
@@ -55,8 +61,8 @@ namespace reshadefx
 				clear();
 			}
 
-			template <typename T>
-			T *add()
+			template <typename T, typename... Args>
+			T *add(Args &&... args)
 			{
 				auto size = sizeof(nodeinfo) - sizeof(node) + sizeof(T);
 				auto page = std::find_if(_pages.begin(), _pages.end(),
@@ -73,7 +79,7 @@ namespace reshadefx
 				}
 
 				const auto node = new (&page->memory.at(page->cursor)) nodeinfo;
-				const auto node_data = new (&node->data) T();
+				const auto node_data = new (&node->data) T(std::forward<Args>(args)...);
 				node->size = size;
 				node->dtor = [](void *object) { reinterpret_cast<T *>(object)->~T(); };
 
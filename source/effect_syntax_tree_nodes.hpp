@@ -5,9 +5,10 @@
 
 #pragma once
 
-#include "variant.hpp"
+#include "annotation.hpp"
 #include "source_location.hpp"
 #include "runtime_objects.hpp"
+#include <float.h>
 
 namespace reshadefx
 {
@@ -54,7 +55,7 @@ namespace reshadefx
 
 	public:
 		const nodeid id;
-		location location;
+		reshadefx::location location;
 
 	protected:
 		explicit node(nodeid id) : id(id), location() { }
@@ -163,6 +164,8 @@ namespace reshadefx::nodes
 		};
 
 		std::string value_string;
+		// The constant this value was copied from by constant folding, if any
+		const struct variable_declaration_node *constant = nullptr;
 	};
 	struct unary_expression_node : public expression_node
 	{
@@ -439,7 +442,7 @@ namespace reshadefx::nodes
 		variable_declaration_node() : declaration_node(nodeid::variable_declaration) { }
 
 		type_node type;
-		std::unordered_map<std::string, reshade::variant> annotation_list;
+		std::unordered_map<std::string, reshade::annotation> annotation_list;
 		std::string semantic;
 		expression_node *initializer_expression;
 
@@ -531,7 +534,7 @@ namespace reshadefx::nodes
 	{
 		technique_declaration_node() : declaration_node(nodeid::technique_declaration) { }
 
-		std::unordered_map<std::string, reshade::variant> annotation_list;
+		std::unordered_map<std::string, reshade::annotation> annotation_list;
 		std::vector<pass_declaration_node *> pass_list;
 	};
 }
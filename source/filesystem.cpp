@@ -107,6 +107,54 @@ namespace reshade::filesystem
 	{
 		return GetFileAttributesW(path.wstring().c_str()) != INVALID_FILE_ATTRIBUTES;
 	}
+	bool create_directory(const path &path)
+	{
+		return CreateDirectoryW(path.wstring().c_str(), nullptr) != FALSE || GetLastError() == ERROR_ALREADY_EXISTS;
+	}
+	bool remove(const path &path)
+	{
+		return DeleteFileW(path.wstring().c_str()) != FALSE;
+	}
+	uint64_t file_size(const path &path)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+		if (!GetFileAttributesExW(path.wstring().c_str(), GetFileExInfoStandard, &attributes))
+		{
+			return 0;
+		}
+
+		return (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	}
+	uint64_t last_write_time(const path &path)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+		if (!GetFileAttributesExW(path.wstring().c_str(), GetFileExInfoStandard, &attributes))
+		{
+			return 0;
+		}
+
+		return (static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+	}
+	bool update_last_write_time(const path &path)
+	{
+		const HANDLE handle = CreateFileW(path.wstring().c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if (handle == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		FILETIME now;
+		GetSystemTimeAsFileTime(&now);
+
+		const bool success = SetFileTime(handle, nullptr, nullptr, &now) != FALSE;
+
+		CloseHandle(handle);
+
+		return success;
+	}
 	path resolve(const path &filename, const std::vector<path> &paths)
 	{
 		for (const auto &path : paths)
@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include <ostream>
+#include <stdint.h>
 
 namespace reshade::filesystem
 {
@@ -33,6 +34,12 @@ namespace reshade::filesystem
 		std::string &string() { return _data; }
 		const std::string &string() const { return _data; }
 		std::wstring wstring() const;
+		// The path in the form file streams accept on this platform
+#ifdef _WIN32
+		std::wstring native() const { return wstring(); }
+#else
+		const std::string &native() const { return _data; }
+#endif
 
 		friend std::ostream &operator<<(std::ostream &stream, const path &path);
 
@@ -56,6 +63,11 @@ namespace reshade::filesystem
 	};
 
 	bool exists(const path &path);
+	bool create_directory(const path &path);
+	bool remove(const path &path);
+	uint64_t file_size(const path &path);
+	uint64_t last_write_time(const path &path);
+	bool update_last_write_time(const path &path);
 	path resolve(const path &filename, const std::vector<path> &paths);
 	path absolute(const path &filename, const path &parent_path);
 
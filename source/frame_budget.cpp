@@ -0,0 +1,86 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "frame_budget.hpp"
+
+namespace reshade
+{
+	bool frame_budget::update(uint64_t budget, const std::vector<item *> &items)
+	{
+		if (++_frames_since_change < _settle_frames)
+		{
+			return false;
+		}
+
+		uint64_t total_cost = 0;
+
+		for (const item *item : items)
+		{
+			if (!item->skipped)
+			{
+				total_cost += item->cost;
+			}
+		}
+
+		bool changed = false;
+
+		if (total_cost > budget)
+		{
+			for (size_t i = items.size(); i-- > 1;)
+			{
+				if (!items[i]->skipped)
+				{
+					// Updating an item less often keeps its effect on screen, so that is tried before giving up on it
+					if (items[i]->interval * 2 <= items[i]->max_interval)
+					{
+						items[i]->interval *= 2;
+					}
+					else
+					{
+						items[i]->skipped = true;
+					}
+
+					changed = true;
+					break;
+				}
+			}
+		}
+		else
+		{
+			// Restore items in order of importance only, so that a cheap unimportant item cannot take the place of an expensive important one
+			for (item *item : items)
+			{
+				if (item->skipped)
+				{
+					if (total_cost + item->cost <= budget - budget / 10)
+					{
+						item->skipped = false;
+						changed = true;
+					}
+
+					break;
+				}
+
+				if (item->interval > 1)
+				{
+					if (total_cost + item->cost <= budget - budget / 10)
+					{
+						item->interval /= 2;
+						changed = true;
+					}
+
+					break;
+				}
+			}
+		}
+
+		if (changed)
+		{
+			_frames_since_change = 0;
+		}
+
+		return changed;
+	}
+}
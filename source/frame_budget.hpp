@@ -0,0 +1,59 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace reshade
+{
+	/// <summary>
+	/// Keeps the measured cost of a list of techniques within a budget, by updating the least important ones less often and then skipping them while it is exceeded, and restoring them once there is room again.
+	/// </summary>
+	class frame_budget
+	{
+	public:
+		struct item
+		{
+			/// <summary>
+			/// The cost of the item in nanoseconds, averaged over the frames in between its updates. For skipped items this is the cost they had when they were last run.
+			/// </summary>
+			uint64_t cost;
+			/// <summary>
+			/// Whether the item is currently skipped.
+			/// </summary>
+			bool skipped;
+			/// <summary>
+			/// The number of frames between updates of the item, which is doubled before the item is skipped. It is updated along with the "skipped" field.
+			/// </summary>
+			unsigned int interval = 1;
+			/// <summary>
+			/// The highest number of frames the item may go without an update. Items that have to be updated every frame have a maximum of one.
+			/// </summary>
+			unsigned int max_interval = 1;
+		};
+
+		/// <summary>
+		/// Create a new budget controller.
+		/// </summary>
+		/// <param name="settle_frames">The number of updates to wait after skipping or restoring an item before making the next change, so that the measured costs can catch up with it.</param>
+		explicit frame_budget(unsigned int settle_frames = 30) : _settle_frames(settle_frames) { }
+
+		/// <summary>
+		/// Degrade or restore at most one item by one step, depending on whether the cost of the items that are not skipped exceeds the budget.
+		/// The least important item that is still running is degraded first. Its update interval is doubled as long as it stays within its maximum, and only then is it skipped. The most important item is never degraded.
+		/// The most important degraded item is restored first, one step at a time, and only if it fits into the budget with some headroom, so that items are not degraded and restored over and over again. Halving the interval of an item is assumed to double its cost.
+		/// </summary>
+		/// <param name="budget">The maximum total cost in nanoseconds.</param>
+		/// <param name="items">The items to keep within the budget, ordered from most to least important. Their "skipped" and "interval" fields are updated.</param>
+		/// <returns><c>true</c> if an item was degraded or restored, <c>false</c> otherwise.</returns>
+		bool update(uint64_t budget, const std::vector<item *> &items);
+
+	private:
+		unsigned int _settle_frames, _frames_since_change = 0;
+	};
+}
@@ -0,0 +1,30 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace reshade
+{
+	/// <summary>
+	/// The value to start a new 64-bit FNV-1a hash with.
+	/// </summary>
+	const uint64_t fnv1a_offset_basis = 14695981039346656037ull;
+
+	/// <summary>
+	/// Continue a 64-bit FNV-1a hash with the specified data. Pass <see cref="fnv1a_offset_basis"/> to start a new one.
+	/// </summary>
+	/// <param name="hash">The hash computed so far.</param>
+	/// <param name="data">The data to add to the hash.</param>
+	/// <param name="size">The size of the data in bytes.</param>
+	inline uint64_t hash_fnv1a(uint64_t hash, const void *data, size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+			hash = (hash ^ static_cast<const uint8_t *>(data)[i]) * 1099511628211ull;
+		return hash;
+	}
+}
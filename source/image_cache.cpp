@@ -0,0 +1,191 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "log.hpp"
+#include "hash.hpp"
+#include "image_cache.hpp"
+#include <stdio.h>
+#include <Windows.h>
+
+namespace reshade
+{
+	static const uint32_t cache_magic = 0x43495352; // "RSIC"
+	static const uint32_t cache_version = 1;
+
+	image_cache::mapping::mapping(mapping &&other)
+	{
+		operator=(std::move(other));
+	}
+	image_cache::mapping::~mapping()
+	{
+		if (_view != nullptr)
+		{
+			UnmapViewOfFile(_view);
+		}
+		if (_mapping_handle != nullptr)
+		{
+			CloseHandle(_mapping_handle);
+		}
+		if (_file_handle != nullptr)
+		{
+			CloseHandle(_file_handle);
+		}
+	}
+
+	image_cache::mapping &image_cache::mapping::operator=(mapping &&other)
+	{
+		std::swap(_file_handle, other._file_handle);
+		std::swap(_mapping_handle, other._mapping_handle);
+		std::swap(_view, other._view);
+		std::swap(_data, other._data);
+
+		return *this;
+	}
+
+	bool image_cache::open(const filesystem::path &directory)
+	{
+		_directory = filesystem::path();
+
+		if (!filesystem::create_directory(directory))
+		{
+			LOG(WARNING) << "Failed to create image cache directory " << directory << ".";
+			return false;
+		}
+
+		_directory = directory;
+
+		return true;
+	}
+
+	bool image_cache::compute_key(const filesystem::path &path, unsigned int width, unsigned int height, uint64_t &entry, uint64_t &key)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+		if (!GetFileAttributesExW(path.wstring().c_str(), GetFileExInfoStandard, &attributes))
+		{
+			return false;
+		}
+
+		// Paths are case-insensitive on Windows, so normalize them before hashing
+		std::wstring path_string = path.wstring();
+		CharLowerBuffW(&path_string[0], static_cast<DWORD>(path_string.size()));
+
+		// The pixel data is always stored as RGBA8, so the texture format does not affect the entry
+		entry = hash_fnv1a(fnv1a_offset_basis, path_string.data(), path_string.size() * sizeof(wchar_t));
+		entry = hash_fnv1a(entry, &width, sizeof(width));
+		entry = hash_fnv1a(entry, &height, sizeof(height));
+
+		key = hash_fnv1a(entry, &attributes.ftLastWriteTime, sizeof(attributes.ftLastWriteTime));
+		key = hash_fnv1a(key, &attributes.nFileSizeLow, sizeof(attributes.nFileSizeLow));
+		key = hash_fnv1a(key, &attributes.nFileSizeHigh, sizeof(attributes.nFileSizeHigh));
+
+		return true;
+	}
+
+	bool image_cache::load(uint64_t entry, uint64_t key, size_t size, mapping &result) const
+	{
+		if (!is_open())
+		{
+			return false;
+		}
+
+		mapping mapped;
+
+		mapped._file_handle = CreateFileW(entry_path(entry).wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if (mapped._file_handle == INVALID_HANDLE_VALUE)
+		{
+			mapped._file_handle = nullptr;
+			return false;
+		}
+
+		LARGE_INTEGER file_size;
+
+		if (!GetFileSizeEx(mapped._file_handle, &file_size) || static_cast<uint64_t>(file_size.QuadPart) != sizeof(file_header) + size)
+		{
+			return false;
+		}
+
+		mapped._mapping_handle = CreateFileMappingW(mapped._file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+		if (mapped._mapping_handle == nullptr)
+		{
+			return false;
+		}
+
+		mapped._view = MapViewOfFile(mapped._mapping_handle, FILE_MAP_READ, 0, 0, 0);
+
+		if (mapped._view == nullptr)
+		{
+			return false;
+		}
+
+		const auto &header = *static_cast<const file_header *>(mapped._view);
+
+		if (header.magic != cache_magic ||
+			header.version != cache_version ||
+			header.key != key ||
+			header.data_size != size)
+		{
+			return false;
+		}
+
+		// The pixel data directly follows the header, so it can be passed to 'update_texture' without copying it out of the mapping first
+		mapped._data = static_cast<const uint8_t *>(mapped._view) + sizeof(file_header);
+
+		result = std::move(mapped);
+
+		return true;
+	}
+	bool image_cache::save(uint64_t entry, uint64_t key, const std::vector<uint8_t> &pixels) const
+	{
+		if (!is_open() || pixels.empty())
+		{
+			return false;
+		}
+
+		// Write to a temporary file first and move it into place afterwards, so that other threads never see a partially written entry
+		const filesystem::path path = entry_path(entry);
+		filesystem::path temp_path = path;
+		temp_path.replace_extension(".tmp" + std::to_string(GetCurrentThreadId()));
+
+		FILE *file;
+
+		if (_wfopen_s(&file, temp_path.wstring().c_str(), L"wb") != 0)
+		{
+			return false;
+		}
+
+		file_header header = { };
+		header.magic = cache_magic;
+		header.version = cache_version;
+		header.key = key;
+		header.data_size = pixels.size();
+
+		bool success =
+			fwrite(&header, sizeof(header), 1, file) == 1 &&
+			fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+
+		fclose(file);
+
+		// Replace the previous version of the image. This fails while the existing entry is still mapped somewhere, in which case it is kept and replaced on a later reload.
+		success = success && MoveFileExW(temp_path.wstring().c_str(), path.wstring().c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+
+		if (!success)
+		{
+			_wremove(temp_path.wstring().c_str());
+		}
+
+		return success;
+	}
+
+	filesystem::path image_cache::entry_path(uint64_t entry) const
+	{
+		char filename[21];
+		sprintf_s(filename, "%016llx.bin", static_cast<unsigned long long>(entry));
+
+		return _directory / filename;
+	}
+}
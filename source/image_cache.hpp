@@ -0,0 +1,100 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <vector>
+#include "filesystem.hpp"
+
+namespace reshade
+{
+	/// <summary>
+	/// On-disk cache of decoded and resized image data, so that unchanged image files do not have to be decoded again on every reload.
+	/// </summary>
+	class image_cache
+	{
+	public:
+		/// <summary>
+		/// A read-only memory mapping of the pixel data of a cache entry.
+		/// </summary>
+		class mapping
+		{
+		public:
+			mapping() { }
+			mapping(mapping &&other);
+			mapping(const mapping &) = delete;
+			~mapping();
+
+			mapping &operator=(mapping &&other);
+			mapping &operator=(const mapping &) = delete;
+
+			/// <summary>
+			/// Returns a pointer to the pixel data, or <c>nullptr</c> if nothing is mapped.
+			/// </summary>
+			const uint8_t *data() const { return _data; }
+
+		private:
+			friend class image_cache;
+
+			void *_file_handle = nullptr, *_mapping_handle = nullptr;
+			const void *_view = nullptr;
+			const uint8_t *_data = nullptr;
+		};
+
+		/// <summary>
+		/// Open the cache in the specified directory.
+		/// </summary>
+		/// <param name="directory">The directory to store cached images in.</param>
+		bool open(const filesystem::path &directory);
+
+		/// <summary>
+		/// Returns whether the cache was opened successfully.
+		/// </summary>
+		bool is_open() const { return !_directory.empty(); }
+
+		/// <summary>
+		/// Compute the cache key for an image file.
+		/// The entry is named after the path and dimensions only, so that a changed file replaces its previous entry instead of leaving it behind.
+		/// The key also includes the modification time and size of the file, so that changes to the file invalidate the entry.
+		/// </summary>
+		/// <param name="path">The path to the source image file.</param>
+		/// <param name="width">The width the image is resized to.</param>
+		/// <param name="height">The height the image is resized to.</param>
+		/// <param name="entry">The resulting name of the entry.</param>
+		/// <param name="key">The resulting key the entry has to match.</param>
+		/// <returns><c>true</c> if the file exists and a key was computed, <c>false</c> otherwise.</returns>
+		static bool compute_key(const filesystem::path &path, unsigned int width, unsigned int height, uint64_t &entry, uint64_t &key);
+
+		/// <summary>
+		/// Look up image data in the cache and map it into memory.
+		/// </summary>
+		/// <param name="entry">The name of the entry.</param>
+		/// <param name="key">The key of the image.</param>
+		/// <param name="size">The expected size of the pixel data in bytes.</param>
+		/// <param name="result">The mapping of the pixel data.</param>
+		bool load(uint64_t entry, uint64_t key, size_t size, mapping &result) const;
+		/// <summary>
+		/// Store image data in the cache, replacing any previous version of the same image.
+		/// </summary>
+		/// <param name="entry">The name of the entry.</param>
+		/// <param name="key">The key of the image.</param>
+		/// <param name="pixels">The pixel data to store.</param>
+		bool save(uint64_t entry, uint64_t key, const std::vector<uint8_t> &pixels) const;
+
+	private:
+		struct file_header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t key;
+			uint64_t data_size;
+			uint64_t reserved;
+		};
+
+		filesystem::path entry_path(uint64_t entry) const;
+
+		filesystem::path _directory;
+	};
+}
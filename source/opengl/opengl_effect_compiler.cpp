@@ -5,6 +5,7 @@
 
 #include "opengl_runtime.hpp"
 #include "opengl_effect_compiler.hpp"
+#include "dds_file.hpp"
 #include <assert.h>
 #include <iomanip>
 #include <fstream>
@@ -362,12 +363,6 @@ namespace reshade::opengl
 
 		return code;
 	}
-	static inline uintptr_t align(uintptr_t address, size_t alignment)
-	{
-		if (address % alignment != 0)
-			address += alignment - address % alignment;
-		return address;
-	}
 
 	opengl_effect_compiler::opengl_effect_compiler(opengl_runtime *runtime, const syntax_tree &ast, std::string &errors) :
 		_runtime(runtime),
@@ -395,6 +390,8 @@ namespace reshade::opengl
 			visit(_global_code, node);
 		}
 
+		std::vector<const variable_declaration_node *> uniforms;
+
 		for (auto uniform : _ast.variables)
 		{
 			if (uniform->type.is_texture())
@@ -407,7 +404,7 @@ namespace reshade::opengl
 			}
 			else if (uniform->type.has_qualifier(type_node::qualifier_uniform))
 			{
-				visit_uniform(uniform);
+				uniforms.push_back(uniform);
 			}
 			else
 			{
@@ -417,6 +414,8 @@ namespace reshade::opengl
 			}
 		}
 
+		visit_uniforms(uniforms);
+
 		for (auto function : _ast.functions)
 		{
 			std::stringstream function_code;
@@ -433,20 +432,31 @@ namespace reshade::opengl
 			visit_technique(technique);
 		}
 
-		if (_uniform_buffer_size != 0)
+		if (_uniform_buffer_size != 0 || _frame_uniform_buffer_size != 0)
 		{
-			GLuint ubo = 0;
-			glGenBuffers(1, &ubo);
+			opengl_uniform_buffers ubos;
+			ubos.user_buffer_size = _uniform_buffer_size;
+			ubos.frame_buffer_size = _frame_uniform_buffer_size;
 
 			GLint previous = 0;
 			glGetIntegerv(GL_UNIFORM_BUFFER_BINDING, &previous);
 
-			glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-			glBufferData(GL_UNIFORM_BUFFER, _uniform_buffer_size, _runtime->get_uniform_value_storage().data() + _uniform_storage_offset, GL_DYNAMIC_DRAW);
+			if (_uniform_buffer_size != 0)
+			{
+				glGenBuffers(1, &ubos.user_buffer);
+				glBindBuffer(GL_UNIFORM_BUFFER, ubos.user_buffer);
+				glBufferData(GL_UNIFORM_BUFFER, _uniform_buffer_size, _runtime->get_uniform_value_storage().data() + _uniform_storage_offset, GL_STATIC_DRAW);
+			}
+			if (_frame_uniform_buffer_size != 0)
+			{
+				glGenBuffers(1, &ubos.frame_buffer);
+				glBindBuffer(GL_UNIFORM_BUFFER, ubos.frame_buffer);
+				glBufferData(GL_UNIFORM_BUFFER, _frame_uniform_buffer_size, _runtime->get_uniform_value_storage().data() + _uniform_storage_offset + _uniform_buffer_size, GL_STREAM_DRAW);
+			}
 
 			glBindBuffer(GL_UNIFORM_BUFFER, previous);
 
-			_runtime->_effect_ubos.emplace_back(ubo, _uniform_buffer_size);
+			_runtime->_effect_ubos.push_back(ubos);
 		}
 
 		return _success;
@@ -2116,14 +2126,18 @@ namespace reshade::opengl
 			glTextureView(obj_data->id[1], GL_TEXTURE_2D, obj_data->id[0], internalformat_srgb, 0, levels, 0, 1);
 			glBindTexture(GL_TEXTURE_2D, previous);
 
-			// Clear texture to black
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _runtime->_blit_fbo);
-			glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, obj_data->id[0], 0);
-			glDrawBuffer(GL_COLOR_ATTACHMENT1);
-			const GLuint clearColor[4] = { 0, 0, 0, 0 };
-			glClearBufferuiv(GL_COLOR, 0, clearColor);
-			glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, 0, 0);
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous_fbo);
+			// Block-compressed textures cannot be attached to a framebuffer, so their contents only ever come from uploads
+			if (!dds::is_block_compressed(obj.format))
+			{
+				// Clear texture to black
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _runtime->_blit_fbo);
+				glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, obj_data->id[0], 0);
+				glDrawBuffer(GL_COLOR_ATTACHMENT1);
+				const GLuint clearColor[4] = { 0, 0, 0, 0 };
+				glClearBufferuiv(GL_COLOR, 0, clearColor);
+				glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, 0, 0);
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous_fbo);
+			}
 		}
 
 		_runtime->add_texture(std::move(obj));
@@ -2142,7 +2156,6 @@ namespace reshade::opengl
 		sampler.id = 0;
 		sampler.texture = texture->impl->as<opengl_tex_data>();
 		sampler.is_srgb = node->properties.srgb_texture;
-		sampler.has_mipmaps = texture->levels > 1;
 
 		GLenum minfilter = GL_NONE, magfilter = GL_NONE;
 		literal_to_filter_mode(node->properties.filter, minfilter, magfilter);
@@ -2161,25 +2174,78 @@ namespace reshade::opengl
 
 		_runtime->_effect_samplers.push_back(std::move(sampler));
 	}
-	void opengl_effect_compiler::visit_uniform(const variable_declaration_node *node)
+	void opengl_effect_compiler::visit_uniforms(const std::vector<const variable_declaration_node *> &nodes)
+	{
+		std::vector<const variable_declaration_node *> user_uniforms, frame_uniforms;
+
+		// Uniforms with a source annotation are updated by the runtime every frame, so keep them in a separate uniform block
+		// This way the user-modifiable uniforms only have to be uploaded when their value actually changes
+		for (auto node : nodes)
+		{
+			if (node->annotation_list.count("source"))
+			{
+				frame_uniforms.push_back(node);
+			}
+			else
+			{
+				user_uniforms.push_back(node);
+			}
+		}
+
+		_uniform_buffer_size = visit_uniform_buffer(_global_uniforms, user_uniforms, _uniform_storage_offset);
+		_frame_uniform_buffer_size = visit_uniform_buffer(_global_frame_uniforms, frame_uniforms, _uniform_storage_offset + _uniform_buffer_size);
+	}
+	GLsizeiptr opengl_effect_compiler::visit_uniform_buffer(std::stringstream &output, const std::vector<const variable_declaration_node *> &nodes, GLintptr storage_offset)
+	{
+		std::vector<uniform_layout_entry> layout(nodes.size());
+
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			layout[i].rows = nodes[i]->type.rows;
+			layout[i].columns = nodes[i]->type.cols;
+			layout[i].elements = std::max(0, nodes[i]->type.array_length);
+		}
+
+		// Reorder uniforms to minimize padding in the uniform block
+		// Explicit offsets require GLSL 4.40, so instead declare the members in order of their offset, which reproduces the same layout with std140 packing
+		const GLsizeiptr size = static_cast<GLsizeiptr>(compute_uniform_layout(uniform_layout_rules::glsl_std140, layout));
+
+		_runtime->get_uniform_value_storage().resize(static_cast<size_t>(storage_offset + size));
+
+		// Add uniforms in declaration order, but emit their declarations in order of their offset
+		std::vector<std::stringstream> declarations(nodes.size());
+
+		for (size_t i = 0; i < nodes.size(); i++)
+		{
+			visit_uniform(declarations[i], nodes[i], layout[i], storage_offset);
+		}
+
+		for (const size_t index : sort_uniform_layout(layout))
+		{
+			output << declarations[index].str();
+		}
+
+		return size;
+	}
+	void opengl_effect_compiler::visit_uniform(std::stringstream &output, const variable_declaration_node *node, const uniform_layout_entry &layout, GLintptr storage_offset)
 	{
-		visit(_global_uniforms, node->type, true, false);
+		visit(output, node->type, true, false);
 
-		_global_uniforms << ' ' << escape_name(node->unique_name);
+		output << ' ' << escape_name(node->unique_name);
 
 		if (node->type.is_array())
 		{
-			_global_uniforms << '[';
+			output << '[';
 
 			if (node->type.array_length > 0)
 			{
-				_global_uniforms << node->type.array_length;
+				output << node->type.array_length;
 			}
 
-			_global_uniforms << ']';
+			output << ']';
 		}
 
-		_global_uniforms << ";\n";
+		output << ";\n";
 
 		uniform obj;
 		obj.name = node->name;
@@ -2189,28 +2255,11 @@ namespace reshade::opengl
 		obj.columns = node->type.cols;
 		obj.elements = node->type.array_length;
 		obj.storage_size = obj.rows * obj.columns * std::max(1u, obj.elements) * 4;
+		obj.storage_offset = storage_offset + layout.offset;
 		obj.annotations = node->annotation_list;
 
-		// GLSL specification on std140 layout:
-		// 1. If the member is a scalar consuming N basic machine units, the base alignment is N.
-		// 2. If the member is a two- or four-component vector with components consuming N basic machine units, the base alignment is 2N or 4N, respectively.
-		// 3. If the member is a three-component vector with components consuming N basic machine units, the base alignment is 4N.
-		size_t alignment = obj.storage_size;
-		if (obj.rows == 3)
-		{
-			alignment = alignment * 4 / 3;
-		}
-		_uniform_buffer_size = align(_uniform_buffer_size, alignment);
-		obj.storage_offset = _uniform_storage_offset + _uniform_buffer_size;
-		_uniform_buffer_size += obj.storage_size;
-
 		auto &uniform_storage = _runtime->get_uniform_value_storage();
 
-		if (_uniform_storage_offset + _uniform_buffer_size >= static_cast<ptrdiff_t>(uniform_storage.size()))
-		{
-			uniform_storage.resize(uniform_storage.size() + 128);
-		}
-
 		if (node->initializer_expression != nullptr && node->initializer_expression->id == nodeid::literal_expression)
 		{
 			std::memcpy(uniform_storage.data() + obj.storage_offset, &static_cast<const literal_expression_node *>(node->initializer_expression)->value_float, obj.storage_size);
@@ -2230,9 +2279,11 @@ namespace reshade::opengl
 		obj.annotations = node->annotation_list;
 
 		const auto obj_data = obj.impl->as<opengl_technique_data>();
-		glGenQueries(1, &obj_data->query);
+		obj_data->queries.resize(obj_data->query_slots.size());
+		obj_data->pass_queries_issued.resize(obj_data->query_slots.size());
+		glGenQueries(static_cast<GLsizei>(obj_data->queries.size()), obj_data->queries.data());
 
-		if (_uniform_buffer_size != 0)
+		if (_uniform_buffer_size != 0 || _frame_uniform_buffer_size != 0)
 		{
 			obj.uniform_storage_index = _runtime->_effect_ubos.size();
 			obj.uniform_storage_offset = _uniform_storage_offset;
@@ -2334,27 +2385,68 @@ namespace reshade::opengl
 		GLuint shaders[2] = { 0, 0 };
 		GLenum shader_types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
 		const function_declaration_node *shader_functions[2] = { node->vertex_shader, node->pixel_shader };
+		std::vector<std::string> shader_sources(2);
+
+		for (unsigned int i = 0; i < 2; i++)
+		{
+			if (shader_functions[i] != nullptr)
+			{
+				visit_pass_shader(shader_functions[i], shader_types[i], shader_sources[i]);
+			}
+		}
 
 		pass.program = glCreateProgram();
 
+		// Try to skip compilation and linking by loading a previously cached program binary
+		auto &program_cache = _runtime->_program_cache;
+		const uint64_t program_key = program_cache.compute_key(shader_sources);
+
+		uint32_t binary_format = 0;
+		std::vector<uint8_t> binary;
+
+		if (program_cache.load(program_key, binary_format, binary))
+		{
+			GLint status = GL_FALSE;
+
+			glProgramBinary(pass.program, binary_format, binary.data(), static_cast<GLsizei>(binary.size()));
+			glGetProgramiv(pass.program, GL_LINK_STATUS, &status);
+
+			if (status != GL_FALSE)
+			{
+				return;
+			}
+
+			// The driver rejected the binary, so fall back to a full compile and replace the cache entry
+			program_cache.remove(program_key);
+		}
+
 		for (unsigned int i = 0; i < 2; i++)
 		{
 			if (shader_functions[i] != nullptr)
 			{
-				shaders[i] = glCreateShader(shader_types[i]);
+				compile_pass_shader(shader_functions[i], shader_types[i], shader_sources[i], shaders[i]);
 
-				visit_pass_shader(shader_functions[i], shader_types[i], shaders[i]);
-
-				glAttachShader(pass.program, shaders[i]);
+				if (shaders[i] != 0)
+				{
+					glAttachShader(pass.program, shaders[i]);
+				}
 			}
 		}
 
+		if (program_cache.is_open())
+		{
+			glProgramParameteri(pass.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+
 		glLinkProgram(pass.program);
 
+		// Shader objects are owned by the runtime and shared between passes, so only detach them here
 		for (unsigned int i = 0; i < 2; i++)
 		{
-			glDetachShader(pass.program, shaders[i]);
-			glDeleteShader(shaders[i]);
+			if (shaders[i] != 0)
+			{
+				glDetachShader(pass.program, shaders[i]);
+			}
 		}
 
 		GLint status = GL_FALSE;
@@ -2376,8 +2468,23 @@ namespace reshade::opengl
 			error(node->location, "program linking failed");
 			return;
 		}
+
+		if (program_cache.is_open() && _success)
+		{
+			GLint binary_size = 0;
+			glGetProgramiv(pass.program, GL_PROGRAM_BINARY_LENGTH, &binary_size);
+
+			if (binary_size > 0)
+			{
+				GLenum format = GL_NONE;
+				binary.resize(binary_size);
+				glGetProgramBinary(pass.program, binary_size, nullptr, &format, binary.data());
+
+				program_cache.save(program_key, format, binary);
+			}
+		}
 	}
-	void opengl_effect_compiler::visit_pass_shader(const function_declaration_node *node, unsigned int shadertype, unsigned int &shader)
+	void opengl_effect_compiler::visit_pass_shader(const function_declaration_node *node, unsigned int shadertype, std::string &source_str)
 	{
 		std::stringstream source;
 
@@ -2402,6 +2509,10 @@ namespace reshade::opengl
 		{
 			source << "layout(std140, binding = 0) uniform _GLOBAL_\n{\n" << _global_uniforms.str() << "};\n";
 		}
+		if (_frame_uniform_buffer_size != 0)
+		{
+			source << "layout(std140, binding = 1) uniform _GLOBAL_FRAME_\n{\n" << _global_frame_uniforms.str() << "};\n";
+		}
 
 		if (shadertype != GL_FRAGMENT_SHADER)
 		{
@@ -2642,10 +2753,7 @@ namespace reshade::opengl
 
 		source << "}\n";
 
-		GLint status = GL_FALSE;
-		const std::string source_str = source.str();
-		const GLchar *src = source_str.c_str();
-		const GLsizei len = static_cast<GLsizei>(source_str.size());
+		source_str = source.str();
 
 #if RESHADE_DUMP_NATIVE_SHADERS
 		if (!_dumped_shaders.count(node->unique_name))
@@ -2660,6 +2768,23 @@ namespace reshade::opengl
 			}
 		}
 #endif
+	}
+	void opengl_effect_compiler::compile_pass_shader(const function_declaration_node *node, unsigned int shadertype, const std::string &source, unsigned int &shader)
+	{
+		// Passes with identical code share the same shader object
+		const std::string shader_key = source + '\n' + std::to_string(shadertype);
+
+		if (const auto it = _runtime->_effect_shaders.find(shader_key); it != _runtime->_effect_shaders.end())
+		{
+			shader = it->second;
+			return;
+		}
+
+		GLint status = GL_FALSE;
+		const GLchar *src = source.c_str();
+		const GLsizei len = static_cast<GLsizei>(source.size());
+
+		shader = glCreateShader(shadertype);
 
 		glShaderSource(shader, 1, &src, &len);
 		glCompileShader(shader);
@@ -2673,9 +2798,15 @@ namespace reshade::opengl
 			std::string log(logsize, '\0');
 			glGetShaderInfoLog(shader, logsize, nullptr, &log.front());
 
+			glDeleteShader(shader);
+			shader = 0;
+
 			_errors += log;
 			error(node->location, "internal shader compilation failed");
+			return;
 		}
+
+		_runtime->_effect_shaders.emplace(shader_key, shader);
 	}
 	void opengl_effect_compiler::visit_shader_param(std::stringstream &output, type_node type, unsigned int qualifier, const std::string &name, const std::string &semantic, unsigned int shadertype)
 	{
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "effect_syntax_tree.hpp"
+#include "uniform_layout.hpp"
 #include <sstream>
 #include <unordered_set>
 
@@ -60,10 +61,13 @@ namespace reshade::opengl
 
 		void visit_texture(const reshadefx::nodes::variable_declaration_node *node);
 		void visit_sampler(const reshadefx::nodes::variable_declaration_node *node);
-		void visit_uniform(const reshadefx::nodes::variable_declaration_node *node);
+		void visit_uniforms(const std::vector<const reshadefx::nodes::variable_declaration_node *> &nodes);
+		GLsizeiptr visit_uniform_buffer(std::stringstream &output, const std::vector<const reshadefx::nodes::variable_declaration_node *> &nodes, GLintptr storage_offset);
+		void visit_uniform(std::stringstream &output, const reshadefx::nodes::variable_declaration_node *node, const uniform_layout_entry &layout, GLintptr storage_offset);
 		void visit_technique(const reshadefx::nodes::technique_declaration_node *node);
 		void visit_pass(const reshadefx::nodes::pass_declaration_node *node, opengl_pass_data &pass);
-		void visit_pass_shader(const reshadefx::nodes::function_declaration_node *node, unsigned int shadertype, unsigned int &shader);
+		void visit_pass_shader(const reshadefx::nodes::function_declaration_node *node, unsigned int shadertype, std::string &source);
+		void compile_pass_shader(const reshadefx::nodes::function_declaration_node *node, unsigned int shadertype, const std::string &source, unsigned int &shader);
 		void visit_shader_param(std::stringstream &output, reshadefx::nodes::type_node type, unsigned int qualifier, const std::string &name, const std::string &semantic, unsigned int shadertype);
 
 		struct function
@@ -76,10 +80,10 @@ namespace reshade::opengl
 		bool _success;
 		const reshadefx::syntax_tree &_ast;
 		std::string &_errors;
-		std::stringstream _global_code, _global_uniforms;
+		std::stringstream _global_code, _global_uniforms, _global_frame_uniforms;
 		const reshadefx::nodes::function_declaration_node *_current_function;
 		std::unordered_map<const reshadefx::nodes::function_declaration_node *, function> _functions;
-		GLintptr _uniform_storage_offset = 0, _uniform_buffer_size = 0;
+		GLintptr _uniform_storage_offset = 0, _uniform_buffer_size = 0, _frame_uniform_buffer_size = 0;
 #if RESHADE_DUMP_NATIVE_SHADERS
 		filesystem::path _dump_filename;
 		std::unordered_set<std::string> _dumped_shaders;
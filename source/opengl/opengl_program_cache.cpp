@@ -0,0 +1,228 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "hash.hpp"
+#include "opengl_program_cache.hpp"
+#include <stdio.h>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+namespace reshade::opengl
+{
+	static const uint32_t cache_magic = 0x42505352; // "RSPB"
+	static const uint32_t cache_version = 1;
+
+	bool program_cache::open(const filesystem::path &directory, const std::string &driver, uint64_t max_size)
+	{
+		_directory = filesystem::path();
+		_driver_hash = hash_fnv1a(fnv1a_offset_basis, driver.data(), driver.size());
+		_max_size = max_size;
+		_total_size = 0;
+		_driver_changed = false;
+
+		if (!filesystem::create_directory(directory))
+		{
+			return false;
+		}
+
+		// Discard all entries when the driver changed, since binaries are not portable between driver versions
+		const filesystem::path stamp_path = directory / "driver.txt";
+		std::string stamp;
+
+		if (std::ifstream file(stamp_path.native(), std::ios::binary); file)
+		{
+			stamp.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+
+		if (stamp != driver)
+		{
+			_driver_changed = !stamp.empty();
+
+			for (const auto &entry : filesystem::list_files(directory, "*.bin"))
+			{
+				filesystem::remove(entry);
+			}
+
+			std::ofstream file(stamp_path.native(), std::ios::binary | std::ios::trunc);
+
+			if (!file.write(driver.data(), driver.size()))
+			{
+				return false;
+			}
+		}
+
+		for (const auto &entry : filesystem::list_files(directory, "*.bin"))
+		{
+			_total_size += filesystem::file_size(entry);
+		}
+
+		_directory = directory;
+
+		// The limit may have been lowered since the cache was last used
+		evict();
+
+		return true;
+	}
+
+	uint64_t program_cache::compute_key(const std::vector<std::string> &sources) const
+	{
+		uint64_t hash = hash_fnv1a(fnv1a_offset_basis, &_driver_hash, sizeof(_driver_hash));
+
+		for (const auto &source : sources)
+		{
+			const uint64_t size = source.size();
+			hash = hash_fnv1a(hash, &size, sizeof(size));
+			hash = hash_fnv1a(hash, source.data(), source.size());
+		}
+
+		return hash;
+	}
+
+	bool program_cache::load(uint64_t key, uint32_t &format, std::vector<uint8_t> &binary)
+	{
+		if (!is_open())
+		{
+			return false;
+		}
+
+		const filesystem::path path = entry_path(key);
+		bool success = false;
+
+		if (std::ifstream file(path.native(), std::ios::binary); file)
+		{
+			file_header header = { };
+			success = file.read(reinterpret_cast<char *>(&header), sizeof(header)) &&
+				header.magic == cache_magic &&
+				header.version == cache_version &&
+				header.key == key &&
+				header.driver_hash == _driver_hash &&
+				header.binary_size != 0;
+
+			if (success)
+			{
+				binary.resize(header.binary_size);
+				success = file.read(reinterpret_cast<char *>(binary.data()), binary.size()) && file.peek() == std::ifstream::traits_type::eof();
+				format = header.binary_format;
+			}
+		}
+		else
+		{
+			return false;
+		}
+
+		if (success)
+		{
+			// The modification time is what decides which entries are removed first when the cache grows too large
+			filesystem::update_last_write_time(path);
+		}
+		else
+		{
+			remove(key);
+		}
+
+		return success;
+	}
+	bool program_cache::save(uint64_t key, uint32_t format, const std::vector<uint8_t> &binary)
+	{
+		if (!is_open() || binary.empty())
+		{
+			return false;
+		}
+
+		// Replace an existing entry
+		remove(key);
+
+		file_header header = { };
+		header.magic = cache_magic;
+		header.version = cache_version;
+		header.key = key;
+		header.driver_hash = _driver_hash;
+		header.binary_format = format;
+		header.binary_size = static_cast<uint32_t>(binary.size());
+
+		bool success = false;
+
+		if (std::ofstream file(entry_path(key).native(), std::ios::binary | std::ios::trunc); file)
+		{
+			success =
+				file.write(reinterpret_cast<const char *>(&header), sizeof(header)) &&
+				file.write(reinterpret_cast<const char *>(binary.data()), binary.size());
+		}
+
+		if (!success)
+		{
+			filesystem::remove(entry_path(key));
+			return false;
+		}
+
+		_total_size += sizeof(header) + binary.size();
+
+		evict();
+
+		return true;
+	}
+	void program_cache::remove(uint64_t key)
+	{
+		if (!is_open())
+		{
+			return;
+		}
+
+		const filesystem::path path = entry_path(key);
+		const uint64_t size = filesystem::file_size(path);
+
+		if (filesystem::remove(path))
+		{
+			_total_size -= std::min(size, _total_size);
+		}
+	}
+
+	filesystem::path program_cache::entry_path(uint64_t key) const
+	{
+		char filename[21];
+		snprintf(filename, sizeof(filename), "%016llx.bin", static_cast<unsigned long long>(key));
+
+		return _directory / filename;
+	}
+
+	void program_cache::evict()
+	{
+		if (_total_size <= _max_size)
+		{
+			return;
+		}
+
+		struct entry_info
+		{
+			filesystem::path path;
+			uint64_t last_used;
+			uint64_t size;
+		};
+
+		std::vector<entry_info> entries;
+
+		for (const auto &entry : filesystem::list_files(_directory, "*.bin"))
+		{
+			entries.push_back({ entry, filesystem::last_write_time(entry), filesystem::file_size(entry) });
+		}
+
+		std::sort(entries.begin(), entries.end(), [](const entry_info &lhs, const entry_info &rhs) { return lhs.last_used < rhs.last_used; });
+
+		// Remove the least recently used entries first, until everything fits again
+		for (const auto &entry : entries)
+		{
+			if (_total_size <= _max_size)
+			{
+				break;
+			}
+
+			if (filesystem::remove(entry.path))
+			{
+				_total_size -= std::min(entry.size, _total_size);
+			}
+		}
+	}
+}
@@ -0,0 +1,95 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include "filesystem.hpp"
+#include <stdint.h>
+
+namespace reshade::opengl
+{
+	/// <summary>
+	/// On-disk cache of linked program binaries (GL_ARB_get_program_binary), keyed by generated source and driver.
+	/// This only deals with files and does not call into OpenGL, the binaries are retrieved and loaded by the caller.
+	/// </summary>
+	class program_cache
+	{
+	public:
+		/// <summary>
+		/// Open the cache in the specified directory. All existing entries are discarded if they were created by a different driver.
+		/// </summary>
+		/// <param name="directory">The directory to store cached program binaries in.</param>
+		/// <param name="driver">A string identifying the driver (vendor, renderer and version).</param>
+		/// <param name="max_size">The maximum number of bytes all entries may occupy. The least recently used entries are removed when this is exceeded.</param>
+		bool open(const filesystem::path &directory, const std::string &driver, uint64_t max_size = 128 * 1024 * 1024);
+		/// <summary>
+		/// Close the cache so that all further lookups fail.
+		/// </summary>
+		void close() { _directory = filesystem::path(); }
+
+		/// <summary>
+		/// Returns whether the cache was opened successfully.
+		/// </summary>
+		bool is_open() const { return !_directory.empty(); }
+		/// <summary>
+		/// Returns whether opening the cache discarded entries of a different driver.
+		/// </summary>
+		bool driver_changed() const { return _driver_changed; }
+		/// <summary>
+		/// Returns the number of bytes all entries currently occupy.
+		/// </summary>
+		uint64_t total_size() const { return _total_size; }
+
+		/// <summary>
+		/// Compute the cache key for a program made up of the specified shader sources.
+		/// </summary>
+		/// <param name="sources">The source code of each shader stage linked into the program.</param>
+		uint64_t compute_key(const std::vector<std::string> &sources) const;
+
+		/// <summary>
+		/// Look up a program binary in the cache and mark it as recently used.
+		/// </summary>
+		/// <param name="key">The key of the program.</param>
+		/// <param name="format">The binary format as reported by the driver when the binary was stored.</param>
+		/// <param name="binary">The buffer to store the binary data in.</param>
+		bool load(uint64_t key, uint32_t &format, std::vector<uint8_t> &binary);
+		/// <summary>
+		/// Store a program binary in the cache, removing the least recently used entries if it grows too large.
+		/// </summary>
+		/// <param name="key">The key of the program.</param>
+		/// <param name="format">The binary format returned by 'glGetProgramBinary'.</param>
+		/// <param name="binary">The binary data returned by 'glGetProgramBinary'.</param>
+		bool save(uint64_t key, uint32_t format, const std::vector<uint8_t> &binary);
+		/// <summary>
+		/// Remove a program binary from the cache (e.g. after the driver rejected it).
+		/// </summary>
+		/// <param name="key">The key of the program.</param>
+		void remove(uint64_t key);
+
+		/// <summary>
+		/// Returns the path of the file the entry for a program is stored in.
+		/// </summary>
+		/// <param name="key">The key of the program.</param>
+		filesystem::path entry_path(uint64_t key) const;
+
+	private:
+		struct file_header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t key;
+			uint64_t driver_hash;
+			uint32_t binary_format;
+			uint32_t binary_size;
+		};
+
+		void evict();
+
+		filesystem::path _directory;
+		uint64_t _driver_hash = 0;
+		uint64_t _max_size = 0, _total_size = 0;
+		bool _driver_changed = false;
+	};
+}
@@ -7,8 +7,10 @@
 #include "opengl_runtime.hpp"
 #include "opengl_effect_compiler.hpp"
 #include "input.hpp"
+#include "dds_file.hpp"
 #include <imgui.h>
 #include <assert.h>
+#include <algorithm>
 
 namespace reshade::opengl
 {
@@ -344,6 +346,29 @@ namespace reshade::opengl
 
 		_stateblock.apply();
 
+		// Program binaries can only be reused with the exact driver they were created with
+		GLint num_program_binary_formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_program_binary_formats);
+
+		if (num_program_binary_formats > 0 && gl3wProcs.gl.ProgramBinary != nullptr)
+		{
+			std::string driver;
+			driver += reinterpret_cast<const char *>(glGetString(GL_VENDOR));
+			driver += '\n';
+			driver += reinterpret_cast<const char *>(glGetString(GL_RENDERER));
+			driver += '\n';
+			driver += reinterpret_cast<const char *>(glGetString(GL_VERSION));
+
+			if (!_program_cache.open(s_reshade_dll_path.parent_path() / "ReShade-ProgramCache", driver))
+			{
+				LOG(WARNING) << "Failed to open program binary cache. Programs will be linked from source every time.";
+			}
+			else if (_program_cache.driver_changed())
+			{
+				LOG(INFO) << "Discarded cached program binaries of a different driver.";
+			}
+		}
+
 		return runtime::on_init();
 	}
 	void opengl_runtime::on_reset()
@@ -366,6 +391,7 @@ namespace reshade::opengl
 		glDeleteVertexArrays(1, &_imgui_vao);
 		glDeleteBuffers(2, _imgui_vbo);
 		glDeleteProgram(_imgui_shader_program);
+		glDeleteBuffers(capture_ring_size, _capture_pbo);
 
 		_default_vao = 0;
 		_default_backbuffer_fbo = 0;
@@ -379,7 +405,14 @@ namespace reshade::opengl
 		_imgui_shader_program = 0;
 		_imgui_vao = _imgui_vbo[0] = _imgui_vbo[1] = 0;
 
+		for (auto &pbo : _capture_pbo)
+		{
+			pbo = 0;
+		}
+
 		_depth_source = 0;
+
+		_program_cache.close();
 	}
 	void opengl_runtime::on_reset_effect()
 	{
@@ -392,12 +425,20 @@ namespace reshade::opengl
 
 		_effect_samplers.clear();
 
-		for (auto &uniform_buffer : _effect_ubos)
+		for (auto &uniform_buffers : _effect_ubos)
 		{
-			glDeleteBuffers(1, &uniform_buffer.first);
+			glDeleteBuffers(1, &uniform_buffers.user_buffer);
+			glDeleteBuffers(1, &uniform_buffers.frame_buffer);
 		}
 
 		_effect_ubos.clear();
+
+		for (auto &shader : _effect_shaders)
+		{
+			glDeleteShader(shader.second);
+		}
+
+		_effect_shaders.clear();
 	}
 	void opengl_runtime::on_present()
 	{
@@ -406,19 +447,54 @@ namespace reshade::opengl
 
 		detect_depth_source();
 
-		// Evaluate queries
+		// Evaluate queries of earlier frames that finished, without waiting for those that did not
 		for (technique &technique : _techniques)
 		{
 			opengl_technique_data &technique_data = *technique.impl->as<opengl_technique_data>();
 
-			if (technique.enabled && technique_data.query_in_flight)
-			{
+			technique_data.query_slots.poll([this, &technique, &technique_data](size_t index, uint64_t frame) {
+				GLuint available = GL_FALSE;
+				glGetQueryObjectuiv(technique_data.queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+
+				if (available == GL_FALSE)
+				{
+					return false;
+				}
+
+				// There is a timestamp before every pass and one after the last, if passes were measured in this frame
+				const size_t pass_query_count = technique_data.pass_queries_issued[index] ? technique.passes.size() + 1 : 0;
+
+				for (size_t k = 0; k < pass_query_count; k++)
+				{
+					glGetQueryObjectuiv(technique_data.pass_queries[index * pass_query_count + k], GL_QUERY_RESULT_AVAILABLE, &available);
+
+					if (available == GL_FALSE)
+					{
+						return false;
+					}
+				}
+
 				GLuint64 elapsed_time = 0;
-				glGetQueryObjectui64v(technique_data.query, GL_QUERY_RESULT, &elapsed_time);
+				glGetQueryObjectui64v(technique_data.queries[index], GL_QUERY_RESULT, &elapsed_time);
 
-				technique.average_gpu_duration.append(elapsed_time);
-				technique_data.query_in_flight = false;
-			}
+				std::vector<GLuint64> pass_timestamps(pass_query_count);
+
+				for (size_t k = 0; k < pass_query_count; k++)
+				{
+					glGetQueryObjectui64v(technique_data.pass_queries[index * pass_query_count + k], GL_QUERY_RESULT, &pass_timestamps[k]);
+				}
+
+				std::vector<uint64_t> pass_durations(pass_query_count == 0 ? 0 : pass_query_count - 1);
+
+				for (size_t k = 0; k < pass_durations.size(); k++)
+				{
+					pass_durations[k] = pass_timestamps[k + 1] - pass_timestamps[k];
+				}
+
+				record_gpu_timings(technique, frame, elapsed_time, pass_durations);
+
+				return true;
+			});
 		}
 
 		// Capture states
@@ -586,31 +662,90 @@ namespace reshade::opengl
 		_depth_source_table.emplace(id, info);
 	}
 
-	void opengl_runtime::capture_frame(uint8_t *buffer) const
+	bool opengl_runtime::capture_frame(const std::function<void(const frame_data &)> &callback) const
 	{
+		std::vector<uint8_t> buffer(_width * _height * 4);
+
 		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 		glReadBuffer(GL_BACK);
 
-		glReadPixels(0, 0, static_cast<GLsizei>(_width), static_cast<GLsizei>(_height), GL_RGBA, GL_UNSIGNED_BYTE, buffer);
+		glReadPixels(0, 0, static_cast<GLsizei>(_width), static_cast<GLsizei>(_height), GL_RGBA, GL_UNSIGNED_BYTE, buffer.data());
 
-		// Flip image
-		const unsigned int pitch = _width * 4;
+		callback(bottom_up_frame(buffer.data()));
+
+		return true;
+	}
+	bool opengl_runtime::copy_frame_to_staging(unsigned int slot)
+	{
+		GLint previous = 0;
+		glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &previous);
 
-		for (unsigned int y = 0; y * 2 < _height; ++y)
+		if (_capture_pbo[slot] == 0)
 		{
-			const unsigned int i1 = y * pitch;
-			const unsigned int i2 = (_height - 1 - y) * pitch;
+			glGenBuffers(1, &_capture_pbo[slot]);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, _capture_pbo[slot]);
+			glBufferData(GL_PIXEL_PACK_BUFFER, _width * _height * 4, nullptr, GL_STREAM_READ);
+		}
+		else
+		{
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, _capture_pbo[slot]);
+		}
 
-			for (unsigned int x = 0; x < pitch; x += 4)
-			{
-				buffer[i1 + x + 3] = 0xFF;
-				buffer[i2 + x + 3] = 0xFF;
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glReadBuffer(GL_BACK);
 
-				std::swap(buffer[i1 + x + 0], buffer[i2 + x + 0]);
-				std::swap(buffer[i1 + x + 1], buffer[i2 + x + 1]);
-				std::swap(buffer[i1 + x + 2], buffer[i2 + x + 2]);
-			}
+		// Reading into a pixel buffer object returns immediately, the copy happens on the GPU in the background
+		glReadPixels(0, 0, static_cast<GLsizei>(_width), static_cast<GLsizei>(_height), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, previous);
+
+		return true;
+	}
+	bool opengl_runtime::map_frame_from_staging(unsigned int slot, frame_data &frame)
+	{
+		if (_capture_pbo[slot] == 0)
+		{
+			return false;
+		}
+
+		GLint previous = 0;
+		glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &previous);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, _capture_pbo[slot]);
+
+		// Map the pixel buffer object instead of copying it out, so the consumer reads straight from the driver memory
+		// The buffer stays mapped while other commands are issued, which is fine as long as it is not used by any of them
+		const auto mapped_data = static_cast<const uint8_t *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, _width * _height * 4, GL_MAP_READ_BIT));
+
+		if (mapped_data != nullptr)
+		{
+			frame = bottom_up_frame(mapped_data);
 		}
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, previous);
+
+		return mapped_data != nullptr;
+	}
+	void opengl_runtime::unmap_frame_from_staging(unsigned int slot)
+	{
+		GLint previous = 0;
+		glGetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &previous);
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, _capture_pbo[slot]);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, previous);
+	}
+	runtime::frame_data opengl_runtime::bottom_up_frame(const uint8_t *data) const
+	{
+		// OpenGL returns the rows starting at the bottom of the image, so start at the last one and walk backwards instead of flipping the image
+		frame_data frame;
+		frame.data = data + (_height - 1) * _width * 4;
+		frame.row_pitch = -static_cast<ptrdiff_t>(_width * 4);
+		frame.width = _width;
+		frame.height = _height;
+		frame.format = frame_format::rgba8;
+
+		return frame;
 	}
 	bool opengl_runtime::load_effect(const reshadefx::syntax_tree &ast, std::string &errors)
 	{
@@ -637,24 +772,44 @@ namespace reshade::opengl
 		GLint previous = 0;
 		glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
 
-		// Flip image data vertically
-		unsigned int stride = texture.width * 4;
-		std::vector<uint8_t> data_flipped(data, data + stride * texture.height);
-		const auto temp = static_cast<uint8_t *>(alloca(stride));
-
-		for (unsigned int y = 0; 2 * y < texture.height; y++)
+		if (dds::is_block_compressed(texture.format))
 		{
-			const auto line1 = data_flipped.data() + stride * (y);
-			const auto line2 = data_flipped.data() + stride * (texture.height - 1 - y);
+			glBindTexture(GL_TEXTURE_2D, texture_impl->id[0]);
+
+			GLint internalformat = GL_NONE;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalformat);
+
+			// Upload every mipmap level directly from the compressed data, flipped upside down block by block to match the OpenGL texture origin
+			for (unsigned int level = 0; level < texture.levels; level++)
+			{
+				const unsigned int level_width = std::max(texture.width >> level, 1u), level_height = std::max(texture.height >> level, 1u);
+				const size_t level_size = dds::mip_chain_size(texture.format, level_width, level_height, 1);
+
+				_texture_upload_buffer.assign(data, data + level_size);
+				dds::flip_level_vertically(texture.format, _texture_upload_buffer.data(), level_width, level_height);
+
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, level_width, level_height, internalformat, static_cast<GLsizei>(level_size), _texture_upload_buffer.data());
+
+				data += level_size;
+			}
+
+			glBindTexture(GL_TEXTURE_2D, previous);
+
+			return true;
+		}
+
+		// Flip image data vertically while copying it into the reused upload buffer
+		const unsigned int stride = texture.width * 4;
+		_texture_upload_buffer.resize(stride * texture.height);
 
-			std::memcpy(temp, line1, stride);
-			std::memcpy(line1, line2, stride);
-			std::memcpy(line2, temp, stride);
+		for (unsigned int y = 0; y < texture.height; y++)
+		{
+			std::memcpy(_texture_upload_buffer.data() + stride * (texture.height - 1 - y), data + stride * y, stride);
 		}
 
 		// Bind and update texture
 		glBindTexture(GL_TEXTURE_2D, texture_impl->id[0]);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texture.width, texture.height, GL_RGBA, GL_UNSIGNED_BYTE, data_flipped.data());
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, texture.width, texture.height, GL_RGBA, GL_UNSIGNED_BYTE, _texture_upload_buffer.data());
 
 		if (texture.levels > 1)
 		{
@@ -665,6 +820,58 @@ namespace reshade::opengl
 
 		return true;
 	}
+	bool opengl_runtime::alias_texture(texture &texture, const texture &target)
+	{
+		const auto texture_impl = texture.impl->as<opengl_tex_data>();
+		const auto target_impl = target.impl->as<opengl_tex_data>();
+
+		if (texture_impl == nullptr || target_impl == nullptr)
+		{
+			return false;
+		}
+
+		GLint previous_fbo = 0;
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous_fbo);
+
+		// Samplers reference the texture data rather than the texture itself, but the frame buffers of passes have the texture attached directly
+		for (const auto &technique : _techniques)
+		{
+			for (const auto &pass_object : technique.passes)
+			{
+				opengl_pass_data &pass = *pass_object->as<opengl_pass_data>();
+
+				for (GLuint i = 0; i < 8; i++)
+				{
+					for (unsigned int k = 0; k < 2; k++)
+					{
+						if (pass.draw_textures[i] == 0 || pass.draw_textures[i] != texture_impl->id[k])
+						{
+							continue;
+						}
+
+						glBindFramebuffer(GL_FRAMEBUFFER, pass.fbo);
+						glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, target_impl->id[k], 0);
+
+						pass.draw_textures[i] = target_impl->id[k];
+						break;
+					}
+				}
+			}
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, previous_fbo);
+
+		if (texture_impl->should_delete)
+		{
+			glDeleteTextures(2, texture_impl->id);
+		}
+
+		texture_impl->should_delete = false;
+		texture_impl->id[0] = target_impl->id[0];
+		texture_impl->id[1] = target_impl->id[1];
+
+		return true;
+	}
 	bool opengl_runtime::update_texture_reference(texture &texture, texture_reference id)
 	{
 		GLuint new_reference[2] = { };
@@ -707,12 +914,35 @@ namespace reshade::opengl
 		return true;
 	}
 
-	void opengl_runtime::render_technique(const technique &technique)
+	void opengl_runtime::render_technique(technique &technique)
 	{
 		opengl_technique_data &technique_data = *technique.impl->as<opengl_technique_data>();
 
-		if (!technique_data.query_in_flight)
-			glBeginQuery(GL_TIME_ELAPSED, technique_data.query);
+		// Only measure this frame if a query is free, which is not the case while the GPU is more frames behind than there are queries
+		size_t query_index = 0;
+		const bool measure = technique_data.query_slots.reserve(_framecount, query_index);
+
+		if (measure)
+		{
+			glBeginQuery(GL_TIME_ELAPSED, technique_data.queries[query_index]);
+		}
+
+		// Timestamps between passes are only issued while they are shown in the statistics, and created the first time they are needed
+		// These have to be timestamp queries, since time elapsed queries cannot be nested in the one for the whole technique
+		const size_t pass_query_count = technique.passes.size() + 1;
+		const bool measure_passes = measure && _profile_passes;
+
+		if (measure_passes && technique_data.pass_queries.empty())
+		{
+			technique_data.pass_queries.resize(technique_data.query_slots.size() * pass_query_count);
+
+			glGenQueries(static_cast<GLsizei>(technique_data.pass_queries.size()), technique_data.pass_queries.data());
+		}
+
+		if (measure)
+		{
+			technique_data.pass_queries_issued[query_index] = measure_passes;
+		}
 
 		// Clear depth stencil
 		glBindFramebuffer(GL_FRAMEBUFFER, _default_backbuffer_fbo);
@@ -721,21 +951,75 @@ namespace reshade::opengl
 		// Setup shader constants
 		if (technique.uniform_storage_index >= 0)
 		{
-			glBindBufferBase(GL_UNIFORM_BUFFER, 0, _effect_ubos[technique.uniform_storage_index].first);
-			glBufferSubData(GL_UNIFORM_BUFFER, 0, _effect_ubos[technique.uniform_storage_index].second, get_uniform_value_storage().data() + technique.uniform_storage_offset);
+			auto &uniform_buffers = _effect_ubos[technique.uniform_storage_index];
+			const size_t user_buffer_offset = technique.uniform_storage_offset;
+			const size_t frame_buffer_offset = user_buffer_offset + uniform_buffers.user_buffer_size;
+			const auto uniform_storage_data = get_uniform_value_storage().data();
+			size_t dirty_begin = 0, dirty_end = 0;
+
+			glBindBufferBase(GL_UNIFORM_BUFFER, 0, uniform_buffers.user_buffer);
+
+			// Only upload the bytes that changed. Taking the range from the dirty list means techniques sharing the same buffers do not upload it again.
+			if (uniform_buffers.user_buffer != 0 && _uniform_dirty_ranges.take(user_buffer_offset, frame_buffer_offset, dirty_begin, dirty_end))
+			{
+				glBufferSubData(GL_UNIFORM_BUFFER, dirty_begin - user_buffer_offset, dirty_end - dirty_begin, uniform_storage_data + dirty_begin);
+
+				_uniform_bytes_uploaded += dirty_end - dirty_begin;
+			}
+
+			glBindBufferBase(GL_UNIFORM_BUFFER, 1, uniform_buffers.frame_buffer);
+
+			if (uniform_buffers.frame_buffer != 0 && _uniform_dirty_ranges.take(frame_buffer_offset, frame_buffer_offset + uniform_buffers.frame_buffer_size, dirty_begin, dirty_end))
+			{
+				glBufferSubData(GL_UNIFORM_BUFFER, dirty_begin - frame_buffer_offset, dirty_end - dirty_begin, uniform_storage_data + dirty_begin);
+
+				_uniform_bytes_uploaded += dirty_end - dirty_begin;
+			}
 		}
 
-		for (const auto &pass_object : technique.passes)
+		for (size_t pass_index = 0; pass_index < technique.passes.size(); pass_index++)
 		{
-			const opengl_pass_data &pass = *pass_object->as<opengl_pass_data>();
+			const opengl_pass_data &pass = *technique.passes[pass_index]->as<opengl_pass_data>();
+
+			if (measure_passes)
+			{
+				glQueryCounter(technique_data.pass_queries[query_index * pass_query_count + pass_index], GL_TIMESTAMP);
+			}
 
-			// Save frame buffer of previous pass
-			glDisable(GL_FRAMEBUFFER_SRGB);
-			glBindFramebuffer(GL_READ_FRAMEBUFFER, _default_backbuffer_fbo);
-			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _blit_fbo);
-			glReadBuffer(GL_COLOR_ATTACHMENT0);
-			glDrawBuffer(GL_COLOR_ATTACHMENT0);
-			glBlitFramebuffer(0, 0, _width, _height, 0, 0, _width, _height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			// Passes can be skipped on frames a technique reuses what it rendered earlier. Their averages only include the frames they ran in.
+			if (technique.pass_infos[pass_index].skipped)
+			{
+				continue;
+			}
+
+			const auto time_pass_started = std::chrono::high_resolution_clock::now();
+
+			// Save frame buffer of previous pass, unless this pass does not sample it or it was not rendered to since the last copy
+			if (technique.pass_infos[pass_index].copy_backbuffer)
+			{
+				glDisable(GL_FRAMEBUFFER_SRGB);
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, _default_backbuffer_fbo);
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _blit_fbo);
+				glReadBuffer(GL_COLOR_ATTACHMENT0);
+				glDrawBuffer(GL_COLOR_ATTACHMENT0);
+				glBlitFramebuffer(0, 0, _width, _height, 0, 0, _width, _height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			}
+
+			// Generate mipmaps of textures this pass samples that were rendered to since they were last generated, using a texture unit they are already bound to
+			for (const auto texture : technique.pass_infos[pass_index].generate_mipmaps)
+			{
+				const auto texture_impl = texture->impl->as<opengl_tex_data>();
+
+				for (GLsizei i = 0; i < static_cast<GLsizei>(_effect_samplers.size()); i++)
+				{
+					if (_effect_samplers[i].texture->id[0] == texture_impl->id[0])
+					{
+						glActiveTexture(GL_TEXTURE0 + i);
+						glGenerateMipmap(GL_TEXTURE_2D);
+						break;
+					}
+				}
+			}
 
 			// Setup states
 			glUseProgram(pass.program);
@@ -798,25 +1082,21 @@ namespace reshade::opengl
 			_vertices += 3;
 			_drawcalls += 1;
 
-			// Update shader resources
-			for (GLuint texture_id : pass.draw_textures)
+			if (_profile_passes)
 			{
-				for (GLsizei i = 0; i < static_cast<GLsizei>(_effect_samplers.size()); i++)
-				{
-					const auto texture = _effect_samplers[i].texture;
-
-					if (_effect_samplers[i].has_mipmaps && (texture->id[0] == texture_id || texture->id[1] == texture_id))
-					{
-						glActiveTexture(GL_TEXTURE0 + i);
-						glGenerateMipmap(GL_TEXTURE_2D);
-					}
-				}
+				technique.pass_infos[pass_index].average_cpu_duration.append(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - time_pass_started).count());
 			}
 		}
 
-		if (!technique_data.query_in_flight)
+		if (measure_passes)
+		{
+			glQueryCounter(technique_data.pass_queries[query_index * pass_query_count + technique.passes.size()], GL_TIMESTAMP);
+		}
+
+		if (measure)
+		{
 			glEndQuery(GL_TIME_ELAPSED);
-		technique_data.query_in_flight = true;
+		}
 	}
 	void opengl_runtime::render_imgui_draw_data(ImDrawData *draw_data)
 	{
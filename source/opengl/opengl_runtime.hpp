@@ -6,7 +6,9 @@
 #pragma once
 
 #include "runtime.hpp"
+#include "query_ring.hpp"
 #include "opengl_stateblock.hpp"
+#include "opengl_program_cache.hpp"
 
 namespace reshade::opengl
 {
@@ -47,11 +49,19 @@ namespace reshade::opengl
 	{
 		~opengl_technique_data()
 		{
-			glDeleteQueries(1, &query);
+			glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+			glDeleteQueries(static_cast<GLsizei>(pass_queries.size()), pass_queries.data());
 		}
 
-		GLuint query = 0;
-		bool query_in_flight = false;
+		query_ring query_slots;
+		std::vector<GLuint> queries;
+		std::vector<GLuint> pass_queries;
+		std::vector<bool> pass_queries_issued;
+	};
+	struct opengl_uniform_buffers
+	{
+		GLuint user_buffer = 0, frame_buffer = 0;
+		GLsizeiptr user_buffer_size = 0, frame_buffer_size = 0;
 	};
 
 	struct opengl_sampler
@@ -59,7 +69,6 @@ namespace reshade::opengl
 		GLuint id;
 		opengl_tex_data *texture;
 		bool is_srgb;
-		bool has_mipmaps;
 	};
 
 	class opengl_runtime : public runtime
@@ -74,12 +83,16 @@ namespace reshade::opengl
 		void on_draw_call(unsigned int vertices);
 		void on_fbo_attachment(GLenum target, GLenum attachment, GLenum objecttarget, GLuint object, GLint level);
 
-		void capture_frame(uint8_t *buffer) const override;
+		bool capture_frame(const std::function<void(const frame_data &)> &callback) const override;
 		bool load_effect(const reshadefx::syntax_tree &ast, std::string &errors) override;
 		bool update_texture(texture &texture, const uint8_t *data) override;
+		bool alias_texture(texture &texture, const texture &target) override;
 		bool update_texture_reference(texture &texture, texture_reference id);
+		bool copy_frame_to_staging(unsigned int slot) override;
+		bool map_frame_from_staging(unsigned int slot, frame_data &frame) override;
+		void unmap_frame_from_staging(unsigned int slot) override;
 
-		void render_technique(const technique &technique) override;
+		void render_technique(technique &technique) override;
 		void render_imgui_draw_data(ImDrawData *data) override;
 
 		HDC _hdc;
@@ -89,7 +102,9 @@ namespace reshade::opengl
 		GLuint _depth_source_fbo = 0, _depth_source = 0, _depth_texture = 0, _blit_fbo = 0;
 		std::vector<struct opengl_sampler> _effect_samplers;
 		GLuint _default_vao = 0;
-		std::vector<std::pair<GLuint, GLsizeiptr>> _effect_ubos;
+		std::vector<opengl_uniform_buffers> _effect_ubos;
+		shader_registry<GLuint> _effect_shaders;
+		program_cache _program_cache;
 
 	private:
 		struct depth_source_info
@@ -99,6 +114,8 @@ namespace reshade::opengl
 			unsigned int drawcall_count, vertices_count;
 		};
 
+		frame_data bottom_up_frame(const uint8_t *data) const;
+
 		bool init_backbuffer_texture();
 		bool init_default_depth_stencil();
 		bool init_fx_resources();
@@ -110,6 +127,8 @@ namespace reshade::opengl
 
 		opengl_stateblock _stateblock;
 		std::unordered_map<GLuint, depth_source_info> _depth_source_table;
+		std::vector<uint8_t> _texture_upload_buffer;
+		GLuint _capture_pbo[capture_ring_size] = { };
 
 		GLuint _imgui_shader_program = 0, _imgui_VertHandle = 0, _imgui_FragHandle = 0;
 		int _imgui_attribloc_tex = 0, _imgui_attribloc_projmtx = 0;
@@ -0,0 +1,202 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "pixel_conversion.hpp"
+#include <string.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <tmmintrin.h>
+#endif
+
+// GCC and Clang only compile the SSSE3 intrinsics in functions that enable the instruction set, which must not include the fallback paths
+#ifdef _MSC_VER
+#define SSSE3_FUNCTION
+#else
+#define SSSE3_FUNCTION __attribute__((target("ssse3")))
+#endif
+
+namespace reshade::pixel_conversion
+{
+	static bool has_ssse3()
+	{
+		static const bool result = []() {
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 1);
+			return (info[2] & (1 << 9)) != 0;
+#else
+			unsigned int eax, ebx, ecx, edx;
+			return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1 << 9)) != 0;
+#endif
+		}();
+
+		return result;
+	}
+
+	void scalar::shuffle_rgba8(const uint8_t *src, uint8_t *dst, size_t count, const int8_t pattern[4])
+	{
+		for (size_t i = 0; i < count * 4; i += 4)
+		{
+			const uint8_t pixel[4] = { src[i + 0], src[i + 1], src[i + 2], src[i + 3] };
+
+			for (size_t c = 0; c < 4; c++)
+				dst[i + c] = pattern[c] < 0 ? 0 : pixel[pattern[c]];
+		}
+	}
+	void scalar::fill_alpha_rgba8(uint8_t *data, size_t count, uint8_t alpha)
+	{
+		for (size_t i = 3; i < count * 4; i += 4)
+			data[i] = alpha;
+	}
+	void scalar::extract_channels_rgba8(const uint8_t *src, uint8_t *dst, size_t count, unsigned int channels)
+	{
+		for (size_t i = 0, k = 0; i < count * 4; i += 4, k += channels)
+			for (size_t c = 0; c < channels; c++)
+				dst[k + c] = src[i + c];
+	}
+	uint16_t scalar::float_to_float16(float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+
+		const uint32_t sign = (bits >> 16) & 0x8000;
+		const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+		uint32_t mantissa = bits & 0x7FFFFF;
+
+		if (exponent >= 31)
+		{
+			// Overflow, infinity and NaN
+			return static_cast<uint16_t>(sign | 0x7C00 | ((bits & 0x7FFFFFFF) > 0x7F800000 ? 0x200 : 0));
+		}
+		if (exponent <= 0)
+		{
+			// Denormals and underflow to zero
+			if (exponent < -10)
+			{
+				return static_cast<uint16_t>(sign);
+			}
+
+			mantissa |= 0x800000;
+			const uint32_t shift = 14 - exponent;
+			const uint32_t rounded = (mantissa + (1 << (shift - 1)) - 1 + ((mantissa >> shift) & 1)) >> shift;
+			return static_cast<uint16_t>(sign | rounded);
+		}
+
+		// Round to nearest even, a carry from the mantissa correctly increments the exponent
+		const uint32_t rounded = ((exponent << 23) | mantissa) + 0xFFF + ((mantissa >> 13) & 1);
+		return static_cast<uint16_t>(sign | (rounded >> 13));
+	}
+
+	SSSE3_FUNCTION static size_t shuffle_rgba8_ssse3(const uint8_t *src, uint8_t *dst, size_t count, const int8_t pattern[4])
+	{
+		size_t i = 0;
+
+		// Build a byte shuffle mask that applies the pattern to four pixels at once (a negative index sets the high bit, which makes 'pshufb' write zero)
+		int8_t mask[16];
+		for (int p = 0; p < 4; p++)
+			for (int c = 0; c < 4; c++)
+				mask[p * 4 + c] = pattern[c] < 0 ? -1 : static_cast<int8_t>(p * 4 + pattern[c]);
+
+		const __m128i shuffle_mask = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask));
+
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), _mm_shuffle_epi8(pixels, shuffle_mask));
+		}
+
+		return i;
+	}
+	SSSE3_FUNCTION static size_t extract_channels_rgba8_ssse3(const uint8_t *src, uint8_t *dst, size_t count, unsigned int channels)
+	{
+		size_t i = 0;
+
+		// Gather the wanted channels of four pixels into the low bytes of the register, then store only those
+		const __m128i shuffle_mask = channels == 1 ?
+			_mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1) :
+			_mm_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128i pixels = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4)), shuffle_mask);
+
+			if (channels == 1)
+			{
+				const int packed = _mm_cvtsi128_si32(pixels);
+				memcpy(dst + i, &packed, 4);
+			}
+			else
+			{
+				_mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i * 2), pixels);
+			}
+		}
+
+		return i;
+	}
+
+	void shuffle_rgba8(const uint8_t *src, uint8_t *dst, size_t count, const int8_t pattern[4])
+	{
+		size_t i = 0;
+
+		if (has_ssse3())
+		{
+			i = shuffle_rgba8_ssse3(src, dst, count, pattern);
+		}
+
+		scalar::shuffle_rgba8(src + i * 4, dst + i * 4, count - i, pattern);
+	}
+	void swizzle_rgba8_bgra8(const uint8_t *src, uint8_t *dst, size_t count)
+	{
+		const int8_t pattern[4] = { 2, 1, 0, 3 };
+
+		shuffle_rgba8(src, dst, count, pattern);
+	}
+	void fill_alpha_rgba8(uint8_t *data, size_t count, uint8_t alpha)
+	{
+		size_t i = 0;
+
+		// SSE2 is available on every processor that can run this
+		const __m128i alpha_mask = _mm_set1_epi32(0xFF000000);
+		const __m128i alpha_value = _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(alpha) << 24));
+
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(data + i * 4), _mm_or_si128(_mm_andnot_si128(alpha_mask, pixels), alpha_value));
+		}
+
+		scalar::fill_alpha_rgba8(data + i * 4, count - i, alpha);
+	}
+	void extract_channels_rgba8(const uint8_t *src, uint8_t *dst, size_t count, unsigned int channels)
+	{
+		size_t i = 0;
+
+		if (has_ssse3() && (channels == 1 || channels == 2))
+		{
+			i = extract_channels_rgba8_ssse3(src, dst, count, channels);
+		}
+
+		scalar::extract_channels_rgba8(src + i * 4, dst + i * channels, count - i, channels);
+	}
+	void unorm8_to_float16(const uint8_t *src, uint16_t *dst, size_t count)
+	{
+		// There are only 256 possible inputs, so a lookup table beats any arithmetic conversion
+		static const struct lookup_table
+		{
+			lookup_table()
+			{
+				for (unsigned int i = 0; i < 256; i++)
+					values[i] = scalar::float_to_float16(i / 255.0f);
+			}
+
+			uint16_t values[256];
+		} table;
+
+		for (size_t i = 0; i < count; i++)
+			dst[i] = table.values[src[i]];
+	}
+}
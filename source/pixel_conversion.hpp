@@ -0,0 +1,50 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace reshade::pixel_conversion
+{
+	/// <summary>
+	/// Rearrange the channels of RGBA8 pixels. Source and destination may point to the same memory.
+	/// </summary>
+	/// <param name="src">The source pixels.</param>
+	/// <param name="dst">The destination pixels.</param>
+	/// <param name="count">The number of pixels to convert.</param>
+	/// <param name="pattern">For each destination channel, the index of the source channel to read from, or -1 to write zero.</param>
+	void shuffle_rgba8(const uint8_t *src, uint8_t *dst, size_t count, const int8_t pattern[4]);
+	/// <summary>
+	/// Swap red and blue channels to convert between RGBA8 and BGRA8. Source and destination may point to the same memory.
+	/// </summary>
+	void swizzle_rgba8_bgra8(const uint8_t *src, uint8_t *dst, size_t count);
+	/// <summary>
+	/// Set the alpha channel of RGBA8 or BGRA8 pixels to the specified value.
+	/// </summary>
+	void fill_alpha_rgba8(uint8_t *data, size_t count, uint8_t alpha);
+	/// <summary>
+	/// Copy the first channels of RGBA8 pixels into a tightly packed R8 (one channel) or RG8 (two channels) destination.
+	/// </summary>
+	/// <param name="channels">The number of channels to keep, either 1 or 2.</param>
+	void extract_channels_rgba8(const uint8_t *src, uint8_t *dst, size_t count, unsigned int channels);
+	/// <summary>
+	/// Convert normalized 8-bit components to 16-bit floating-point components.
+	/// </summary>
+	/// <param name="count">The number of components (not pixels) to convert.</param>
+	void unorm8_to_float16(const uint8_t *src, uint16_t *dst, size_t count);
+
+	/// <summary>
+	/// Scalar reference implementations of the kernels above, which are used on processors without the required instruction set extensions.
+	/// </summary>
+	namespace scalar
+	{
+		void shuffle_rgba8(const uint8_t *src, uint8_t *dst, size_t count, const int8_t pattern[4]);
+		void fill_alpha_rgba8(uint8_t *data, size_t count, uint8_t alpha);
+		void extract_channels_rgba8(const uint8_t *src, uint8_t *dst, size_t count, unsigned int channels);
+		uint16_t float_to_float16(float value);
+	}
+}
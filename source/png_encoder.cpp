@@ -0,0 +1,493 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "png_encoder.hpp"
+#include <atomic>
+#include <thread>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+namespace reshade::png
+{
+	static const unsigned int window_size = 32768;
+	static const unsigned int hash_bits = 15;
+	static const unsigned int min_match_length = 3, max_match_length = 258;
+
+	// Maximum number of hash chain entries to search and the match length after which searching stops, for each compression level
+	static const unsigned int max_chain_lengths[10] = { 0, 4, 8, 16, 32, 64, 128, 256, 1024, 4096 };
+	static const unsigned int nice_match_lengths[10] = { 0, 8, 16, 32, 64, 128, 258, 258, 258, 258 };
+	static const unsigned int max_insert_lengths[10] = { 0, 4, 5, 6, max_match_length, max_match_length, max_match_length, max_match_length, max_match_length, max_match_length };
+
+	static const uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	static const uint8_t length_extra_bits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	static const uint16_t distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	static const uint8_t distance_extra_bits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	static const struct code_tables
+	{
+		code_tables()
+		{
+			// Fixed Huffman codes as defined in RFC 1951, stored bit-reversed since deflate streams are written starting at the least significant bit
+			for (unsigned int symbol = 0; symbol < 288; symbol++)
+			{
+				unsigned int code, length;
+
+				if (symbol < 144)
+					code = 0x30 + symbol, length = 8;
+				else if (symbol < 256)
+					code = 0x190 + symbol - 144, length = 9;
+				else if (symbol < 280)
+					code = symbol - 256, length = 7;
+				else
+					code = 0xC0 + symbol - 280, length = 8;
+
+				literal_codes[symbol] = static_cast<uint16_t>(reverse(code, length));
+				literal_code_lengths[symbol] = static_cast<uint8_t>(length);
+			}
+
+			for (unsigned int symbol = 0; symbol < 30; symbol++)
+			{
+				distance_codes[symbol] = static_cast<uint8_t>(reverse(symbol, 5));
+			}
+
+			for (unsigned int index = 0, length = min_match_length; length <= max_match_length; length++)
+			{
+				while (index + 1 < 29 && length_base[index + 1] <= length)
+					index++;
+				length_symbols[length] = static_cast<uint8_t>(index);
+			}
+
+			for (unsigned int index = 0, distance = 1; distance <= window_size; distance++)
+			{
+				while (index + 1 < 30 && distance_base[index + 1] <= distance)
+					index++;
+				distance_symbols[distance] = static_cast<uint8_t>(index);
+			}
+
+			for (uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for (unsigned int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+				crc[n] = c;
+			}
+		}
+
+		static uint32_t reverse(uint32_t code, unsigned int length)
+		{
+			uint32_t result = 0;
+			for (unsigned int i = 0; i < length; i++)
+				result |= ((code >> i) & 1) << (length - 1 - i);
+			return result;
+		}
+
+		uint16_t literal_codes[288];
+		uint8_t literal_code_lengths[288];
+		uint8_t distance_codes[30];
+		uint8_t length_symbols[max_match_length + 1];
+		uint8_t distance_symbols[window_size + 1];
+		uint32_t crc[256];
+	} s_tables;
+
+	static uint32_t compute_crc(uint32_t crc, const uint8_t *data, size_t size)
+	{
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+			crc = s_tables.crc[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+	static uint32_t compute_adler32(uint32_t adler, const uint8_t *data, size_t size)
+	{
+		uint32_t a = adler & 0xFFFF, b = adler >> 16;
+
+		while (size > 0)
+		{
+			// 5552 is the largest number of bytes that can be summed before the 32-bit sums could overflow
+			const size_t count = std::min<size_t>(size, 5552);
+
+			for (size_t i = 0; i < count; i++)
+				a += data[i], b += a;
+
+			a %= 65521, b %= 65521;
+			data += count, size -= count;
+		}
+
+		return a | (b << 16);
+	}
+	static uint32_t combine_adler32(uint32_t adler1, uint32_t adler2, size_t size2)
+	{
+		// Compute the checksum of the concatenation of two blocks of data from their individual checksums, see 'adler32_combine' in zlib
+		const uint32_t base = 65521;
+		const uint32_t remainder = static_cast<uint32_t>(size2 % base);
+		uint32_t sum1 = adler1 & 0xFFFF;
+		uint32_t sum2 = static_cast<uint32_t>((static_cast<uint64_t>(remainder) * sum1) % base);
+		sum1 += (adler2 & 0xFFFF) + base - 1;
+		sum2 += (adler1 >> 16) + (adler2 >> 16) + base - remainder;
+		if (sum1 >= base) sum1 -= base;
+		if (sum1 >= base) sum1 -= base;
+		if (sum2 >= (base << 1)) sum2 -= (base << 1);
+		if (sum2 >= base) sum2 -= base;
+		return sum1 | (sum2 << 16);
+	}
+
+	static void write_uint32(std::vector<uint8_t> &output, uint32_t value)
+	{
+		const uint8_t bytes[4] = { static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value) };
+		output.insert(output.end(), bytes, bytes + 4);
+	}
+	static void begin_chunk(std::vector<uint8_t> &output, const char type[4])
+	{
+		// The length is filled in by 'end_chunk' once the data was written
+		write_uint32(output, 0);
+		output.insert(output.end(), type, type + 4);
+	}
+	static void end_chunk(std::vector<uint8_t> &output, size_t chunk_offset)
+	{
+		const size_t data_size = output.size() - chunk_offset - 8;
+		for (unsigned int i = 0; i < 4; i++)
+			output[chunk_offset + i] = static_cast<uint8_t>(data_size >> (24 - i * 8));
+
+		// The checksum covers the chunk type and data, but not the length
+		write_uint32(output, compute_crc(0, output.data() + chunk_offset + 4, data_size + 4));
+	}
+
+	class bit_writer
+	{
+	public:
+		explicit bit_writer(std::vector<uint8_t> &output) : _output(output) { }
+
+		void put(uint32_t bits, unsigned int count)
+		{
+			_buffer |= static_cast<uint64_t>(bits) << _count;
+			_count += count;
+
+			while (_count >= 8)
+			{
+				_output.push_back(static_cast<uint8_t>(_buffer));
+				_buffer >>= 8;
+				_count -= 8;
+			}
+		}
+		void put_symbol(unsigned int symbol)
+		{
+			put(s_tables.literal_codes[symbol], s_tables.literal_code_lengths[symbol]);
+		}
+		void align()
+		{
+			if (_count > 0)
+			{
+				put(0, 8 - _count);
+			}
+		}
+
+	private:
+		std::vector<uint8_t> &_output;
+		uint64_t _buffer = 0;
+		unsigned int _count = 0;
+	};
+
+	static void deflate_stored(const uint8_t *data, size_t size, std::vector<uint8_t> &output)
+	{
+		// Stored blocks start on a byte boundary and cannot be larger than 64 KB
+		for (size_t offset = 0; offset < size;)
+		{
+			const uint16_t block_size = static_cast<uint16_t>(std::min<size_t>(size - offset, 0xFFFF));
+			const uint8_t header[5] = { 0, static_cast<uint8_t>(block_size), static_cast<uint8_t>(block_size >> 8), static_cast<uint8_t>(~block_size), static_cast<uint8_t>(~block_size >> 8) };
+			output.insert(output.end(), header, header + 5);
+			output.insert(output.end(), data + offset, data + offset + block_size);
+			offset += block_size;
+		}
+	}
+	static uint32_t load_uint32(const uint8_t *data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	static void deflate_fixed(const uint8_t *data, size_t size, int level, std::vector<uint8_t> &output)
+	{
+		// Fixed Huffman codes need at most 9 bits per byte
+		output.reserve(output.size() + size + size / 8 + 16);
+
+		bit_writer writer(output);
+
+		// Single non-final block with fixed Huffman codes
+		writer.put(0, 1);
+		writer.put(1, 2);
+
+		const unsigned int max_chain_length = max_chain_lengths[level];
+		const unsigned int nice_match_length = nice_match_lengths[level];
+		const unsigned int max_insert_length = max_insert_lengths[level];
+
+		std::vector<int32_t> head(1 << hash_bits, -1);
+		std::vector<int32_t> prev(window_size, -1);
+
+		const auto hash = [data](size_t i) {
+			return ((static_cast<uint32_t>(data[i]) << 16 | static_cast<uint32_t>(data[i + 1]) << 8 | data[i + 2]) * 2654435761u) >> (32 - hash_bits);
+		};
+		const auto insert = [&](size_t i) {
+			const uint32_t h = hash(i);
+			prev[i & (window_size - 1)] = head[h];
+			head[h] = static_cast<int32_t>(i);
+		};
+
+		for (size_t i = 0; i < size;)
+		{
+			unsigned int best_length = 0, best_distance = 0;
+
+			if (i + min_match_length <= size)
+			{
+				const unsigned int max_length = static_cast<unsigned int>(std::min<size_t>(max_match_length, size - i));
+
+				int32_t candidate = head[hash(i)];
+
+				for (unsigned int chain = max_chain_length; candidate >= 0 && i - candidate <= window_size && chain > 0; chain--)
+				{
+					// Quick rejection by checking the byte that would have to match for this candidate to be better than the current best
+					if (data[candidate + best_length] == data[i + best_length] || best_length == 0)
+					{
+						unsigned int length = 0;
+						while (length + 4 <= max_length && load_uint32(data + candidate + length) == load_uint32(data + i + length))
+							length += 4;
+						while (length < max_length && data[candidate + length] == data[i + length])
+							length++;
+
+						if (length > best_length)
+						{
+							best_length = length;
+							best_distance = static_cast<unsigned int>(i - candidate);
+
+							if (length >= nice_match_length || length == max_length)
+								break;
+						}
+					}
+
+					// Positions in the ring buffer get overwritten, so stop once the chain no longer leads further back in the data
+					const int32_t next = prev[candidate & (window_size - 1)];
+					if (next >= candidate)
+						break;
+					candidate = next;
+				}
+
+				insert(i);
+			}
+
+			if (best_length >= min_match_length)
+			{
+				const unsigned int length_symbol = s_tables.length_symbols[best_length];
+				writer.put_symbol(257 + length_symbol);
+				writer.put(best_length - length_base[length_symbol], length_extra_bits[length_symbol]);
+
+				const unsigned int distance_symbol = s_tables.distance_symbols[best_distance];
+				writer.put(s_tables.distance_codes[distance_symbol], 5);
+				writer.put(best_distance - distance_base[distance_symbol], distance_extra_bits[distance_symbol]);
+
+				// Make the positions covered by the match available for later matches too, which the fast levels skip for long matches
+				if (best_length <= max_insert_length)
+					for (size_t k = i + 1; k < i + best_length && k + min_match_length <= size; k++)
+						insert(k);
+
+				i += best_length;
+			}
+			else
+			{
+				writer.put_symbol(data[i]);
+
+				i += 1;
+			}
+		}
+
+		// End of block
+		writer.put_symbol(256);
+
+		// Sync flush with an empty stored block, which ends the stream of this strip on a byte boundary so the next one can simply be appended
+		writer.put(0, 3);
+		writer.align();
+		const uint8_t sync_marker[4] = { 0x00, 0x00, 0xFF, 0xFF };
+		output.insert(output.end(), sync_marker, sync_marker + 4);
+	}
+
+	static uint8_t paeth_predictor(int a, int b, int c)
+	{
+		const int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+		return static_cast<uint8_t>(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+	}
+	static void filter_row(const uint8_t *row, const uint8_t *prev_row, size_t size, int filter, uint8_t *output)
+	{
+		// The first pixel has no left neighbor, so it is filtered separately to keep the branches out of the inner loops
+		const size_t bpp = 4;
+
+		switch (filter)
+		{
+			case 0:
+				memcpy(output, row, size);
+				break;
+			case 1:
+				memcpy(output, row, bpp);
+				for (size_t i = bpp; i < size; i++)
+					output[i] = static_cast<uint8_t>(row[i] - row[i - bpp]);
+				break;
+			case 2:
+				for (size_t i = 0; i < size; i++)
+					output[i] = static_cast<uint8_t>(row[i] - prev_row[i]);
+				break;
+			case 3:
+				for (size_t i = 0; i < bpp; i++)
+					output[i] = static_cast<uint8_t>(row[i] - (prev_row[i] >> 1));
+				for (size_t i = bpp; i < size; i++)
+					output[i] = static_cast<uint8_t>(row[i] - ((row[i - bpp] + prev_row[i]) >> 1));
+				break;
+			case 4:
+				for (size_t i = 0; i < bpp; i++)
+					output[i] = static_cast<uint8_t>(row[i] - prev_row[i]);
+				for (size_t i = bpp; i < size; i++)
+					output[i] = static_cast<uint8_t>(row[i] - paeth_predictor(row[i - bpp], prev_row[i], prev_row[i - bpp]));
+				break;
+		}
+	}
+
+	void encode(const uint8_t *pixels, unsigned int width, unsigned int height, int level, unsigned int num_threads, std::vector<uint8_t> &output)
+	{
+		level = std::max(0, std::min(level, 9));
+		num_threads = std::max(num_threads, 1u);
+
+		const size_t stride = width * 4;
+		const std::vector<uint8_t> zero_row(stride);
+
+		// Use a few more strips than threads to balance the load, but keep them large enough that restarting the compression window for each strip does not hurt the compression ratio
+		const unsigned int num_strips = std::max(1u, std::min(num_threads * 4, height / 16));
+		const unsigned int rows_per_strip = (height + num_strips - 1) / num_strips;
+
+		struct strip
+		{
+			std::vector<uint8_t> chunk;
+			uint32_t adler = 1;
+			size_t filtered_size = 0;
+		};
+
+		std::vector<strip> strips(height > 0 ? (height + rows_per_strip - 1) / rows_per_strip : 0);
+		std::atomic<size_t> next_strip(0);
+
+		const auto encode_strips = [&]() {
+			std::vector<uint8_t> filtered, candidate(stride);
+
+			for (size_t index; (index = next_strip++) < strips.size();)
+			{
+				const unsigned int row_begin = static_cast<unsigned int>(index * rows_per_strip);
+				const unsigned int row_end = std::min(row_begin + rows_per_strip, height);
+
+				filtered.resize((row_end - row_begin) * (stride + 1));
+
+				for (unsigned int y = row_begin; y < row_end; y++)
+				{
+					// Rows only depend on the unfiltered previous row, so strips can be filtered independently
+					const uint8_t *const row = pixels + y * stride;
+					const uint8_t *const prev_row = y > 0 ? row - stride : zero_row.data();
+					uint8_t *const filtered_row = filtered.data() + (y - row_begin) * (stride + 1);
+
+					int best_filter = 0;
+
+					// Choose the filter that minimizes the sum of absolute differences, which usually compresses best (not worth it when storing uncompressed)
+					if (level > 0)
+					{
+						unsigned int best_sum = UINT32_MAX;
+
+						for (int filter = 0; filter < 5; filter++)
+						{
+							filter_row(row, prev_row, stride, filter, candidate.data());
+
+							unsigned int sum = 0;
+							for (size_t i = 0; i < stride; i++)
+								sum += std::abs(static_cast<int8_t>(candidate[i]));
+
+							if (sum < best_sum)
+							{
+								best_sum = sum;
+								best_filter = filter;
+								memcpy(filtered_row + 1, candidate.data(), stride);
+							}
+						}
+					}
+					else
+					{
+						memcpy(filtered_row + 1, row, stride);
+					}
+
+					filtered_row[0] = static_cast<uint8_t>(best_filter);
+				}
+
+				auto &strip = strips[index];
+				strip.adler = compute_adler32(1, filtered.data(), filtered.size());
+				strip.filtered_size = filtered.size();
+
+				begin_chunk(strip.chunk, "IDAT");
+
+				if (index == 0)
+				{
+					// zlib stream header with deflate compression and a 32 KB window, the second byte hints at the compression level and makes the header a multiple of 31
+					strip.chunk.push_back(0x78);
+					strip.chunk.push_back(level <= 1 ? 0x01 : level <= 5 ? 0x5E : level == 6 ? 0x9C : 0xDA);
+				}
+
+				if (level == 0)
+					deflate_stored(filtered.data(), filtered.size(), strip.chunk);
+				else
+					deflate_fixed(filtered.data(), filtered.size(), level, strip.chunk);
+
+				end_chunk(strip.chunk, 0);
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (unsigned int i = 1; i < std::min<size_t>(num_threads, strips.size()); i++)
+			threads.emplace_back(encode_strips);
+
+		encode_strips();
+
+		for (auto &thread : threads)
+			thread.join();
+
+		output.clear();
+
+		const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		output.insert(output.end(), signature, signature + 8);
+
+		// 8-bit RGBA, no interlacing
+		begin_chunk(output, "IHDR");
+		write_uint32(output, width);
+		write_uint32(output, height);
+		const uint8_t header[5] = { 8, 6, 0, 0, 0 };
+		output.insert(output.end(), header, header + 5);
+		end_chunk(output, 8);
+
+		uint32_t adler = 1;
+
+		for (const auto &strip : strips)
+		{
+			output.insert(output.end(), strip.chunk.begin(), strip.chunk.end());
+
+			adler = combine_adler32(adler, strip.adler, strip.filtered_size);
+		}
+
+		// Final empty block with fixed Huffman codes (header bits 1 and 01, followed by the 7-bit end of block code), then the checksum to finish the zlib stream
+		const size_t trailer_offset = output.size();
+		begin_chunk(output, "IDAT");
+		if (strips.empty())
+		{
+			output.push_back(0x78);
+			output.push_back(0x01);
+		}
+		output.push_back(0x03);
+		output.push_back(0x00);
+		write_uint32(output, adler);
+		end_chunk(output, trailer_offset);
+
+		const size_t end_offset = output.size();
+		begin_chunk(output, "IEND");
+		end_chunk(output, end_offset);
+	}
+}
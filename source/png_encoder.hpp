@@ -0,0 +1,23 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+namespace reshade::png
+{
+	/// <summary>
+	/// Encode an image as PNG file. The image is split into strips of rows, which are filtered and compressed concurrently and then joined at zlib sync-flush boundaries, with every strip stored in its own IDAT chunk.
+	/// </summary>
+	/// <param name="pixels">The tightly packed 32bpp RGBA pixel data of the image.</param>
+	/// <param name="width">The width of the image.</param>
+	/// <param name="height">The height of the image.</param>
+	/// <param name="level">The compression level, from 0 (store uncompressed) to 9 (smallest output).</param>
+	/// <param name="num_threads">The number of threads to encode on, including the calling thread.</param>
+	/// <param name="output">The resulting PNG file contents.</param>
+	void encode(const uint8_t *pixels, unsigned int width, unsigned int height, int level, unsigned int num_threads, std::vector<uint8_t> &output);
+}
@@ -0,0 +1,78 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+
+namespace reshade
+{
+	/// <summary>
+	/// Keeps track of a fixed number of GPU queries that are reused round-robin, so that new queries can be issued every frame while the results of earlier frames are still on their way.
+	/// This only does the bookkeeping, the graphics API objects are kept by the caller in a list of the same size and addressed by the indices handed out here.
+	/// </summary>
+	class query_ring
+	{
+	public:
+		/// <summary>
+		/// Create a new ring.
+		/// </summary>
+		/// <param name="size">The number of queries, which is the number of frames results may lag behind before no new queries are issued.</param>
+		explicit query_ring(size_t size = 4) : _frames(size) { }
+
+		/// <summary>
+		/// Returns the number of queries in the ring.
+		/// </summary>
+		size_t size() const { return _frames.size(); }
+		/// <summary>
+		/// Returns the number of queries that were issued but whose results were not read yet.
+		/// </summary>
+		size_t pending() const { return _pending; }
+
+		/// <summary>
+		/// Reserve the next query for a frame. Fails if all queries are still waiting for their results, in which case the frame is not measured.
+		/// </summary>
+		/// <param name="frame">The frame the query measures.</param>
+		/// <param name="index">The index of the query to issue.</param>
+		/// <returns><c>true</c> if a query was reserved, <c>false</c> otherwise.</returns>
+		bool reserve(uint64_t frame, size_t &index)
+		{
+			if (_pending == _frames.size())
+			{
+				return false;
+			}
+
+			index = (_oldest + _pending++) % _frames.size();
+			_frames[index] = frame;
+
+			return true;
+		}
+
+		/// <summary>
+		/// Read the results of all queries that are available without waiting, oldest first. Stops at the first query whose result is not available yet, since the GPU finishes them in the order they were issued.
+		/// </summary>
+		/// <param name="read_result">Called with the index of a query and the frame it was reserved for. Returns <c>true</c> if the result was available and read, <c>false</c> to try again later.</param>
+		/// <returns>The number of results that were read.</returns>
+		template <typename F>
+		size_t poll(F read_result)
+		{
+			size_t count = 0;
+
+			while (_pending != 0 && read_result(_oldest, _frames[_oldest]))
+			{
+				_oldest = (_oldest + 1) % _frames.size();
+				_pending--;
+				count++;
+			}
+
+			return count;
+		}
+
+	private:
+		std::vector<uint64_t> _frames;
+		size_t _oldest = 0, _pending = 0;
+	};
+}
@@ -0,0 +1,666 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "render_graph.hpp"
+#include "effect_syntax_tree.hpp"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace reshadefx;
+using namespace reshadefx::nodes;
+
+namespace reshade::render_graph
+{
+	class resource_collector
+	{
+	public:
+		explicit resource_collector(pass_info &info, const std::vector<location> *watched_locations = nullptr) : _info(info), _watched_locations(watched_locations) { }
+
+		/// <summary>
+		/// Check whether any of the visited code is on a line of the watched locations, including the initializers of variables it references.
+		/// </summary>
+		bool found_watched_location() const { return _found_watched_location; }
+
+		void visit(const function_declaration_node *node)
+		{
+			// Functions can be called from many places, but only need to be looked at once
+			if (node == nullptr || !_visited_functions.insert(node).second)
+			{
+				return;
+			}
+
+			visit(node->definition);
+		}
+
+	private:
+		void add_sampler(const variable_declaration_node *node)
+		{
+			// Sampler parameters of functions do not reference a texture, but the global sampler passed in at the call site is visited as an argument too
+			const variable_declaration_node *const texture = node->properties.texture;
+
+			if (texture == nullptr || std::find(_info.sampled_textures.begin(), _info.sampled_textures.end(), texture->unique_name) != _info.sampled_textures.end())
+			{
+				return;
+			}
+
+			_info.sampled_textures.push_back(texture->unique_name);
+
+			if (texture->semantic == "COLOR" || texture->semantic == "SV_TARGET")
+			{
+				_info.reads_backbuffer = true;
+			}
+		}
+
+		void watch(const location &location)
+		{
+			if (_watched_locations == nullptr || _found_watched_location)
+			{
+				return;
+			}
+
+			_found_watched_location = std::any_of(_watched_locations->begin(), _watched_locations->end(), [&location](const reshadefx::location &watched) {
+				return watched.line == location.line && watched.source == location.source;
+			});
+		}
+
+		void visit(const expression_node *node)
+		{
+			if (node == nullptr)
+			{
+				return;
+			}
+
+			watch(node->location);
+
+			switch (node->id)
+			{
+				case nodeid::lvalue_expression:
+				{
+					const auto reference = static_cast<const lvalue_expression_node *>(node)->reference;
+					if (reference != nullptr && reference->type.is_sampler())
+						add_sampler(reference);
+					// Constants are usually declared globally and only referenced in the shader code, so their value has to be looked at too
+					if (reference != nullptr && _watched_locations != nullptr && _visited_variables.insert(reference).second)
+						visit(reference->initializer_expression);
+					break;
+				}
+				case nodeid::literal_expression:
+				{
+					// References to constants are replaced with a copy of their value while parsing
+					const auto constant = static_cast<const literal_expression_node *>(node)->constant;
+					if (constant != nullptr && _watched_locations != nullptr && _visited_variables.insert(constant).second)
+						visit(constant->initializer_expression);
+					break;
+				}
+				case nodeid::unary_expression:
+					visit(static_cast<const unary_expression_node *>(node)->operand);
+					break;
+				case nodeid::binary_expression:
+					for (auto operand : static_cast<const binary_expression_node *>(node)->operands)
+						visit(operand);
+					break;
+				case nodeid::intrinsic_expression:
+					for (auto argument : static_cast<const intrinsic_expression_node *>(node)->arguments)
+						visit(argument);
+					break;
+				case nodeid::conditional_expression:
+					visit(static_cast<const conditional_expression_node *>(node)->condition);
+					visit(static_cast<const conditional_expression_node *>(node)->expression_when_true);
+					visit(static_cast<const conditional_expression_node *>(node)->expression_when_false);
+					break;
+				case nodeid::assignment_expression:
+					visit(static_cast<const assignment_expression_node *>(node)->left);
+					visit(static_cast<const assignment_expression_node *>(node)->right);
+					break;
+				case nodeid::expression_sequence:
+					for (auto expression : static_cast<const expression_sequence_node *>(node)->expression_list)
+						visit(expression);
+					break;
+				case nodeid::call_expression:
+					for (auto argument : static_cast<const call_expression_node *>(node)->arguments)
+						visit(argument);
+					visit(static_cast<const call_expression_node *>(node)->callee);
+					break;
+				case nodeid::constructor_expression:
+					for (auto argument : static_cast<const constructor_expression_node *>(node)->arguments)
+						visit(argument);
+					break;
+				case nodeid::swizzle_expression:
+					visit(static_cast<const swizzle_expression_node *>(node)->operand);
+					break;
+				case nodeid::field_expression:
+					visit(static_cast<const field_expression_node *>(node)->operand);
+					break;
+				case nodeid::initializer_list:
+					for (auto value : static_cast<const initializer_list_node *>(node)->values)
+						visit(value);
+					break;
+				default:
+					break;
+			}
+		}
+		void visit(const statement_node *node)
+		{
+			if (node == nullptr)
+			{
+				return;
+			}
+
+			watch(node->location);
+
+			switch (node->id)
+			{
+				case nodeid::compound_statement:
+					for (auto statement : static_cast<const compound_statement_node *>(node)->statement_list)
+						visit(statement);
+					break;
+				case nodeid::declarator_list:
+					for (auto declarator : static_cast<const declarator_list_node *>(node)->declarator_list)
+						visit(declarator->initializer_expression);
+					break;
+				case nodeid::expression_statement:
+					visit(static_cast<const expression_statement_node *>(node)->expression);
+					break;
+				case nodeid::if_statement:
+					visit(static_cast<const if_statement_node *>(node)->condition);
+					visit(static_cast<const if_statement_node *>(node)->statement_when_true);
+					visit(static_cast<const if_statement_node *>(node)->statement_when_false);
+					break;
+				case nodeid::switch_statement:
+					visit(static_cast<const switch_statement_node *>(node)->test_expression);
+					for (auto case_statement : static_cast<const switch_statement_node *>(node)->case_list)
+						visit(case_statement);
+					break;
+				case nodeid::case_statement:
+					visit(static_cast<const case_statement_node *>(node)->statement_list);
+					break;
+				case nodeid::for_statement:
+					visit(static_cast<const for_statement_node *>(node)->init_statement);
+					visit(static_cast<const for_statement_node *>(node)->condition);
+					visit(static_cast<const for_statement_node *>(node)->increment_expression);
+					visit(static_cast<const for_statement_node *>(node)->statement_list);
+					break;
+				case nodeid::while_statement:
+					visit(static_cast<const while_statement_node *>(node)->condition);
+					visit(static_cast<const while_statement_node *>(node)->statement_list);
+					break;
+				case nodeid::return_statement:
+					visit(static_cast<const return_statement_node *>(node)->return_value);
+					break;
+				default:
+					break;
+			}
+		}
+
+		pass_info &_info;
+		const std::vector<location> *_watched_locations;
+		bool _found_watched_location = false;
+		std::unordered_set<const function_declaration_node *> _visited_functions;
+		std::unordered_set<const variable_declaration_node *> _visited_variables;
+	};
+
+	void analyze_pass(const pass_declaration_node *node, pass_info &info)
+	{
+		info = pass_info();
+
+		// The first render target defaults to the back buffer if the pass does not set one
+		info.writes_backbuffer = node->render_targets[0] == nullptr;
+		info.clear_render_targets = node->clear_render_targets;
+
+		for (auto target : node->render_targets)
+		{
+			if (target != nullptr)
+			{
+				info.render_targets.push_back(target->unique_name);
+			}
+		}
+
+		resource_collector collector(info);
+		collector.visit(node->vertex_shader);
+		collector.visit(node->pixel_shader);
+	}
+
+	size_t schedule_backbuffer_copies(const std::vector<pass_info *> &passes)
+	{
+		size_t copies = 0;
+		bool copy_outdated = true;
+
+		for (auto pass : passes)
+		{
+			pass->copy_backbuffer = pass->reads_backbuffer && copy_outdated;
+
+			if (pass->copy_backbuffer)
+			{
+				copies++;
+				copy_outdated = false;
+			}
+
+			// Rendering to the back buffer makes the copy stale only after the pass, since it samples the copy taken before
+			if (pass->writes_backbuffer)
+			{
+				copy_outdated = true;
+			}
+		}
+
+		return copies;
+	}
+
+	void resolve_mipmapped_textures(const std::vector<texture> &textures, std::vector<technique> &techniques)
+	{
+		std::unordered_map<std::string, const texture *> mipmapped;
+
+		for (const auto &texture : textures)
+		{
+			if (texture.levels > 1 && texture.impl_reference == texture_reference::none)
+			{
+				mipmapped[texture.unique_name] = &texture;
+			}
+		}
+
+		const auto resolve = [&mipmapped](const std::vector<std::string> &names, std::vector<const texture *> &result) {
+			result.clear();
+
+			for (const auto &name : names)
+			{
+				if (const auto it = mipmapped.find(name); it != mipmapped.end())
+				{
+					result.push_back(it->second);
+				}
+			}
+		};
+
+		for (auto &technique : techniques)
+		{
+			for (auto &pass : technique.pass_infos)
+			{
+				resolve(pass.render_targets, pass.mipmapped_render_targets);
+				resolve(pass.sampled_textures, pass.mipmapped_textures);
+			}
+		}
+	}
+
+	size_t schedule_mipmap_generation(const std::vector<pass_info *> &passes)
+	{
+		std::unordered_set<const texture *> outdated;
+
+		// Find the textures that are still outdated at the end of the frame first, which are the ones that were rendered to after they were last sampled
+		for (auto pass : passes)
+		{
+			for (auto texture : pass->mipmapped_textures)
+			{
+				outdated.erase(texture);
+			}
+			for (auto texture : pass->mipmapped_render_targets)
+			{
+				outdated.insert(texture);
+			}
+		}
+
+		size_t generations = 0;
+
+		for (auto pass : passes)
+		{
+			pass->generate_mipmaps.clear();
+
+			for (auto texture : pass->mipmapped_textures)
+			{
+				if (outdated.erase(texture) != 0)
+				{
+					pass->generate_mipmaps.push_back(texture);
+					generations++;
+				}
+			}
+
+			for (auto texture : pass->mipmapped_render_targets)
+			{
+				outdated.insert(texture);
+			}
+		}
+
+		return generations;
+	}
+
+	std::vector<unsigned int> stagger_updates(const std::vector<unsigned int> &intervals, const std::vector<uint64_t> &costs)
+	{
+		// The pattern of updates repeats after the least common multiple of all intervals
+		size_t period = 1;
+
+		for (const unsigned int interval : intervals)
+		{
+			period = std::lcm(period, static_cast<size_t>(std::max(interval, 1u)));
+		}
+
+		std::vector<size_t> order(intervals.size());
+		std::iota(order.begin(), order.end(), 0);
+
+		// Place the most expensive techniques first, so that the cheap ones can fill the gaps they leave
+		std::stable_sort(order.begin(), order.end(), [&costs](size_t lhs, size_t rhs) { return costs[lhs] > costs[rhs]; });
+
+		std::vector<uint64_t> load(period);
+		std::vector<unsigned int> phases(intervals.size());
+
+		for (const size_t index : order)
+		{
+			const unsigned int interval = std::max(intervals[index], 1u);
+
+			// Count every technique at least a little, so that they are still spread out before their cost was measured
+			const uint64_t cost = std::max<uint64_t>(costs[index], 1);
+
+			// Choose the phase whose busiest frame is the least busy
+			uint64_t best_load = std::numeric_limits<uint64_t>::max();
+
+			for (unsigned int phase = 0; phase < interval; phase++)
+			{
+				uint64_t max_load = 0;
+
+				for (size_t frame = phase; frame < period; frame += interval)
+				{
+					max_load = std::max(max_load, load[frame]);
+				}
+
+				if (max_load < best_load)
+				{
+					best_load = max_load;
+					phases[index] = phase;
+				}
+			}
+
+			for (size_t frame = phases[index]; frame < period; frame += interval)
+			{
+				load[frame] += cost;
+			}
+		}
+
+		return phases;
+	}
+
+	bool pass_state_filter::is_bound(pass_state kind, const pass_state_desc &state) const
+	{
+		const size_t index = static_cast<size_t>(kind);
+
+		return (_bound_mask & (1u << index)) != 0 && _bound.values[index] == state.values[index];
+	}
+	void pass_state_filter::set_bound(pass_state kind, const pass_state_desc &state)
+	{
+		const size_t index = static_cast<size_t>(kind);
+
+		// Assigning reuses the memory of the previous values, so this does not allocate once the largest pass was bound
+		_bound.values[index] = state.values[index];
+		_bound_mask |= 1u << index;
+	}
+
+	size_t scale_technique_resolution(syntax_tree &ast, const technique_declaration_node *technique, float scale, unsigned int frame_width, unsigned int frame_height, const std::vector<location> &buffer_size_references)
+	{
+		std::vector<std::pair<std::vector<std::string>, bool>> passes;
+		std::unordered_set<std::string> candidates, used_elsewhere;
+
+		for (auto node : ast.techniques)
+		{
+			for (auto pass : node->pass_list)
+			{
+				pass_info info;
+				analyze_pass(pass, info);
+
+				if (node == technique)
+				{
+					// The preprocessor replaced the macros for the back buffer dimensions with their full resolution values, so a pass using them has to keep rendering at full resolution
+					pass_info references;
+					resource_collector collector(references, &buffer_size_references);
+					collector.visit(pass->vertex_shader);
+					collector.visit(pass->pixel_shader);
+
+					candidates.insert(info.render_targets.begin(), info.render_targets.end());
+					passes.emplace_back(std::move(info.render_targets), info.writes_backbuffer || collector.found_watched_location());
+				}
+				else
+				{
+					// Other techniques expect these textures at their declared size
+					used_elsewhere.insert(info.render_targets.begin(), info.render_targets.end());
+					used_elsewhere.insert(info.sampled_textures.begin(), info.sampled_textures.end());
+				}
+			}
+		}
+
+		for (auto variable : ast.variables)
+		{
+			const auto &properties = variable->properties;
+
+			if (!variable->type.is_texture() || !variable->semantic.empty() ||
+				properties.width != frame_width || properties.height != frame_height ||
+				used_elsewhere.count(variable->unique_name) != 0)
+			{
+				candidates.erase(variable->unique_name);
+			}
+		}
+
+		// All render targets of a pass have to be the same size, so a pass keeps all of them at full resolution if any of them has to be, which in turn affects the other passes rendering to those
+		for (bool changed = true; changed;)
+		{
+			changed = false;
+
+			for (const auto &[render_targets, keep_full_resolution] : passes)
+			{
+				if (!keep_full_resolution && std::all_of(render_targets.begin(), render_targets.end(), [&candidates](const std::string &name) { return candidates.count(name) != 0; }))
+				{
+					continue;
+				}
+
+				for (const auto &name : render_targets)
+				{
+					changed |= candidates.erase(name) != 0;
+				}
+			}
+		}
+
+		size_t count = 0;
+
+		for (auto variable : ast.variables)
+		{
+			auto &properties = variable->properties;
+
+			if (!variable->type.is_texture() || candidates.count(variable->unique_name) == 0)
+			{
+				continue;
+			}
+
+			properties.width = std::max(static_cast<unsigned int>(properties.width * scale), 1u);
+			properties.height = std::max(static_cast<unsigned int>(properties.height * scale), 1u);
+
+			// The smaller texture may not have room for as many mipmap levels as requested
+			unsigned int max_levels = 1;
+
+			while ((std::max(properties.width, properties.height) >> max_levels) != 0)
+			{
+				max_levels++;
+			}
+
+			properties.levels = std::min(properties.levels, max_levels);
+
+			variable->unique_name += "_scaled";
+
+			count++;
+		}
+
+		return count;
+	}
+
+	size_t texture_size(const texture &texture)
+	{
+		size_t pixel_size = 0, block_size = 0;
+
+		switch (texture.format)
+		{
+			case texture_format::unknown:
+				// Nothing is known about the memory layout, so there is no size to compare
+				return 0;
+			case texture_format::r8:
+				pixel_size = 1;
+				break;
+			case texture_format::r16f:
+			case texture_format::rg8:
+				pixel_size = 2;
+				break;
+			case texture_format::r32f:
+			case texture_format::rg16:
+			case texture_format::rg16f:
+			case texture_format::rgba8:
+				pixel_size = 4;
+				break;
+			case texture_format::rgba16:
+			case texture_format::rgba16f:
+			case texture_format::rg32f:
+				pixel_size = 8;
+				break;
+			case texture_format::rgba32f:
+				pixel_size = 16;
+				break;
+			case texture_format::dxt1:
+			case texture_format::latc1:
+				block_size = 8;
+				break;
+			case texture_format::dxt3:
+			case texture_format::dxt5:
+			case texture_format::latc2:
+				block_size = 16;
+				break;
+		}
+
+		size_t size = 0;
+
+		for (unsigned int level = 0; level < std::max(texture.levels, 1u); level++)
+		{
+			const size_t width = std::max(texture.width >> level, 1u);
+			const size_t height = std::max(texture.height >> level, 1u);
+
+			// Block-compressed formats store blocks of 4x4 pixels, so even the smallest levels occupy a whole block
+			if (block_size != 0)
+			{
+				size += ((width + 3) / 4) * ((height + 3) / 4) * block_size;
+			}
+			else
+			{
+				size += width * height * pixel_size;
+			}
+		}
+
+		return size;
+	}
+
+	texture_allocation_plan plan_texture_aliasing(const std::vector<texture> &textures, const std::vector<technique> &techniques)
+	{
+		struct lifetime
+		{
+			size_t technique = std::numeric_limits<size_t>::max();
+			size_t first = 0, last = 0;
+			bool written = false, persistent = false;
+		};
+
+		std::unordered_map<std::string, lifetime> lifetimes;
+
+		const auto access = [&lifetimes, &techniques](const std::string &name, size_t technique, size_t position, bool write, bool clear) {
+			lifetime &lifetime = lifetimes[name];
+
+			if (lifetime.technique == std::numeric_limits<size_t>::max())
+			{
+				// The contents from the previous frame are needed unless the first pass to use the texture clears it
+				lifetime.technique = technique;
+				lifetime.first = position;
+				lifetime.persistent = !write || !clear;
+			}
+			else if (lifetime.technique != technique)
+			{
+				lifetime.persistent = true;
+			}
+
+			// Techniques that are not rendered every frame sample the contents from an earlier frame on the frames in between
+			if (techniques[technique].update_interval > 1)
+			{
+				lifetime.persistent = true;
+			}
+
+			lifetime.last = position;
+			lifetime.written |= write;
+		};
+
+		size_t position = 0;
+
+		for (size_t technique = 0; technique < techniques.size(); technique++)
+		{
+			for (const auto &pass : techniques[technique].pass_infos)
+			{
+				// A pass samples its textures before it renders to its targets
+				for (const auto &name : pass.sampled_textures)
+				{
+					access(name, technique, position, false, false);
+				}
+				for (const auto &name : pass.render_targets)
+				{
+					access(name, technique, position, true, pass.clear_render_targets);
+				}
+
+				position++;
+			}
+		}
+
+		texture_allocation_plan plan;
+		std::vector<size_t> candidates;
+
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			plan.resources.push_back(i);
+
+			if (textures[i].impl_reference != texture_reference::none)
+			{
+				continue;
+			}
+
+			plan.total_size += texture_size(textures[i]);
+
+			const auto it = lifetimes.find(textures[i].unique_name);
+
+			// Textures of unknown format are never shared, since it cannot be told whether the memory of another texture is large enough for them
+			if (it != lifetimes.end() && it->second.written && !it->second.persistent && textures[i].format != texture_format::unknown)
+			{
+				candidates.push_back(i);
+			}
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [&](size_t lhs, size_t rhs) {
+			return lifetimes[textures[lhs].unique_name].first < lifetimes[textures[rhs].unique_name].first;
+		});
+
+		// Assign each texture to the first resource with matching dimensions and format that is no longer in use when the texture is first rendered to
+		std::vector<std::pair<size_t, size_t>> resources;
+
+		for (const size_t index : candidates)
+		{
+			const texture &texture = textures[index];
+			const lifetime &lifetime = lifetimes[texture.unique_name];
+
+			const auto resource = std::find_if(resources.begin(), resources.end(), [&](const std::pair<size_t, size_t> &resource) {
+				const auto &owner = textures[resource.first];
+				return resource.second < lifetime.first && owner.width == texture.width && owner.height == texture.height && owner.levels == texture.levels && owner.format == texture.format;
+			});
+
+			if (resource != resources.end())
+			{
+				plan.resources[index] = resource->first;
+				plan.saved_size += texture_size(texture);
+
+				resource->second = lifetime.last;
+			}
+			else
+			{
+				resources.emplace_back(index, lifetime.last);
+			}
+		}
+
+		return plan;
+	}
+}
@@ -0,0 +1,218 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <vector>
+#include "runtime_objects.hpp"
+#include "source_location.hpp"
+
+namespace reshadefx
+{
+	class syntax_tree;
+}
+namespace reshadefx::nodes
+{
+	struct pass_declaration_node;
+	struct technique_declaration_node;
+}
+
+namespace reshade::render_graph
+{
+	/// <summary>
+	/// The kinds of pipeline state a pass binds, which <see cref="pass_state_filter"/> compares to what is bound already.
+	/// </summary>
+	enum class pass_state
+	{
+		shaders,
+		blend_state,
+		depth_stencil_state,
+		render_targets,
+		shader_resources,
+		viewport,
+	};
+
+	/// <summary>
+	/// The values that make up each kind of state a pass binds, like the addresses of the graphics API objects. Two passes bind the same state of a kind exactly when its values are equal, so this works the same for every graphics API.
+	/// </summary>
+	struct pass_state_desc
+	{
+		void add(pass_state state, uintptr_t value)
+		{
+			values[static_cast<size_t>(state)].push_back(value);
+		}
+
+		std::vector<uintptr_t> values[6];
+	};
+
+	/// <summary>
+	/// Which textures share a GPU resource, as decided by <see cref="plan_texture_aliasing"/>.
+	/// </summary>
+	struct texture_allocation_plan
+	{
+		/// <summary>
+		/// The index of the texture whose resource each texture uses. This is the index of the texture itself for textures that keep their own resource.
+		/// </summary>
+		std::vector<size_t> resources;
+		/// <summary>
+		/// The number of bytes all textures would occupy with a resource each.
+		/// </summary>
+		size_t total_size = 0;
+		/// <summary>
+		/// The number of bytes that are not allocated because of shared resources.
+		/// </summary>
+		size_t saved_size = 0;
+	};
+
+	/// <summary>
+	/// Collect the textures a pass renders to and samples from, by walking its shaders and all functions they call.
+	/// This only depends on the syntax tree, so it works the same for every graphics API.
+	/// </summary>
+	/// <param name="node">The pass to analyze.</param>
+	/// <param name="info">The resulting pass information.</param>
+	void analyze_pass(const reshadefx::nodes::pass_declaration_node *node, pass_info &info);
+
+	/// <summary>
+	/// Decide before which passes the back buffer copy that effects sample from has to be updated. It only has to be updated before a pass that samples the back buffer, and only if an earlier pass rendered to the back buffer since the last update.
+	/// The copy is assumed to be out of date before the first pass, since the application rendered a new frame.
+	/// </summary>
+	/// <param name="passes">All passes rendered this frame, in order. The "copy_backbuffer" field of each is updated.</param>
+	/// <returns>The number of copies that are needed.</returns>
+	size_t schedule_backbuffer_copies(const std::vector<pass_info *> &passes);
+	/// <summary>
+	/// Look up the textures with more than one mipmap level that each pass renders to and samples from, so that this does not have to be done every frame.
+	/// This has to be called again after textures were added, since it keeps pointers to them.
+	/// </summary>
+	/// <param name="textures">All textures of the loaded effects.</param>
+	/// <param name="techniques">All techniques of the loaded effects, with their pass information filled in. The "mipmapped_render_targets" and "mipmapped_textures" fields of each pass are updated.</param>
+	void resolve_mipmapped_textures(const std::vector<texture> &textures, std::vector<technique> &techniques);
+	/// <summary>
+	/// Decide before which passes the mipmaps of textures have to be generated. They only have to be generated right before the first pass that samples a texture after it was rendered to, rather than after every pass that renders to it.
+	/// Textures that are rendered to after the last pass that samples them are generated before the first pass sampling them in the next frame, assuming the same passes are rendered again.
+	/// </summary>
+	/// <param name="passes">All passes rendered this frame, in order. The "generate_mipmaps" field of each is updated.</param>
+	/// <returns>The number of mipmap chains that are generated.</returns>
+	size_t schedule_mipmap_generation(const std::vector<pass_info *> &passes);
+
+	/// <summary>
+	/// Spread the updates of techniques that are only rendered every few frames evenly over the frames, so that they do not all update on the same frame.
+	/// A technique with an interval of N updates on the frames whose number modulo N equals its phase.
+	/// </summary>
+	/// <param name="intervals">The number of frames between updates of each technique.</param>
+	/// <param name="costs">The cost of updating each technique, in any unit.</param>
+	/// <returns>The phase of each technique, which is less than its interval.</returns>
+	std::vector<unsigned int> stagger_updates(const std::vector<unsigned int> &intervals, const std::vector<uint64_t> &costs);
+
+	/// <summary>
+	/// Keeps track of the state that is bound while the passes of a technique are rendered, so that each pass only binds the kinds of state that differ from what is bound already.
+	/// It does not call into a graphics API itself. Instead it tells a device which kinds of state of the current pass to bind, which has to provide these functions:
+	/// <c>void bind(pass_state state)</c> binds a kind of state of the current pass.
+	/// <c>void unbind_resources()</c> unbinds the render targets and shader resources that were bound last.
+	/// </summary>
+	class pass_state_filter
+	{
+	public:
+		/// <summary>
+		/// Bind the state of a pass, skipping every kind of state that is bound with the same values already.
+		/// </summary>
+		/// <param name="state">The state of the pass.</param>
+		/// <param name="device">The device that binds the state of the pass.</param>
+		template <typename Device>
+		void bind(const pass_state_desc &state, Device &device)
+		{
+			for (const pass_state kind : { pass_state::shaders, pass_state::blend_state, pass_state::depth_stencil_state })
+			{
+				if (!is_bound(kind, state))
+				{
+					device.bind(kind);
+					set_bound(kind, state);
+				}
+			}
+
+			// Render targets and shader resources are rebound together, since a texture cannot be bound as both at the same time
+			if (!is_bound(pass_state::render_targets, state) || !is_bound(pass_state::shader_resources, state))
+			{
+				unbind_resources(device);
+
+				device.bind(pass_state::shader_resources);
+				device.bind(pass_state::render_targets);
+				set_bound(pass_state::shader_resources, state);
+				set_bound(pass_state::render_targets, state);
+			}
+
+			if (!is_bound(pass_state::viewport, state))
+			{
+				device.bind(pass_state::viewport);
+				set_bound(pass_state::viewport, state);
+			}
+		}
+
+		/// <summary>
+		/// Unbind the render targets and shader resources of the last pass, e.g. before a texture is written to outside of a pass. They are bound again for the next pass.
+		/// </summary>
+		/// <param name="device">The device that bound them.</param>
+		template <typename Device>
+		void unbind_resources(Device &device)
+		{
+			if (_bound_mask & resources_mask)
+			{
+				device.unbind_resources();
+				_bound_mask &= ~resources_mask;
+			}
+		}
+
+		/// <summary>
+		/// Leave no resources bound at the end of a technique and forget the bound state, since anything may be bound in between techniques.
+		/// </summary>
+		/// <param name="device">The device that bound the state.</param>
+		template <typename Device>
+		void end_technique(Device &device)
+		{
+			unbind_resources(device);
+			invalidate();
+		}
+
+		/// <summary>
+		/// Forget the bound state, so that everything is bound again for the next pass.
+		/// </summary>
+		void invalidate() { _bound_mask = 0; }
+
+	private:
+		static const uint32_t resources_mask = (1u << static_cast<uint32_t>(pass_state::render_targets)) | (1u << static_cast<uint32_t>(pass_state::shader_resources));
+
+		bool is_bound(pass_state kind, const pass_state_desc &state) const;
+		void set_bound(pass_state kind, const pass_state_desc &state);
+
+		pass_state_desc _bound;
+		uint32_t _bound_mask = 0;
+	};
+
+	/// <summary>
+	/// Make a technique run at a lower resolution, by shrinking the back buffer sized textures only it renders to. Its passes that render to these textures run at the lower resolution, while the passes rendering to the back buffer stay at full resolution and upsample the result when sampling them.
+	/// The shrunk textures get a different unique name, so that effects declaring a texture of the same name still get one at its original size.
+	/// A pass only runs at the lower resolution if all of its render targets can be shrunk and its shaders do not use the back buffer dimensions, since the preprocessor replaced those with the full resolution values already.
+	/// </summary>
+	/// <param name="ast">The syntax tree of the effect the technique is declared in. The properties of the texture declarations are updated.</param>
+	/// <param name="technique">The technique to scale.</param>
+	/// <param name="scale">The factor to multiply the texture dimensions by.</param>
+	/// <param name="frame_width">The width of the back buffer.</param>
+	/// <param name="frame_height">The height of the back buffer.</param>
+	/// <param name="buffer_size_references">The locations at which the back buffer dimension macros were expanded, as reported by the preprocessor.</param>
+	/// <returns>The number of textures that were shrunk.</returns>
+	size_t scale_technique_resolution(reshadefx::syntax_tree &ast, const reshadefx::nodes::technique_declaration_node *technique, float scale, unsigned int frame_width, unsigned int frame_height, const std::vector<reshadefx::location> &buffer_size_references);
+
+	/// <summary>
+	/// Estimate the number of bytes of video memory a texture occupies, including all of its mipmap levels. Returns zero for textures of unknown format.
+	/// </summary>
+	size_t texture_size(const texture &texture);
+	/// <summary>
+	/// Find textures with the same dimensions and format that are never needed at the same time, so that they can share one resource.
+	/// A texture qualifies if only a single technique uses it and every frame first clears and renders to it before sampling it, which means its contents only have to be kept from that first pass to the last one that samples it.
+	/// Techniques are always rendered one after another, so the resulting plan stays valid regardless of which techniques are enabled and in which order.
+	/// </summary>
+	/// <param name="textures">All textures of the loaded effects.</param>
+	/// <param name="techniques">All techniques of the loaded effects, with their pass information filled in.</param>
+	texture_allocation_plan plan_texture_aliasing(const std::vector<texture> &textures, const std::vector<technique> &techniques);
+}
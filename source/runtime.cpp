@@ -7,15 +7,18 @@
 #include "version.h"
 #include "runtime.hpp"
 #include "effect_parser.hpp"
+#include "effect_pass_fusion.hpp"
 #include "effect_preprocessor.hpp"
 #include "input.hpp"
+#include "texture_loader.hpp"
+#include "screenshot_writer.hpp"
+#include "dds_file.hpp"
+#include "render_graph.hpp"
+#include "pixel_conversion.hpp"
 #include "ini_file.hpp"
 #include <algorithm>
+#include <iterator>
 #include <unordered_set>
-#include <stb_image.h>
-#include <stb_image_dds.h>
-#include <stb_image_write.h>
-#include <stb_image_resize.h>
 #include <imgui.h>
 #include <imgui_internal.h>
 
@@ -30,6 +33,9 @@ namespace reshade
 		_imgui_context(ImGui::CreateContext()),
 		_effect_search_paths({ s_reshade_dll_path.parent_path() }),
 		_texture_search_paths({ s_reshade_dll_path.parent_path() }),
+		_texture_loader(std::make_unique<texture_loader>(4, std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 2)))),
+		_screenshot_writer(std::make_unique<screenshot_writer>(4, 1)),
+		_sequence_writer(std::make_unique<screenshot_writer>(4, 2)),
 		_preprocessor_definitions({
 			"RESHADE_DEPTH_LINEARIZATION_FAR_PLANE=1000.0",
 			"RESHADE_DEPTH_INPUT_IS_UPSIDE_DOWN=0",
@@ -45,6 +51,8 @@ namespace reshade
 		_menu_key_data[2] = true; // VK_SHIFT
 		_screenshot_key_data[0] = 0x2C; // VK_SNAPSHOT
 
+		_texture_loader->open_cache(s_reshade_dll_path.parent_path() / "ReShade-ImageCache");
+
 		_configuration_path = s_reshade_dll_path;
 		_configuration_path.replace_extension(".ini");
 		if (!filesystem::exists(_configuration_path))
@@ -132,6 +140,12 @@ namespace reshade
 	{
 		on_reset_effect();
 
+		// The staging resources are destroyed after this, so read back all outstanding captures now and wait for them to be written, even if that means waiting for the GPU and the disk
+		finish_screenshots(true);
+
+		// A sequence cannot continue across a change of the frame dimensions
+		_sequence_active = false;
+
 		if (!_is_initialized)
 		{
 			return;
@@ -155,11 +169,18 @@ namespace reshade
 		_textures.clear();
 		_uniforms.clear();
 		_techniques.clear();
+		_staggered_techniques.clear();
 		_uniform_data_storage.clear();
+		_uniform_dirty_ranges.clear();
+		_uniform_sources.clear();
+
+		_texture_loader->cancel();
 
 		_texture_count = 0;
 		_uniform_count = 0;
 		_technique_count = 0;
+		_texture_memory_total = 0;
+		_texture_memory_saved = 0;
 	}
 	void runtime::on_present()
 	{
@@ -174,14 +195,37 @@ namespace reshade
 		// Advance various statistics
 		g_network_traffic = 0;
 		_framecount++;
+		_last_uniform_bytes_uploaded = _uniform_bytes_uploaded;
+		_uniform_bytes_uploaded = 0;
 		_last_frame_duration = std::chrono::high_resolution_clock::now() - _last_present_time;
 		_last_present_time += _last_frame_duration;
 
+		// Read back frames captured a few frames ago and pass them on to be written in the background, which also frees up their staging resources for new captures
+		finish_screenshots(false);
+
 		// Create and save screenshot if associated shortcut is down
 		if (!_screenshot_key_setting_active &&
 			_input->is_key_pressed(_screenshot_key_data[0], _screenshot_key_data[1] != 0, _screenshot_key_data[2] != 0, false))
 		{
-			save_screenshot();
+			if (!_screenshot_sequence)
+			{
+				save_screenshot();
+			}
+			else if (!_sequence_active)
+			{
+				start_sequence();
+			}
+			else
+			{
+				LOG(INFO) << "Stopped frame sequence capture after " << _sequence_index << " frames.";
+
+				_sequence_active = false;
+			}
+		}
+
+		if (_sequence_active)
+		{
+			update_sequence();
 		}
 
 		// Draw overlay
@@ -200,6 +244,10 @@ namespace reshade
 
 			if (_reload_remaining_effects == 0)
 			{
+				alias_textures();
+
+				render_graph::resolve_mipmapped_textures(_textures, _techniques);
+
 				load_textures();
 
 				load_current_preset();
@@ -211,8 +259,46 @@ namespace reshade
 			}
 		}
 
+		// Upload textures that finished loading in the background, but only for a limited amount of time per frame to avoid stalls
+		_texture_loader->process(std::chrono::milliseconds(2), [this](const texture_loader::image &image) {
+			if (image.source.texture_index >= _textures.size())
+			{
+				return;
+			}
+
+			auto &texture = _textures[image.source.texture_index];
+
+			if (texture.unique_name != image.source.texture_name)
+			{
+				return;
+			}
+
+			if (!image.found)
+			{
+				LOG(ERROR) << "> Source " << image.path << " for texture '" << texture.name << "' could not be found.";
+			}
+			else if (!image.success || !update_texture(texture, image.data()))
+			{
+				LOG(ERROR) << "> Source " << image.path << " for texture '" << texture.name << "' could not be loaded! Make sure it is of a compatible file format.";
+			}
+		});
+
 		_drawcalls = _vertices = 0;
 	}
+
+	static uint64_t average_gpu_duration_per_frame(const technique &technique)
+	{
+		const unsigned int interval = technique.update_interval * technique.budget_interval;
+
+		if (interval <= 1)
+		{
+			return technique.average_gpu_duration;
+		}
+
+		// A technique that is updated every n-th frame only runs the passes rendering to the back buffer in the n-1 frames in between
+		return (technique.average_gpu_duration + (interval - 1) * technique.average_gpu_duration_between_updates) / interval;
+	}
+
 	void runtime::on_present_effect()
 	{
 		if (!_toggle_key_setting_active && _input->is_key_pressed(_effects_key_data[0], _effects_key_data[1] != 0, _effects_key_data[2] != 0, _effects_key_data[3] != 0))
@@ -226,205 +312,178 @@ namespace reshade
 		}
 
 		// Update all uniform variables
-		for (auto &variable : _uniforms)
-		{
-			const auto it = variable.annotations.find("source");
-
-			if (it == variable.annotations.end())
-			{
-				continue;
-			}
+		const float frametime = _last_frame_duration.count() * 1e-6f;
+		const unsigned long long timer = std::chrono::duration_cast<std::chrono::nanoseconds>(_last_present_time - _start_time).count();
 
-			const auto source = it->second.as<std::string>();
+		for (const auto &binding : _uniform_sources)
+		{
+			auto &variable = _uniforms[binding.uniform_index];
 
-			if (source == "frametime")
-			{
-				const float value = _last_frame_duration.count() * 1e-6f;
-				set_uniform_value(variable, &value, 1);
-			}
-			else if (source == "framecount")
+			switch (binding.source)
 			{
-				switch (variable.basetype)
+				case uniform_source::frametime:
 				{
-					case uniform_datatype::boolean:
-					{
-						const bool even = (_framecount % 2) == 0;
-						set_uniform_value(variable, &even, 1);
-						break;
-					}
-					case uniform_datatype::signed_integer:
-					case uniform_datatype::unsigned_integer:
-					{
-						const unsigned int framecount = static_cast<unsigned int>(_framecount % UINT_MAX);
-						set_uniform_value(variable, &framecount, 1);
-						break;
-					}
-					case uniform_datatype::floating_point:
-					{
-						const float framecount = static_cast<float>(_framecount % 16777216);
-						set_uniform_value(variable, &framecount, 1);
-						break;
-					}
-				}
-			}
-			else if (source == "pingpong")
-			{
-				float value[2] = { 0, 0 };
-				get_uniform_value(variable, value, 2);
-
-				const float min = variable.annotations["min"].as<float>(), max = variable.annotations["max"].as<float>();
-				const float step_min = variable.annotations["step"].as<float>(0), step_max = variable.annotations["step"].as<float>(1);
-				float increment = step_max == 0 ? step_min : (step_min + std::fmodf(static_cast<float>(std::rand()), step_max - step_min + 1));
-				const float smoothing = variable.annotations["smoothing"].as<float>();
-
-				if (value[1] >= 0)
-				{
-					increment = std::max(increment - std::max(0.0f, smoothing - (max - value[0])), 0.05f);
-					increment *= _last_frame_duration.count() * 1e-9f;
-
-					if ((value[0] += increment) >= max)
-					{
-						value[0] = max;
-						value[1] = -1;
-					}
+					set_uniform_value(variable, &frametime, 1);
+					break;
 				}
-				else
+				case uniform_source::framecount:
 				{
-					increment = std::max(increment - std::max(0.0f, smoothing - (value[0] - min)), 0.05f);
-					increment *= _last_frame_duration.count() * 1e-9f;
-
-					if ((value[0] -= increment) <= min)
+					switch (variable.basetype)
 					{
-						value[0] = min;
-						value[1] = +1;
+						case uniform_datatype::boolean:
+						{
+							const bool even = (_framecount % 2) == 0;
+							set_uniform_value(variable, &even, 1);
+							break;
+						}
+						case uniform_datatype::signed_integer:
+						case uniform_datatype::unsigned_integer:
+						{
+							const unsigned int framecount = static_cast<unsigned int>(_framecount % UINT_MAX);
+							set_uniform_value(variable, &framecount, 1);
+							break;
+						}
+						case uniform_datatype::floating_point:
+						{
+							const float framecount = static_cast<float>(_framecount % 16777216);
+							set_uniform_value(variable, &framecount, 1);
+							break;
+						}
 					}
+					break;
 				}
-
-				set_uniform_value(variable, value, 2);
-			}
-			else if (source == "date")
-			{
-				set_uniform_value(variable, _date, 4);
-			}
-			else if (source == "timer")
-			{
-				const unsigned long long timer = std::chrono::duration_cast<std::chrono::nanoseconds>(_last_present_time - _start_time).count();
-
-				switch (variable.basetype)
+				case uniform_source::pingpong:
 				{
-					case uniform_datatype::boolean:
-					{
-						const bool even = (timer % 2) == 0;
-						set_uniform_value(variable, &even, 1);
-						break;
-					}
-					case uniform_datatype::signed_integer:
-					case uniform_datatype::unsigned_integer:
-					{
-						const unsigned int timer_int = static_cast<unsigned int>(timer % UINT_MAX);
-						set_uniform_value(variable, &timer_int, 1);
-						break;
-					}
-					case uniform_datatype::floating_point:
-					{
-						const float timer_float = std::fmod(static_cast<float>(timer * 1e-6f), 16777216.0f);
-						set_uniform_value(variable, &timer_float, 1);
-						break;
-					}
-				}
-			}
-			else if (source == "key")
-			{
-				const int key = variable.annotations["keycode"].as<int>();
+					float value[2] = { 0, 0 };
+					get_uniform_value(variable, value, 2);
 
-				if (key > 7 && key < 256)
-				{
-					const std::string mode = variable.annotations["mode"].as<std::string>();
+					float increment = binding.step_max == 0 ? binding.step_min : (binding.step_min + std::fmodf(static_cast<float>(std::rand()), binding.step_max - binding.step_min + 1));
 
-					if (mode == "toggle" || variable.annotations["toggle"].as<bool>())
+					if (value[1] >= 0)
 					{
-						bool current = false;
-						get_uniform_value(variable, &current, 1);
+						increment = std::max(increment - std::max(0.0f, binding.smoothing - (binding.max - value[0])), 0.05f);
+						increment *= _last_frame_duration.count() * 1e-9f;
 
-						if (_input->is_key_pressed(key))
+						if ((value[0] += increment) >= binding.max)
 						{
-							current = !current;
-
-							set_uniform_value(variable, &current, 1);
+							value[0] = binding.max;
+							value[1] = -1;
 						}
 					}
-					else if (mode == "press")
+					else
 					{
-						const bool state = _input->is_key_pressed(key);
+						increment = std::max(increment - std::max(0.0f, binding.smoothing - (value[0] - binding.min)), 0.05f);
+						increment *= _last_frame_duration.count() * 1e-9f;
 
-						set_uniform_value(variable, &state, 1);
+						if ((value[0] -= increment) <= binding.min)
+						{
+							value[0] = binding.min;
+							value[1] = +1;
+						}
 					}
-					else
-					{
-						const bool state = _input->is_key_down(key);
 
-						set_uniform_value(variable, &state, 1);
+					set_uniform_value(variable, value, 2);
+					break;
+				}
+				case uniform_source::date:
+				{
+					set_uniform_value(variable, _date, 4);
+					break;
+				}
+				case uniform_source::timer:
+				{
+					switch (variable.basetype)
+					{
+						case uniform_datatype::boolean:
+						{
+							const bool even = (timer % 2) == 0;
+							set_uniform_value(variable, &even, 1);
+							break;
+						}
+						case uniform_datatype::signed_integer:
+						case uniform_datatype::unsigned_integer:
+						{
+							const unsigned int timer_int = static_cast<unsigned int>(timer % UINT_MAX);
+							set_uniform_value(variable, &timer_int, 1);
+							break;
+						}
+						case uniform_datatype::floating_point:
+						{
+							const float timer_float = std::fmod(static_cast<float>(timer * 1e-6f), 16777216.0f);
+							set_uniform_value(variable, &timer_float, 1);
+							break;
+						}
 					}
+					break;
 				}
-			}
-			else if (source == "mousepoint")
-			{
-				const float values[2] = { static_cast<float>(_input->mouse_position_x()), static_cast<float>(_input->mouse_position_y()) };
-
-				set_uniform_value(variable, values, 2);
-			}
-			else if (source == "mousedelta")
-			{
-				const float values[2] = { static_cast<float>(_input->mouse_movement_delta_x()), static_cast<float>(_input->mouse_movement_delta_y()) };
-
-				set_uniform_value(variable, values, 2);
-			}
-			else if (source == "mousebutton")
-			{
-				const int index = variable.annotations["keycode"].as<int>();
-
-				if (index >= 0 && index < 5)
+				case uniform_source::key:
+				case uniform_source::mousebutton:
 				{
-					const std::string mode = variable.annotations["mode"].as<std::string>();
+					const bool is_key = binding.source == uniform_source::key;
 
-					if (mode == "toggle" || variable.annotations["toggle"].as<bool>())
+					if (binding.mode == uniform_source_mode::toggle)
 					{
 						bool current = false;
 						get_uniform_value(variable, &current, 1);
 
-						if (_input->is_mouse_button_pressed(index))
+						if (is_key ? _input->is_key_pressed(binding.keycode) : _input->is_mouse_button_pressed(binding.keycode))
 						{
 							current = !current;
 
 							set_uniform_value(variable, &current, 1);
 						}
 					}
-					else if (mode == "press")
+					else if (binding.mode == uniform_source_mode::press)
 					{
-						const bool state = _input->is_mouse_button_pressed(index);
+						const bool state = is_key ? _input->is_key_pressed(binding.keycode) : _input->is_mouse_button_pressed(binding.keycode);
 
 						set_uniform_value(variable, &state, 1);
 					}
 					else
 					{
-						const bool state = _input->is_mouse_button_down(index);
+						const bool state = is_key ? _input->is_key_down(binding.keycode) : _input->is_mouse_button_down(binding.keycode);
 
 						set_uniform_value(variable, &state, 1);
 					}
+					break;
 				}
-			}
-			else if (source == "random")
-			{
-				const int min = variable.annotations["min"].as<int>(), max = variable.annotations["max"].as<int>();
-				const int value = min + (std::rand() % (max - min + 1));
+				case uniform_source::mousepoint:
+				{
+					const float values[2] = { static_cast<float>(_input->mouse_position_x()), static_cast<float>(_input->mouse_position_y()) };
+
+					set_uniform_value(variable, values, 2);
+					break;
+				}
+				case uniform_source::mousedelta:
+				{
+					const float values[2] = { static_cast<float>(_input->mouse_movement_delta_x()), static_cast<float>(_input->mouse_movement_delta_y()) };
 
-				set_uniform_value(variable, &value, 1);
+					set_uniform_value(variable, values, 2);
+					break;
+				}
+				case uniform_source::random:
+				{
+					const int value = binding.min_int + (std::rand() % (binding.max_int - binding.min_int + 1));
+
+					set_uniform_value(variable, &value, 1);
+					break;
+				}
 			}
 		}
 
-		// Render all enabled techniques
+		std::vector<technique *> enabled_techniques, fused_techniques;
+		std::vector<pass_info *> enabled_passes;
+
+		// Update the enabled state of all techniques first, so that the whole frame can be planned before rendering any of it
 		for (auto &technique : _techniques)
 		{
+			// Techniques generated by fusing passes are never enabled themselves, only rendered in place of the techniques they were made from
+			if (!technique.fused_techniques.empty())
+			{
+				fused_techniques.push_back(&technique);
+				continue;
+			}
+
 			if (technique.timeleft > 0)
 			{
 				technique.timeleft -= static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::milliseconds>(_last_frame_duration).count());
@@ -435,6 +494,7 @@ namespace reshade
 					technique.timeleft = 0;
 					technique.average_cpu_duration.clear();
 					technique.average_gpu_duration.clear();
+					technique.average_gpu_duration_between_updates.clear();
 				}
 			}
 			else if (!_toggle_key_setting_active &&
@@ -449,16 +509,213 @@ namespace reshade
 			{
 				technique.average_cpu_duration.clear();
 				technique.average_gpu_duration.clear();
+				technique.average_gpu_duration_between_updates.clear();
+				technique.skipped_by_budget = false;
+				technique.budget_interval = 1;
+
+				for (auto &pass : technique.pass_infos)
+				{
+					pass.average_cpu_duration.clear();
+					pass.average_gpu_duration.clear();
+				}
+
 				continue;
 			}
 
+			enabled_techniques.push_back(&technique);
+		}
+
+		update_budget(enabled_techniques);
+
+		// Spread the updates of techniques that are not rendered every frame again whenever a different set of them is enabled
+		std::vector<technique *> interval_techniques;
+		std::copy_if(enabled_techniques.begin(), enabled_techniques.end(), std::back_inserter(interval_techniques), [](const technique *technique) { return technique->update_interval * technique->budget_interval > 1; });
+
+		// All of them are updated on the frame the set changes, so that techniques that were just enabled do not sample textures they never rendered to
+		const bool update_all = interval_techniques != _staggered_techniques;
+
+		if (update_all)
+		{
+			std::vector<uint64_t> costs;
+			std::vector<unsigned int> intervals;
+
+			for (const technique *technique : interval_techniques)
+			{
+				costs.push_back(technique->average_gpu_duration);
+				intervals.push_back(technique->update_interval * technique->budget_interval);
+			}
+
+			const std::vector<unsigned int> phases = render_graph::stagger_updates(intervals, costs);
+
+			for (size_t i = 0; i < interval_techniques.size(); i++)
+			{
+				interval_techniques[i]->update_phase = phases[i];
+			}
+
+			_staggered_techniques = std::move(interval_techniques);
+		}
+
+		// Render a fused technique instead of the techniques it was made from when those are enabled one after another in the same order
+		std::vector<std::pair<technique *, size_t>> render_list;
+
+		for (size_t i = 0; i < enabled_techniques.size(); i += render_list.back().second)
+		{
+			const auto fused = std::find_if(fused_techniques.begin(), fused_techniques.end(),
+				[&enabled_techniques, i](const technique *candidate) {
+				return candidate->fused_techniques.size() <= enabled_techniques.size() - i &&
+					std::equal(candidate->fused_techniques.begin(), candidate->fused_techniques.end(), enabled_techniques.begin() + i,
+						[candidate](const std::string &name, const technique *technique) { return technique->name == name && technique->effect_filename == candidate->effect_filename; });
+			});
+
+			if (fused != fused_techniques.end())
+			{
+				render_list.emplace_back(*fused, (*fused)->fused_techniques.size());
+			}
+			else
+			{
+				render_list.emplace_back(enabled_techniques[i], 1);
+			}
+
+			// Between updates only the passes that render to the back buffer run, which sample what the other passes rendered on the last update
+			const auto technique = render_list.back().first;
+			const unsigned int interval = technique->update_interval * technique->budget_interval;
+			const bool update = update_all || interval <= 1 || _framecount % interval == technique->update_phase;
+
+			// Remember which passes ran in this frame, so that its GPU timings can be told apart when they arrive
+			rendered_frame &record = technique->rendered_frames[_framecount % technique->rendered_frames.size()];
+			record.frame = _framecount;
+			record.skipped_passes.resize(technique->pass_infos.size());
+
+			for (size_t pass_index = 0; pass_index < technique->pass_infos.size(); pass_index++)
+			{
+				pass_info &pass = technique->pass_infos[pass_index];
+				pass.skipped = !update && !pass.writes_backbuffer;
+				record.skipped_passes[pass_index] = pass.skipped;
+
+				if (!pass.skipped)
+				{
+					enabled_passes.push_back(&pass);
+				}
+			}
+		}
+
+		// Skip copying the back buffer before passes that do not sample it or when no pass rendered to it since the last copy
+		_backbuffer_copies = render_graph::schedule_backbuffer_copies(enabled_passes);
+		// Only generate mipmaps of render targets right before a pass samples them, instead of after every pass that renders to them
+		_mipmap_generations = render_graph::schedule_mipmap_generation(enabled_passes);
+		_planned_pass_count = enabled_passes.size();
+
+		// Render all enabled techniques
+		for (size_t i = 0, k = 0; i < render_list.size(); k += render_list[i++].second)
+		{
+			const auto technique = render_list[i].first;
 			const auto time_technique_started = std::chrono::high_resolution_clock::now();
 
-			render_technique(technique);
+			render_technique(*technique);
 
 			const auto time_technique_finished = std::chrono::high_resolution_clock::now();
 
-			technique.average_cpu_duration.append(std::chrono::duration_cast<std::chrono::nanoseconds>(time_technique_finished - time_technique_started).count());
+			const uint64_t duration = std::chrono::duration_cast<std::chrono::nanoseconds>(time_technique_finished - time_technique_started).count();
+
+			technique->average_cpu_duration.append(duration);
+
+			// Split the time of a fused technique evenly between the techniques it replaced, so that the statistics and the frame budget still see all of them
+			// Its GPU time only arrives a few frames later, so there is nothing to split until the first queries finished
+			for (size_t member = 0, count = render_list[i].second; count > 1 && member < count; member++)
+			{
+				enabled_techniques[k + member]->average_cpu_duration.append(duration / count);
+
+				if (technique->average_gpu_duration != 0)
+				{
+					enabled_techniques[k + member]->average_gpu_duration.append(technique->average_gpu_duration / count);
+				}
+			}
+		}
+	}
+
+	void runtime::update_budget(std::vector<technique *> &enabled_techniques)
+	{
+		if (_effect_budget <= 0.0f)
+		{
+			for (technique *technique : enabled_techniques)
+			{
+				if (technique->budget_interval != 1)
+				{
+					// The phases were chosen for the longer interval
+					_staggered_techniques.clear();
+				}
+
+				technique->skipped_by_budget = false;
+				technique->budget_interval = 1;
+			}
+
+			return;
+		}
+
+		// Techniques in the priority list are the most important in the order listed, all others follow in the order they are rendered
+		std::vector<technique *> techniques_by_priority = enabled_techniques;
+
+		std::stable_sort(techniques_by_priority.begin(), techniques_by_priority.end(), [this](const technique *lhs, const technique *rhs) {
+			return std::find(_budget_priority.begin(), _budget_priority.end(), lhs->name) < std::find(_budget_priority.begin(), _budget_priority.end(), rhs->name);
+		});
+
+		std::vector<frame_budget::item> items(techniques_by_priority.size());
+		std::vector<frame_budget::item *> item_pointers;
+
+		for (size_t i = 0; i < techniques_by_priority.size(); i++)
+		{
+			// Skipped techniques are not measured, so their cost stays at what it was when they were last rendered
+			items[i].cost = average_gpu_duration_per_frame(*techniques_by_priority[i]);
+			items[i].skipped = techniques_by_priority[i]->skipped_by_budget;
+			items[i].interval = techniques_by_priority[i]->budget_interval;
+			// The interval set in the preset and the one of the budget multiply, which should not exceed the longest one the preset can set
+			items[i].max_interval = std::max(techniques_by_priority[i]->max_budget_interval / techniques_by_priority[i]->update_interval, 1u);
+			item_pointers.push_back(&items[i]);
+		}
+
+		if (_frame_budget.update(static_cast<uint64_t>(_effect_budget * 1e6f), item_pointers))
+		{
+			for (size_t i = 0; i < techniques_by_priority.size(); i++)
+			{
+				techniques_by_priority[i]->skipped_by_budget = items[i].skipped;
+				techniques_by_priority[i]->budget_interval = items[i].interval;
+			}
+
+			// Choose the phases again for the changed intervals, which also updates all techniques once, so that none samples a texture it has not rendered to in a while
+			_staggered_techniques.clear();
+		}
+
+		enabled_techniques.erase(std::remove_if(enabled_techniques.begin(), enabled_techniques.end(), [](const technique *technique) { return technique->skipped_by_budget; }), enabled_techniques.end());
+	}
+
+	void runtime::record_gpu_timings(technique &technique, uint64_t frame, uint64_t duration, const std::vector<uint64_t> &pass_durations)
+	{
+		const rendered_frame &record = technique.rendered_frames[frame % technique.rendered_frames.size()];
+
+		// The record was overwritten if the GPU is that many frames behind, in which case it is no longer known which passes ran
+		if (record.frame != frame)
+		{
+			return;
+		}
+
+		const bool update = std::find(record.skipped_passes.begin(), record.skipped_passes.end(), true) == record.skipped_passes.end();
+
+		if (update)
+		{
+			technique.average_gpu_duration.append(duration);
+		}
+		else
+		{
+			technique.average_gpu_duration_between_updates.append(duration);
+		}
+
+		// Skipped passes took no time in that frame, which would only drag down their average
+		for (size_t pass_index = 0; pass_index < pass_durations.size() && pass_index < record.skipped_passes.size(); pass_index++)
+		{
+			if (!record.skipped_passes[pass_index])
+			{
+				technique.pass_infos[pass_index].average_gpu_duration.append(pass_durations[pass_index]);
+			}
 		}
 	}
 
@@ -515,6 +772,36 @@ namespace reshade
 
 		_reload_remaining_effects = _effect_files.size();
 	}
+
+	static float get_resolution_scale(const ini_file &preset, const std::string &technique_name, const std::unordered_map<std::string, annotation> &annotations)
+	{
+		float scale = 1.0f;
+
+		if (const auto it = annotations.find("scale"); it != annotations.end())
+		{
+			scale = it->second.as<float>();
+		}
+
+		// The preset overrides the annotation, so users can trade quality for speed without editing the effect
+		preset.get("", "Scale" + technique_name, scale);
+
+		return std::min(std::max(scale, 0.25f), 1.0f);
+	}
+
+	static unsigned int get_update_interval(const ini_file &preset, const std::string &technique_name, const std::unordered_map<std::string, annotation> &annotations)
+	{
+		unsigned int interval = 1;
+
+		if (const auto it = annotations.find("interval"); it != annotations.end())
+		{
+			interval = it->second.as<unsigned int>();
+		}
+
+		preset.get("", "Interval" + technique_name, interval);
+
+		return std::min(std::max(interval, 1u), 8u);
+	}
+
 	void runtime::load_effect(const filesystem::path &path)
 	{
 		LOG(INFO) << "Compiling " << path << " ...";
@@ -616,9 +903,61 @@ namespace reshade
 			}
 		}
 
+		// Shrink the back buffer sized textures of techniques that ask for a lower resolution, which has to happen before passes are fused, so that fused techniques see the final texture sizes
+		std::vector<float> resolution_scales;
+		std::vector<unsigned int> update_intervals;
+		std::vector<reshadefx::location> buffer_size_references;
+		size_t scaled_texture_count = 0;
+
+		for (const char *const name : { "BUFFER_WIDTH", "BUFFER_HEIGHT", "BUFFER_RCP_WIDTH", "BUFFER_RCP_HEIGHT" })
+		{
+			if (const auto it = pp.current_macro_usages().find(name); it != pp.current_macro_usages().end())
+			{
+				buffer_size_references.insert(buffer_size_references.end(), it->second.begin(), it->second.end());
+			}
+		}
+
+		{ const ini_file preset(_current_preset >= 0 ? _preset_files[_current_preset] : filesystem::path());
+			for (auto technique : ast.techniques)
+			{
+				const float scale = get_resolution_scale(preset, technique->name, technique->annotation_list);
+
+				if (scale < 1.0f)
+				{
+					scaled_texture_count += render_graph::scale_technique_resolution(ast, technique, scale, _width, _height, buffer_size_references);
+				}
+
+				resolution_scales.push_back(scale);
+				update_intervals.push_back(get_update_interval(preset, technique->name, technique->annotation_list));
+			}
+		}
+
+		reshadefx::pass_fusion_result fusion;
+
+		if (_fuse_passes)
+		{
+			fusion = reshadefx::fuse_pixel_local_passes(ast, !_is_backbuffer_float);
+		}
+
 		std::string errors = parser.errors();
+		bool success = load_effect(ast, errors);
+
+		if (!success && (fusion.removed_pass_count != 0 || !fusion.fused_techniques.empty()))
+		{
+			// The fused pixel shaders may exceed limits of the shader model that the original ones did not, so try again without them
+			LOG(WARNING) << "Failed to compile fused passes in " << path << ", compiling them separately instead:\n" << errors;
+			_textures.erase(_textures.begin() + _texture_count, _textures.end());
+			_uniforms.erase(_uniforms.begin() + _uniform_count, _uniforms.end());
+			_techniques.erase(_techniques.begin() + _technique_count, _techniques.end());
+
+			reshadefx::revert_pass_fusion(ast, fusion);
+			fusion = reshadefx::pass_fusion_result();
 
-		if (!load_effect(ast, errors))
+			errors = parser.errors();
+			success = load_effect(ast, errors);
+		}
+
+		if (!success)
 		{
 			LOG(ERROR) << "Failed to compile " << path << ":\n" << errors;
 			_textures.erase(_textures.begin() + _texture_count, _textures.end());
@@ -635,36 +974,105 @@ namespace reshade
 			LOG(WARNING) << "> Successfully compiled with warnings:\n" << errors;
 		}
 
+		if (fusion.removed_pass_count != 0 || !fusion.fused_techniques.empty())
+		{
+			LOG(INFO) << "> Fused " << fusion.removed_pass_count << " passes within techniques and " << fusion.fused_techniques.size() << " runs of single-pass techniques.";
+		}
+
+		if (scaled_texture_count != 0)
+		{
+			LOG(INFO) << "> Reduced the resolution of " << scaled_texture_count << " textures.";
+		}
+
 		for (size_t i = _uniform_count, max = _uniform_count = _uniforms.size(); i < max; i++)
 		{
 			auto &variable = _uniforms[i];
 			variable.effect_filename = path.filename().string();
-			variable.hidden = variable.annotations["hidden"].as<bool>();
+			variable.hidden = find_annotation(variable.annotations, "hidden").as<bool>();
+
+			const auto ui_label = variable.annotations.find("ui_label");
+			variable.ui_type = find_annotation(variable.annotations, "ui_type").as<std::string>();
+			variable.ui_label = ui_label != variable.annotations.end() ? ui_label->second.as<std::string>() : variable.name;
+			variable.ui_tooltip = find_annotation(variable.annotations, "ui_tooltip").as<std::string>();
+			variable.ui_category = find_annotation(variable.annotations, "ui_category").as<std::string>();
+			variable.ui_items = find_annotation(variable.annotations, "ui_items").as<std::string>();
+			variable.ui_min_int = find_annotation(variable.annotations, "ui_min").as<int>();
+			variable.ui_max_int = find_annotation(variable.annotations, "ui_max").as<int>();
+			variable.ui_min = find_annotation(variable.annotations, "ui_min").as<float>();
+			variable.ui_max = find_annotation(variable.annotations, "ui_max").as<float>();
+			variable.ui_step = find_annotation(variable.annotations, "ui_step").as<float>();
+
+			// Make sure list is terminated with a zero in case user forgot so no invalid memory is read accidentally
+			if (!variable.ui_items.empty() && variable.ui_items.back() != '\0')
+			{
+				variable.ui_items.push_back('\0');
+			}
+
+			// Resolve the source annotation once here, so that updating the value every frame does not have to look up and parse any annotations
+			uniform_source_binding binding;
+			binding.uniform_index = i;
+
+			if (!resolve_uniform_source(variable.annotations, binding))
+			{
+				continue;
+			}
+
+			_uniform_sources.push_back(std::move(binding));
 		}
 		for (size_t i = _texture_count, max = _texture_count = _textures.size(); i < max; i++)
 		{
 			auto &texture = _textures[i];
 			texture.effect_filename = path.filename().string();
 		}
+		const size_t first_technique = _technique_count;
+
 		for (size_t i = _technique_count, max = _technique_count = _techniques.size(); i < max; i++)
 		{
 			auto &technique = _techniques[i];
 			technique.effect_filename = path.filename().string();
-			technique.enabled = technique.annotations["enabled"].as<bool>();
-			technique.hidden = technique.annotations["hidden"].as<bool>();
-			technique.timeleft = technique.timeout = technique.annotations["timeout"].as<int>();
-			technique.toggle_key_data[0] = technique.annotations["toggle"].as<unsigned int>();
-			technique.toggle_key_data[1] = technique.annotations["togglectrl"].as<bool>() ? 1 : 0;
-			technique.toggle_key_data[2] = technique.annotations["toggleshift"].as<bool>() ? 1 : 0;
-			technique.toggle_key_data[3] = technique.annotations["togglealt"].as<bool>() ? 1 : 0;
+
+			// The effect compilers add techniques and their passes in the order they appear in the syntax tree
+			const auto technique_node = ast.techniques[i - first_technique];
+			const auto &pass_list = technique_node->pass_list;
+			technique.pass_infos.resize(pass_list.size());
+
+			if (i - first_technique < resolution_scales.size())
+			{
+				technique.resolution_scale = resolution_scales[i - first_technique];
+				technique.update_interval = update_intervals[i - first_technique];
+			}
+
+			if (const auto it = fusion.fused_techniques.find(technique_node); it != fusion.fused_techniques.end())
+			{
+				technique.fused_techniques = it->second;
+			}
+
+			for (size_t k = 0; k < pass_list.size(); k++)
+			{
+				technique.pass_infos[k].name = pass_list[k]->name;
+
+				render_graph::analyze_pass(pass_list[k], technique.pass_infos[k]);
+			}
+
+			technique.enabled = find_annotation(technique.annotations, "enabled").as<bool>();
+			technique.hidden = find_annotation(technique.annotations, "hidden").as<bool>();
+			technique.timeleft = technique.timeout = find_annotation(technique.annotations, "timeout").as<int>();
+			technique.toggle_key_data[0] = find_annotation(technique.annotations, "toggle").as<unsigned int>();
+			technique.toggle_key_data[1] = find_annotation(technique.annotations, "togglectrl").as<bool>() ? 1 : 0;
+			technique.toggle_key_data[2] = find_annotation(technique.annotations, "toggleshift").as<bool>() ? 1 : 0;
+			technique.toggle_key_data[3] = find_annotation(technique.annotations, "togglealt").as<bool>() ? 1 : 0;
 		}
 	}
 	void runtime::load_textures()
 	{
 		LOG(INFO) << "Loading image files for textures ...";
 
-		for (auto &texture : _textures)
+		std::vector<uint8_t> placeholder;
+
+		for (size_t i = 0; i < _textures.size(); i++)
 		{
+			auto &texture = _textures[i];
+
 			if (texture.impl_reference != texture_reference::none)
 			{
 				continue;
@@ -677,57 +1085,71 @@ namespace reshade
 				continue;
 			}
 
-			const filesystem::path path = filesystem::resolve(it->second.as<std::string>(), _texture_search_paths);
+			// Fill texture with transparent black until the image file was loaded, so effects never sample undefined contents (all-zero blocks decode to black as well)
+			placeholder.resize(dds::is_block_compressed(texture.format) ? dds::mip_chain_size(texture.format, texture.width, texture.height, texture.levels) : texture.width * texture.height * 4);
+			update_texture(texture, placeholder.data());
+
+			// Finding, decoding and resizing the image file is done on a background thread, the result is uploaded in 'on_present'
+			texture_loader::request request;
+			request.texture_index = i;
+			request.texture_name = texture.unique_name;
+			request.source = it->second.as<std::string>();
+			request.search_paths = _texture_search_paths;
+			request.width = texture.width;
+			request.height = texture.height;
+			request.levels = texture.levels;
+			request.format = static_cast<unsigned int>(texture.format);
+
+			_texture_loader->enqueue(std::move(request));
+		}
+	}
+
+	void runtime::alias_textures()
+	{
+		const render_graph::texture_allocation_plan plan = render_graph::plan_texture_aliasing(_textures, _techniques);
 
-			if (!filesystem::exists(path))
+		_texture_memory_total = plan.total_size;
+		_texture_memory_saved = 0;
+
+		size_t aliased_count = 0;
+		std::unordered_set<std::string> aliased_textures;
+
+		for (size_t i = 0; i < _textures.size(); i++)
+		{
+			if (plan.resources[i] == i)
 			{
-				LOG(ERROR) << "> Source " << path << " for texture '" << texture.name << "' could not be found.";
 				continue;
 			}
 
-			FILE *file;
-			unsigned char *filedata = nullptr;
-			int width = 0, height = 0, channels = 0;
-			bool success = false;
+			aliased_textures.insert(_textures[i].unique_name);
+			aliased_textures.insert(_textures[plan.resources[i]].unique_name);
 
-			if (_wfopen_s(&file, path.wstring().c_str(), L"rb") == 0)
+			if (!alias_texture(_textures[i], _textures[plan.resources[i]]))
 			{
-				if (stbi_dds_test_file(file))
-				{
-					filedata = stbi_dds_load_from_file(file, &width, &height, &channels, STBI_rgb_alpha);
-				}
-				else
-				{
-					filedata = stbi_load_from_file(file, &width, &height, &channels, STBI_rgb_alpha);
-				}
-
-				fclose(file);
+				LOG(WARNING) << "Failed to share resource of texture '" << _textures[i].unique_name << "' with texture '" << _textures[plan.resources[i]].unique_name << "'.";
+				continue;
 			}
 
-			if (filedata != nullptr)
-			{
-				if (texture.width != static_cast<unsigned int>(width) ||
-					texture.height != static_cast<unsigned int>(height))
-				{
-					LOG(INFO) << "> Resizing image data for texture '" << texture.name << "' from " << width << "x" << height << " to " << texture.width << "x" << texture.height << " ...";
+			// Only count what was actually released, in case some textures could not be aliased
+			_texture_memory_saved += render_graph::texture_size(_textures[i]);
+			aliased_count++;
+		}
 
-					std::vector<uint8_t> resized(texture.width * texture.height * 4);
-					stbir_resize_uint8(filedata, width, height, 0, resized.data(), texture.width, texture.height, 0, 4);
-					success = update_texture(texture, resized.data());
-				}
-				else
-				{
-					success = update_texture(texture, filedata);
-				}
+		if (aliased_count != 0)
+		{
+			LOG(INFO) << "Shared resources between " << aliased_count << " textures that are never used at the same time, saving " << (_texture_memory_saved / (1024 * 1024)) << " MiB of video memory.";
+		}
 
-				stbi_image_free(filedata);
-			}
+		// The budget can only update a technique less often if it has passes that do not render to the back buffer, and it keeps the textures these render to between frames
+		for (auto &technique : _techniques)
+		{
+			const bool can_update_less_often = std::any_of(technique.pass_infos.begin(), technique.pass_infos.end(), [](const pass_info &pass) {
+				return !pass.writes_backbuffer;
+			}) && std::none_of(technique.pass_infos.begin(), technique.pass_infos.end(), [&aliased_textures](const pass_info &pass) {
+				return std::any_of(pass.render_targets.begin(), pass.render_targets.end(), [&aliased_textures](const std::string &name) { return aliased_textures.count(name) != 0; });
+			});
 
-			if (!success)
-			{
-				LOG(ERROR) << "> Source " << path << " for texture '" << texture.name << "' could not be loaded! Make sure it is of a compatible file format.";
-				continue;
-			}
+			technique.max_budget_interval = can_update_less_often ? 8 : 1;
 		}
 	}
 
@@ -741,6 +1163,9 @@ namespace reshade
 		config.get("INPUT", "InputProcessing", _input_processing_mode);
 
 		config.get("GENERAL", "PerformanceMode", _performance_mode);
+		config.get("GENERAL", "FusePasses", _fuse_passes);
+		config.get("GENERAL", "EffectBudget", _effect_budget);
+		config.get("GENERAL", "ProfilePasses", _profile_passes);
 		config.get("GENERAL", "EffectSearchPaths", _effect_search_paths);
 		config.get("GENERAL", "TextureSearchPaths", _texture_search_paths);
 		config.get("GENERAL", "PreprocessorDefinitions", _preprocessor_definitions);
@@ -749,6 +1174,10 @@ namespace reshade
 		config.get("GENERAL", "TutorialProgress", _tutorial_index);
 		config.get("GENERAL", "ScreenshotPath", _screenshot_path);
 		config.get("GENERAL", "ScreenshotFormat", _screenshot_format);
+		config.get("GENERAL", "ScreenshotPngCompression", _screenshot_png_level);
+		config.get("GENERAL", "ScreenshotSequence", _screenshot_sequence);
+		config.get("GENERAL", "ScreenshotSequenceLength", _sequence_length);
+		config.get("GENERAL", "ScreenshotSequenceInterval", _sequence_interval);
 		config.get("GENERAL", "ShowClock", _show_clock);
 		config.get("GENERAL", "ShowFPS", _show_framerate);
 		config.get("GENERAL", "FontGlobalScale", _imgui_context->IO.FontGlobalScale);
@@ -855,6 +1284,9 @@ namespace reshade
 		config.set("INPUT", "InputProcessing", _input_processing_mode);
 
 		config.set("GENERAL", "PerformanceMode", _performance_mode);
+		config.set("GENERAL", "FusePasses", _fuse_passes);
+		config.set("GENERAL", "EffectBudget", _effect_budget);
+		config.set("GENERAL", "ProfilePasses", _profile_passes);
 		config.set("GENERAL", "EffectSearchPaths", _effect_search_paths);
 		config.set("GENERAL", "TextureSearchPaths", _texture_search_paths);
 		config.set("GENERAL", "PreprocessorDefinitions", _preprocessor_definitions);
@@ -863,6 +1295,10 @@ namespace reshade
 		config.set("GENERAL", "TutorialProgress", _tutorial_index);
 		config.set("GENERAL", "ScreenshotPath", _screenshot_path);
 		config.set("GENERAL", "ScreenshotFormat", _screenshot_format);
+		config.set("GENERAL", "ScreenshotPngCompression", _screenshot_png_level);
+		config.set("GENERAL", "ScreenshotSequence", _screenshot_sequence);
+		config.set("GENERAL", "ScreenshotSequenceLength", _sequence_length);
+		config.set("GENERAL", "ScreenshotSequenceInterval", _sequence_interval);
 		config.set("GENERAL", "ShowClock", _show_clock);
 		config.set("GENERAL", "ShowFPS", _show_framerate);
 		config.set("GENERAL", "FontGlobalScale", _imgui_context->IO.FontGlobalScale);
@@ -919,6 +1355,9 @@ namespace reshade
 		std::vector<std::string> technique_sorting_list;
 		preset.get("", "TechniqueSorting", technique_sorting_list);
 
+		_budget_priority.clear();
+		preset.get("", "BudgetPriority", _budget_priority);
+
 		if (technique_sorting_list.empty())
 			technique_sorting_list = technique_list;
 
@@ -931,10 +1370,33 @@ namespace reshade
 		for (auto &technique : _techniques)
 		{
 			// Ignore preset if "enabled" annotation is set
-			technique.enabled = technique.annotations["enabled"].as<bool>() || std::find(technique_list.begin(), technique_list.end(), technique.name) != technique_list.end();
+			technique.enabled = find_annotation(technique.annotations, "enabled").as<bool>() || std::find(technique_list.begin(), technique_list.end(), technique.name) != technique_list.end();
 
 			preset.get("", "Key" + technique.name, technique.toggle_key_data);
 		}
+
+		// Textures have to be created again to change the resolution a technique runs at, or when a technique starts or stops keeping its textures between frames, since only textures that do not have to can share resources
+		bool needs_reload = false;
+
+		for (auto &technique : _techniques)
+		{
+			const unsigned int update_interval = get_update_interval(preset, technique.name, technique.annotations);
+
+			if (get_resolution_scale(preset, technique.name, technique.annotations) != technique.resolution_scale || (update_interval > 1) != (technique.update_interval > 1))
+			{
+				needs_reload = true;
+			}
+
+			technique.update_interval = update_interval;
+		}
+
+		// Phases have to be chosen again for the new intervals
+		_staggered_techniques.clear();
+
+		if (needs_reload)
+		{
+			reload();
+		}
 	}
 	void runtime::load_current_preset()
 	{
@@ -998,7 +1460,11 @@ namespace reshade
 				technique_list.push_back(technique.name);
 			}
 
-			technique_sorting_list.push_back(technique.name);
+			// Fused techniques are generated again on every reload, so they do not need to be stored
+			if (technique.fused_techniques.empty())
+			{
+				technique_sorting_list.push_back(technique.name);
+			}
 
 			if (technique.toggle_key_data[0] != 0)
 			{
@@ -1026,46 +1492,194 @@ namespace reshade
 		}
 	}
 
-	void runtime::save_screenshot() const
+	void runtime::frame_data::convert_to_rgba8(uint8_t *buffer) const
+	{
+		const uint8_t *row = data;
+
+		for (unsigned int y = 0; y < height; y++, row += row_pitch, buffer += width * 4)
+		{
+			if (format == frame_format::bgra8)
+			{
+				pixel_conversion::swizzle_rgba8_bgra8(row, buffer, width);
+			}
+			else
+			{
+				memcpy(buffer, row, width * 4);
+			}
+
+			pixel_conversion::fill_alpha_rgba8(buffer, width, 0xFF);
+		}
+	}
+	void runtime::capture_frame(uint8_t *buffer) const
 	{
-		std::vector<uint8_t> data(_width * _height * 4);
-		capture_frame(data.data());
+		capture_frame([buffer](const frame_data &frame) {
+			frame.convert_to_rgba8(buffer);
+		});
+	}
 
+	void runtime::save_screenshot()
+	{
 		const int hour = _date[3] / 3600;
 		const int minute = (_date[3] - hour * 3600) / 60;
 		const int second = _date[3] - hour * 3600 - minute * 60;
 
 		char filename[25];
-		ImFormatString(filename, sizeof(filename), " %.4d-%.2d-%.2d %.2d-%.2d-%.2d%s", _date[0], _date[1], _date[2], hour, minute, second, _screenshot_format == 0 ? ".bmp" : ".png");
+		ImFormatString(filename, sizeof(filename), " %.4d-%.2d-%.2d %.2d-%.2d-%.2d%s", _date[0], _date[1], _date[2], hour, minute, second, _screenshot_format == 0 ? ".bmp" : _screenshot_format == 1 ? ".png" : ".tga");
 		const auto path = _screenshot_path / (s_target_executable_path.filename_without_extension() + filename);
 
 		LOG(INFO) << "Saving screenshot to " << path << " ...";
 
-		FILE *file;
-		bool success = false;
+		if (!capture_screenshot(path, _screenshot_format, false))
+		{
+			LOG(WARNING) << "Skipped screenshot because too many captures are still in flight.";
+		}
+	}
+	bool runtime::capture_screenshot(const filesystem::path &path, int format, bool sequence)
+	{
+		unsigned int slot = 0;
+
+		// Find a staging resource that is not in use by another capture that was not written yet
+		while (slot < capture_ring_size && std::any_of(_pending_captures.begin(), _pending_captures.end(), [slot](const pending_capture &capture) { return capture.slot == slot; }))
+		{
+			slot++;
+		}
 
-		if (_wfopen_s(&file, path.wstring().c_str(), L"wb") == 0)
+		if (slot == capture_ring_size)
 		{
-			stbi_write_func *const func = [](void *context, void *data, int size) {
-				fwrite(data, 1, size, static_cast<FILE *>(context));
-			};
+			return false;
+		}
+
+		if (!copy_frame_to_staging(slot))
+		{
+			LOG(ERROR) << "Failed to capture screenshot!";
+			return false;
+		}
 
-			switch (_screenshot_format)
+		_pending_captures.push_back({ slot, _framecount, format, sequence, path });
+
+		return true;
+	}
+	void runtime::finish_screenshots(bool wait)
+	{
+		for (auto it = _pending_captures.begin(); it != _pending_captures.end();)
+		{
+			if (it->released == nullptr)
 			{
-			case 0:
-				success = stbi_write_bmp_to_func(func, file, _width, _height, 4, data.data()) != 0;
-				break;
-			case 1:
-				success = stbi_write_png_to_func(func, file, _width, _height, 4, data.data(), 0) != 0;
-				break;
+				// Reading back earlier would force a synchronization with the GPU, since it likely did not finish copying the frame yet
+				if (!wait && _framecount - it->framecount < capture_readback_latency)
+				{
+					++it;
+					continue;
+				}
+
+				frame_data frame;
+
+				if (!map_frame_from_staging(it->slot, frame))
+				{
+					LOG(ERROR) << "Failed to read back screenshot for " << it->path << "!";
+					it = _pending_captures.erase(it);
+					continue;
+				}
+
+				// The writer threads read the pixels straight from the mapped staging resource, so it is only unmapped and reused once they released the frame again
+				// Any conversion is left to them too, which also write BGRA frames to Targa files without touching the pixels
+				screenshot_writer::job job;
+				job.path = it->path;
+				job.format = static_cast<screenshot_writer::file_format>(it->format);
+				job.width = frame.width;
+				job.height = frame.height;
+				job.compression_level = _screenshot_png_level;
+				job.bgra = frame.format == frame_format::bgra8;
+				job.data = frame.data;
+				job.row_pitch = frame.row_pitch;
+
+				const auto released = std::make_shared<std::atomic<bool>>(false);
+				job.release = [released]() { *released = true; };
+
+				it->released = released;
+
+				if (it->sequence)
+				{
+					// Drop frames rather than waiting when the disk cannot keep up, so the game never stalls
+					if (!_sequence_writer->enqueue(std::move(job)))
+					{
+						_sequence_frames_dropped++;
+						*released = true;
+					}
+				}
+				else if (!_screenshot_writer->enqueue(std::move(job)))
+				{
+					LOG(ERROR) << "Failed to write screenshot to " << it->path << " because too many screenshots are waiting to be written!";
+					*released = true;
+				}
+			}
+
+			if (wait)
+			{
+				(it->sequence ? _sequence_writer : _screenshot_writer)->wait_idle();
+			}
+
+			if (!*it->released)
+			{
+				++it;
+				continue;
 			}
 
-			fclose(file);
+			unmap_frame_from_staging(it->slot);
+
+			it = _pending_captures.erase(it);
 		}
 
-		if (!success)
+		// The writer threads cannot log themselves, so report frames they failed to write here
+		for (const auto &path : _screenshot_writer->take_failed())
+		{
+			LOG(ERROR) << "Failed to write screenshot to " << path << "!";
+		}
+		for (const auto &path : _sequence_writer->take_failed())
 		{
 			LOG(ERROR) << "Failed to write screenshot to " << path << "!";
+			_sequence_frames_dropped++;
+		}
+	}
+	void runtime::start_sequence()
+	{
+		const int hour = _date[3] / 3600;
+		const int minute = (_date[3] - hour * 3600) / 60;
+		const int second = _date[3] - hour * 3600 - minute * 60;
+
+		char date[21];
+		ImFormatString(date, sizeof(date), " %.4d-%.2d-%.2d %.2d-%.2d-%.2d", _date[0], _date[1], _date[2], hour, minute, second);
+
+		_sequence_name = s_target_executable_path.filename_without_extension() + date;
+		_sequence_start_frame = _framecount;
+		_sequence_index = 0;
+		_sequence_active = true;
+
+		LOG(INFO) << "Capturing frame sequence to " << (_screenshot_path / (_sequence_name + " #####.tga")) << " ...";
+	}
+	void runtime::update_sequence()
+	{
+		if ((_framecount - _sequence_start_frame) % std::max(_sequence_interval, 1) != 0)
+		{
+			return;
+		}
+
+		// Frames are numbered by their position in the sequence, so dropped frames show up as gaps
+		char filename[16];
+		ImFormatString(filename, sizeof(filename), " %.5u.tga", _sequence_index);
+
+		if (!capture_screenshot(_screenshot_path / (_sequence_name + filename), 2, true))
+		{
+			_sequence_frames_dropped++;
+		}
+
+		_sequence_index++;
+
+		if (_sequence_length > 0 && _sequence_index >= static_cast<unsigned int>(_sequence_length))
+		{
+			LOG(INFO) << "Finished frame sequence capture after " << _sequence_index << " frames.";
+
+			_sequence_active = false;
 		}
 	}
 
@@ -1671,6 +2285,32 @@ namespace reshade
 				reload();
 			}
 
+			if (ImGui::Checkbox("Fuse Simple Passes", &_fuse_passes))
+			{
+				save_config();
+				reload();
+			}
+
+			if (ImGui::IsItemHovered())
+			{
+				ImGui::SetTooltip("Combine consecutive passes of an effect file that only change the color of each pixel into a single pass, which saves a draw and a back buffer copy for each of them.");
+			}
+
+			if (ImGui::DragFloat("Effect Budget", &_effect_budget, 0.1f, 0.0f, 100.0f, _effect_budget > 0.0f ? "%.1f ms" : "Unlimited"))
+			{
+				save_config();
+			}
+
+			if (ImGui::IsItemHovered())
+			{
+				ImGui::SetTooltip("Update the least important techniques less often and then skip them while the GPU time of all enabled techniques exceeds this budget, and restore them once there is room again. The order of importance is set by the \"BudgetPriority\" list in the preset.\nThis has no effect with Direct3D 9, which does not measure GPU time.");
+			}
+
+			if (!_has_gpu_timings && _effect_budget > 0.0f)
+			{
+				ImGui::TextDisabled("GPU time is not measured with this API, so the budget has no effect.");
+			}
+
 			if (ImGui::Combo("Input Processing", &_input_processing_mode, "Pass on all input\0Block input when cursor is on overlay\0Block all input when overlay is visible\0"))
 			{
 				save_config();
@@ -1741,7 +2381,52 @@ namespace reshade
 				save_config();
 			}
 
-			if (ImGui::Combo("Screenshot Format", &_screenshot_format, "Bitmap (*.bmp)\0Portable Network Graphics (*.png)\0"))
+			if (ImGui::Combo("Screenshot Format", &_screenshot_format, "Bitmap (*.bmp)\0Portable Network Graphics (*.png)\0Targa (*.tga)\0"))
+			{
+				save_config();
+			}
+
+			if (_screenshot_format == 1)
+			{
+				if (ImGui::SliderInt("PNG Compression", &_screenshot_png_level, 0, 9))
+				{
+					save_config();
+				}
+
+				if (ImGui::IsItemHovered())
+				{
+					ImGui::SetTooltip("Zero stores the image uncompressed, which is fastest to write. Higher levels produce smaller files, but take longer to encode.");
+				}
+			}
+
+			bool modified = ImGui::Checkbox("Capture Sequence", &_screenshot_sequence);
+
+			if (ImGui::IsItemHovered())
+			{
+				ImGui::SetTooltip("Pressing the screenshot key starts (and stops) capturing a numbered sequence of frames instead of a single screenshot.\nSequence frames are always written as uncompressed Targa files and dropped when the disk cannot keep up.");
+			}
+
+			if (_screenshot_sequence)
+			{
+				modified |= ImGui::InputInt("Sequence Length", &_sequence_length);
+
+				if (ImGui::IsItemHovered())
+				{
+					ImGui::SetTooltip("The number of frames to capture, or zero to capture until the screenshot key is pressed again.");
+				}
+
+				modified |= ImGui::InputInt("Sequence Interval", &_sequence_interval);
+
+				if (ImGui::IsItemHovered())
+				{
+					ImGui::SetTooltip("Capture every n-th frame.");
+				}
+
+				_sequence_length = std::max(_sequence_length, 0);
+				_sequence_interval = std::max(_sequence_interval, 1);
+			}
+
+			if (modified)
 			{
 				save_config();
 			}
@@ -1788,8 +2473,14 @@ namespace reshade
 
 			for (const auto &technique : _techniques)
 			{
+				// The time of fused techniques is already accounted to the techniques they replaced, and skipped techniques only have the time from when they last ran
+				if (!technique.fused_techniques.empty() || technique.skipped_by_budget)
+				{
+					continue;
+				}
+
 				post_processing_time_cpu += technique.average_cpu_duration;
-				post_processing_time_gpu += technique.average_gpu_duration;
+				post_processing_time_gpu += average_gpu_duration_per_frame(technique);
 			}
 
 			ImGui::BeginGroup();
@@ -1802,6 +2493,11 @@ namespace reshade
 			ImGui::Text("Frame %llu:", _framecount + 1);
 			ImGui::TextUnformatted("Timer:");
 			ImGui::TextUnformatted("Network:");
+			ImGui::TextUnformatted("Uniform Uploads:");
+			ImGui::TextUnformatted("Sequence Frames:");
+			ImGui::TextUnformatted("Back Buffer Copies:");
+			ImGui::TextUnformatted("Mipmap Generations:");
+			ImGui::TextUnformatted("Texture Memory:");
 			ImGui::EndGroup();
 
 			ImGui::SameLine(ImGui::GetWindowWidth() * 0.333f);
@@ -1816,6 +2512,11 @@ namespace reshade
 			ImGui::Text("%f ms", _last_frame_duration.count() * 1e-6f);
 			ImGui::Text("%f ms", std::fmod(std::chrono::duration_cast<std::chrono::nanoseconds>(_last_present_time - _start_time).count() * 1e-6f, 16777216.0f));
 			ImGui::Text("%u B", g_network_traffic);
+			ImGui::Text("%zu B", _last_uniform_bytes_uploaded);
+			ImGui::Text("%zu written, %zu dropped", _sequence_writer->written(), _sequence_frames_dropped);
+			ImGui::Text("%zu for %zu passes", _backbuffer_copies, _planned_pass_count);
+			ImGui::Text("%zu", _mipmap_generations);
+			ImGui::Text("%.1f MiB (%.1f MiB saved by sharing)", (_texture_memory_total - _texture_memory_saved) / (1024.0f * 1024.0f), _texture_memory_saved / (1024.0f * 1024.0f));
 			ImGui::EndGroup();
 
 			ImGui::SameLine(ImGui::GetWindowWidth() * 0.666f);
@@ -1867,11 +2568,71 @@ namespace reshade
 
 		if (ImGui::CollapsingHeader("Techniques", ImGuiTreeNodeFlags_DefaultOpen))
 		{
+			if (ImGui::Checkbox("Measure Individual Passes", &_profile_passes))
+			{
+				for (auto &technique : _techniques)
+				{
+					for (auto &pass : technique.pass_infos)
+					{
+						pass.average_cpu_duration.clear();
+						pass.average_gpu_duration.clear();
+					}
+				}
+
+				save_config();
+			}
+
+			if (ImGui::IsItemHovered())
+			{
+				ImGui::SetTooltip("Time every pass of the enabled techniques on the CPU and GPU, so that the passes of a technique can be expanded to see which one is slow. This issues additional GPU queries while it is enabled.");
+			}
+
+			// Remember which techniques are expanded, so that the time columns list their passes on the same lines
+			std::vector<bool> expanded(_techniques.size());
+
 			ImGui::BeginGroup();
 
-			for (const auto &technique : _techniques)
+			for (size_t i = 0; i < _techniques.size(); i++)
 			{
-				if (technique.enabled)
+				const auto &technique = _techniques[i];
+
+				if (!technique.fused_techniques.empty())
+				{
+					continue;
+				}
+
+				if (technique.skipped_by_budget)
+				{
+					ImGui::TextDisabled("%s (skipped to stay within budget)", technique.name.c_str());
+				}
+				else if (technique.enabled && _profile_passes && technique.passes.size() > 1)
+				{
+					expanded[i] = ImGui::TreeNodeEx(&technique, ImGuiTreeNodeFlags_NoTreePushOnOpen, "%s (%u passes)", technique.name.c_str(), static_cast<unsigned int>(technique.passes.size()));
+
+					if (expanded[i])
+					{
+						ImGui::Indent();
+
+						for (size_t k = 0; k < technique.pass_infos.size(); k++)
+						{
+							if (technique.pass_infos[k].name.empty())
+							{
+								ImGui::Text("Pass %zu", k);
+							}
+							else
+							{
+								ImGui::Text("%s", technique.pass_infos[k].name.c_str());
+							}
+						}
+
+						ImGui::Unindent();
+					}
+				}
+				else if (technique.enabled && technique.update_interval * technique.budget_interval > 1)
+				{
+					ImGui::Text(technique.budget_interval > 1 ? "%s (updated every %u frames to stay within budget)" : "%s (updated every %u frames)", technique.name.c_str(), technique.update_interval * technique.budget_interval);
+				}
+				else if (technique.enabled)
 				{
 					if (technique.passes.size() > 1)
 					{
@@ -1899,8 +2660,15 @@ namespace reshade
 			ImGui::SameLine(ImGui::GetWindowWidth() * 0.333f);
 			ImGui::BeginGroup();
 
-			for (const auto &technique : _techniques)
+			for (size_t i = 0; i < _techniques.size(); i++)
 			{
+				const auto &technique = _techniques[i];
+
+				if (!technique.fused_techniques.empty())
+				{
+					continue;
+				}
+
 				if (technique.enabled)
 				{
 					ImGui::Text("%f ms (CPU)", (technique.average_cpu_duration * 1e-6f));
@@ -1909,22 +2677,52 @@ namespace reshade
 				{
 					ImGui::NewLine();
 				}
+
+				if (expanded[i])
+				{
+					for (const auto &pass : technique.pass_infos)
+					{
+						ImGui::Text("%f ms (CPU)", (pass.average_cpu_duration * 1e-6f));
+					}
+				}
 			}
 
 			ImGui::EndGroup();
 			ImGui::SameLine(ImGui::GetWindowWidth() * 0.666f);
 			ImGui::BeginGroup();
 
-			for (const auto &technique : _techniques)
+			for (size_t i = 0; i < _techniques.size(); i++)
 			{
+				const auto &technique = _techniques[i];
+
+				if (!technique.fused_techniques.empty())
+				{
+					continue;
+				}
+
 				if (technique.enabled && technique.average_gpu_duration != 0)
 				{
-					ImGui::Text("%f ms (GPU)", (technique.average_gpu_duration * 1e-6f));
+					ImGui::Text("%f ms (GPU)", (average_gpu_duration_per_frame(technique) * 1e-6f));
 				}
 				else
 				{
 					ImGui::NewLine();
 				}
+
+				if (expanded[i])
+				{
+					for (const auto &pass : technique.pass_infos)
+					{
+						if (pass.average_gpu_duration != 0)
+						{
+							ImGui::Text("%f ms (GPU)", (pass.average_gpu_duration * 1e-6f));
+						}
+						else
+						{
+							ImGui::NewLine();
+						}
+					}
+				}
 			}
 
 			ImGui::EndGroup();
@@ -2085,10 +2883,10 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 			}
 
 			bool modified = false;
-			const auto ui_type = variable.annotations["ui_type"].as<std::string>();
-			const auto ui_label = variable.annotations.count("ui_label") ? variable.annotations.at("ui_label").as<std::string>() : variable.name;
-			const auto ui_tooltip = variable.annotations["ui_tooltip"].as<std::string>();
-			const auto ui_category = variable.annotations["ui_category"].as<std::string>();
+			const auto &ui_type = variable.ui_type;
+			const auto &ui_label = variable.ui_label;
+			const auto &ui_tooltip = variable.ui_tooltip;
+			const auto &ui_category = variable.ui_category;
 
 			if (current_category != ui_category)
 			{
@@ -2151,21 +2949,11 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 					if (ui_type == "drag")
 					{
-						const int ui_min = variable.annotations["ui_min"].as<int>();
-						const int ui_max = variable.annotations["ui_max"].as<int>();
-						const float ui_step = variable.annotations["ui_step"].as<float>();
-
-						modified = ImGui::DragScalarN(ui_label.c_str(), ImGuiDataType_S32, data, variable.rows, ui_step, &ui_min, &ui_max);
+						modified = ImGui::DragScalarN(ui_label.c_str(), ImGuiDataType_S32, data, variable.rows, variable.ui_step, &variable.ui_min_int, &variable.ui_max_int);
 					}
 					else if (ui_type == "combo")
 					{
-						std::string items = variable.annotations["ui_items"].as<std::string>();
-
-						// Make sure list is terminated with a zero in case user forgot so no invalid memory is read accidentally
-						if (!items.empty() && items.back() != '\0')
-							items.push_back('\0');
-
-						modified = ImGui::Combo(ui_label.c_str(), data, items.c_str());
+						modified = ImGui::Combo(ui_label.c_str(), data, variable.ui_items.c_str());
 					}
 					else
 					{
@@ -2185,11 +2973,7 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 					if (ui_type == "drag")
 					{
-						const float ui_min = variable.annotations["ui_min"].as<float>();
-						const float ui_max = variable.annotations["ui_max"].as<float>();
-						const float ui_step = variable.annotations["ui_step"].as<float>();
-
-						modified = ImGui::DragScalarN(ui_label.c_str(), ImGuiDataType_Float, data, variable.rows, ui_step, &ui_min, &ui_max, "%.3f");
+						modified = ImGui::DragScalarN(ui_label.c_str(), ImGuiDataType_Float, data, variable.rows, variable.ui_step, &variable.ui_min, &variable.ui_max, "%.3f");
 					}
 					else if (ui_type == "input" || (ui_type.empty() && variable.rows < 3))
 					{
@@ -2386,14 +3170,14 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 			for (auto &uniform : _uniforms)
 			{
-				if (uniform.annotations["hidden"].as<bool>())
+				if (find_annotation(uniform.annotations, "hidden").as<bool>())
 					continue;
 
 				uniform.hidden = false;
 			}
 			for (auto &technique : _techniques)
 			{
-				if (technique.annotations["hidden"].as<bool>())
+				if (find_annotation(technique.annotations, "hidden").as<bool>())
 					continue;
 
 				technique.hidden = false;
@@ -2405,7 +3189,7 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 			for (auto &uniform : _uniforms)
 			{
-				if (uniform.annotations["hidden"].as<bool>())
+				if (find_annotation(uniform.annotations, "hidden").as<bool>())
 					continue;
 
 				uniform.hidden =
@@ -2416,7 +3200,7 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 			}
 			for (auto &technique : _techniques)
 			{
-				if (technique.annotations["hidden"].as<bool>())
+				if (find_annotation(technique.annotations, "hidden").as<bool>())
 					continue;
 
 				technique.hidden =
@@ -5,10 +5,13 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <functional>
 #include "filesystem.hpp"
 #include "ini_file.hpp"
+#include "dirty_range_list.hpp"
+#include "frame_budget.hpp"
 #include "runtime_objects.hpp"
 
 #pragma region Forward Declarations
@@ -19,6 +22,8 @@ struct ImGuiContext;
 namespace reshade
 {
 	class input;
+	class texture_loader;
+	class screenshot_writer;
 }
 namespace reshadefx
 {
@@ -30,6 +35,12 @@ extern volatile long g_network_traffic;
 
 namespace reshade
 {
+	/// <summary>
+	/// Shader objects compiled from effect code, shared between all passes that use identical code. They are keyed by the whole code and compile options rather than a hash of it, so that a hash collision cannot bind the wrong shader.
+	/// </summary>
+	template <typename T>
+	using shader_registry = std::unordered_map<std::string, T>;
+
 	class runtime abstract
 	{
 	public:
@@ -58,10 +69,45 @@ namespace reshade
 		/// </summary>
 		unsigned int frame_height() const { return _height; }
 		/// <summary>
+		/// Channel order of the pixels of a captured frame.
+		/// </summary>
+		enum class frame_format
+		{
+			rgba8,
+			bgra8
+		};
+		/// <summary>
+		/// A captured frame in the memory it was read back to. Frames passed to a callback are only valid while it runs.
+		/// </summary>
+		struct frame_data
+		{
+			/// <summary>
+			/// The first (top) row of pixels. The alpha channel is undefined.
+			/// </summary>
+			const uint8_t *data;
+			/// <summary>
+			/// The distance in bytes from one row to the next, which can be larger than "width * 4" and is negative if the rows are stored bottom-up.
+			/// </summary>
+			ptrdiff_t row_pitch;
+			unsigned int width, height;
+			frame_format format;
+
+			/// <summary>
+			/// Convert the frame to tightly packed RGBA8 pixels with an opaque alpha channel.
+			/// </summary>
+			/// <param name="buffer">The buffer to save the pixels to. It has to be the size of at least "width * height * 4".</param>
+			void convert_to_rgba8(uint8_t *buffer) const;
+		};
+		/// <summary>
 		/// Create a copy of the current frame.
 		/// </summary>
 		/// <param name="buffer">The buffer to save the copy to. It has to be the size of at least "frame_width() * frame_height() * 4".</param>
-		virtual void capture_frame(uint8_t *buffer) const = 0;
+		void capture_frame(uint8_t *buffer) const;
+		/// <summary>
+		/// Capture the current frame and pass the mapped memory it was read back to directly to a callback, without converting or copying it first.
+		/// </summary>
+		/// <param name="callback">The function that consumes the frame. It is called on the calling thread before this returns.</param>
+		virtual bool capture_frame(const std::function<void(const frame_data &)> &callback) const = 0;
 
 		/// <summary>
 		/// Returns the initialization status.
@@ -196,8 +242,43 @@ namespace reshade
 		/// Update the image data of a texture.
 		/// </summary>
 		/// <param name="texture">The texture to update.</param>
-		/// <param name="data">The 32bpp RGBA image data to update the texture to.</param>
+		/// <param name="data">The 32bpp RGBA image data to update the texture to. For block-compressed formats this is instead the compressed data of all mipmap levels, which is uploaded as-is.</param>
 		virtual bool update_texture(texture &texture, const uint8_t *data) = 0;
+		/// <summary>
+		/// Let textures that are never used at the same time share their resources, as planned by "render_graph::plan_texture_aliasing".
+		/// </summary>
+		void alias_textures();
+		/// <summary>
+		/// Make a texture use the resource of another texture with the same dimensions and format instead of its own, which is released. Passes that render to or sample from the texture use the shared resource afterwards.
+		/// </summary>
+		/// <param name="texture">The texture to alias.</param>
+		/// <param name="target">The texture whose resource to share.</param>
+		virtual bool alias_texture(texture &texture, const texture &target) = 0;
+
+		/// <summary>
+		/// The number of staging resources frames are captured to. A staging resource stays in use until its frame was written to disk, so this also covers frames waiting in the screenshot writers.
+		/// </summary>
+		static const unsigned int capture_ring_size = 8;
+		/// <summary>
+		/// The number of frames it takes until a capture is read back.
+		/// </summary>
+		static const unsigned int capture_readback_latency = 3;
+		/// <summary>
+		/// Copy the current frame into a reusable staging resource. It is mapped with "map_frame_from_staging" a few frames later, once the GPU finished the copy, so that capturing does not stall the render thread.
+		/// </summary>
+		/// <param name="slot">The index of the staging resource to copy to, which is less than "capture_ring_size".</param>
+		virtual bool copy_frame_to_staging(unsigned int slot) = 0;
+		/// <summary>
+		/// Map a frame that was previously copied into a staging resource, so that it can be read without copying it out first. The memory stays valid on any thread until "unmap_frame_from_staging" is called.
+		/// </summary>
+		/// <param name="slot">The index of the staging resource to read from.</param>
+		/// <param name="frame">The mapped frame.</param>
+		virtual bool map_frame_from_staging(unsigned int slot, frame_data &frame) = 0;
+		/// <summary>
+		/// Unmap a staging resource that was mapped with "map_frame_from_staging", so that it can be captured to again.
+		/// </summary>
+		/// <param name="slot">The index of the staging resource to unmap.</param>
+		virtual void unmap_frame_from_staging(unsigned int slot) = 0;
 
 		/// <summary>
 		/// Load user configuration from disk.
@@ -212,7 +293,15 @@ namespace reshade
 		/// Render all passes in a technique.
 		/// </summary>
 		/// <param name="technique">The technique to render.</param>
-		virtual void render_technique(const technique &technique) = 0;
+		virtual void render_technique(technique &technique) = 0;
+		/// <summary>
+		/// Add GPU timings to the averages of a technique and its passes. Only passes that ran in the frame the timings were measured in are accounted for.
+		/// </summary>
+		/// <param name="technique">The technique that was measured.</param>
+		/// <param name="frame">The frame the timings were measured in.</param>
+		/// <param name="duration">The time the whole technique took, in nanoseconds.</param>
+		/// <param name="pass_durations">The time each pass took, in nanoseconds, or an empty list if passes were not measured in that frame.</param>
+		void record_gpu_timings(technique &technique, uint64_t frame, uint64_t duration, const std::vector<uint64_t> &pass_durations);
 		/// <summary>
 		/// Render command lists obtained from ImGui.
 		/// </summary>
@@ -221,24 +310,34 @@ namespace reshade
 
 		unsigned int _width = 0, _height = 0;
 		unsigned int _vendor_id = 0, _device_id = 0;
+		bool _is_backbuffer_float = false;
+		bool _has_gpu_timings = true;
 		uint64_t _framecount = 0;
 		unsigned int _drawcalls = 0, _vertices = 0;
+		bool _profile_passes = false;
 		std::shared_ptr<input> _input;
 		ImGuiContext *_imgui_context = nullptr;
 		std::unique_ptr<base_object> _imgui_font_atlas_texture;
 		std::vector<texture> _textures;
 		std::vector<uniform> _uniforms;
 		std::vector<technique> _techniques;
+		dirty_range_list _uniform_dirty_ranges;
+		size_t _uniform_bytes_uploaded = 0;
 
 	private:
 		static bool check_for_update(unsigned long latest_version[3]);
 
 		void reload();
+		void update_budget(std::vector<technique *> &enabled_techniques);
 		void load_preset(const filesystem::path &path);
 		void load_current_preset();
 		void save_preset(const filesystem::path &path) const;
 		void save_current_preset() const;
-		void save_screenshot() const;
+		void save_screenshot();
+		bool capture_screenshot(const filesystem::path &path, int format, bool sequence);
+		void finish_screenshots(bool wait);
+		void start_sequence();
+		void update_sequence();
 
 		void draw_overlay();
 		void draw_overlay_menu();
@@ -262,7 +361,32 @@ namespace reshade
 		std::chrono::high_resolution_clock::time_point _last_reload_time;
 		std::chrono::high_resolution_clock::time_point _last_present_time;
 		std::chrono::high_resolution_clock::duration _last_frame_duration;
+		size_t _last_uniform_bytes_uploaded = 0;
 		std::vector<unsigned char> _uniform_data_storage;
+		std::vector<uniform_source_binding> _uniform_sources;
+		std::unique_ptr<texture_loader> _texture_loader;
+		struct pending_capture
+		{
+			unsigned int slot;
+			uint64_t framecount;
+			int format;
+			bool sequence;
+			filesystem::path path;
+			std::shared_ptr<std::atomic<bool>> released;
+		};
+		std::vector<pending_capture> _pending_captures;
+		std::unique_ptr<screenshot_writer> _screenshot_writer;
+		std::unique_ptr<screenshot_writer> _sequence_writer;
+		std::string _sequence_name;
+		uint64_t _sequence_start_frame = 0;
+		unsigned int _sequence_index = 0;
+		size_t _sequence_frames_dropped = 0;
+		size_t _backbuffer_copies = 0, _mipmap_generations = 0, _planned_pass_count = 0;
+		size_t _texture_memory_total = 0, _texture_memory_saved = 0;
+		float _effect_budget = 0.0f;
+		frame_budget _frame_budget;
+		std::vector<std::string> _budget_priority;
+		std::vector<technique *> _staggered_techniques;
 		int _date[4] = { };
 		std::vector<std::string> _preprocessor_definitions;
 		std::vector<std::pair<std::string, std::function<void()>>> _menu_callables;
@@ -270,6 +394,9 @@ namespace reshade
 		std::vector<std::function<void(ini_file &)>> _save_config_callables;
 		size_t _menu_index = 0;
 		int _screenshot_format = 0;
+		int _screenshot_png_level = 6;
+		int _sequence_length = 60;
+		int _sequence_interval = 1;
 		int _current_preset = -1;
 		int _selected_technique = -1;
 		int _input_processing_mode = 2;
@@ -289,9 +416,12 @@ namespace reshade
 		bool _no_font_scaling = false;
 		bool _no_reload_on_init = false;
 		bool _performance_mode = false;
+		bool _fuse_passes = false;
 		bool _save_imgui_window_state = false;
 		bool _overlay_key_setting_active = false;
 		bool _screenshot_key_setting_active = false;
+		bool _screenshot_sequence = false;
+		bool _sequence_active = false;
 		bool _toggle_key_setting_active = false;
 		bool _log_wordwrap = false;
 		float _imgui_col_background[3] = { 0.275f, 0.275f, 0.275f };
@@ -134,7 +134,15 @@ namespace reshade
 
 		assert(variable.storage_offset + size <= _uniform_data_storage.size());
 
+		if (std::memcmp(&_uniform_data_storage[variable.storage_offset], data, size) == 0)
+		{
+			return;
+		}
+
 		std::memcpy(&_uniform_data_storage[variable.storage_offset], data, size);
+
+		// Remember which bytes changed, so that backends only have to upload those
+		_uniform_dirty_ranges.add(variable.storage_offset, size);
 	}
 	void runtime::set_uniform_value(uniform &variable, const bool *values, size_t count)
 	{
@@ -5,12 +5,14 @@
 
 #pragma once
 
+#include <array>
 #include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
-#include "variant.hpp"
+#include "annotation.hpp"
 #include "moving_average.hpp"
+#include "uniform_source.hpp"
 
 namespace reshade
 {
@@ -93,7 +95,7 @@ namespace reshade
 		std::string name, unique_name, effect_filename;
 		unsigned int width = 0, height = 0, levels = 0;
 		texture_format format = texture_format::unknown;
-		std::unordered_map<std::string, variant> annotations;
+		std::unordered_map<std::string, annotation> annotations;
 		texture_reference impl_reference = texture_reference::none;
 		std::unique_ptr<base_object> impl;
 	};
@@ -113,8 +115,30 @@ namespace reshade
 		uniform_datatype displaytype = uniform_datatype::floating_point;
 		unsigned int rows = 0, columns = 0, elements = 0;
 		size_t storage_offset = 0, storage_size = 0;
-		std::unordered_map<std::string, variant> annotations;
+		std::unordered_map<std::string, annotation> annotations;
 		bool hidden = false;
+		// Settings for the variable editor, resolved from the "ui_*" annotations when the effect is loaded
+		std::string ui_type, ui_label, ui_tooltip, ui_category, ui_items;
+		int ui_min_int = 0, ui_max_int = 0;
+		float ui_min = 0, ui_max = 0, ui_step = 0;
+	};
+	struct pass_info final
+	{
+		std::string name;
+		std::vector<std::string> render_targets, sampled_textures;
+		bool reads_backbuffer = false, writes_backbuffer = false;
+		bool clear_render_targets = true;
+		bool copy_backbuffer = true;
+		bool skipped = false;
+		std::vector<const texture *> mipmapped_render_targets, mipmapped_textures;
+		std::vector<const texture *> generate_mipmaps;
+		moving_average<uint64_t, 60> average_cpu_duration;
+		moving_average<uint64_t, 60> average_gpu_duration;
+	};
+	struct rendered_frame final
+	{
+		uint64_t frame = ~0ull;
+		std::vector<bool> skipped_passes;
 	};
 	struct technique final
 	{
@@ -129,14 +153,23 @@ namespace reshade
 
 		std::string name, effect_filename;
 		std::vector<std::unique_ptr<base_object>> passes;
-		std::unordered_map<std::string, variant> annotations;
+		std::vector<pass_info> pass_infos;
+		std::vector<std::string> fused_techniques;
+		float resolution_scale = 1.0f;
+		bool skipped_by_budget = false;
+		unsigned int update_interval = 1, update_phase = 0;
+		unsigned int budget_interval = 1, max_budget_interval = 1;
+		std::unordered_map<std::string, annotation> annotations;
 		bool hidden = false;
 		bool enabled = false;
 		int32_t timeout = 0;
 		int32_t timeleft = 0;
 		uint32_t toggle_key_data[4];
 		moving_average<uint64_t, 60> average_cpu_duration;
-		moving_average<uint64_t, 60> average_gpu_duration;
+		// The GPU time of frames in which all passes ran and of those in between updates, in which only the passes rendering to the back buffer ran
+		moving_average<uint64_t, 60> average_gpu_duration, average_gpu_duration_between_updates;
+		// The passes skipped in the last frames this technique was rendered in, indexed by frame, since GPU timings only arrive a few frames later
+		std::array<rendered_frame, 8> rendered_frames;
 		ptrdiff_t uniform_storage_offset = 0, uniform_storage_index = -1;
 		std::unique_ptr<base_object> impl;
 	};
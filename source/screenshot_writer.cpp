@@ -0,0 +1,314 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "screenshot_writer.hpp"
+#include "pixel_conversion.hpp"
+#include "png_encoder.hpp"
+#include <string.h>
+#include <fstream>
+#include <algorithm>
+
+namespace reshade
+{
+	screenshot_writer::screenshot_writer(size_t max_queued_jobs, size_t num_threads) : _max_queued_jobs(max_queued_jobs)
+	{
+		for (size_t i = 0; i < num_threads; i++)
+		{
+			_threads.emplace_back(&screenshot_writer::worker, this);
+		}
+	}
+	screenshot_writer::~screenshot_writer()
+	{
+		{ const std::lock_guard<std::mutex> lock(_mutex);
+			_shutdown = true;
+		}
+
+		_condition.notify_all();
+
+		for (auto &thread : _threads)
+		{
+			thread.join();
+		}
+	}
+
+	bool screenshot_writer::enqueue(job &&job)
+	{
+		{ const std::lock_guard<std::mutex> lock(_mutex);
+			if (_jobs.size() >= _max_queued_jobs)
+			{
+				return false;
+			}
+
+			_jobs.push_back(std::move(job));
+		}
+
+		_condition.notify_one();
+
+		return true;
+	}
+
+	size_t screenshot_writer::pending() const
+	{
+		const std::lock_guard<std::mutex> lock(_mutex);
+
+		return _jobs.size() + _num_writing;
+	}
+	size_t screenshot_writer::written() const
+	{
+		const std::lock_guard<std::mutex> lock(_mutex);
+
+		return _num_written;
+	}
+	std::vector<filesystem::path> screenshot_writer::take_failed()
+	{
+		const std::lock_guard<std::mutex> lock(_mutex);
+
+		std::vector<filesystem::path> failed;
+		failed.swap(_failed);
+
+		return failed;
+	}
+
+	void screenshot_writer::wait_idle()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		_idle_condition.wait(lock, [this]() { return _jobs.empty() && _num_writing == 0; });
+	}
+
+	bool screenshot_writer::write(job &job)
+	{
+		if (job.data == nullptr && job.pixels.size() < job.width * job.height * 4)
+		{
+			return false;
+		}
+
+		std::ofstream file(job.path.native(), std::ios::binary | std::ios::trunc);
+
+		if (!file)
+		{
+			return false;
+		}
+
+		bool success = false;
+
+		switch (job.format)
+		{
+			case file_format::bmp:
+				success = write_bmp(file, job);
+				break;
+			case file_format::png:
+				success = write_png(file, job);
+				break;
+			case file_format::tga:
+				success = write_tga(file, job);
+				break;
+		}
+
+		file.flush();
+
+		return success && file.good();
+	}
+
+	bool screenshot_writer::write_bmp(std::ostream &file, const job &job)
+	{
+		// Uncompressed 24bpp bitmap, stored bottom-up with every row padded to a multiple of four bytes
+		const uint32_t row_size = (job.width * 3 + 3) & ~3u;
+		const uint32_t data_size = row_size * job.height;
+
+		uint8_t header[54] = { 'B', 'M' };
+		const auto write_u32 = [&header](size_t offset, uint32_t value) {
+			for (size_t i = 0; i < 4; i++)
+				header[offset + i] = static_cast<uint8_t>(value >> (i * 8));
+		};
+
+		write_u32(2, sizeof(header) + data_size);
+		write_u32(10, sizeof(header));
+		write_u32(14, 40);
+		write_u32(18, job.width);
+		write_u32(22, job.height);
+		header[26] = 1; // Planes
+		header[28] = 24; // Bits per pixel
+		write_u32(34, data_size);
+
+		if (!file.write(reinterpret_cast<const char *>(header), sizeof(header)))
+		{
+			return false;
+		}
+
+		// Bitmaps store pixels in BGR order, so frames captured in BGRA order only need their alpha channel dropped
+		const int8_t pattern[4] = { 2, 1, 0, 3 };
+		std::vector<uint8_t> pixels(job.width * 4);
+		std::vector<uint8_t> row(row_size);
+
+		for (unsigned int y = job.height; y-- > 0;)
+		{
+			const uint8_t *const src = row_data(job, y);
+
+			if (job.bgra)
+			{
+				memcpy(pixels.data(), src, pixels.size());
+			}
+			else
+			{
+				pixel_conversion::shuffle_rgba8(src, pixels.data(), job.width, pattern);
+			}
+
+			for (unsigned int x = 0; x < job.width; x++)
+			{
+				memcpy(row.data() + x * 3, pixels.data() + x * 4, 3);
+			}
+
+			if (!file.write(reinterpret_cast<const char *>(row.data()), row.size()))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+	bool screenshot_writer::write_png(std::ostream &file, job &job)
+	{
+		convert_to_rgba8(job);
+
+		// Compress strips of the image on all cores, since this is by far the slowest format to encode
+		std::vector<uint8_t> data;
+		png::encode(job.pixels.data(), job.width, job.height, job.compression_level, std::max(std::thread::hardware_concurrency(), 1u), data);
+
+		return !!file.write(reinterpret_cast<const char *>(data.data()), data.size());
+	}
+	bool screenshot_writer::write_tga(std::ostream &file, const job &job)
+	{
+		// Uncompressed true-color image with 8 alpha bits and the origin in the upper-left corner, which is about as fast to write as the raw pixel data
+		// Not using 'stbi_write_tga_to_func' here, since it always run-length encodes unless a global flag is changed, which would affect other threads
+		const uint8_t header[18] = {
+			0, 0, 2,
+			0, 0, 0, 0, 0,
+			0, 0, 0, 0,
+			static_cast<uint8_t>(job.width & 0xFF), static_cast<uint8_t>(job.width >> 8),
+			static_cast<uint8_t>(job.height & 0xFF), static_cast<uint8_t>(job.height >> 8),
+			32, 0x28
+		};
+
+		if (job.width > 0xFFFF || job.height > 0xFFFF || !file.write(reinterpret_cast<const char *>(header), sizeof(header)))
+		{
+			return false;
+		}
+
+		// TGA stores pixels in BGRA order, so frames captured in that order only need their alpha channel fixed
+		std::vector<uint8_t> row(job.width * 4);
+
+		for (unsigned int y = 0; y < job.height; y++)
+		{
+			if (job.bgra)
+			{
+				memcpy(row.data(), row_data(job, y), row.size());
+			}
+			else
+			{
+				pixel_conversion::swizzle_rgba8_bgra8(row_data(job, y), row.data(), job.width);
+			}
+
+			pixel_conversion::fill_alpha_rgba8(row.data(), job.width, 0xFF);
+
+			if (!file.write(reinterpret_cast<const char *>(row.data()), row.size()))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void screenshot_writer::convert_to_rgba8(job &job)
+	{
+		const size_t count = job.width * job.height;
+
+		if (job.data != nullptr)
+		{
+			// Memory owned by the caller must not be modified, so convert into a buffer of the job instead, which also removes any row padding
+			job.pixels.resize(count * 4);
+
+			for (unsigned int y = 0; y < job.height; y++)
+			{
+				if (job.bgra)
+				{
+					pixel_conversion::swizzle_rgba8_bgra8(row_data(job, y), job.pixels.data() + y * job.width * 4, job.width);
+				}
+				else
+				{
+					memcpy(job.pixels.data() + y * job.width * 4, row_data(job, y), job.width * 4);
+				}
+			}
+
+			job.data = nullptr;
+		}
+		else if (job.bgra)
+		{
+			pixel_conversion::swizzle_rgba8_bgra8(job.pixels.data(), job.pixels.data(), count);
+		}
+
+		job.bgra = false;
+
+		pixel_conversion::fill_alpha_rgba8(job.pixels.data(), count, 0xFF);
+	}
+	const uint8_t *screenshot_writer::row_data(const job &job, unsigned int y)
+	{
+		if (job.data != nullptr)
+		{
+			return job.data + y * job.row_pitch;
+		}
+
+		return job.pixels.data() + y * job.width * 4;
+	}
+
+	void screenshot_writer::worker()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+
+		while (true)
+		{
+			_condition.wait(lock, [this]() { return _shutdown || !_jobs.empty(); });
+
+			// Keep going until the queue is empty even when shutting down, so that no screenshot the user took is lost
+			if (_jobs.empty())
+			{
+				break;
+			}
+
+			job job = std::move(_jobs.front());
+			_jobs.pop_front();
+
+			_num_writing++;
+
+			lock.unlock();
+
+			const bool success = write(job);
+
+			if (job.release)
+			{
+				job.release();
+			}
+
+			lock.lock();
+
+			_num_writing--;
+
+			if (success)
+			{
+				_num_written++;
+			}
+			else
+			{
+				_failed.push_back(std::move(job.path));
+			}
+
+			if (_jobs.empty() && _num_writing == 0)
+			{
+				_idle_condition.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,113 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include "filesystem.hpp"
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <ostream>
+#include <functional>
+#include <condition_variable>
+
+namespace reshade
+{
+	/// <summary>
+	/// Encodes captured frames and writes them to disk on background threads, so that saving a screenshot does not stall the render thread.
+	/// It does not depend on any graphics API, so it can be fed with synthetic frames as well.
+	/// </summary>
+	class screenshot_writer
+	{
+	public:
+		enum class file_format
+		{
+			bmp,
+			png,
+			tga
+		};
+
+		struct job
+		{
+			filesystem::path path;
+			file_format format = file_format::png;
+			unsigned int width = 0, height = 0;
+			int compression_level = 6;
+			bool bgra = false;
+			std::vector<uint8_t> pixels;
+			/// <summary>
+			/// Pixel data owned by the caller (e.g. mapped staging memory), which is read instead of "pixels" if set. It has to stay valid until "release" was called.
+			/// </summary>
+			const uint8_t *data = nullptr;
+			/// <summary>
+			/// The distance in bytes from one row of "data" to the next, which may be negative for rows stored bottom-up.
+			/// </summary>
+			ptrdiff_t row_pitch = 0;
+			/// <summary>
+			/// Called on the worker thread once the frame was written or failed to, after which "data" is no longer accessed.
+			/// </summary>
+			std::function<void()> release;
+		};
+
+		/// <summary>
+		/// Start the worker threads.
+		/// </summary>
+		/// <param name="max_queued_jobs">The maximum number of frames waiting to be written. Further frames are rejected until there is space again, which bounds memory usage.</param>
+		/// <param name="num_threads">The number of worker threads to start.</param>
+		screenshot_writer(size_t max_queued_jobs, size_t num_threads);
+		/// <summary>
+		/// Write all remaining queued frames and stop the worker threads.
+		/// </summary>
+		~screenshot_writer();
+
+		/// <summary>
+		/// Queue a frame to be encoded and written in the background.
+		/// </summary>
+		/// <param name="job">The frame, with 32bpp RGBA or BGRA pixel data. The alpha channel is ignored.</param>
+		/// <returns><c>true</c> if the frame was queued, <c>false</c> if the queue is full and the frame was discarded without calling its release function.</returns>
+		bool enqueue(job &&job);
+
+		/// <summary>
+		/// Returns the number of frames that were queued, but not completely written yet.
+		/// </summary>
+		size_t pending() const;
+		/// <summary>
+		/// Returns the number of frames that were written successfully so far.
+		/// </summary>
+		size_t written() const;
+		/// <summary>
+		/// Returns the paths of all frames that failed to be written since the last call.
+		/// </summary>
+		std::vector<filesystem::path> take_failed();
+		/// <summary>
+		/// Block until all queued frames were written.
+		/// </summary>
+		void wait_idle();
+
+		/// <summary>
+		/// Encode a frame and write it to disk on the calling thread. Pixels owned by the job are converted in place as needed by the file format.
+		/// </summary>
+		static bool write(job &job);
+
+	private:
+		static bool write_bmp(std::ostream &file, const job &job);
+		static bool write_png(std::ostream &file, job &job);
+		static bool write_tga(std::ostream &file, const job &job);
+		static void convert_to_rgba8(job &job);
+		static const uint8_t *row_data(const job &job, unsigned int y);
+
+		void worker();
+
+		const size_t _max_queued_jobs;
+		mutable std::mutex _mutex;
+		std::condition_variable _condition, _idle_condition;
+		std::deque<job> _jobs;
+		std::vector<std::thread> _threads;
+		std::vector<filesystem::path> _failed;
+		size_t _num_writing = 0, _num_written = 0;
+		bool _shutdown = false;
+	};
+}
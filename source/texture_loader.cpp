@@ -0,0 +1,148 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "log.hpp"
+#include "dds_file.hpp"
+#include "texture_loader.hpp"
+#include <cstring>
+#include <stb_image.h>
+#include <stb_image_dds.h>
+#include <stb_image_resize.h>
+
+namespace reshade
+{
+	texture_loader::texture_loader(size_t max_ready_images, size_t num_threads) :
+		_queue(max_ready_images, num_threads, [this](request &&request) { return load(std::move(request)); })
+	{
+	}
+
+	bool texture_loader::decode(const filesystem::path &path, unsigned int target_width, unsigned int target_height, std::vector<uint8_t> &pixels)
+	{
+		FILE *file;
+		unsigned char *filedata = nullptr;
+		int width = 0, height = 0, channels = 0;
+
+		if (_wfopen_s(&file, path.wstring().c_str(), L"rb") == 0)
+		{
+			if (stbi_dds_test_file(file))
+			{
+				filedata = stbi_dds_load_from_file(file, &width, &height, &channels, STBI_rgb_alpha);
+			}
+			else
+			{
+				filedata = stbi_load_from_file(file, &width, &height, &channels, STBI_rgb_alpha);
+			}
+
+			fclose(file);
+		}
+
+		if (filedata == nullptr)
+		{
+			return false;
+		}
+
+		pixels.resize(target_width * target_height * 4);
+
+		if (target_width != static_cast<unsigned int>(width) ||
+			target_height != static_cast<unsigned int>(height))
+		{
+			stbir_resize_uint8(filedata, width, height, 0, pixels.data(), target_width, target_height, 0, 4);
+		}
+		else
+		{
+			std::memcpy(pixels.data(), filedata, pixels.size());
+		}
+
+		stbi_image_free(filedata);
+
+		return true;
+	}
+
+	bool texture_loader::load_compressed(const filesystem::path &path, const request &request, std::vector<uint8_t> &data)
+	{
+		FILE *file;
+
+		if (_wfopen_s(&file, path.wstring().c_str(), L"rb") != 0)
+		{
+			return false;
+		}
+
+		std::vector<uint8_t> filedata;
+
+		if (fseek(file, 0, SEEK_END) == 0)
+		{
+			const long size = ftell(file);
+
+			if (size > 0 && fseek(file, 0, SEEK_SET) == 0)
+			{
+				filedata.resize(size);
+
+				if (fread(filedata.data(), 1, filedata.size(), file) != filedata.size())
+				{
+					filedata.clear();
+				}
+			}
+		}
+
+		fclose(file);
+
+		dds::file_info info;
+
+		if (!dds::read_header(filedata.data(), filedata.size(), info))
+		{
+			LOG(ERROR) << "> Source " << path << " is not a block-compressed DDS file.";
+			return false;
+		}
+
+		const auto format = static_cast<texture_format>(request.format);
+
+		// Block-compressed data cannot be resized or converted without decompressing it first, so the file has to match the texture exactly
+		if (info.format != format || info.width != request.width || info.height != request.height || info.levels < request.levels)
+		{
+			LOG(ERROR) << "> Source " << path << " does not match the format, dimensions or number of mipmap levels of texture '" << request.texture_name << "'.";
+			return false;
+		}
+
+		// Additional levels in the file are not needed by the texture and are simply cut off
+		const auto begin = filedata.begin() + info.data_offset;
+		data.assign(begin, begin + dds::mip_chain_size(format, request.width, request.height, request.levels));
+
+		return true;
+	}
+
+	texture_loader::image texture_loader::load(request &&request)
+	{
+		image image;
+		image.source = std::move(request);
+		image.path = filesystem::resolve(image.source.source, image.source.search_paths);
+		image.found = filesystem::exists(image.path);
+
+		if (image.found && dds::is_block_compressed(static_cast<texture_format>(image.source.format)))
+		{
+			// The file is read as-is, so there is nothing to gain from caching it
+			image.success = load_compressed(image.path, image.source, image.pixels);
+		}
+		else if (image.found)
+		{
+			uint64_t entry = 0, key = 0;
+			const bool has_key = image_cache::compute_key(image.path, image.source.width, image.source.height, entry, key);
+
+			// Skip decoding entirely if the file did not change since it was last loaded
+			image.success = has_key && _cache.load(entry, key, image.source.width * image.source.height * 4, image.cached_pixels);
+
+			if (!image.success)
+			{
+				image.success = decode(image.path, image.source.width, image.source.height, image.pixels);
+
+				if (image.success && has_key)
+				{
+					_cache.save(entry, key, image.pixels);
+				}
+			}
+		}
+
+		return image;
+	}
+}
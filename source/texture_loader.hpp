@@ -0,0 +1,92 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include "image_cache.hpp"
+#include "worker_queue.hpp"
+
+namespace reshade
+{
+	/// <summary>
+	/// Loads and decodes image files for textures on background threads, so that the render thread only has to upload the results.
+	/// </summary>
+	class texture_loader
+	{
+	public:
+		struct request
+		{
+			size_t texture_index;
+			std::string texture_name;
+			std::string source;
+			std::vector<filesystem::path> search_paths;
+			unsigned int width, height, levels, format;
+		};
+		struct image
+		{
+			request source;
+			filesystem::path path;
+			bool found = false, success = false;
+			std::vector<uint8_t> pixels;
+			image_cache::mapping cached_pixels;
+
+			/// <summary>
+			/// Returns a pointer to the decoded pixel data, which points directly into the cache file if the image was found in the cache.
+			/// For block-compressed texture formats this is the compressed data of all mipmap levels instead.
+			/// </summary>
+			const uint8_t *data() const { return cached_pixels.data() != nullptr ? cached_pixels.data() : pixels.data(); }
+		};
+
+		/// <summary>
+		/// Start the worker threads.
+		/// </summary>
+		/// <param name="max_ready_images">The maximum number of decoded images waiting to be uploaded. Workers pause until there is space again, which bounds memory usage.</param>
+		/// <param name="num_threads">The number of worker threads to start.</param>
+		texture_loader(size_t max_ready_images, size_t num_threads);
+
+		/// <summary>
+		/// Enable caching of decoded images on disk. Must be called before any requests are queued.
+		/// </summary>
+		/// <param name="directory">The directory to store cached images in.</param>
+		bool open_cache(const filesystem::path &directory) { return _cache.open(directory); }
+
+		/// <summary>
+		/// Queue an image file to be found, loaded and resized to the texture dimensions in the background.
+		/// </summary>
+		void enqueue(request &&request) { _queue.enqueue(std::move(request)); }
+		/// <summary>
+		/// Discard all queued requests and decoded images that were not uploaded yet. Requests currently being decoded are dropped once they finish.
+		/// </summary>
+		void cancel() { _queue.cancel(); }
+
+		/// <summary>
+		/// Pass decoded images to the upload callback until the time budget is used up. At least one image is processed per call, so loading always makes progress.
+		/// </summary>
+		/// <param name="budget">The maximum time to spend in this call.</param>
+		/// <param name="upload">The callback which uploads an image to its texture.</param>
+		/// <returns>The number of images passed to the callback.</returns>
+		size_t process(std::chrono::nanoseconds budget, const std::function<void(const image &)> &upload) { return _queue.process(budget, upload); }
+
+		/// <summary>
+		/// Returns the number of images that were requested, but not passed to the upload callback yet.
+		/// </summary>
+		size_t pending() const { return _queue.pending(); }
+
+		/// <summary>
+		/// Load an image file from disk and resize it to the requested dimensions.
+		/// </summary>
+		static bool decode(const filesystem::path &path, unsigned int width, unsigned int height, std::vector<uint8_t> &pixels);
+		/// <summary>
+		/// Load the block-compressed mipmap chain from a DDS file without decompressing it. Fails if the file does not match the texture format, dimensions or number of levels.
+		/// </summary>
+		static bool load_compressed(const filesystem::path &path, const request &request, std::vector<uint8_t> &data);
+
+	private:
+		image load(request &&request);
+
+		image_cache _cache;
+		worker_queue<request, image> _queue;
+	};
+}
@@ -0,0 +1,110 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "uniform_layout.hpp"
+#include <algorithm>
+
+namespace reshade
+{
+	size_t compute_uniform_layout(uniform_layout_rules rules, std::vector<uniform_layout_entry> &entries)
+	{
+		std::vector<size_t> order(entries.size());
+		// Number of bytes used in each 16-byte register
+		std::vector<size_t> registers;
+
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			auto &entry = entries[i];
+
+			// Matrices are column-major, so each column occupies a separate register
+			const size_t width = entry.rows * 4;
+			const size_t register_count = std::max(1u, entry.elements) * (entry.columns > 1 ? entry.columns : 1);
+
+			if (entry.is_multi_register())
+			{
+				// Only constant buffers can pack other members into the space left over in the last register
+				entry.size = rules == uniform_layout_rules::hlsl_cbuffer ? (register_count - 1) * 16 + width : register_count * 16;
+			}
+			else
+			{
+				entry.size = width;
+			}
+
+			order[i] = i;
+		}
+
+		std::stable_sort(order.begin(), order.end(), [&entries](size_t lhs, size_t rhs) {
+			if (entries[lhs].is_multi_register() != entries[rhs].is_multi_register())
+				return entries[lhs].is_multi_register();
+			return entries[lhs].size > entries[rhs].size;
+		});
+
+		for (const size_t index : order)
+		{
+			auto &entry = entries[index];
+
+			if (entry.is_multi_register())
+			{
+				entry.offset = registers.size() * 16;
+
+				for (size_t size = entry.size; size != 0; size -= std::min<size_t>(size, 16))
+				{
+					registers.push_back(std::min<size_t>(size, 16));
+				}
+				continue;
+			}
+
+			size_t alignment = 4;
+
+			if (rules == uniform_layout_rules::glsl_std140)
+			{
+				// GLSL specification on std140 layout:
+				// 1. If the member is a scalar consuming N basic machine units, the base alignment is N.
+				// 2. If the member is a two- or four-component vector with components consuming N basic machine units, the base alignment is 2N or 4N, respectively.
+				// 3. If the member is a three-component vector with components consuming N basic machine units, the base alignment is 4N.
+				alignment = entry.rows == 3 ? 16 : entry.size;
+			}
+
+			size_t register_index = 0;
+
+			for (; register_index < registers.size(); register_index++)
+			{
+				const size_t offset = (registers[register_index] + alignment - 1) / alignment * alignment;
+
+				if (offset + entry.size <= 16)
+				{
+					break;
+				}
+			}
+
+			if (register_index == registers.size())
+			{
+				registers.push_back(0);
+			}
+
+			auto &used = registers[register_index];
+			used = (used + alignment - 1) / alignment * alignment;
+			entry.offset = register_index * 16 + used;
+			used += entry.size;
+		}
+
+		return registers.size() * 16;
+	}
+	std::vector<size_t> sort_uniform_layout(const std::vector<uniform_layout_entry> &entries)
+	{
+		std::vector<size_t> order(entries.size());
+
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			order[i] = i;
+		}
+
+		std::sort(order.begin(), order.end(), [&entries](size_t lhs, size_t rhs) {
+			return entries[lhs].offset < entries[rhs].offset;
+		});
+
+		return order;
+	}
+}
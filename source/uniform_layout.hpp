@@ -0,0 +1,62 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <vector>
+#include <stddef.h>
+
+namespace reshade
+{
+	enum class uniform_layout_rules
+	{
+		/// <summary>
+		/// D3D10/D3D11 constant buffer packing: Members may not straddle a 16-byte register, arrays and matrices start on a register boundary.
+		/// </summary>
+		hlsl_cbuffer,
+		/// <summary>
+		/// D3D9 constant registers: Same as 'hlsl_cbuffer', but arrays and matrices always occupy whole registers.
+		/// </summary>
+		hlsl_registers,
+		/// <summary>
+		/// GLSL std140 uniform block layout: Two-component vectors are aligned to 8 bytes, three- and four-component vectors to 16 bytes.
+		/// </summary>
+		glsl_std140
+	};
+
+	struct uniform_layout_entry
+	{
+		unsigned int rows = 0, columns = 0, elements = 0;
+		size_t offset = 0, size = 0;
+
+		/// <summary>
+		/// Returns whether this entry spans more than a single register (arrays and matrices).
+		/// </summary>
+		bool is_multi_register() const { return elements != 0 || columns > 1; }
+		/// <summary>
+		/// Returns the index of the 16-byte register this entry starts in.
+		/// </summary>
+		size_t register_index() const { return offset / 16; }
+		/// <summary>
+		/// Returns the component (0 = x, 1 = y, 2 = z, 3 = w) this entry starts at in its first register.
+		/// </summary>
+		unsigned int register_component() const { return static_cast<unsigned int>(offset % 16) / 4; }
+	};
+
+	/// <summary>
+	/// Assign an offset to every entry so that the resulting buffer is as small as possible under the specified packing rules.
+	/// Arrays and matrices are placed first, followed by vectors and scalars in decreasing size, each filling the first register it fits in.
+	/// Declaring the members in order of their offset reproduces the same layout with the implicit packing rules of the target language.
+	/// </summary>
+	/// <param name="rules">The packing rules of the target.</param>
+	/// <param name="entries">The list of entries to lay out. Only the 'offset' and 'size' members are modified.</param>
+	/// <returns>The total size of the buffer in bytes, which is always a multiple of 16.</returns>
+	size_t compute_uniform_layout(uniform_layout_rules rules, std::vector<uniform_layout_entry> &entries);
+	/// <summary>
+	/// Returns the indices of the specified entries sorted by their offset.
+	/// </summary>
+	/// <param name="entries">The list of entries after a call to 'compute_uniform_layout'.</param>
+	std::vector<size_t> sort_uniform_layout(const std::vector<uniform_layout_entry> &entries);
+}
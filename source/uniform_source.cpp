@@ -0,0 +1,89 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "uniform_source.hpp"
+
+namespace reshade
+{
+	bool resolve_uniform_source(const std::unordered_map<std::string, annotation> &annotations, uniform_source_binding &binding)
+	{
+		const std::string source = find_annotation(annotations, "source").as<std::string>();
+
+		if (source.empty())
+		{
+			return false;
+		}
+
+		if (source == "frametime")
+		{
+			binding.source = uniform_source::frametime;
+		}
+		else if (source == "framecount")
+		{
+			binding.source = uniform_source::framecount;
+		}
+		else if (source == "pingpong")
+		{
+			const annotation &step = find_annotation(annotations, "step");
+
+			binding.source = uniform_source::pingpong;
+			binding.min = find_annotation(annotations, "min").as<float>();
+			binding.max = find_annotation(annotations, "max").as<float>();
+			binding.step_min = step.as<float>(0);
+			binding.step_max = step.as<float>(1);
+			binding.smoothing = find_annotation(annotations, "smoothing").as<float>();
+		}
+		else if (source == "date")
+		{
+			binding.source = uniform_source::date;
+		}
+		else if (source == "timer")
+		{
+			binding.source = uniform_source::timer;
+		}
+		else if (source == "key" || source == "mousebutton")
+		{
+			const std::string mode = find_annotation(annotations, "mode").as<std::string>();
+
+			binding.source = source == "key" ? uniform_source::key : uniform_source::mousebutton;
+			binding.keycode = find_annotation(annotations, "keycode").as<int>();
+
+			if (mode == "toggle" || find_annotation(annotations, "toggle").as<bool>())
+			{
+				binding.mode = uniform_source_mode::toggle;
+			}
+			else if (mode == "press")
+			{
+				binding.mode = uniform_source_mode::press;
+			}
+
+			// Invalid key codes and mouse button indices are ignored
+			if (binding.source == uniform_source::key ? (binding.keycode <= 7 || binding.keycode >= 256) : (binding.keycode < 0 || binding.keycode >= 5))
+			{
+				return false;
+			}
+		}
+		else if (source == "mousepoint")
+		{
+			binding.source = uniform_source::mousepoint;
+		}
+		else if (source == "mousedelta")
+		{
+			binding.source = uniform_source::mousedelta;
+		}
+		else if (source == "random")
+		{
+			binding.source = uniform_source::random;
+			binding.min_int = find_annotation(annotations, "min").as<int>();
+			binding.max_int = find_annotation(annotations, "max").as<int>();
+		}
+		else
+		{
+			return false;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,52 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include "annotation.hpp"
+
+namespace reshade
+{
+	enum class uniform_source
+	{
+		none,
+		frametime,
+		framecount,
+		pingpong,
+		date,
+		timer,
+		key,
+		mousepoint,
+		mousedelta,
+		mousebutton,
+		random
+	};
+	enum class uniform_source_mode
+	{
+		down,
+		press,
+		toggle
+	};
+
+	struct uniform_source_binding final
+	{
+		uniform_source source = uniform_source::none;
+		size_t uniform_index = 0;
+		uniform_source_mode mode = uniform_source_mode::down;
+		int keycode = 0;
+		int min_int = 0, max_int = 0;
+		float min = 0, max = 0, step_min = 0, step_max = 0, smoothing = 0;
+	};
+
+	/// <summary>
+	/// Translate the "source" annotation of a uniform and the parameters that go with it into a binding, so that updating the value every frame does not have to look up and parse any annotations.
+	/// </summary>
+	/// <param name="annotations">The annotations of the uniform.</param>
+	/// <param name="binding">The binding to fill in. The uniform index is left untouched.</param>
+	/// <returns><c>true</c> if the uniform has a valid source, <c>false</c> otherwise.</returns>
+	bool resolve_uniform_source(const std::unordered_map<std::string, annotation> &annotations, uniform_source_binding &binding);
+}
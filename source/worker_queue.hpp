@@ -0,0 +1,183 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace reshade
+{
+	/// <summary>
+	/// Runs a function on a pool of worker threads for every queued request and hands the results back to a single consumer thread in small portions.
+	/// </summary>
+	template <typename Request, typename Result>
+	class worker_queue
+	{
+	public:
+		/// <summary>
+		/// Start the worker threads.
+		/// </summary>
+		/// <param name="max_ready_results">The maximum number of results waiting to be processed. Workers pause until there is space again, which bounds memory usage.</param>
+		/// <param name="num_threads">The number of worker threads to start.</param>
+		/// <param name="work">The function which turns a request into a result. It is called on the worker threads.</param>
+		worker_queue(size_t max_ready_results, size_t num_threads, std::function<Result(Request &&)> work) :
+			_max_ready_results(max_ready_results), _work(std::move(work))
+		{
+			for (size_t i = 0; i < num_threads; i++)
+			{
+				_threads.emplace_back(&worker_queue::worker, this);
+			}
+		}
+		~worker_queue()
+		{
+			{ const std::lock_guard<std::mutex> lock(_mutex);
+				_shutdown = true;
+			}
+
+			_request_condition.notify_all();
+			_ready_condition.notify_all();
+
+			for (auto &thread : _threads)
+			{
+				thread.join();
+			}
+		}
+
+		/// <summary>
+		/// Queue a request to be worked on in the background.
+		/// </summary>
+		void enqueue(Request &&request)
+		{
+			{ const std::lock_guard<std::mutex> lock(_mutex);
+				_requests.push_back(std::move(request));
+			}
+
+			_request_condition.notify_one();
+		}
+		/// <summary>
+		/// Discard all queued requests and results that were not processed yet. Requests currently being worked on are dropped once they finish.
+		/// </summary>
+		void cancel()
+		{
+			{ const std::lock_guard<std::mutex> lock(_mutex);
+				_requests.clear();
+				_ready_results.clear();
+				// Results of requests that are still being worked on are out of date, so mark them as stale
+				_generation++;
+			}
+
+			_ready_condition.notify_all();
+		}
+
+		/// <summary>
+		/// Pass results to the callback until the time budget is used up. At least one result is processed per call, so the queue always makes progress.
+		/// </summary>
+		/// <param name="budget">The maximum time to spend in this call.</param>
+		/// <param name="process_result">The callback which consumes a result.</param>
+		/// <returns>The number of results passed to the callback.</returns>
+		template <typename F>
+		size_t process(std::chrono::nanoseconds budget, F process_result)
+		{
+			const auto start_time = std::chrono::high_resolution_clock::now();
+
+			size_t num_processed = 0;
+
+			do
+			{
+				Result result;
+
+				{ const std::lock_guard<std::mutex> lock(_mutex);
+					if (_ready_results.empty())
+					{
+						break;
+					}
+
+					result = std::move(_ready_results.front());
+					_ready_results.pop_front();
+				}
+
+				// Space was freed up in the queue, so a worker waiting on it can continue
+				_ready_condition.notify_one();
+
+				process_result(result);
+
+				num_processed++;
+			} while (std::chrono::high_resolution_clock::now() - start_time < budget);
+
+			return num_processed;
+		}
+
+		/// <summary>
+		/// Returns the number of requests that were queued, but whose results were not passed to the callback yet.
+		/// </summary>
+		size_t pending() const
+		{
+			const std::lock_guard<std::mutex> lock(_mutex);
+
+			return _requests.size() + _num_working + _ready_results.size();
+		}
+
+	private:
+		void worker()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+
+			while (true)
+			{
+				_request_condition.wait(lock, [this]() { return _shutdown || !_requests.empty(); });
+
+				if (_shutdown)
+				{
+					break;
+				}
+
+				Request request = std::move(_requests.front());
+				_requests.pop_front();
+
+				const unsigned int generation = _generation;
+
+				_num_working++;
+
+				lock.unlock();
+
+				Result result = _work(std::move(request));
+
+				lock.lock();
+
+				// Wait for the consumer to process some of the finished results before adding another one
+				_ready_condition.wait(lock, [this, generation]() { return _shutdown || generation != _generation || _ready_results.size() < _max_ready_results; });
+
+				_num_working--;
+
+				if (_shutdown)
+				{
+					break;
+				}
+
+				if (generation == _generation)
+				{
+					_ready_results.push_back(std::move(result));
+				}
+			}
+		}
+
+		const size_t _max_ready_results;
+		const std::function<Result(Request &&)> _work;
+		mutable std::mutex _mutex;
+		std::condition_variable _request_condition, _ready_condition;
+		std::deque<Request> _requests;
+		std::deque<Result> _ready_results;
+		std::vector<std::thread> _threads;
+		size_t _num_working = 0;
+		unsigned int _generation = 0;
+		bool _shutdown = false;
+	};
+}
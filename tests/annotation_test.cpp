@@ -0,0 +1,61 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "test.hpp"
+#include "annotation.hpp"
+
+using namespace reshade;
+
+static void test_numeric_conversion()
+{
+	const int ints[] = { -3, 7 };
+	const annotation a(ints, 2);
+	CHECK_EQUAL(a.as<int>(0), -3);
+	CHECK_EQUAL(a.as<float>(1), 7.0f);
+	CHECK_EQUAL(a.as<std::string>(0), std::string("-3"));
+	CHECK(a.as<bool>(1));
+
+	// Components past the end read as zero
+	CHECK_EQUAL(a.as<int>(2), 0);
+	CHECK_EQUAL(a.as<std::string>(2), std::string());
+
+	// Values with more components than fit inline are still all kept
+	const unsigned int uints[] = { 1, 2, 3, 4, 5, 6 };
+	const annotation b(uints, 6);
+	CHECK_EQUAL(b.size(), 6u);
+	CHECK_EQUAL(b.as<unsigned int>(5), 6u);
+
+	// Strings are parsed on access
+	const annotation c("2.5");
+	CHECK_EQUAL(c.as<float>(), 2.5f);
+	CHECK_EQUAL(c.as<int>(), 2);
+	CHECK(annotation("true").as<bool>());
+	CHECK(!annotation("false").as<bool>());
+}
+
+static void test_float_formatting()
+{
+	const float floats[] = { 0.5f, 1.0f, 0.1f, -2.25f, 1e-6f, 123456.0f, 1.0f / 3.0f };
+	const annotation a(floats, 7);
+
+	// Floats are written like in an effect file, with no more digits than needed to read back the same value
+	CHECK_EQUAL(a.as<std::string>(0), std::string("0.5"));
+	CHECK_EQUAL(a.as<std::string>(1), std::string("1"));
+	CHECK_EQUAL(a.as<std::string>(2), std::string("0.1"));
+	CHECK_EQUAL(a.as<std::string>(3), std::string("-2.25"));
+	CHECK_EQUAL(a.as<std::string>(4), std::string("1e-06"));
+	CHECK_EQUAL(a.as<std::string>(5), std::string("123456"));
+
+	for (size_t i = 0; i < a.size(); i++)
+		CHECK_EQUAL(std::strtof(a.as<std::string>(i).c_str(), nullptr), floats[i]);
+}
+
+int main()
+{
+	test_numeric_conversion();
+	test_float_formatting();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,145 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "test.hpp"
+#include "dirty_range_list.hpp"
+
+using namespace reshade;
+
+typedef std::vector<std::pair<size_t, size_t>> range_vector;
+
+static void test_add()
+{
+	dirty_range_list list;
+	CHECK(list.empty());
+
+	list.add(10, 0);
+	CHECK(list.empty());
+
+	list.add(10, 10);
+	list.add(40, 10);
+	list.add(0, 4);
+	CHECK(list.ranges() == (range_vector { { 0, 4 }, { 10, 20 }, { 40, 50 } }));
+
+	// Adjacent ranges are merged
+	list.add(20, 5);
+	CHECK(list.ranges() == (range_vector { { 0, 4 }, { 10, 25 }, { 40, 50 } }));
+	list.add(4, 6);
+	CHECK(list.ranges() == (range_vector { { 0, 25 }, { 40, 50 } }));
+
+	// Ranges contained in existing ones change nothing
+	list.add(42, 2);
+	CHECK(list.ranges() == (range_vector { { 0, 25 }, { 40, 50 } }));
+
+	// A range overlapping several others merges all of them
+	list.add(60, 4);
+	list.add(20, 42);
+	CHECK(list.ranges() == (range_vector { { 0, 64 } }));
+
+	list.clear();
+	CHECK(list.empty());
+}
+
+static void test_take()
+{
+	dirty_range_list list;
+	size_t dirty_begin = 0, dirty_end = 0;
+
+	CHECK(!list.take(0, 100, dirty_begin, dirty_end));
+
+	list.add(10, 10);
+	list.add(30, 10);
+	list.add(60, 10);
+
+	// Regions without modified bytes leave the list untouched
+	CHECK(!list.take(0, 10, dirty_begin, dirty_end));
+	CHECK(!list.take(20, 30, dirty_begin, dirty_end));
+	CHECK(!list.take(70, 100, dirty_begin, dirty_end));
+	CHECK_EQUAL(list.ranges().size(), 3u);
+
+	// The result is the bounding range of everything in the region, clipped to it, and the parts outside the region stay in the list
+	CHECK(list.take(15, 35, dirty_begin, dirty_end));
+	CHECK_EQUAL(dirty_begin, 15u);
+	CHECK_EQUAL(dirty_end, 35u);
+	CHECK(list.ranges() == (range_vector { { 10, 15 }, { 35, 40 }, { 60, 70 } }));
+
+	// Taking the same region again finds nothing
+	CHECK(!list.take(15, 35, dirty_begin, dirty_end));
+
+	// A region in the middle of a range splits it
+	CHECK(list.take(62, 65, dirty_begin, dirty_end));
+	CHECK_EQUAL(dirty_begin, 62u);
+	CHECK_EQUAL(dirty_end, 65u);
+	CHECK(list.ranges() == (range_vector { { 10, 15 }, { 35, 40 }, { 60, 62 }, { 65, 70 } }));
+
+	CHECK(list.take(0, 100, dirty_begin, dirty_end));
+	CHECK_EQUAL(dirty_begin, 10u);
+	CHECK_EQUAL(dirty_end, 70u);
+	CHECK(list.empty());
+}
+
+static void test_against_bitmap()
+{
+	// Compare against a plain per-byte flag array on a random sequence of operations
+	const size_t storage_size = 256;
+	std::vector<bool> reference(storage_size);
+	dirty_range_list list;
+
+	unsigned int seed = 1;
+	const auto next = [&seed](size_t range) { seed = seed * 1664525 + 1013904223; return (seed >> 8) % range; };
+
+	for (int iteration = 0; iteration < 10000; ++iteration)
+	{
+		const size_t begin = next(storage_size);
+		const size_t end = begin + next(storage_size - begin + 1);
+
+		if (next(3) != 0)
+		{
+			list.add(begin, end - begin);
+			for (size_t i = begin; i < end; ++i)
+				reference[i] = true;
+		}
+		else
+		{
+			size_t expected_begin = end, expected_end = begin;
+			for (size_t i = begin; i < end; ++i)
+				if (reference[i])
+					expected_begin = std::min(expected_begin, i), expected_end = i + 1, reference[i] = false;
+
+			size_t dirty_begin = 0, dirty_end = 0;
+			const bool dirty = list.take(begin, end, dirty_begin, dirty_end);
+
+			CHECK_EQUAL(dirty, expected_begin < expected_end);
+			if (dirty)
+			{
+				CHECK_EQUAL(dirty_begin, expected_begin);
+				CHECK_EQUAL(dirty_end, expected_end);
+			}
+		}
+
+		// The list must stay sorted, disjoint and not contain adjacent ranges that could have been merged
+		std::vector<bool> flags(storage_size);
+		for (size_t i = 0; i < list.ranges().size(); ++i)
+		{
+			const auto &range = list.ranges()[i];
+			CHECK(range.first < range.second);
+			if (i != 0)
+				CHECK(list.ranges()[i - 1].second < range.first);
+			for (size_t k = range.first; k < range.second; ++k)
+				flags[k] = true;
+		}
+
+		CHECK(flags == reference);
+	}
+}
+
+int main()
+{
+	test_add();
+	test_take();
+	test_against_bitmap();
+
+	return TEST_RESULT();
+}
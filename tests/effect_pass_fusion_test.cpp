@@ -0,0 +1,160 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "test.hpp"
+#include "effect_parser.hpp"
+#include "effect_pass_fusion.hpp"
+
+using namespace reshadefx;
+using namespace reshadefx::nodes;
+
+static const char *const common_declarations = R"(
+texture BackBufferTex : COLOR;
+sampler BackBuffer { Texture = BackBufferTex; };
+texture Other { Width = 800; Height = 600; };
+sampler sOther { Texture = Other; };
+
+// The full-screen triangle from ReShade.fxh
+void PostProcessVS(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD)
+{
+	texcoord.x = (id == 2) ? 2.0 : 0.0;
+	texcoord.y = (id == 1) ? 2.0 : 0.0;
+	position = float4(texcoord * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+// The same triangle written differently and under a different name
+void FullscreenVS(uint id : SV_VertexID, out float2 uv : TEXCOORD0, out float4 pos : SV_Position)
+{
+	float2 corner = float2(id == 2, id == 1) * 2.0;
+	if (id > 2)
+		corner = 0.0;
+	pos = float4(corner.x * 2.0 - 1.0, 1.0 - corner.y * 2.0, 0.5, 1.0);
+	uv = corner;
+}
+// Covers the screen too, but the texture coordinates only go up to the center of it
+void ZoomVS(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD)
+{
+	texcoord.x = (id == 2) ? 1.0 : 0.0;
+	texcoord.y = (id == 1) ? 1.0 : 0.0;
+	position = float4(texcoord * float2(4.0, -4.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+// The vertex positions depend on something that is not known when compiling
+uniform float Offset;
+void ShiftedVS(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD)
+{
+	PostProcessVS(id, position, texcoord);
+	position.x += Offset;
+}
+
+float4 InvertPS(float4 vpos : SV_Position, float2 texcoord : TEXCOORD) : SV_Target { return 1.0 - tex2D(BackBuffer, texcoord); }
+float4 GammaPS(float4 vpos : SV_Position, float2 texcoord : TEXCOORD) : SV_Target { float4 color = tex2D(BackBuffer, texcoord); return pow(abs(color), 2.2); }
+float4 TintPS(float4 vpos : SV_Position, float2 texcoord : TEXCOORD) : SV_Target { return tex2D(BackBuffer, texcoord) * float4(1.0, 0.9, 0.8, 1.0); }
+float4 BlurPS(float4 vpos : SV_Position, float2 texcoord : TEXCOORD) : SV_Target { return tex2D(BackBuffer, texcoord + 0.001) + tex2D(BackBuffer, texcoord); }
+float4 MixPS(float4 vpos : SV_Position, float2 texcoord : TEXCOORD) : SV_Target { return tex2D(BackBuffer, texcoord) + tex2D(sOther, texcoord); }
+)";
+
+static bool parse(syntax_tree &ast, const std::string &source)
+{
+	parser parser(ast);
+	if (parser.run(common_declarations + source))
+		return true;
+	printf("%s\n", parser.errors().c_str());
+	return false;
+}
+
+static size_t count_passes(const syntax_tree &ast, size_t technique_count)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < technique_count; ++i)
+		count += ast.techniques[i]->pass_list.size();
+	return count;
+}
+
+static size_t fuse_within_technique(const char *vertex_shader, const char *second_pixel_shader)
+{
+	syntax_tree ast;
+	if (!parse(ast, std::string("technique T { pass { VertexShader = ") + vertex_shader + "; PixelShader = InvertPS; } pass { VertexShader = " + vertex_shader + "; PixelShader = " + second_pixel_shader + "; } }"))
+		return ~size_t(0);
+
+	return fuse_pixel_local_passes(ast, true).removed_pass_count;
+}
+
+static void test_detection()
+{
+	// Vertex shaders are recognized by what they compute, not by their name
+	CHECK_EQUAL(fuse_within_technique("PostProcessVS", "GammaPS"), 1u);
+	CHECK_EQUAL(fuse_within_technique("FullscreenVS", "GammaPS"), 1u);
+	CHECK_EQUAL(fuse_within_technique("ZoomVS", "GammaPS"), 0u);
+	CHECK_EQUAL(fuse_within_technique("ShiftedVS", "GammaPS"), 0u);
+
+	// Only passes that sample the back buffer at the unmodified texture coordinate can be fused
+	CHECK_EQUAL(fuse_within_technique("PostProcessVS", "TintPS"), 1u);
+	CHECK_EQUAL(fuse_within_technique("PostProcessVS", "BlurPS"), 0u);
+	CHECK_EQUAL(fuse_within_technique("PostProcessVS", "MixPS"), 0u);
+
+	// Passes rendering to a texture or blending with the back buffer are not replaced by the next one
+	syntax_tree ast;
+	CHECK(parse(ast, R"(
+technique T1 { pass { VertexShader = PostProcessVS; PixelShader = InvertPS; BlendEnable = true; } pass { VertexShader = PostProcessVS; PixelShader = GammaPS; } }
+technique T2 { pass { VertexShader = PostProcessVS; PixelShader = InvertPS; RenderTarget = Other; } pass { VertexShader = PostProcessVS; PixelShader = GammaPS; } }
+)"));
+	CHECK_EQUAL(fuse_pixel_local_passes(ast, true).removed_pass_count, 0u);
+}
+
+static const intrinsic_expression_node *find_saturate(const function_declaration_node *function)
+{
+	// The fused pixel shader returns a chain of calls, with the color of the previous pass passed in as last argument
+	const auto return_statement = static_cast<const return_statement_node *>(function->definition->statement_list[0]);
+	const auto call = static_cast<const call_expression_node *>(return_statement->return_value);
+	const auto color = call->arguments.back();
+	return color->id == nodeid::intrinsic_expression && static_cast<const intrinsic_expression_node *>(color)->op == intrinsic_expression_node::saturate ?
+		static_cast<const intrinsic_expression_node *>(color) : nullptr;
+}
+
+static void test_fused_techniques()
+{
+	for (const bool clamp_colors : { true, false })
+	{
+		syntax_tree ast;
+		CHECK(parse(ast, R"(
+technique Invert { pass { VertexShader = PostProcessVS; PixelShader = InvertPS; } }
+technique Gamma { pass { VertexShader = PostProcessVS; PixelShader = GammaPS; } }
+technique Tint { pass { VertexShader = PostProcessVS; PixelShader = TintPS; } }
+technique Blur { pass { VertexShader = PostProcessVS; PixelShader = BlurPS; } }
+)"));
+
+		const size_t function_count = ast.functions.size();
+		const pass_fusion_result result = fuse_pixel_local_passes(ast, clamp_colors);
+
+		// The first three techniques form a run, while the last one cannot follow them
+		CHECK_EQUAL(result.fused_techniques.size(), 1u);
+		CHECK_EQUAL(ast.techniques.size(), 5u);
+		if (ast.techniques.size() != 5)
+			continue;
+
+		const technique_declaration_node *const fused = ast.techniques[4];
+		CHECK(result.fused_techniques.count(fused) && result.fused_techniques.at(fused) == std::vector<std::string>({ "Invert", "Gamma", "Tint" }));
+		CHECK_EQUAL(fused->pass_list.size(), 1u);
+		CHECK(fused->annotation_list.count("hidden") != 0);
+
+		// Colors are only clamped between passes when the back buffer would clamp them too, so that HDR values survive on floating-point back buffers
+		CHECK((find_saturate(fused->pass_list[0]->pixel_shader) != nullptr) == clamp_colors);
+
+		// The original techniques still render on their own
+		CHECK_EQUAL(count_passes(ast, 4), 4u);
+		CHECK(ast.techniques[0]->pass_list[0]->pixel_shader->name == "InvertPS");
+
+		revert_pass_fusion(ast, result);
+		CHECK_EQUAL(ast.techniques.size(), 4u);
+		CHECK_EQUAL(ast.functions.size(), function_count);
+	}
+}
+
+int main()
+{
+	test_detection();
+	test_fused_techniques();
+
+	return TEST_RESULT();
+}
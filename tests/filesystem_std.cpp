@@ -0,0 +1,176 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+// The runtime implements 'reshade::filesystem' with the Windows shell API. This implements it on top of 'std::filesystem' instead, so that modules using it can be tested on other platforms too.
+// Module and special folder paths only exist on Windows and are left out.
+
+#include "filesystem.hpp"
+#include <filesystem>
+
+namespace reshade::filesystem
+{
+	static std::filesystem::path to_std(const path &path)
+	{
+		return std::filesystem::u8path(path.string());
+	}
+	static path from_std(const std::filesystem::path &path)
+	{
+		return path.u8string();
+	}
+
+	static bool match_mask(const char *name, const char *mask)
+	{
+		if (*mask == '\0')
+			return *name == '\0';
+		if (*mask == '*')
+			return match_mask(name, mask + 1) || (*name != '\0' && match_mask(name + 1, mask));
+		return *name != '\0' && (*mask == '?' || *mask == *name) && match_mask(name + 1, mask + 1);
+	}
+
+	path::path(const std::string &data) : _data(data)
+	{
+	}
+	path::path(const std::wstring &data) : _data(std::filesystem::path(data).u8string())
+	{
+	}
+
+	bool path::operator==(const path &other) const
+	{
+		return _data == other._data;
+	}
+	bool path::operator!=(const path &other) const
+	{
+		return !operator==(other);
+	}
+
+	std::wstring path::wstring() const
+	{
+		return to_std(*this).wstring();
+	}
+
+	std::ostream &operator<<(std::ostream &stream, const path &path)
+	{
+		return stream << '\'' << path.string() << '\'';
+	}
+
+	bool path::is_absolute() const
+	{
+		return to_std(*this).is_absolute();
+	}
+
+	path path::parent_path() const
+	{
+		return from_std(to_std(*this).parent_path());
+	}
+	path path::filename() const
+	{
+		return from_std(to_std(*this).filename());
+	}
+	path path::filename_without_extension() const
+	{
+		return from_std(to_std(*this).stem());
+	}
+	path path::extension() const
+	{
+		return from_std(to_std(*this).extension());
+	}
+
+	path &path::replace_extension(const path &extension)
+	{
+		return operator=(from_std(to_std(*this).replace_extension(to_std(extension))));
+	}
+
+	path path::operator/(const path &more) const
+	{
+		return from_std(to_std(*this) / to_std(more));
+	}
+
+	bool exists(const path &path)
+	{
+		std::error_code ec;
+		return std::filesystem::exists(to_std(path), ec);
+	}
+	bool create_directory(const path &path)
+	{
+		std::error_code ec;
+		std::filesystem::create_directory(to_std(path), ec);
+		return std::filesystem::is_directory(to_std(path), ec);
+	}
+	bool remove(const path &path)
+	{
+		std::error_code ec;
+		return std::filesystem::remove(to_std(path), ec);
+	}
+	uint64_t file_size(const path &path)
+	{
+		std::error_code ec;
+		const uint64_t size = std::filesystem::file_size(to_std(path), ec);
+		return ec ? 0 : size;
+	}
+	uint64_t last_write_time(const path &path)
+	{
+		std::error_code ec;
+		const auto time = std::filesystem::last_write_time(to_std(path), ec);
+
+		if (ec)
+		{
+			return 0;
+		}
+
+		// The epoch of the file clock may lie in the future, so flip the sign bit to get an unsigned value that still compares the same way
+		return static_cast<uint64_t>(time.time_since_epoch().count()) ^ (1ull << 63);
+	}
+	bool update_last_write_time(const path &path)
+	{
+		std::error_code ec;
+		std::filesystem::last_write_time(to_std(path), std::filesystem::file_time_type::clock::now(), ec);
+		return !ec;
+	}
+	path resolve(const path &filename, const std::vector<path> &paths)
+	{
+		for (const auto &path : paths)
+		{
+			auto result = absolute(filename, path);
+
+			if (exists(result))
+			{
+				return result;
+			}
+		}
+
+		return filename;
+	}
+	path absolute(const path &filename, const path &parent_path)
+	{
+		if (filename.is_absolute())
+			return filename;
+
+		return parent_path / filename;
+	}
+
+	std::vector<path> list_files(const path &path, const std::string &mask, bool recursive)
+	{
+		std::vector<filesystem::path> result;
+		std::error_code ec;
+
+		for (const auto &entry : std::filesystem::directory_iterator(to_std(path), ec))
+		{
+			if (entry.is_directory(ec))
+			{
+				if (recursive)
+				{
+					const auto recursive_result = list_files(from_std(entry.path()), mask, true);
+					result.insert(result.end(), recursive_result.begin(), recursive_result.end());
+				}
+			}
+			else if (match_mask(entry.path().filename().u8string().c_str(), mask.c_str()))
+			{
+				result.push_back(from_std(entry.path()));
+			}
+		}
+
+		return result;
+	}
+}
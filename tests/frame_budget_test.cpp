@@ -0,0 +1,188 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "test.hpp"
+#include "frame_budget.hpp"
+
+using namespace reshade;
+
+/// <summary>
+/// A technique with a fixed cost per update, whose measured cost is spread over the frames in between its updates.
+/// </summary>
+struct synthetic_technique : frame_budget::item
+{
+	synthetic_technique(uint64_t update_cost, unsigned int max_interval = 1) : update_cost(update_cost)
+	{
+		this->cost = update_cost;
+		this->skipped = false;
+		this->max_interval = max_interval;
+	}
+
+	void measure()
+	{
+		// Skipped techniques keep the cost from when they last ran
+		if (!skipped)
+			cost = update_cost / interval;
+	}
+
+	uint64_t update_cost;
+};
+
+static bool run_frames(frame_budget &budget, uint64_t limit, std::vector<synthetic_technique> &techniques, unsigned int frames)
+{
+	std::vector<frame_budget::item *> items;
+	for (auto &technique : techniques)
+		items.push_back(&technique);
+
+	// The measurements are assumed to have caught up with every change by the next update
+	bool changed = false;
+	for (unsigned int i = 0; i < frames; ++i)
+	{
+		changed |= budget.update(limit, items);
+		for (auto &technique : techniques)
+			technique.measure();
+	}
+	return changed;
+}
+
+static uint64_t running_cost(const std::vector<synthetic_technique> &techniques)
+{
+	uint64_t total = 0;
+	for (const auto &technique : techniques)
+		if (!technique.skipped)
+			total += technique.cost;
+	return total;
+}
+
+static void test_skipping()
+{
+	frame_budget budget(3);
+	std::vector<synthetic_technique> techniques = { 5000, 4000, 3000 };
+
+	// Nothing changes while the costs are within the budget
+	CHECK(!run_frames(budget, 12000, techniques, 10));
+
+	// The least important technique goes first
+	CHECK(run_frames(budget, 8000, techniques, 1));
+	CHECK(!techniques[0].skipped && !techniques[1].skipped && techniques[2].skipped);
+
+	// After a change, the next one is only made once the measurements had time to settle, and the most important technique always stays
+	CHECK(!run_frames(budget, 4000, techniques, 2));
+	CHECK(run_frames(budget, 4000, techniques, 1));
+	CHECK(!techniques[0].skipped && techniques[1].skipped && techniques[2].skipped);
+	CHECK(!run_frames(budget, 4000, techniques, 30));
+	CHECK(!techniques[0].skipped);
+
+	// Techniques are restored in order of importance, and only with some headroom left in the budget
+	CHECK(!run_frames(budget, 9500, techniques, 30));
+	CHECK(run_frames(budget, 10000, techniques, 3));
+	CHECK(!techniques[1].skipped && techniques[2].skipped);
+
+	// A cheap unimportant technique does not take the place of an expensive important one
+	techniques[1].skipped = true;
+	CHECK(!run_frames(budget, 9000, techniques, 30));
+	CHECK(techniques[1].skipped && techniques[2].skipped);
+}
+
+static void test_decimation()
+{
+	frame_budget budget(1);
+	std::vector<synthetic_technique> techniques = { { 4000, 8 }, { 4000, 4 }, { 8000, 8 } };
+
+	// The least important technique is updated every second, then every fourth and every eighth frame, before it is skipped
+	CHECK(run_frames(budget, 9000, techniques, 1));
+	CHECK_EQUAL(techniques[2].interval, 2u);
+	run_frames(budget, 9000, techniques, 1);
+	CHECK_EQUAL(techniques[2].interval, 4u);
+	CHECK_EQUAL(running_cost(techniques), 10000u);
+	run_frames(budget, 9000, techniques, 1);
+	CHECK_EQUAL(techniques[2].interval, 8u);
+	CHECK(!techniques[2].skipped);
+	CHECK_EQUAL(running_cost(techniques), 9000u);
+	CHECK(!run_frames(budget, 9000, techniques, 10));
+
+	// Only then is it skipped, and the next one is updated less often, but never beyond its own maximum
+	run_frames(budget, 5500, techniques, 1);
+	CHECK(techniques[2].skipped);
+	CHECK_EQUAL(techniques[2].interval, 8u);
+	run_frames(budget, 5500, techniques, 2);
+	CHECK_EQUAL(techniques[1].interval, 4u);
+	CHECK(!techniques[1].skipped);
+	CHECK(!run_frames(budget, 5500, techniques, 10));
+	run_frames(budget, 4500, techniques, 1);
+	CHECK(techniques[1].skipped);
+	CHECK_EQUAL(techniques[1].interval, 4u);
+
+	// The most important technique is never degraded
+	CHECK(!run_frames(budget, 1000, techniques, 10));
+	CHECK(!techniques[0].skipped && techniques[0].interval == 1);
+
+	// Restoring goes the same way back, most important first, assuming each halving of the interval doubles the cost
+	run_frames(budget, 100000, techniques, 1);
+	CHECK(!techniques[1].skipped);
+	CHECK_EQUAL(techniques[1].interval, 4u);
+	run_frames(budget, 100000, techniques, 2);
+	CHECK_EQUAL(techniques[1].interval, 1u);
+	run_frames(budget, 100000, techniques, 1);
+	CHECK(!techniques[2].skipped);
+	run_frames(budget, 100000, techniques, 3);
+	CHECK_EQUAL(techniques[2].interval, 1u);
+	CHECK_EQUAL(running_cost(techniques), 16000u);
+	CHECK(!run_frames(budget, 100000, techniques, 10));
+
+	// Halving the interval is held back when the doubled cost would not fit
+	std::vector<synthetic_technique> decimated = { { 4000, 8 }, { 8000, 8 } };
+	decimated[1].interval = 4;
+	decimated[1].cost = 2000;
+	CHECK(!run_frames(budget, 8000, decimated, 10));
+	CHECK(run_frames(budget, 9000, decimated, 1));
+	CHECK_EQUAL(decimated[1].interval, 2u);
+}
+
+static void test_stability()
+{
+	// Costs that vary from frame to frame around the budget must not make the controller change its mind every time it is allowed to
+	frame_budget budget(10);
+	std::vector<synthetic_technique> techniques = { { 3000, 8 }, { 3000, 8 }, { 3000, 8 }, { 3000, 8 } };
+	std::vector<frame_budget::item *> items;
+	for (auto &technique : techniques)
+		items.push_back(&technique);
+
+	unsigned int changes = 0, late_changes = 0;
+	uint32_t random = 1;
+
+	for (unsigned int frame = 0; frame < 2000; ++frame)
+	{
+		for (auto &technique : techniques)
+		{
+			random = random * 1103515245 + 12345;
+			technique.update_cost = 3000 + (random >> 16) % 300;
+			technique.measure();
+		}
+
+		if (budget.update(8000, items))
+		{
+			changes++;
+			if (frame >= 1000)
+				late_changes++;
+		}
+
+		// The budget is never exceeded for longer than it takes to react
+		if (frame >= 1000)
+			CHECK(running_cost(techniques) <= 8000);
+	}
+
+	CHECK(changes > 0);
+	CHECK_EQUAL(late_changes, 0u);
+}
+
+int main()
+{
+	test_skipping();
+	test_decimation();
+	test_stability();
+
+	return TEST_RESULT();
+}
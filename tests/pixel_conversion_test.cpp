@@ -0,0 +1,174 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "test.hpp"
+#include "pixel_conversion.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace reshade;
+
+static std::vector<uint8_t> make_pixels(size_t count, unsigned int seed)
+{
+	std::vector<uint8_t> data(count * 4);
+	for (auto &value : data)
+		value = static_cast<uint8_t>((seed = seed * 1664525 + 1013904223) >> 24);
+	return data;
+}
+
+static float float16_to_float(uint16_t value)
+{
+	const int exponent = (value >> 10) & 0x1F, mantissa = value & 0x3FF;
+	const float sign = (value & 0x8000) ? -1.0f : 1.0f;
+
+	if (exponent == 0)
+		return sign * std::ldexp(static_cast<float>(mantissa), -24);
+	if (exponent == 31)
+		return mantissa != 0 ? NAN : sign * INFINITY;
+	return sign * std::ldexp(static_cast<float>(mantissa | 0x400), exponent - 25);
+}
+
+static void test_against_scalar()
+{
+	// Cover counts that are not a multiple of the vector width and sources that are not aligned
+	for (size_t count = 0; count < 40; ++count)
+	{
+		for (size_t offset = 0; offset < 4; ++offset)
+		{
+			const std::vector<uint8_t> source = make_pixels(count + 1, static_cast<unsigned int>(count * 4 + offset));
+			const uint8_t *const src = source.data() + offset;
+
+			const int8_t patterns[][4] = { { 2, 1, 0, 3 }, { 0, 0, 0, -1 }, { 3, -1, 1, 2 } };
+			for (const auto &pattern : patterns)
+			{
+				std::vector<uint8_t> expected(count * 4), actual(count * 4);
+				pixel_conversion::scalar::shuffle_rgba8(src, expected.data(), count, pattern);
+				pixel_conversion::shuffle_rgba8(src, actual.data(), count, pattern);
+				CHECK(actual == expected);
+
+				// In place
+				std::vector<uint8_t> in_place(src, src + count * 4);
+				pixel_conversion::shuffle_rgba8(in_place.data(), in_place.data(), count, pattern);
+				CHECK(in_place == expected);
+			}
+
+			{
+				std::vector<uint8_t> expected(src, src + count * 4), actual = expected;
+				pixel_conversion::scalar::fill_alpha_rgba8(expected.data(), count, 0x80);
+				pixel_conversion::fill_alpha_rgba8(actual.data(), count, 0x80);
+				CHECK(actual == expected);
+			}
+
+			for (unsigned int channels = 1; channels <= 2; ++channels)
+			{
+				// One extra byte to detect writes past the end
+				std::vector<uint8_t> expected(count * channels + 1, 0xCD), actual = expected;
+				pixel_conversion::scalar::extract_channels_rgba8(src, expected.data(), count, channels);
+				pixel_conversion::extract_channels_rgba8(src, actual.data(), count, channels);
+				CHECK(actual == expected);
+			}
+		}
+	}
+
+	// Swizzling twice restores the original
+	const std::vector<uint8_t> original = make_pixels(1001, 7);
+	std::vector<uint8_t> data = original;
+	pixel_conversion::swizzle_rgba8_bgra8(data.data(), data.data(), 1001);
+	CHECK(data[0] == original[2] && data[2] == original[0] && data[3] == original[3]);
+	pixel_conversion::swizzle_rgba8_bgra8(data.data(), data.data(), 1001);
+	CHECK(data == original);
+}
+
+static void test_float16()
+{
+	using pixel_conversion::scalar::float_to_float16;
+
+	CHECK_EQUAL(float_to_float16(0.0f), 0x0000);
+	CHECK_EQUAL(float_to_float16(-0.0f), 0x8000);
+	CHECK_EQUAL(float_to_float16(1.0f), 0x3C00);
+	CHECK_EQUAL(float_to_float16(0.5f), 0x3800);
+	CHECK_EQUAL(float_to_float16(-2.0f), 0xC000);
+	CHECK_EQUAL(float_to_float16(65504.0f), 0x7BFF);
+	CHECK_EQUAL(float_to_float16(65520.0f), 0x7C00);
+	CHECK_EQUAL(float_to_float16(INFINITY), 0x7C00);
+	CHECK_EQUAL(float_to_float16(-INFINITY), 0xFC00);
+	CHECK((float_to_float16(NAN) & 0x7FFF) > 0x7C00);
+	CHECK_EQUAL(float_to_float16(std::ldexp(1.0f, -24)), 0x0001);
+	CHECK_EQUAL(float_to_float16(std::ldexp(1.0f, -26)), 0x0000);
+	// Ties round to even
+	CHECK_EQUAL(float_to_float16(1.0f + std::ldexp(1.0f, -11)), 0x3C00);
+	CHECK_EQUAL(float_to_float16(1.0f + 3 * std::ldexp(1.0f, -11)), 0x3C02);
+
+	// Every finite half-precision value converts back to itself
+	for (unsigned int bits = 0; bits < 0x10000; ++bits)
+	{
+		if ((bits & 0x7C00) == 0x7C00)
+			continue;
+		CHECK_EQUAL(float_to_float16(float16_to_float(static_cast<uint16_t>(bits))), bits);
+	}
+
+	uint8_t unorm[256];
+	for (unsigned int i = 0; i < 256; ++i)
+		unorm[i] = static_cast<uint8_t>(i);
+
+	uint16_t converted[256];
+	pixel_conversion::unorm8_to_float16(unorm, converted, 256);
+	CHECK_EQUAL(converted[0], 0x0000);
+	CHECK_EQUAL(converted[255], 0x3C00);
+	for (unsigned int i = 0; i < 256; ++i)
+		CHECK(std::fabs(float16_to_float(converted[i]) - i / 255.0f) <= std::ldexp(1.0f, -12));
+}
+
+template <typename F>
+static double measure(F function)
+{
+	// Take the best of a few runs to reduce noise
+	double best = 1e9;
+	for (int run = 0; run < 5; ++run)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		function();
+		best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+	}
+	return best;
+}
+
+static void benchmark_4k()
+{
+	const size_t count = 3840 * 2160;
+	const std::vector<uint8_t> source = make_pixels(count, 1);
+	std::vector<uint8_t> dst(count * 4);
+	std::vector<uint16_t> dst16(count * 4);
+
+	const int8_t bgra[4] = { 2, 1, 0, 3 };
+
+	printf("Converting a 3840x2160 RGBA8 texture (scalar reference / library, in ms):\n");
+	printf("  swizzle RGBA to BGRA: %7.2f / %7.2f\n",
+		measure([&]() { pixel_conversion::scalar::shuffle_rgba8(source.data(), dst.data(), count, bgra); }),
+		measure([&]() { pixel_conversion::swizzle_rgba8_bgra8(source.data(), dst.data(), count); }));
+	printf("  fill alpha:           %7.2f / %7.2f\n",
+		measure([&]() { pixel_conversion::scalar::fill_alpha_rgba8(dst.data(), count, 0xFF); }),
+		measure([&]() { pixel_conversion::fill_alpha_rgba8(dst.data(), count, 0xFF); }));
+	printf("  extract R8:           %7.2f / %7.2f\n",
+		measure([&]() { pixel_conversion::scalar::extract_channels_rgba8(source.data(), dst.data(), count, 1); }),
+		measure([&]() { pixel_conversion::extract_channels_rgba8(source.data(), dst.data(), count, 1); }));
+	printf("  extract RG8:          %7.2f / %7.2f\n",
+		measure([&]() { pixel_conversion::scalar::extract_channels_rgba8(source.data(), dst.data(), count, 2); }),
+		measure([&]() { pixel_conversion::extract_channels_rgba8(source.data(), dst.data(), count, 2); }));
+	printf("  UNORM8 to FLOAT16:    %7.2f / %7.2f\n",
+		measure([&]() { for (size_t i = 0; i < count * 4; ++i) dst16[i] = pixel_conversion::scalar::float_to_float16(source[i] / 255.0f); }),
+		measure([&]() { pixel_conversion::unorm8_to_float16(source.data(), dst16.data(), count * 4); }));
+}
+
+int main()
+{
+	test_against_scalar();
+	test_float16();
+	benchmark_4k();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,60 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "png_encoder.hpp"
+#include "png_test_image.hpp"
+#include <zlib.h>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+
+using namespace reshade;
+
+static void benchmark(unsigned int width, unsigned int height)
+{
+	const std::vector<uint8_t> pixels = make_image(width, height, 1);
+	const unsigned int num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	printf("Encoding a %ux%u frame (%u threads):\n", width, height, num_threads);
+
+	// Reference point: zlib with its default settings on a single thread, compressing the rows without filtering them
+	{
+		std::vector<uint8_t> filtered((width * 4 + 1) * height);
+		for (unsigned int y = 0; y < height; ++y)
+			memcpy(filtered.data() + y * (width * 4 + 1) + 1, pixels.data() + y * width * 4, width * 4);
+
+		uLongf size = compressBound(static_cast<uLong>(filtered.size()));
+		std::vector<uint8_t> compressed(size);
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		compress2(compressed.data(), &size, filtered.data(), static_cast<uLong>(filtered.size()), Z_DEFAULT_COMPRESSION);
+		const auto end = std::chrono::high_resolution_clock::now();
+
+		printf("  zlib level 6, 1 thread:      %8.2f ms, %6.2f MB\n", std::chrono::duration<double, std::milli>(end - start).count(), size / 1e6);
+	}
+
+	for (const int level : { 1, 6 })
+	{
+		for (unsigned int threads = 1; threads <= num_threads; threads = threads == num_threads ? threads + 1 : num_threads)
+		{
+			std::vector<uint8_t> file;
+
+			const auto start = std::chrono::high_resolution_clock::now();
+			png::encode(pixels.data(), width, height, level, threads, file);
+			const auto end = std::chrono::high_resolution_clock::now();
+
+			printf("  png level %d, %2u thread(s):  %8.2f ms, %6.2f MB\n", level, threads, std::chrono::duration<double, std::milli>(end - start).count(), file.size() / 1e6);
+		}
+	}
+}
+
+int main()
+{
+	benchmark(3840, 2160);
+	benchmark(7680, 4320);
+
+	return 0;
+}
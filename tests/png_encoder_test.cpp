@@ -0,0 +1,150 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "test.hpp"
+#include "png_encoder.hpp"
+#include "png_test_image.hpp"
+#include <zlib.h>
+#include <cstring>
+#include <algorithm>
+
+using namespace reshade;
+
+static uint32_t read_uint32(const uint8_t *data)
+{
+	return static_cast<uint32_t>(data[0]) << 24 | data[1] << 16 | data[2] << 8 | data[3];
+}
+
+static uint8_t paeth_predictor(int a, int b, int c)
+{
+	const int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+	return static_cast<uint8_t>(pa <= pb && pa <= pc ? a : pb <= pc ? b : c);
+}
+
+/// <summary>
+/// Decode a PNG file written by the encoder with zlib, checking the structure of every chunk along the way.
+/// </summary>
+static bool decode(const std::vector<uint8_t> &file, unsigned int &width, unsigned int &height, std::vector<uint8_t> &pixels)
+{
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	if (file.size() < 8 || memcmp(file.data(), signature, 8) != 0)
+		return false;
+
+	std::vector<uint8_t> compressed;
+	bool has_header = false, has_end = false;
+
+	for (size_t offset = 8; offset < file.size();)
+	{
+		if (has_end || file.size() - offset < 12)
+			return false;
+
+		const uint32_t size = read_uint32(&file[offset]);
+		if (file.size() - offset - 12 < size)
+			return false;
+
+		const uint8_t *const type = &file[offset + 4], *const data = type + 4;
+		if (read_uint32(data + size) != crc32(crc32(0, nullptr, 0), type, size + 4))
+			return false;
+
+		if (memcmp(type, "IHDR", 4) == 0)
+		{
+			// 8 bits per channel, RGBA, deflate, adaptive filtering, no interlacing
+			if (size != 13 || data[8] != 8 || data[9] != 6 || data[10] != 0 || data[11] != 0 || data[12] != 0)
+				return false;
+			width = read_uint32(data);
+			height = read_uint32(data + 4);
+			has_header = true;
+		}
+		else if (memcmp(type, "IDAT", 4) == 0)
+		{
+			compressed.insert(compressed.end(), data, data + size);
+		}
+		else if (memcmp(type, "IEND", 4) == 0)
+		{
+			has_end = true;
+		}
+
+		offset += size + 12;
+	}
+
+	if (!has_header || !has_end)
+		return false;
+
+	// Every row is prefixed with its filter type. 'uncompress' also verifies the Adler-32 checksum of the joined strips.
+	const size_t row_size = width * 4;
+	std::vector<uint8_t> filtered((row_size + 1) * height);
+	uLongf filtered_size = static_cast<uLongf>(filtered.size());
+	if (uncompress(filtered.data(), &filtered_size, compressed.data(), static_cast<uLong>(compressed.size())) != Z_OK || filtered_size != filtered.size())
+		return false;
+
+	pixels.assign(row_size * height, 0);
+	const std::vector<uint8_t> zero_row(row_size);
+
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		const uint8_t *const src = filtered.data() + y * (row_size + 1) + 1;
+		const uint8_t *const prev = y > 0 ? pixels.data() + (y - 1) * row_size : zero_row.data();
+		uint8_t *const row = pixels.data() + y * row_size;
+
+		for (size_t i = 0; i < row_size; ++i)
+		{
+			const uint8_t a = i >= 4 ? row[i - 4] : 0, b = prev[i], c = i >= 4 ? prev[i - 4] : 0;
+
+			switch (src[-1])
+			{
+			case 0: row[i] = src[i]; break;
+			case 1: row[i] = static_cast<uint8_t>(src[i] + a); break;
+			case 2: row[i] = static_cast<uint8_t>(src[i] + b); break;
+			case 3: row[i] = static_cast<uint8_t>(src[i] + ((a + b) >> 1)); break;
+			case 4: row[i] = static_cast<uint8_t>(src[i] + paeth_predictor(a, b, c)); break;
+			default: return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void test_round_trip()
+{
+	const unsigned int sizes[][2] = { { 1, 1 }, { 3, 1 }, { 1, 7 }, { 17, 13 }, { 64, 64 }, { 333, 97 }, { 1000, 300 } };
+
+	for (const auto &size : sizes)
+	{
+		const std::vector<uint8_t> pixels = make_image(size[0], size[1], size[0] * 31 + size[1]);
+
+		for (int level = 0; level <= 9; ++level)
+		{
+			for (const unsigned int num_threads : { 1u, 3u, 8u })
+			{
+				std::vector<uint8_t> file;
+				png::encode(pixels.data(), size[0], size[1], level, num_threads, file);
+
+				unsigned int width = 0, height = 0;
+				std::vector<uint8_t> decoded;
+				CHECK(decode(file, width, height, decoded));
+				CHECK_EQUAL(width, size[0]);
+				CHECK_EQUAL(height, size[1]);
+				CHECK(decoded == pixels);
+			}
+		}
+	}
+
+	// Long runs of identical pixels exercise the longest matches and distances
+	std::vector<uint8_t> flat(512 * 512 * 4, 0x7F);
+	std::vector<uint8_t> file;
+	png::encode(flat.data(), 512, 512, 9, 4, file);
+	unsigned int width = 0, height = 0;
+	std::vector<uint8_t> decoded;
+	CHECK(decode(file, width, height, decoded) && decoded == flat);
+	CHECK(file.size() < flat.size() / 100);
+}
+
+int main()
+{
+	test_round_trip();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,29 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+
+inline std::vector<uint8_t> make_image(unsigned int width, unsigned int height, unsigned int seed)
+{
+	// Smooth gradients with some noise, so that both the filters and the match finder have something to do
+	std::vector<uint8_t> pixels(width * height * 4);
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			seed = seed * 1664525 + 1013904223;
+			uint8_t *const pixel = pixels.data() + (y * width + x) * 4;
+			pixel[0] = static_cast<uint8_t>(x * 255 / std::max(width, 1u));
+			pixel[1] = static_cast<uint8_t>(y * 255 / std::max(height, 1u) + (seed >> 30));
+			pixel[2] = static_cast<uint8_t>((x / 16 + y / 16) % 2 ? 0x20 : 0xE0);
+			pixel[3] = 0xFF;
+		}
+	}
+	return pixels;
+}
@@ -0,0 +1,182 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "test.hpp"
+#include "opengl_program_cache.hpp"
+#include <fstream>
+#include <filesystem>
+
+using namespace reshade;
+using namespace reshade::opengl;
+
+static const filesystem::path cache_directory = "program_cache_test_data";
+
+static std::vector<uint8_t> make_binary(size_t size, uint8_t seed)
+{
+	std::vector<uint8_t> binary(size);
+	for (size_t i = 0; i < size; ++i)
+		binary[i] = static_cast<uint8_t>(seed + i);
+	return binary;
+}
+
+static void test_key_derivation()
+{
+	program_cache cache_a, cache_b;
+	CHECK(cache_a.open(cache_directory, "Vendor\nRenderer\n4.5 1.0"));
+	CHECK(cache_b.open(cache_directory / "other", "Vendor\nRenderer\n4.5 2.0"));
+
+	const uint64_t key = cache_a.compute_key({ "vs", "ps" });
+
+	CHECK_EQUAL(cache_a.compute_key({ "vs", "ps" }), key);
+	// The stage boundaries are part of the key, not just the concatenated source
+	CHECK(cache_a.compute_key({ "vsp", "s" }) != key);
+	CHECK(cache_a.compute_key({ "ps", "vs" }) != key);
+	CHECK(cache_a.compute_key({ "vs" }) != key);
+	// The same sources on a different driver never share an entry
+	CHECK(cache_b.compute_key({ "vs", "ps" }) != key);
+}
+
+static void test_file_format()
+{
+	program_cache cache;
+	CHECK(cache.open(cache_directory, "Vendor\nRenderer\n4.5 1.0"));
+
+	const uint64_t key = cache.compute_key({ "round", "trip" });
+	const std::vector<uint8_t> binary = make_binary(100, 7);
+
+	uint32_t format = 0;
+	std::vector<uint8_t> loaded;
+
+	CHECK(!cache.load(key, format, loaded));
+	CHECK(cache.save(key, 0x1234, binary));
+	CHECK(cache.load(key, format, loaded));
+	CHECK_EQUAL(format, 0x1234u);
+	CHECK(loaded == binary);
+
+	// Saving again replaces the entry without counting it twice
+	const uint64_t size = cache.total_size();
+	CHECK(cache.save(key, 0x1234, binary));
+	CHECK_EQUAL(cache.total_size(), size);
+
+	// A truncated entry is rejected and removed
+	std::filesystem::resize_file(cache.entry_path(key).native(), filesystem::file_size(cache.entry_path(key)) - 1);
+	CHECK(!cache.load(key, format, loaded));
+	CHECK(!filesystem::exists(cache.entry_path(key)));
+
+	// An entry with trailing data or a damaged header is rejected too
+	CHECK(cache.save(key, 0x1234, binary));
+	std::ofstream(cache.entry_path(key).native(), std::ios::binary | std::ios::app).put(0);
+	CHECK(!cache.load(key, format, loaded));
+
+	CHECK(cache.save(key, 0x1234, binary));
+	{
+		std::fstream file(cache.entry_path(key).native(), std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(0);
+		file.put('X');
+	}
+	CHECK(!cache.load(key, format, loaded));
+	CHECK_EQUAL(cache.total_size(), 0u);
+
+	// An entry renamed to a different key does not match the key stored inside it
+	const uint64_t other_key = cache.compute_key({ "other" });
+	CHECK(cache.save(key, 0x1234, binary));
+	std::filesystem::rename(cache.entry_path(key).native(), cache.entry_path(other_key).native());
+	CHECK(!cache.load(other_key, format, loaded));
+
+	// Nothing can be stored or found once the cache is closed
+	cache.close();
+	CHECK(!cache.save(key, 0x1234, binary));
+	CHECK(!cache.load(key, format, loaded));
+}
+
+static void test_driver_invalidation()
+{
+	const std::vector<uint8_t> binary = make_binary(64, 1);
+
+	uint64_t key;
+	{
+		program_cache cache;
+		CHECK(cache.open(cache_directory, "Vendor\nRenderer\n4.5 1.0"));
+		CHECK(!cache.driver_changed());
+		key = cache.compute_key({ "vs", "ps" });
+		CHECK(cache.save(key, 1, binary));
+	}
+
+	// Reopening with the same driver keeps the entry
+	{
+		program_cache cache;
+		CHECK(cache.open(cache_directory, "Vendor\nRenderer\n4.5 1.0"));
+		CHECK(!cache.driver_changed());
+		CHECK(cache.total_size() != 0);
+
+		uint32_t format = 0;
+		std::vector<uint8_t> loaded;
+		CHECK(cache.load(key, format, loaded));
+	}
+
+	// A driver update discards every entry, even those whose key would collide
+	{
+		program_cache cache;
+		CHECK(cache.open(cache_directory, "Vendor\nRenderer\n4.5 2.0"));
+		CHECK(cache.driver_changed());
+		CHECK_EQUAL(cache.total_size(), 0u);
+		CHECK(!filesystem::exists(cache.entry_path(key)));
+	}
+}
+
+static void test_eviction()
+{
+	const uint64_t entry_size = 1000;
+	const std::vector<uint8_t> binary = make_binary(entry_size, 3);
+
+	program_cache cache;
+	CHECK(cache.open(cache_directory, "Vendor\nRenderer\n4.5 1.0", 3 * entry_size + 3 * 64));
+
+	uint64_t keys[4];
+	for (int i = 0; i < 4; ++i)
+		keys[i] = cache.compute_key({ std::to_string(i) });
+
+	// Give every entry a distinct age, since file times can be too coarse to order entries written in quick succession
+	const auto now = std::filesystem::file_time_type::clock::now();
+	for (int i = 0; i < 3; ++i)
+	{
+		CHECK(cache.save(keys[i], 1, binary));
+		std::filesystem::last_write_time(cache.entry_path(keys[i]).native(), now - std::chrono::hours(10 - i));
+	}
+
+	// Using the oldest entry makes the second one the least recently used
+	uint32_t format = 0;
+	std::vector<uint8_t> loaded;
+	CHECK(cache.load(keys[0], format, loaded));
+
+	CHECK(cache.save(keys[3], 1, binary));
+	CHECK(cache.total_size() <= 3 * entry_size + 3 * 64);
+	CHECK(filesystem::exists(cache.entry_path(keys[0])));
+	CHECK(!filesystem::exists(cache.entry_path(keys[1])));
+	CHECK(filesystem::exists(cache.entry_path(keys[2])));
+	CHECK(filesystem::exists(cache.entry_path(keys[3])));
+
+	// Lowering the limit trims the cache when it is opened again
+	program_cache smaller_cache;
+	CHECK(smaller_cache.open(cache_directory, "Vendor\nRenderer\n4.5 1.0", entry_size + 64));
+	CHECK(smaller_cache.total_size() <= entry_size + 64);
+	CHECK(filesystem::exists(smaller_cache.entry_path(keys[3])) || filesystem::exists(smaller_cache.entry_path(keys[0])));
+}
+
+int main()
+{
+	std::filesystem::remove_all(cache_directory.native());
+
+	test_key_derivation();
+	std::filesystem::remove_all(cache_directory.native());
+	test_file_format();
+	std::filesystem::remove_all(cache_directory.native());
+	test_driver_invalidation();
+	std::filesystem::remove_all(cache_directory.native());
+	test_eviction();
+	std::filesystem::remove_all(cache_directory.native());
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,157 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "test.hpp"
+#include "query_ring.hpp"
+
+using namespace reshade;
+
+/// <summary>
+/// Stands in for the queries of a graphics API. A query issued in a frame has its result available once the GPU finished that frame.
+/// </summary>
+struct fake_backend
+{
+	explicit fake_backend(size_t size) : issued_frames(size) { }
+
+	void issue(size_t index, uint64_t frame)
+	{
+		issued_frames[index] = frame;
+	}
+	bool available(size_t index) const
+	{
+		return issued_frames[index] <= finished_frame && finished_frame != ~0ull;
+	}
+
+	std::vector<uint64_t> issued_frames;
+	uint64_t finished_frame = ~0ull;
+};
+
+/// <summary>
+/// Render a number of frames, with the GPU being a fixed number of frames behind, and collect the frames results were read for.
+/// </summary>
+static size_t run_frames(query_ring &ring, fake_backend &backend, uint64_t first_frame, uint64_t frame_count, uint64_t gpu_lag, std::vector<uint64_t> &read_frames)
+{
+	size_t measured = 0;
+
+	for (uint64_t frame = first_frame; frame < first_frame + frame_count; ++frame)
+	{
+		backend.finished_frame = frame >= gpu_lag ? frame - gpu_lag : ~0ull;
+
+		ring.poll([&backend, &read_frames](size_t index, uint64_t query_frame) {
+			if (!backend.available(index))
+				return false;
+			// The frame handed back has to be the one the query was issued in
+			CHECK_EQUAL(query_frame, backend.issued_frames[index]);
+			read_frames.push_back(query_frame);
+			return true;
+		});
+
+		size_t index = ~size_t(0);
+		if (ring.reserve(frame, index))
+		{
+			CHECK(index < ring.size());
+			backend.issue(index, frame);
+			measured++;
+		}
+	}
+
+	return measured;
+}
+
+static void test_lagging_gpu()
+{
+	// A GPU that is fewer frames behind than there are queries gets every frame measured, and each result arrives once it finished
+	query_ring ring(4);
+	fake_backend backend(ring.size());
+	std::vector<uint64_t> read_frames;
+
+	CHECK_EQUAL(run_frames(ring, backend, 0, 20, 2, read_frames), 20u);
+	CHECK_EQUAL(read_frames.size(), 18u);
+	for (size_t i = 0; i < read_frames.size(); ++i)
+		CHECK_EQUAL(read_frames[i], i);
+	CHECK_EQUAL(ring.pending(), 2u);
+
+	// When it falls further behind than that, frames are left out instead of waiting, but results still belong to the right frames
+	read_frames.clear();
+	const size_t measured = run_frames(ring, backend, 20, 40, 6, read_frames);
+	CHECK(measured < 40);
+	CHECK(measured > 10);
+	for (size_t i = 1; i < read_frames.size(); ++i)
+		CHECK(read_frames[i] > read_frames[i - 1]);
+	CHECK_EQUAL(read_frames.front(), 18u);
+}
+
+static void test_stalled_gpu()
+{
+	query_ring ring(3);
+	fake_backend backend(ring.size());
+
+	// Nothing finishes, so the ring fills up and no further queries are issued
+	size_t index = 0;
+	for (uint64_t frame = 0; frame < 3; ++frame)
+	{
+		CHECK(ring.reserve(frame, index));
+		backend.issue(index, frame);
+	}
+	CHECK(!ring.reserve(3, index));
+	CHECK(!ring.reserve(4, index));
+	CHECK_EQUAL(ring.pending(), 3u);
+	CHECK_EQUAL(ring.poll([&backend](size_t index, uint64_t) { return backend.available(index); }), 0u);
+
+	// Once the GPU caught up with the first frame, only that one query is freed again
+	backend.finished_frame = 0;
+	CHECK_EQUAL(ring.poll([&backend](size_t index, uint64_t) { return backend.available(index); }), 1u);
+	CHECK(ring.reserve(5, index));
+	backend.issue(index, 5);
+	CHECK(!ring.reserve(6, index));
+
+	backend.finished_frame = 5;
+	std::vector<uint64_t> read_frames;
+	CHECK_EQUAL(ring.poll([&backend, &read_frames](size_t index, uint64_t frame) { read_frames.push_back(frame); return backend.available(index); }), 3u);
+	CHECK(read_frames == std::vector<uint64_t>({ 1, 2, 5 }));
+	CHECK_EQUAL(ring.pending(), 0u);
+}
+
+static void test_oldest_first()
+{
+	query_ring ring(4);
+	size_t index = 0;
+	std::vector<size_t> indices;
+	for (uint64_t frame = 10; frame < 13; ++frame)
+	{
+		CHECK(ring.reserve(frame, index));
+		indices.push_back(index);
+	}
+
+	// Newer results are not read before the oldest one, even if they happen to be available
+	std::vector<uint64_t> read_frames;
+	CHECK_EQUAL(ring.poll([&indices, &read_frames](size_t index, uint64_t frame) {
+		read_frames.push_back(frame);
+		return index != indices[0];
+	}), 0u);
+	CHECK(read_frames == std::vector<uint64_t>({ 10 }));
+
+	// Reading stops at the first result that is not available yet and continues there next time
+	read_frames.clear();
+	CHECK_EQUAL(ring.poll([&indices, &read_frames](size_t index, uint64_t frame) {
+		read_frames.push_back(frame);
+		return index != indices[2];
+	}), 2u);
+	CHECK(read_frames == std::vector<uint64_t>({ 10, 11, 12 }));
+	CHECK_EQUAL(ring.pending(), 1u);
+
+	read_frames.clear();
+	CHECK_EQUAL(ring.poll([&read_frames](size_t, uint64_t frame) { read_frames.push_back(frame); return true; }), 1u);
+	CHECK(read_frames == std::vector<uint64_t>({ 12 }));
+}
+
+int main()
+{
+	test_lagging_gpu();
+	test_stalled_gpu();
+	test_oldest_first();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,560 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "test.hpp"
+#include "render_graph.hpp"
+#include "effect_parser.hpp"
+#include "effect_syntax_tree.hpp"
+#include <algorithm>
+
+using namespace reshade;
+using render_graph::pass_state;
+using render_graph::pass_state_desc;
+
+static const char *const common_declarations = R"(
+texture BackBufferTex : COLOR;
+sampler BackBuffer { Texture = BackBufferTex; };
+texture A { Width = 800; Height = 600; };
+sampler sA { Texture = A; };
+texture B { Width = 800; Height = 600; };
+sampler sB { Texture = B; };
+void PostProcessVS(in uint id : SV_VertexID, out float4 position : SV_Position, out float2 texcoord : TEXCOORD)
+{
+	texcoord = float2((id == 2) ? 2.0 : 0.0, (id == 1) ? 2.0 : 0.0);
+	position = float4(texcoord * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+)";
+
+static bool parse(reshadefx::syntax_tree &ast, const std::string &source)
+{
+	reshadefx::parser parser(ast);
+	if (parser.run(common_declarations + source))
+		return true;
+	printf("%s\n", parser.errors().c_str());
+	return false;
+}
+
+static std::string unique_name(const reshadefx::syntax_tree &ast, const std::string &name)
+{
+	for (auto variable : ast.variables)
+		if (variable->name == name)
+			return variable->unique_name;
+	return std::string();
+}
+
+static pass_info make_pass(bool reads_backbuffer, bool writes_backbuffer)
+{
+	pass_info pass;
+	pass.reads_backbuffer = reads_backbuffer;
+	pass.writes_backbuffer = writes_backbuffer;
+	return pass;
+}
+
+static void test_analyze_pass()
+{
+	reshadefx::syntax_tree ast;
+	CHECK(parse(ast, R"(
+float4 Sample(sampler s, float2 uv) { return tex2D(s, uv); }
+float4 Helper(float2 uv) { return Sample(sA, uv) * 2.0; }
+float4 PS1(float4 vpos : SV_Position, float2 uv : TEXCOORD) : SV_Target { return tex2D(BackBuffer, uv); }
+float4 PS2(float4 vpos : SV_Position, float2 uv : TEXCOORD) : SV_Target { if (uv.x > 0.5) return Helper(uv); return Sample(sA, uv) + Helper(uv); }
+void PS3(float4 vpos : SV_Position, float2 uv : TEXCOORD, out float4 a : SV_Target0, out float4 b : SV_Target1) { a = 0.0; b = 1.0; }
+technique T
+{
+	pass P1 { VertexShader = PostProcessVS; PixelShader = PS1; RenderTarget = A; }
+	pass P2 { VertexShader = PostProcessVS; PixelShader = PS2; }
+	pass P3 { VertexShader = PostProcessVS; PixelShader = PS3; RenderTarget0 = A; RenderTarget1 = B; ClearRenderTargets = false; }
+}
+)"));
+
+	CHECK_EQUAL(ast.techniques.size(), 1u);
+	if (ast.techniques.size() != 1 || ast.techniques[0]->pass_list.size() != 3)
+		return;
+
+	CHECK(!unique_name(ast, "A").empty() && !unique_name(ast, "BackBufferTex").empty());
+
+	pass_info info;
+
+	render_graph::analyze_pass(ast.techniques[0]->pass_list[0], info);
+	CHECK(info.reads_backbuffer && !info.writes_backbuffer);
+	CHECK(info.render_targets == std::vector<std::string>({ unique_name(ast, "A") }));
+	CHECK(info.sampled_textures == std::vector<std::string>({ unique_name(ast, "BackBufferTex") }));
+
+	// Samplers passed through function parameters and nested calls are found, and only listed once
+	render_graph::analyze_pass(ast.techniques[0]->pass_list[1], info);
+	CHECK(!info.reads_backbuffer && info.writes_backbuffer);
+	CHECK(info.render_targets.empty());
+	CHECK(info.sampled_textures == std::vector<std::string>({ unique_name(ast, "A") }));
+
+	render_graph::analyze_pass(ast.techniques[0]->pass_list[2], info);
+	CHECK(!info.reads_backbuffer && !info.writes_backbuffer && !info.clear_render_targets);
+	CHECK(info.render_targets == std::vector<std::string>({ unique_name(ast, "A"), unique_name(ast, "B") }));
+	CHECK(info.sampled_textures.empty());
+}
+
+static void test_backbuffer_copies()
+{
+	const auto schedule = [](std::vector<pass_info> &passes) {
+		std::vector<pass_info *> pointers;
+		for (auto &pass : passes)
+			pointers.push_back(&pass);
+		return render_graph::schedule_backbuffer_copies(pointers);
+	};
+
+	std::vector<pass_info> passes;
+	CHECK_EQUAL(schedule(passes), 0u);
+
+	// The copy is outdated at the start of the frame, so the first pass sampling the back buffer needs one
+	passes = { make_pass(false, false), make_pass(true, false), make_pass(true, false) };
+	CHECK_EQUAL(schedule(passes), 1u);
+	CHECK(!passes[0].copy_backbuffer && passes[1].copy_backbuffer && !passes[2].copy_backbuffer);
+
+	// A pass that samples and renders to the back buffer makes the copy outdated only for the passes after it
+	passes = { make_pass(true, true), make_pass(true, true), make_pass(false, true), make_pass(true, false) };
+	CHECK_EQUAL(schedule(passes), 3u);
+	CHECK(passes[0].copy_backbuffer && passes[1].copy_backbuffer && !passes[2].copy_backbuffer && passes[3].copy_backbuffer);
+
+	// Passes rendering to textures in between do not cause copies
+	passes = { make_pass(true, false), make_pass(false, false), make_pass(false, false), make_pass(true, true), make_pass(false, false) };
+	CHECK_EQUAL(schedule(passes), 1u);
+	CHECK(passes[0].copy_backbuffer && !passes[3].copy_backbuffer);
+
+	// A typical chain of single-pass color effects needs a copy before each of them
+	passes.assign(10, make_pass(true, true));
+	CHECK_EQUAL(schedule(passes), 10u);
+
+	// Three techniques that sample the back buffer in their first pass and only write it in their last pass need one copy each, instead of one per pass
+	passes.clear();
+	for (int i = 0; i < 30; ++i)
+		passes.push_back(make_pass(i % 10 == 0 || i % 10 == 9, i % 10 == 9));
+	CHECK_EQUAL(schedule(passes), 3u);
+}
+
+static texture make_texture(const char *name, unsigned int width, unsigned int height, unsigned int levels = 1, texture_format format = texture_format::rgba8)
+{
+	texture texture;
+	texture.unique_name = name;
+	texture.width = width;
+	texture.height = height;
+	texture.levels = levels;
+	texture.format = format;
+	return texture;
+}
+static pass_info make_texture_pass(std::vector<std::string> render_targets, std::vector<std::string> sampled_textures, bool clear_render_targets = true)
+{
+	pass_info pass;
+	pass.render_targets = std::move(render_targets);
+	pass.sampled_textures = std::move(sampled_textures);
+	pass.clear_render_targets = clear_render_targets;
+	return pass;
+}
+
+static void test_texture_size()
+{
+	CHECK_EQUAL(render_graph::texture_size(make_texture("", 256, 128)), 256u * 128 * 4);
+	CHECK_EQUAL(render_graph::texture_size(make_texture("", 256, 128, 1, texture_format::r8)), 256u * 128);
+	CHECK_EQUAL(render_graph::texture_size(make_texture("", 256, 128, 1, texture_format::rgba16f)), 256u * 128 * 8);
+	CHECK_EQUAL(render_graph::texture_size(make_texture("", 256, 128, 1, texture_format::rgba32f)), 256u * 128 * 16);
+	for (const texture_format format : { texture_format::rgba8, texture_format::rg16, texture_format::rg16f, texture_format::r32f })
+		CHECK_EQUAL(render_graph::texture_size(make_texture("", 256, 128, 1, format)), 256u * 128 * 4);
+	CHECK_EQUAL(render_graph::texture_size(make_texture("", 256, 128, 1, texture_format::unknown)), 0u);
+
+	// Every level of the mipmap chain is counted, down to a single pixel
+	CHECK_EQUAL(render_graph::texture_size(make_texture("", 4, 2, 3, texture_format::r8)), 8u + 2 + 1);
+
+	// Block-compressed formats store 4x4 pixels in 8 or 16 bytes, and levels smaller than a block still take a whole one
+	CHECK_EQUAL(render_graph::texture_size(make_texture("", 256, 128, 1, texture_format::dxt1)), 64u * 32 * 8);
+	CHECK_EQUAL(render_graph::texture_size(make_texture("", 256, 128, 1, texture_format::latc1)), 64u * 32 * 8);
+	CHECK_EQUAL(render_graph::texture_size(make_texture("", 256, 128, 1, texture_format::dxt3)), 64u * 32 * 16);
+	CHECK_EQUAL(render_graph::texture_size(make_texture("", 256, 128, 1, texture_format::dxt5)), 64u * 32 * 16);
+	CHECK_EQUAL(render_graph::texture_size(make_texture("", 256, 128, 1, texture_format::latc2)), 64u * 32 * 16);
+	CHECK_EQUAL(render_graph::texture_size(make_texture("", 10, 6, 1, texture_format::dxt1)), 3u * 2 * 8);
+	CHECK_EQUAL(render_graph::texture_size(make_texture("", 8, 8, 4, texture_format::dxt5)), (4u + 1 + 1 + 1) * 16);
+}
+
+static void test_texture_aliasing()
+{
+	std::vector<texture> textures;
+	textures.push_back(make_texture("A", 64, 64));
+	textures.push_back(make_texture("B", 64, 64));
+	textures.push_back(make_texture("C", 64, 64));
+	textures.push_back(make_texture("D", 64, 64));
+	textures.push_back(make_texture("E", 32, 32));
+	textures.push_back(make_texture("F", 64, 64));
+
+	std::vector<technique> techniques(3);
+	// A is only needed until B was rendered, so C can reuse it, while B is still sampled when C is rendered. E has a different size.
+	techniques[0].pass_infos = { make_texture_pass({ "A" }, { }), make_texture_pass({ "B" }, { "A" }), make_texture_pass({ "C" }, { "B" }), make_texture_pass({ "E" }, { "C" }), make_texture_pass({ }, { "E" }) };
+	// D is sampled before it is rendered to, so it keeps its contents from the previous frame
+	techniques[1].pass_infos = { make_texture_pass({ }, { "D" }), make_texture_pass({ "D" }, { }) };
+	// F is rendered in a technique of its own, after A and C are no longer needed
+	techniques[2].pass_infos = { make_texture_pass({ "F" }, { }), make_texture_pass({ }, { "F" }) };
+
+	render_graph::texture_allocation_plan plan = render_graph::plan_texture_aliasing(textures, techniques);
+	CHECK((plan.resources == std::vector<size_t>({ 0, 1, 0, 3, 4, 0 })));
+	CHECK_EQUAL(plan.total_size, 5u * 64 * 64 * 4 + 32 * 32 * 4);
+	CHECK_EQUAL(plan.saved_size, 2u * 64 * 64 * 4);
+
+	// Textures that are not cleared before they are rendered to keep their contents between frames
+	techniques[0].pass_infos[2].clear_render_targets = false;
+	plan = render_graph::plan_texture_aliasing(textures, techniques);
+	CHECK((plan.resources == std::vector<size_t>({ 0, 1, 2, 3, 4, 0 })));
+
+	// Techniques that only update every few frames sample what they rendered on an earlier frame, even if they clear their textures first
+	techniques[0].pass_infos[2].clear_render_targets = true;
+	techniques[2].update_interval = 2;
+	plan = render_graph::plan_texture_aliasing(textures, techniques);
+	CHECK((plan.resources == std::vector<size_t>({ 0, 1, 0, 3, 4, 5 })));
+	CHECK_EQUAL(plan.saved_size, 64u * 64 * 4);
+
+	// Textures used by more than one technique are not shared, since the techniques may be enabled in a different order. C can then no longer reuse A, and F reuses B instead.
+	techniques[2].update_interval = 1;
+	techniques[2].pass_infos.push_back(make_texture_pass({ }, { "A" }));
+	plan = render_graph::plan_texture_aliasing(textures, techniques);
+	CHECK((plan.resources == std::vector<size_t>({ 0, 1, 2, 3, 4, 1 })));
+
+	// Textures that refer to the back buffer or depth buffer are never allocated by the plan
+	textures[1].impl_reference = texture_reference::back_buffer;
+	plan = render_graph::plan_texture_aliasing(textures, techniques);
+	CHECK_EQUAL(plan.total_size, 4u * 64 * 64 * 4 + 32 * 32 * 4);
+
+	// Without a known format there is no telling whether two textures fit in the same memory
+	textures[1].impl_reference = texture_reference::none;
+	textures[0].format = texture_format::unknown;
+	textures[5].format = texture_format::unknown;
+	plan = render_graph::plan_texture_aliasing(textures, techniques);
+	CHECK((plan.resources == std::vector<size_t>({ 0, 1, 2, 3, 4, 5 })));
+}
+
+static void test_mipmap_generation()
+{
+	std::vector<texture> textures;
+	textures.push_back(make_texture("M", 64, 64, 7));
+	textures.push_back(make_texture("N", 64, 64, 7));
+	textures.push_back(make_texture("P", 64, 64, 1));
+	textures.push_back(make_texture("Q", 64, 64, 7));
+	textures.push_back(make_texture("R", 64, 64, 7));
+	textures[4].impl_reference = texture_reference::depth_buffer;
+
+	std::vector<technique> techniques(4);
+	// M is rendered to twice before it is sampled, N is sampled before it is rendered to, P has no mipmaps
+	techniques[0].pass_infos = { make_texture_pass({ "M" }, { }), make_texture_pass({ "M" }, { "R" }), make_texture_pass({ "P" }, { "M" }), make_texture_pass({ }, { "P" }) };
+	techniques[1].pass_infos = { make_texture_pass({ }, { "N" }), make_texture_pass({ "N" }, { }) };
+	// Q is rendered to by one technique and sampled by another
+	techniques[2].pass_infos = { make_texture_pass({ "Q" }, { }) };
+	techniques[3].pass_infos = { make_texture_pass({ }, { "Q" }) };
+
+	render_graph::resolve_mipmapped_textures(textures, techniques);
+
+	// Only textures with mipmaps that effects allocate themselves are listed
+	CHECK(techniques[0].pass_infos[0].mipmapped_render_targets == std::vector<const texture *>({ &textures[0] }));
+	CHECK(techniques[0].pass_infos[1].mipmapped_textures.empty());
+	CHECK(techniques[0].pass_infos[2].mipmapped_render_targets.empty());
+	CHECK(techniques[0].pass_infos[3].mipmapped_textures.empty());
+
+	const auto schedule = [&techniques](std::initializer_list<size_t> enabled) {
+		std::vector<pass_info *> passes;
+		for (const size_t index : enabled)
+			for (auto &pass : techniques[index].pass_infos)
+				passes.push_back(&pass);
+		return render_graph::schedule_mipmap_generation(passes);
+	};
+
+	// Several writes before a single sample generate the mipmaps only once, right before the sample
+	CHECK_EQUAL(schedule({ 0 }), 1u);
+	CHECK(techniques[0].pass_infos[0].generate_mipmaps.empty() && techniques[0].pass_infos[1].generate_mipmaps.empty());
+	CHECK(techniques[0].pass_infos[2].generate_mipmaps == std::vector<const texture *>({ &textures[0] }));
+	// Textures without mipmaps never need them generated
+	CHECK(techniques[0].pass_infos[3].generate_mipmaps.empty());
+
+	// A texture sampled before it is rendered to samples what was rendered in the previous frame, so its mipmaps are generated before the first pass
+	CHECK_EQUAL(schedule({ 1 }), 1u);
+	CHECK(techniques[1].pass_infos[0].generate_mipmaps == std::vector<const texture *>({ &textures[1] }));
+	CHECK(techniques[1].pass_infos[1].generate_mipmaps.empty());
+
+	// Textures rendered to by another technique are generated when that one is enabled, but not while it is turned off
+	CHECK_EQUAL(schedule({ 2, 3 }), 1u);
+	CHECK(techniques[3].pass_infos[0].generate_mipmaps == std::vector<const texture *>({ &textures[3] }));
+	CHECK_EQUAL(schedule({ 3 }), 0u);
+	CHECK(techniques[3].pass_infos[0].generate_mipmaps.empty());
+
+	CHECK_EQUAL(schedule({ 0, 1, 2, 3 }), 3u);
+}
+
+static pass_state_desc make_state(uintptr_t shaders, uintptr_t blend_state, uintptr_t render_target, std::vector<uintptr_t> shader_resources)
+{
+	pass_state_desc desc;
+	desc.add(pass_state::shaders, shaders);
+	desc.add(pass_state::shaders, shaders + 1);
+	desc.add(pass_state::blend_state, blend_state);
+	desc.add(pass_state::depth_stencil_state, 0x100);
+	desc.add(pass_state::render_targets, render_target);
+	for (const uintptr_t resource : shader_resources)
+		desc.add(pass_state::shader_resources, resource);
+	desc.add(pass_state::viewport, render_target == 0 ? 1920 : 960);
+	return desc;
+}
+
+/// <summary>
+/// Records every call the state filter makes instead of binding anything.
+/// </summary>
+struct recording_device
+{
+	void bind(pass_state state)
+	{
+		static const char *const names[] = { "shaders", "blend_state", "depth_stencil_state", "render_targets", "shader_resources", "viewport" };
+		calls.push_back(names[static_cast<size_t>(state)]);
+	}
+	void unbind_resources()
+	{
+		calls.push_back("unbind_resources");
+	}
+
+	std::vector<std::string> take_calls()
+	{
+		std::vector<std::string> result;
+		result.swap(calls);
+		return result;
+	}
+
+	std::vector<std::string> calls;
+};
+
+static const std::vector<std::string> bind_everything = { "shaders", "blend_state", "depth_stencil_state", "shader_resources", "render_targets", "viewport" };
+static const std::vector<std::string> rebind_resources = { "unbind_resources", "shader_resources", "render_targets" };
+
+static void test_state_filter()
+{
+	render_graph::pass_state_filter filter;
+	recording_device device;
+
+	// Everything is bound for the first pass
+	filter.bind(make_state(0x10, 0x20, 0, { 0x30 }), device);
+	CHECK(device.take_calls() == bind_everything);
+
+	// Redundant binds are filtered
+	filter.bind(make_state(0x10, 0x20, 0, { 0x30 }), device);
+	CHECK(device.take_calls().empty());
+
+	// Only the state that differs is bound
+	filter.bind(make_state(0x40, 0x20, 0, { 0x30 }), device);
+	CHECK(device.take_calls() == std::vector<std::string>({ "shaders" }));
+	filter.bind(make_state(0x40, 0x70, 0, { 0x30 }), device);
+	CHECK(device.take_calls() == std::vector<std::string>({ "blend_state" }));
+
+	// Rendering to a texture changes the render targets and the viewport. The resources of the previous pass are unbound first.
+	filter.bind(make_state(0x40, 0x70, 0x50, { 0x30 }), device);
+	CHECK(device.take_calls() == std::vector<std::string>({ "unbind_resources", "shader_resources", "render_targets", "viewport" }));
+
+	// Binding an additional texture changes the shader resources, even though the first one is the same, and so does binding the same ones in a different order
+	filter.bind(make_state(0x40, 0x70, 0x50, { 0x30, 0x60 }), device);
+	CHECK(device.take_calls() == rebind_resources);
+	filter.bind(make_state(0x40, 0x70, 0x50, { 0x60, 0x30 }), device);
+	CHECK(device.take_calls() == rebind_resources);
+
+	// Resources unbound to write to a texture outside of a pass are bound again by the next pass, even if it binds the same ones
+	filter.unbind_resources(device);
+	filter.unbind_resources(device);
+	CHECK(device.take_calls() == std::vector<std::string>({ "unbind_resources" }));
+	filter.bind(make_state(0x40, 0x70, 0x50, { 0x60, 0x30 }), device);
+	CHECK(device.take_calls() == std::vector<std::string>({ "shader_resources", "render_targets" }));
+}
+
+static void test_state_filter_across_techniques()
+{
+	render_graph::pass_state_filter filter;
+	recording_device device;
+
+	filter.bind(make_state(0x10, 0x20, 0, { 0x30 }), device);
+	device.take_calls();
+
+	// The end of a technique leaves no resources bound and the next one binds everything again, even if its first pass matches the last pass of the previous technique
+	filter.end_technique(device);
+	CHECK(device.take_calls() == std::vector<std::string>({ "unbind_resources" }));
+	filter.bind(make_state(0x10, 0x20, 0, { 0x30 }), device);
+	CHECK(device.take_calls() == bind_everything);
+
+	// Nothing is left to unbind at the end of a technique without passes
+	filter.end_technique(device);
+	device.take_calls();
+	filter.end_technique(device);
+	CHECK(device.take_calls().empty());
+}
+
+static void test_state_filter_after_skipped_passes()
+{
+	const std::vector<pass_state_desc> passes = {
+		make_state(0x10, 0x20, 0, { 0x30 }),
+		make_state(0x40, 0x20, 0x50, { 0x30 }),
+		make_state(0x40, 0x20, 0x50, { 0x30 }),
+		make_state(0x10, 0x20, 0, { 0x30 }) };
+
+	render_graph::pass_state_filter filter;
+	recording_device device;
+
+	// The second pass is skipped, so the third one has to bind everything that differs from the first pass, although it matches the pass right before it
+	filter.bind(passes[0], device);
+	device.take_calls();
+	filter.bind(passes[2], device);
+	CHECK(device.take_calls() == std::vector<std::string>({ "shaders", "unbind_resources", "shader_resources", "render_targets", "viewport" }));
+
+	// When the second and third pass are skipped, the last pass matches what the first one bound, so nothing is bound again
+	filter.end_technique(device);
+	filter.bind(passes[0], device);
+	device.take_calls();
+	filter.bind(passes[3], device);
+	CHECK(device.take_calls().empty());
+}
+
+static uint64_t peak_load(const std::vector<unsigned int> &intervals, const std::vector<uint64_t> &costs, const std::vector<unsigned int> &phases)
+{
+	uint64_t peak = 0;
+	for (unsigned int frame = 0; frame < 840; ++frame)
+	{
+		uint64_t load = 0;
+		for (size_t i = 0; i < intervals.size(); ++i)
+			if (intervals[i] <= 1 || frame % intervals[i] == phases[i])
+				load += costs[i];
+		peak = std::max(peak, load);
+	}
+	return peak;
+}
+
+static void test_stagger_updates()
+{
+	CHECK(render_graph::stagger_updates({ }, { }).empty());
+
+	// Techniques with the same interval are spread over all phases, even before their cost was measured
+	std::vector<unsigned int> phases = render_graph::stagger_updates({ 4, 4, 4, 4 }, { 0, 0, 0, 0 });
+	CHECK((phases == std::vector<unsigned int>({ 0, 1, 2, 3 })));
+
+	// Techniques rendered every frame always have the first phase
+	phases = render_graph::stagger_updates({ 1, 0, 2 }, { 100, 100, 100 });
+	CHECK_EQUAL(phases[0], 0u);
+	CHECK_EQUAL(phases[1], 0u);
+
+	// Every phase is less than the interval
+	const std::vector<unsigned int> intervals = { 2, 2, 3, 1, 4, 8, 5, 3 };
+	const std::vector<uint64_t> costs = { 10, 8, 5, 3, 0, 7, 6, 6 };
+	phases = render_graph::stagger_updates(intervals, costs);
+	CHECK_EQUAL(phases.size(), intervals.size());
+	for (size_t i = 0; i < phases.size(); ++i)
+		CHECK(phases[i] < std::max(intervals[i], 1u));
+
+	// The busiest frame is less busy than if all techniques updated on the same frame
+	CHECK(peak_load(intervals, costs, phases) < peak_load(intervals, costs, std::vector<unsigned int>(intervals.size(), 0)));
+
+	// The two expensive techniques take turns, and the cheap ones fill in after them
+	phases = render_graph::stagger_updates({ 2, 2, 4, 4 }, { 10, 10, 5, 5 });
+	CHECK(phases[0] != phases[1]);
+	CHECK(phases[2] != phases[3]);
+	CHECK_EQUAL(peak_load({ 2, 2, 4, 4 }, { 10, 10, 5, 5 }, phases), 15u);
+
+	// An expensive technique gets a frame of its own where possible, even when it comes last in the list
+	phases = render_graph::stagger_updates({ 3, 3, 3 }, { 1, 1, 50 });
+	CHECK(phases[2] != phases[0] && phases[2] != phases[1]);
+	CHECK_EQUAL(peak_load({ 3, 3, 3 }, { 1, 1, 50 }, phases), 50u);
+}
+
+static const reshadefx::nodes::variable_declaration_node *find_variable(const reshadefx::syntax_tree &ast, const std::string &name)
+{
+	for (auto variable : ast.variables)
+		if (variable->name == name)
+			return variable;
+	return nullptr;
+}
+
+static void test_resolution_scale()
+{
+	const std::string source = R"(
+#line 100 "scaled.fx"
+static const float2 PixelSize = float2(1.0 / 800, 1.0 / 600);
+texture Half { Width = 800; Height = 600; MipLevels = 11; };
+sampler sHalf { Texture = Half; };
+texture Mrt1 { Width = 800; Height = 600; };
+texture Mrt2 { Width = 800; Height = 600; };
+texture Mrt3 { Width = 800; Height = 600; };
+texture Small { Width = 400; Height = 300; };
+texture Mrt4 { Width = 800; Height = 600; };
+texture Shared { Width = 800; Height = 600; };
+sampler sShared { Texture = Shared; };
+texture Offset { Width = 800; Height = 600; };
+texture Cascade { Width = 800; Height = 600; };
+float4 HalfPS(float4 vpos : SV_Position, float2 uv : TEXCOORD) : SV_Target { return tex2D(BackBuffer, uv); }
+void MrtPS(float4 vpos : SV_Position, float2 uv : TEXCOORD, out float4 a : SV_Target0, out float4 b : SV_Target1) { a = 0.0; b = 1.0; }
+float4 OffsetPS(float4 vpos : SV_Position, float2 uv : TEXCOORD) : SV_Target { return tex2D(BackBuffer, vpos.xy * PixelSize); }
+float4 ResolvePS(float4 vpos : SV_Position, float2 uv : TEXCOORD) : SV_Target { return tex2D(sHalf, uv) + tex2D(sShared, uv); }
+technique Scaled
+{
+	pass { VertexShader = PostProcessVS; PixelShader = HalfPS; RenderTarget = Half; }
+	pass { VertexShader = PostProcessVS; PixelShader = MrtPS; RenderTarget0 = Mrt1; RenderTarget1 = Mrt2; }
+	pass { VertexShader = PostProcessVS; PixelShader = MrtPS; RenderTarget0 = Mrt3; RenderTarget1 = Small; }
+	pass { VertexShader = PostProcessVS; PixelShader = MrtPS; RenderTarget0 = Mrt4; RenderTarget1 = Shared; }
+	pass { VertexShader = PostProcessVS; PixelShader = OffsetPS; RenderTarget = Offset; }
+	pass { VertexShader = PostProcessVS; PixelShader = HalfPS; RenderTarget = Cascade; }
+	pass { VertexShader = PostProcessVS; PixelShader = MrtPS; RenderTarget0 = Cascade; RenderTarget1 = Offset; }
+	pass { VertexShader = PostProcessVS; PixelShader = ResolvePS; }
+}
+float4 OtherPS(float4 vpos : SV_Position, float2 uv : TEXCOORD) : SV_Target { return tex2D(sShared, uv); }
+technique Other { pass { VertexShader = PostProcessVS; PixelShader = OtherPS; } }
+)";
+
+	const auto is_scaled = [](const reshadefx::syntax_tree &ast, const char *name) {
+		const auto variable = find_variable(ast, name);
+		return variable != nullptr && variable->properties.width == 400 && variable->properties.height == 300 && variable->unique_name.find("_scaled") != std::string::npos;
+	};
+
+	{
+		reshadefx::syntax_tree ast;
+		CHECK(parse(ast, source));
+		if (ast.techniques.size() != 2)
+			return;
+
+		// The pixel size constant is declared on the line the preprocessor expanded the back buffer dimension macros on
+		CHECK_EQUAL(render_graph::scale_technique_resolution(ast, ast.techniques[0], 0.5f, 800, 600, { reshadefx::location("scaled.fx", 100) }), 3u);
+
+		CHECK(is_scaled(ast, "Half"));
+		CHECK_EQUAL(find_variable(ast, "Half")->properties.levels, 9u);
+		// Both render targets of a pass are shrunk together
+		CHECK(is_scaled(ast, "Mrt1") && is_scaled(ast, "Mrt2"));
+		// Neither is if one of them cannot be, because it is not back buffer sized or used by another technique
+		CHECK(!is_scaled(ast, "Mrt3") && !is_scaled(ast, "Small") && find_variable(ast, "Small")->properties.width == 400);
+		CHECK(!is_scaled(ast, "Mrt4") && !is_scaled(ast, "Shared"));
+		// A pass that computes texture coordinates from the back buffer dimensions keeps its render target at full resolution, and so do the passes sharing it
+		CHECK(!is_scaled(ast, "Offset") && !is_scaled(ast, "Cascade"));
+		// Textures the technique does not render to are left alone
+		CHECK(!is_scaled(ast, "A"));
+	}
+
+	{
+		reshadefx::syntax_tree ast;
+		CHECK(parse(ast, source));
+		if (ast.techniques.size() != 2)
+			return;
+
+		// Without any use of the back buffer dimensions, the passes sharing render targets with the offset pass can be shrunk as well
+		CHECK_EQUAL(render_graph::scale_technique_resolution(ast, ast.techniques[0], 0.5f, 800, 600, { }), 5u);
+		CHECK(is_scaled(ast, "Offset") && is_scaled(ast, "Cascade"));
+
+		// Other techniques keep their textures at full resolution
+		CHECK_EQUAL(render_graph::scale_technique_resolution(ast, ast.techniques[1], 0.5f, 800, 600, { }), 0u);
+	}
+}
+
+int main()
+{
+	test_analyze_pass();
+	test_backbuffer_copies();
+	test_texture_size();
+	test_texture_aliasing();
+	test_mipmap_generation();
+	test_state_filter();
+	test_state_filter_across_techniques();
+	test_state_filter_after_skipped_passes();
+	test_stagger_updates();
+	test_resolution_scale();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,267 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "test.hpp"
+#include "screenshot_writer.hpp"
+#include <fstream>
+#include <iterator>
+#include <atomic>
+#include <filesystem>
+
+using namespace reshade;
+
+static const filesystem::path output_directory = "screenshot_writer_test_data";
+
+static screenshot_writer::job make_job(const char *name, screenshot_writer::file_format format, unsigned int width, unsigned int height, bool bgra)
+{
+	screenshot_writer::job job;
+	job.path = output_directory / name;
+	job.format = format;
+	job.width = width;
+	job.height = height;
+	job.bgra = bgra;
+	job.pixels.resize(width * height * 4);
+
+	// Every channel of every pixel gets a distinct value, with an alpha that is not opaque
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			uint8_t *const pixel = job.pixels.data() + (y * width + x) * 4;
+			pixel[0] = static_cast<uint8_t>(x * 16 + y);
+			pixel[1] = static_cast<uint8_t>(x + y * 16);
+			pixel[2] = static_cast<uint8_t>(x ^ (y * 3));
+			pixel[3] = 0x10;
+		}
+	}
+
+	return job;
+}
+
+static std::vector<uint8_t> read_file(const filesystem::path &path)
+{
+	std::ifstream file(path.native(), std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static uint32_t read_u32(const uint8_t *data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+static void test_tga()
+{
+	for (const bool bgra : { false, true })
+	{
+		screenshot_writer::job job = make_job("frame.tga", screenshot_writer::file_format::tga, 5, 3, bgra);
+		const std::vector<uint8_t> source = job.pixels;
+		CHECK(screenshot_writer::write(job));
+
+		const std::vector<uint8_t> data = read_file(job.path);
+		CHECK_EQUAL(data.size(), 18u + 5 * 3 * 4);
+		if (data.size() != 18u + 5 * 3 * 4)
+			continue;
+
+		CHECK_EQUAL(data[2], 2);
+		CHECK_EQUAL(data[12] | (data[13] << 8), 5);
+		CHECK_EQUAL(data[14] | (data[15] << 8), 3);
+		CHECK_EQUAL(data[16], 32);
+		CHECK_EQUAL(data[17], 0x28);
+
+		// Rows are stored top-down in BGRA order with opaque alpha
+		for (size_t i = 0; i < 5 * 3; ++i)
+		{
+			const uint8_t *const src = source.data() + i * 4, *const dst = data.data() + 18 + i * 4;
+			CHECK_EQUAL(dst[0], src[bgra ? 0 : 2]);
+			CHECK_EQUAL(dst[1], src[1]);
+			CHECK_EQUAL(dst[2], src[bgra ? 2 : 0]);
+			CHECK_EQUAL(dst[3], 0xFF);
+		}
+	}
+}
+
+static void test_bmp()
+{
+	for (const bool bgra : { false, true })
+	{
+		// A width of 5 pixels needs one byte of padding per row
+		screenshot_writer::job job = make_job("frame.bmp", screenshot_writer::file_format::bmp, 5, 3, bgra);
+		const std::vector<uint8_t> source = job.pixels;
+		CHECK(screenshot_writer::write(job));
+
+		const std::vector<uint8_t> data = read_file(job.path);
+		CHECK_EQUAL(data.size(), 54u + 16 * 3);
+		if (data.size() != 54u + 16 * 3)
+			continue;
+
+		CHECK(data[0] == 'B' && data[1] == 'M');
+		CHECK_EQUAL(read_u32(&data[2]), data.size());
+		CHECK_EQUAL(read_u32(&data[10]), 54u);
+		CHECK_EQUAL(read_u32(&data[18]), 5u);
+		CHECK_EQUAL(read_u32(&data[22]), 3u);
+		CHECK_EQUAL(data[28], 24);
+
+		// Rows are stored bottom-up in BGR order
+		for (unsigned int y = 0; y < 3; ++y)
+		{
+			for (unsigned int x = 0; x < 5; ++x)
+			{
+				const uint8_t *const src = source.data() + (y * 5 + x) * 4, *const dst = data.data() + 54 + (2 - y) * 16 + x * 3;
+				CHECK_EQUAL(dst[0], src[bgra ? 0 : 2]);
+				CHECK_EQUAL(dst[1], src[1]);
+				CHECK_EQUAL(dst[2], src[bgra ? 2 : 0]);
+			}
+		}
+	}
+}
+
+static void test_png()
+{
+	screenshot_writer::job job = make_job("frame.png", screenshot_writer::file_format::png, 16, 16, true);
+	CHECK(screenshot_writer::write(job));
+
+	// The encoder itself is covered separately, so only check that a PNG file was written from pixels converted to opaque RGBA
+	const std::vector<uint8_t> data = read_file(job.path);
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	CHECK(data.size() > sizeof(signature) && std::equal(signature, signature + 8, data.begin()));
+	CHECK(!job.bgra && job.pixels[3] == 0xFF);
+
+	// Frames with less pixel data than their size claims are rejected
+	screenshot_writer::job truncated = make_job("truncated.png", screenshot_writer::file_format::png, 16, 16, false);
+	truncated.pixels.pop_back();
+	CHECK(!screenshot_writer::write(truncated));
+}
+
+static void test_queue()
+{
+	const int frame_count = 32;
+
+	size_t num_accepted = 0;
+	{
+		// Without worker threads nothing is taken out of the queue, so it fills up
+		screenshot_writer writer(4, 0);
+
+		for (int i = 0; i < 6; ++i)
+		{
+			const std::string name = "queued" + std::to_string(i) + ".tga";
+			num_accepted += writer.enqueue(make_job(name.c_str(), screenshot_writer::file_format::tga, 8, 8, false));
+		}
+
+		CHECK_EQUAL(num_accepted, 4u);
+		CHECK_EQUAL(writer.pending(), 4u);
+	}
+
+	{
+		screenshot_writer writer(frame_count, 2);
+
+		for (int i = 0; i < frame_count; ++i)
+		{
+			const std::string name = "drained" + std::to_string(i) + ".bmp";
+			CHECK(writer.enqueue(make_job(name.c_str(), screenshot_writer::file_format::bmp, 64, 64, true)));
+		}
+	}
+
+	// Destroying the writer writes everything that was still queued
+	for (int i = 0; i < frame_count; ++i)
+		CHECK(filesystem::exists(output_directory / ("drained" + std::to_string(i) + ".bmp")));
+}
+
+static void test_failure()
+{
+	screenshot_writer writer(4, 1);
+
+	CHECK(writer.enqueue(make_job("written.tga", screenshot_writer::file_format::tga, 4, 4, false)));
+	// A directory that does not exist cannot be written to
+	screenshot_writer::job job = make_job("written.tga", screenshot_writer::file_format::tga, 4, 4, false);
+	job.path = output_directory / "missing" / "failed.tga";
+	CHECK(writer.enqueue(std::move(job)));
+
+	for (int i = 0; i < 2000 && writer.pending() != 0; ++i)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	CHECK_EQUAL(writer.pending(), 0u);
+	CHECK_EQUAL(writer.written(), 1u);
+
+	const std::vector<filesystem::path> failed = writer.take_failed();
+	CHECK_EQUAL(failed.size(), 1u);
+	CHECK(!failed.empty() && failed[0].filename() == "failed.tga");
+	// Failures are only reported once
+	CHECK(writer.take_failed().empty());
+}
+
+static void test_borrowed_pixels()
+{
+	const unsigned int width = 5, height = 3;
+	const ptrdiff_t pitch = width * 4 + 12;
+
+	for (const auto format : { screenshot_writer::file_format::bmp, screenshot_writer::file_format::png, screenshot_writer::file_format::tga })
+	{
+		for (const bool bgra : { false, true })
+		{
+			screenshot_writer::job packed = make_job("packed", format, width, height, bgra);
+
+			// Lay the same pixels out like mapped memory of a bottom-up image with padded rows
+			std::vector<uint8_t> memory(pitch * height, 0xCD);
+			for (unsigned int y = 0; y < height; ++y)
+				std::copy_n(packed.pixels.data() + y * width * 4, width * 4, memory.data() + (height - 1 - y) * pitch);
+			const std::vector<uint8_t> original = memory;
+
+			screenshot_writer::job borrowed = make_job("borrowed", format, width, height, bgra);
+			borrowed.pixels.clear();
+			borrowed.data = memory.data() + (height - 1) * pitch;
+			borrowed.row_pitch = -pitch;
+
+			CHECK(screenshot_writer::write(packed));
+			CHECK(screenshot_writer::write(borrowed));
+
+			// The output is the same as for packed pixels and the memory of the caller is left untouched
+			const std::vector<uint8_t> data = read_file(borrowed.path);
+			CHECK(!data.empty() && data == read_file(packed.path));
+			CHECK(memory == original);
+		}
+	}
+
+	// The release function is called once the frame was written, even if that failed
+	std::atomic<int> num_released(0);
+	std::vector<uint8_t> memory(width * height * 4);
+	{
+		screenshot_writer writer(8, 2);
+
+		for (int i = 0; i < 4; ++i)
+		{
+			screenshot_writer::job job = make_job("released.tga", screenshot_writer::file_format::tga, width, height, false);
+			job.pixels.clear();
+			job.data = memory.data();
+			job.row_pitch = width * 4;
+			job.release = [&num_released]() { num_released++; };
+			if (i == 3)
+				job.path = output_directory / "missing" / "released.tga";
+			CHECK(writer.enqueue(std::move(job)));
+		}
+
+		writer.wait_idle();
+
+		CHECK_EQUAL(writer.pending(), 0u);
+		CHECK_EQUAL(num_released.load(), 4);
+		CHECK_EQUAL(writer.take_failed().size(), 1u);
+	}
+}
+
+int main()
+{
+	std::filesystem::remove_all(output_directory.native());
+	std::filesystem::create_directory(output_directory.native());
+
+	test_tga();
+	test_bmp();
+	test_png();
+	test_queue();
+	test_failure();
+	test_borrowed_pixels();
+
+	std::filesystem::remove_all(output_directory.native());
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,22 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace reshade::test
+{
+	inline int failures = 0;
+}
+
+#define CHECK(condition) \
+	do { if (!(condition)) { fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #condition); reshade::test::failures++; } } while (false)
+#define CHECK_EQUAL(actual, expected) \
+	do { if (!((actual) == (expected))) { fprintf(stderr, "%s(%d): check failed: %s == %s\n", __FILE__, __LINE__, #actual, #expected); reshade::test::failures++; } } while (false)
+
+#define TEST_RESULT() \
+	(reshade::test::failures == 0 ? EXIT_SUCCESS : (fprintf(stderr, "%d check(s) failed\n", reshade::test::failures), EXIT_FAILURE))
@@ -0,0 +1,127 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "test.hpp"
+#include "uniform_layout.hpp"
+#include <stdint.h>
+
+using namespace reshade;
+
+static uniform_layout_entry make_entry(unsigned int rows, unsigned int columns = 1, unsigned int elements = 0)
+{
+	uniform_layout_entry entry;
+	entry.rows = rows;
+	entry.columns = columns;
+	entry.elements = elements;
+	return entry;
+}
+
+static void test_hlsl_cbuffer()
+{
+	// float a; float3 b; float2 c; float4 d; float e;
+	std::vector<uniform_layout_entry> entries = { make_entry(1), make_entry(3), make_entry(2), make_entry(4), make_entry(1) };
+
+	// Declaration order would take four registers, since 'c' cannot share the register of 'b'
+	CHECK_EQUAL(compute_uniform_layout(uniform_layout_rules::hlsl_cbuffer, entries), 48u);
+	CHECK_EQUAL(entries[3].offset, 0u);
+	CHECK_EQUAL(entries[1].offset, 16u);
+	CHECK_EQUAL(entries[2].offset, 32u);
+	CHECK_EQUAL(entries[0].offset, 28u);
+	CHECK_EQUAL(entries[4].offset, 40u);
+
+	CHECK_EQUAL(entries[0].register_index(), 1u);
+	CHECK_EQUAL(entries[0].register_component(), 3u);
+
+	const std::vector<size_t> order = sort_uniform_layout(entries);
+	CHECK(order == (std::vector<size_t> { 3, 1, 0, 2, 4 }));
+}
+
+static void test_arrays_and_matrices()
+{
+	// float2 arr[3]; float2 v; float3x3 m; float s;
+	std::vector<uniform_layout_entry> entries = { make_entry(2, 1, 3), make_entry(2), make_entry(3, 3), make_entry(1) };
+
+	// Constant buffers pack into the space left over after the last array element or matrix column
+	CHECK_EQUAL(compute_uniform_layout(uniform_layout_rules::hlsl_cbuffer, entries), 96u);
+	CHECK_EQUAL(entries[2].offset, 0u);
+	CHECK_EQUAL(entries[2].size, 44u);
+	CHECK_EQUAL(entries[0].offset, 48u);
+	CHECK_EQUAL(entries[0].size, 40u);
+	CHECK_EQUAL(entries[3].offset, 44u);
+	CHECK_EQUAL(entries[1].offset, 88u);
+
+	// Constant registers do not, so the remaining vectors need a register of their own
+	CHECK_EQUAL(compute_uniform_layout(uniform_layout_rules::hlsl_registers, entries), 112u);
+	CHECK_EQUAL(entries[0].size, 48u);
+	CHECK_EQUAL(entries[2].offset, 48u);
+	CHECK_EQUAL(entries[2].size, 48u);
+	CHECK_EQUAL(entries[1].offset, 96u);
+	CHECK_EQUAL(entries[3].offset, 104u);
+}
+
+static void test_glsl_std140()
+{
+	// vec3 x; float y; vec2 z; vec2 w; mat4 m;
+	std::vector<uniform_layout_entry> entries = { make_entry(3), make_entry(1), make_entry(2), make_entry(2), make_entry(4, 4) };
+
+	CHECK_EQUAL(compute_uniform_layout(uniform_layout_rules::glsl_std140, entries), 96u);
+	CHECK_EQUAL(entries[4].offset, 0u);
+	CHECK_EQUAL(entries[4].size, 64u);
+	CHECK_EQUAL(entries[0].offset, 64u);
+	// A float fits into the fourth component of a vec3
+	CHECK_EQUAL(entries[1].offset, 76u);
+	// But a vec2 must be aligned to 8 bytes, so it cannot
+	CHECK_EQUAL(entries[2].offset, 80u);
+	CHECK_EQUAL(entries[3].offset, 88u);
+}
+
+static void test_invariants()
+{
+	// Random layouts must never have overlapping members or scalars and vectors that straddle a register
+	uint32_t seed = 12345;
+	const auto next = [&seed](uint32_t range) { seed = seed * 1664525 + 1013904223; return (seed >> 8) % range; };
+
+	for (int iteration = 0; iteration < 200; ++iteration)
+	{
+		std::vector<uniform_layout_entry> entries(1 + next(20));
+		for (auto &entry : entries)
+		{
+			entry.rows = 1 + next(4);
+			entry.columns = next(4) == 0 ? 1 + next(4) : 1;
+			entry.elements = next(4) == 0 ? 1 + next(8) : 0;
+		}
+
+		for (const auto rules : { uniform_layout_rules::hlsl_cbuffer, uniform_layout_rules::hlsl_registers, uniform_layout_rules::glsl_std140 })
+		{
+			const size_t total_size = compute_uniform_layout(rules, entries);
+			CHECK_EQUAL(total_size % 16, 0u);
+
+			const std::vector<size_t> order = sort_uniform_layout(entries);
+			for (size_t i = 0; i < order.size(); ++i)
+			{
+				const auto &entry = entries[order[i]];
+				CHECK(entry.offset + entry.size <= total_size);
+
+				if (i + 1 < order.size())
+					CHECK(entry.offset + entry.size <= entries[order[i + 1]].offset);
+
+				if (entry.is_multi_register())
+					CHECK_EQUAL(entry.offset % 16, 0u);
+				else
+					CHECK_EQUAL(entry.offset / 16, (entry.offset + entry.size - 1) / 16);
+			}
+		}
+	}
+}
+
+int main()
+{
+	test_hlsl_cbuffer();
+	test_arrays_and_matrices();
+	test_glsl_std140();
+	test_invariants();
+
+	return TEST_RESULT();
+}
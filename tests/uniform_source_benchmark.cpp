@@ -0,0 +1,225 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "test.hpp"
+#include "uniform_source.hpp"
+#include <chrono>
+
+using namespace reshade;
+
+typedef std::unordered_map<std::string, annotation> annotation_map;
+
+static void test_resolve()
+{
+	uniform_source_binding binding;
+	CHECK(!resolve_uniform_source({ }, binding));
+	CHECK(!resolve_uniform_source({ { "source", "unknown" } }, binding));
+
+	const float step[2] = { 1.0f, 3.0f };
+	CHECK(resolve_uniform_source({ { "source", "pingpong" }, { "min", "-2" }, { "max", "2.5" }, { "step", annotation(step, 2) } }, binding));
+	CHECK(binding.source == uniform_source::pingpong);
+	CHECK_EQUAL(binding.min, -2.0f);
+	CHECK_EQUAL(binding.max, 2.5f);
+	CHECK_EQUAL(binding.step_min, 1.0f);
+	CHECK_EQUAL(binding.step_max, 3.0f);
+
+	binding = uniform_source_binding();
+	CHECK(resolve_uniform_source({ { "source", "key" }, { "keycode", "32" }, { "toggle", "true" } }, binding));
+	CHECK(binding.source == uniform_source::key);
+	CHECK(binding.mode == uniform_source_mode::toggle);
+	CHECK_EQUAL(binding.keycode, 32);
+
+	binding = uniform_source_binding();
+	CHECK(resolve_uniform_source({ { "source", "mousebutton" }, { "keycode", "1" }, { "mode", "press" } }, binding));
+	CHECK(binding.mode == uniform_source_mode::press);
+
+	// Invalid key codes and mouse buttons are filtered out
+	CHECK(!resolve_uniform_source({ { "source", "key" }, { "keycode", "3" } }, binding));
+	CHECK(!resolve_uniform_source({ { "source", "mousebutton" }, { "keycode", "5" } }, binding));
+}
+
+static float update(const uniform_source_binding &binding, float frametime, float timer)
+{
+	switch (binding.source)
+	{
+		case uniform_source::frametime:
+			return frametime;
+		case uniform_source::timer:
+			return timer;
+		case uniform_source::pingpong:
+			return binding.min + binding.step_min * frametime;
+		case uniform_source::key:
+		case uniform_source::mousebutton:
+			return static_cast<float>(binding.keycode);
+		case uniform_source::random:
+			return static_cast<float>(binding.min_int);
+		default:
+			return 0.0f;
+	}
+}
+
+// Annotations as they were stored before they became typed, as strings that are parsed again on every access
+typedef std::unordered_map<std::string, std::vector<std::string>> string_annotation_map;
+
+static string_annotation_map to_strings(const annotation_map &annotations)
+{
+	string_annotation_map result;
+	for (const auto &annotation : annotations)
+		for (size_t i = 0; i < annotation.second.size(); ++i)
+			result[annotation.first].push_back(annotation.second.as<std::string>(i));
+	return result;
+}
+
+static float parse_float(string_annotation_map &annotations, const char *name, size_t i = 0)
+{
+	// Like the old code, this inserts annotations that do not exist
+	const std::vector<std::string> &values = annotations[name];
+	return i < values.size() ? static_cast<float>(std::strtod(values[i].c_str(), nullptr)) : 0.0f;
+}
+static int parse_int(string_annotation_map &annotations, const char *name)
+{
+	const std::vector<std::string> &values = annotations[name];
+	return values.empty() ? 0 : static_cast<int>(std::strtol(values[0].c_str(), nullptr, 10));
+}
+
+/// <summary>
+/// A copy of the lookup the runtime did for every uniform on every frame before sources were resolved at load time.
+/// </summary>
+static bool update_from_strings(string_annotation_map &annotations, float frametime, float timer, float &value)
+{
+	const auto it = annotations.find("source");
+
+	if (it == annotations.end())
+	{
+		return false;
+	}
+
+	const std::string source = it->second.empty() ? std::string() : it->second[0];
+	uniform_source_binding binding;
+
+	if (source == "frametime")
+	{
+		binding.source = uniform_source::frametime;
+	}
+	else if (source == "pingpong")
+	{
+		binding.source = uniform_source::pingpong;
+		binding.min = parse_float(annotations, "min");
+		binding.max = parse_float(annotations, "max");
+		binding.step_min = parse_float(annotations, "step", 0);
+		binding.step_max = parse_float(annotations, "step", 1);
+		binding.smoothing = parse_float(annotations, "smoothing");
+	}
+	else if (source == "timer")
+	{
+		binding.source = uniform_source::timer;
+	}
+	else if (source == "key" || source == "mousebutton")
+	{
+		const std::vector<std::string> &mode = annotations["mode"];
+
+		binding.source = source == "key" ? uniform_source::key : uniform_source::mousebutton;
+		binding.keycode = parse_int(annotations, "keycode");
+
+		if ((!mode.empty() && mode[0] == "toggle") || parse_int(annotations, "toggle") != 0)
+		{
+			binding.mode = uniform_source_mode::toggle;
+		}
+	}
+	else if (source == "random")
+	{
+		binding.source = uniform_source::random;
+		binding.min_int = parse_int(annotations, "min");
+		binding.max_int = parse_int(annotations, "max");
+	}
+	else
+	{
+		return false;
+	}
+
+	value = update(binding, frametime, timer);
+	return true;
+}
+
+static void benchmark_update()
+{
+	// Effect collections easily declare hundreds of uniforms, so use a few thousand to make the difference measurable
+	const size_t uniform_count = 4096;
+	const int frame_count = 200;
+
+	const float step[2] = { 1.0f, 3.0f };
+	const annotation_map templates[] = {
+		{ { "source", "frametime" } },
+		{ { "source", "timer" } },
+		{ { "source", "pingpong" }, { "min", "0" }, { "max", "10" }, { "step", annotation(step, 2) }, { "smoothing", "0.5" } },
+		{ { "source", "key" }, { "keycode", "32" }, { "mode", "toggle" } },
+		{ { "source", "random" }, { "min", "0" }, { "max", "100" } },
+		{ { "ui_type", "drag" }, { "ui_min", "0.0" }, { "ui_max", "1.0" } },
+	};
+
+	std::vector<annotation_map> uniforms;
+	std::vector<string_annotation_map> string_uniforms;
+	for (size_t i = 0; i < uniform_count; ++i)
+	{
+		uniforms.push_back(templates[i % (sizeof(templates) / sizeof(*templates))]);
+		string_uniforms.push_back(to_strings(uniforms.back()));
+	}
+
+	std::vector<float> storage_before(uniform_count), storage_after(uniform_count);
+
+	// Before: Every frame looked up the source annotation of every uniform and compared and parsed strings to decide what to do
+	const auto time_before = std::chrono::high_resolution_clock::now();
+
+	for (int frame = 0; frame < frame_count; ++frame)
+	{
+		for (size_t i = 0; i < uniform_count; ++i)
+		{
+			float value = 0.0f;
+			if (update_from_strings(string_uniforms[i], 16.6f, static_cast<float>(frame), value))
+				storage_before[i] = value;
+		}
+	}
+
+	const auto time_resolve = std::chrono::high_resolution_clock::now();
+
+	// After: Sources are resolved once when the effect is loaded and every frame only walks the compact list of bindings
+	std::vector<uniform_source_binding> bindings;
+	for (size_t i = 0; i < uniform_count; ++i)
+	{
+		uniform_source_binding binding;
+		binding.uniform_index = i;
+		if (resolve_uniform_source(uniforms[i], binding))
+			bindings.push_back(binding);
+	}
+
+	const auto time_after = std::chrono::high_resolution_clock::now();
+
+	for (int frame = 0; frame < frame_count; ++frame)
+	{
+		for (const auto &binding : bindings)
+			storage_after[binding.uniform_index] = update(binding, 16.6f, static_cast<float>(frame));
+	}
+
+	const auto time_end = std::chrono::high_resolution_clock::now();
+
+	CHECK(storage_before == storage_after);
+
+	const auto per_frame = [frame_count](std::chrono::high_resolution_clock::duration duration) {
+		return std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(duration).count() / frame_count;
+	};
+
+	printf("Updating %zu uniforms (%zu with a source):\n", uniform_count, bindings.size());
+	printf("  parsing string annotations every frame: %10.2f us per frame\n", per_frame(time_resolve - time_before));
+	printf("  resolving once at load time:            %10.2f us once + %.2f us per frame\n",
+		std::chrono::duration_cast<std::chrono::duration<double, std::micro>>(time_after - time_resolve).count(), per_frame(time_end - time_after));
+}
+
+int main()
+{
+	test_resolve();
+	benchmark_update();
+
+	return TEST_RESULT();
+}
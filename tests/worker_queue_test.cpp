@@ -0,0 +1,117 @@
+/**
+ * Copyright (C) 2014 Patrick Mours. All rights reserved.
+ * License: https://github.com/crosire/reshade#license
+ */
+
+#include "test.hpp"
+#include "worker_queue.hpp"
+#include <atomic>
+
+using namespace reshade;
+
+template <typename F>
+static bool wait_until(F condition)
+{
+	// The condition is only evaluated until it is met once, since it may have side effects
+	for (int i = 0; i < 2000; ++i)
+	{
+		if (condition())
+			return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return false;
+}
+
+static void test_order()
+{
+	// With a single worker every request is finished in the order it was queued
+	worker_queue<int, int> queue(4, 1, [](int &&value) { return value * 2; });
+
+	for (int i = 0; i < 100; ++i)
+		queue.enqueue(int(i));
+
+	std::vector<int> results;
+	CHECK(wait_until([&]() { queue.process(std::chrono::hours(1), [&results](int value) { results.push_back(value); }); return results.size() == 100; }));
+
+	CHECK_EQUAL(results.size(), 100u);
+	for (int i = 0; i < static_cast<int>(results.size()); ++i)
+		CHECK_EQUAL(results[i], i * 2);
+	CHECK_EQUAL(queue.pending(), 0u);
+}
+
+static void test_bounded()
+{
+	// Workers stop once the limit of finished results is reached, so they do not keep memory for everything that was queued
+	std::atomic<int> num_finished(0);
+	worker_queue<int, int> queue(2, 1, [&num_finished](int &&value) { num_finished++; return value; });
+
+	for (int i = 0; i < 10; ++i)
+		queue.enqueue(int(i));
+
+	// Two results waiting in the queue, plus the one the worker holds on to until there is space
+	CHECK(wait_until([&num_finished]() { return num_finished == 3; }));
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	CHECK_EQUAL(num_finished.load(), 3);
+	CHECK_EQUAL(queue.pending(), 10u);
+
+	size_t num_processed = 0;
+	CHECK(wait_until([&]() { num_processed += queue.process(std::chrono::hours(1), [](int) { }); return num_processed == 10; }));
+	CHECK_EQUAL(num_finished.load(), 10);
+}
+
+static void test_budget()
+{
+	worker_queue<int, int> queue(8, 1, [](int &&value) { return value; });
+
+	for (int i = 0; i < 8; ++i)
+		queue.enqueue(int(i));
+
+	CHECK(wait_until([&queue]() { return queue.pending() == 8 && queue.process(std::chrono::nanoseconds(0), [](int) { }) == 1; }));
+
+	// A call always makes progress, even if a single result takes longer than the budget
+	const auto slow_upload = [](int) { std::this_thread::sleep_for(std::chrono::milliseconds(5)); };
+	CHECK_EQUAL(queue.process(std::chrono::milliseconds(1), slow_upload), 1u);
+
+	// Without a budget to limit it, everything that is ready is processed in one call
+	CHECK(wait_until([&queue]() { return queue.pending() == 6 && queue.process(std::chrono::hours(1), [](int) { }) == 6; }));
+	CHECK_EQUAL(queue.process(std::chrono::hours(1), [](int) { }), 0u);
+}
+
+static void test_cancel()
+{
+	std::mutex gate;
+	std::atomic<int> num_started(0);
+
+	std::unique_lock<std::mutex> lock(gate);
+
+	worker_queue<int, int> queue(4, 1, [&](int &&value) { num_started++; const std::lock_guard<std::mutex> wait(gate); return value; });
+
+	for (int i = 0; i < 5; ++i)
+		queue.enqueue(int(i));
+
+	// Cancel while the first request is still being worked on
+	CHECK(wait_until([&num_started]() { return num_started == 1; }));
+	queue.cancel();
+	lock.unlock();
+
+	// Its result is stale and dropped, as are all requests that were still queued
+	CHECK(wait_until([&queue]() { return queue.pending() == 0; }));
+	CHECK_EQUAL(queue.process(std::chrono::hours(1), [](int) { }), 0u);
+	CHECK_EQUAL(num_started.load(), 1);
+
+	// New requests work as usual afterwards
+	queue.enqueue(42);
+	int result = 0;
+	CHECK(wait_until([&]() { return queue.process(std::chrono::hours(1), [&result](int value) { result = value; }) == 1; }));
+	CHECK_EQUAL(result, 42);
+}
+
+int main()
+{
+	test_order();
+	test_bounded();
+	test_budget();
+	test_cancel();
+
+	return TEST_RESULT();
+}